@@ -63,9 +63,9 @@ typedef struct {
 	int error;
 	unsigned int activated:1;	/* PipeWire is activated? */
 	unsigned int drained:1;
-	unsigned int draining:1;
 
 	snd_pcm_uframes_t hw_ptr;
+	snd_pcm_uframes_t held;		/* frames between hw_ptr and appl_ptr */
 	snd_pcm_uframes_t boundary;
 	snd_pcm_uframes_t min_avail;
 	unsigned int sample_bits;
@@ -82,6 +82,14 @@ typedef struct {
 	struct pw_stream *stream;
 	struct spa_hook stream_listener;
 
+	struct pw_buffer *buffers[MAX_BUFFERS];
+	uint32_t n_buffers;
+	/* playback: free buffers, the first one is being filled.
+	 * capture: filled buffers, the first one is being read. */
+	struct pw_buffer *queue[MAX_BUFFERS];
+	uint32_t queue_head;
+	uint32_t n_queue;
+
         struct spa_audio_info_raw format;
 } snd_pcm_pipewire_t;
 
@@ -157,164 +165,289 @@ static int snd_pcm_pipewire_poll_revents(snd_pcm_ioplug_t *io,
 	return 0;
 }
 
-static snd_pcm_sframes_t snd_pcm_pipewire_pointer(snd_pcm_ioplug_t *io)
+static inline uint32_t buffer_frames(struct pw_buffer *b)
 {
-	snd_pcm_pipewire_t *pw = io->private_data;
-	if (pw->error < 0)
-		return pw->error;
-	return pw->hw_ptr;
+	return (uint32_t)(uintptr_t)b->user_data;
+}
+
+static inline void set_buffer_frames(struct pw_buffer *b, uint32_t frames)
+{
+	b->user_data = (void*)(uintptr_t)frames;
 }
 
-static int
-snd_pcm_pipewire_process_playback(snd_pcm_pipewire_t *pw, struct pw_buffer *b, snd_pcm_uframes_t *hw_avail)
+static void make_areas(snd_pcm_pipewire_t *pw, void *ptr, snd_pcm_channel_area_t *areas)
 {
 	snd_pcm_ioplug_t *io = &pw->io;
-	const snd_pcm_channel_area_t *areas;
-	snd_pcm_channel_area_t *pwareas;
-	snd_pcm_uframes_t xfer = 0;
-	unsigned int channel, bps, bpf;
-	snd_pcm_uframes_t nframes;
-	uint32_t offset, index = 0, nbytes, avail, maxsize;
-	int32_t filled;
-	void *ptr;
-	struct spa_data *d;
+	unsigned int channel, bps = io->channels * pw->sample_bits;
 
-	bps = io->channels * pw->sample_bits;
-	bpf = bps / 8;
+	for (channel = 0; channel < io->channels; channel++) {
+		areas[channel].addr = ptr;
+		areas[channel].first = channel * pw->sample_bits;
+		areas[channel].step = bps;
+	}
+}
 
-	pwareas = alloca(io->channels * sizeof(snd_pcm_channel_area_t));
+static inline struct pw_buffer *peek_buffer(snd_pcm_pipewire_t *pw)
+{
+	return pw->n_queue > 0 ? pw->queue[pw->queue_head] : NULL;
+}
 
-	d = b->buffer->datas;
+static inline void push_buffer(snd_pcm_pipewire_t *pw, struct pw_buffer *b)
+{
+	pw->queue[(pw->queue_head + pw->n_queue) % MAX_BUFFERS] = b;
+	pw->n_queue++;
+}
 
-	maxsize = d[0].maxsize;
+static inline void pop_buffer(snd_pcm_pipewire_t *pw)
+{
+	pw->queue_head = (pw->queue_head + 1) % MAX_BUFFERS;
+	pw->n_queue--;
+}
 
-	filled = 0;
-	index = 0;
-	avail = maxsize - filled;
-	avail = SPA_MIN(avail, pw->min_avail * bpf);
-	avail = SPA_MIN(avail, *hw_avail * bpf);
+/* hand the buffer we are filling to PipeWire, its frames stay in
+ * flight until the buffer is recycled */
+static void queue_playback(snd_pcm_pipewire_t *pw)
+{
+	struct pw_buffer *b = peek_buffer(pw);
+	struct spa_data *d;
+	uint32_t bpf = (pw->io.channels * pw->sample_bits) / 8;
 
-	do {
-	offset = index % maxsize;
-	nbytes = SPA_MIN(avail, maxsize - offset);
+	if (b == NULL || buffer_frames(b) == 0)
+		return;
 
-	ptr = SPA_MEMBER(d[0].data, offset, void);
+	d = b->buffer->datas;
+	d[0].chunk->offset = 0;
+	d[0].chunk->size = buffer_frames(b) * bpf;
+	d[0].chunk->stride = bpf;
 
-	nframes = nbytes / bpf;
-	pw_log_trace(NAME" %p: %d %d %lu %d %d %p %d", pw, nbytes, avail, nframes, filled, offset, ptr, io->state);
+	pop_buffer(pw);
+	pw_stream_queue_buffer(pw->stream, b);
+}
 
-	for (channel = 0; channel < io->channels; channel++) {
-		pwareas[channel].addr = ptr;
-		pwareas[channel].first = channel * pw->sample_bits;
-		pwareas[channel].step = bps;
-	}
+/* collect the buffers that PipeWire is done with. For playback, the frames
+ * in recycled buffers have been consumed. For capture, the dequeued buffers
+ * contain new frames. */
+static void update_buffers(snd_pcm_pipewire_t *pw)
+{
+	snd_pcm_ioplug_t *io = &pw->io;
+	uint32_t bpf = (io->channels * pw->sample_bits) / 8;
+	struct pw_buffer *b;
 
-	if (io->state != SND_PCM_STATE_RUNNING && io->state != SND_PCM_STATE_DRAINING) {
-		pw_log_trace(NAME" %p: silence %lu frames %d", pw, nframes, io->state);
-		for (channel = 0; channel < io->channels; channel++)
-			snd_pcm_area_silence(&pwareas[channel], 0, nframes, io->format);
-		goto done;
+	if (pw->stream == NULL || bpf == 0)
+		return;
+
+	while (pw->n_queue < MAX_BUFFERS &&
+	    (b = pw_stream_dequeue_buffer(pw->stream)) != NULL) {
+		if (io->stream == SND_PCM_STREAM_PLAYBACK) {
+			pw->held -= SPA_MIN(pw->held, buffer_frames(b));
+			set_buffer_frames(b, 0);
+		} else {
+			struct spa_data *d = b->buffer->datas;
+			uint32_t offset = SPA_MIN(d[0].chunk->offset, d[0].maxsize);
+			uint32_t frames = SPA_MIN(d[0].chunk->size, d[0].maxsize - offset) / bpf;
+
+			if (frames == 0 || pw->held + frames > io->buffer_size) {
+				pw_log_trace(NAME" %p: overrun, drop %u frames", pw, frames);
+				pw_stream_queue_buffer(pw->stream, b);
+				continue;
+			}
+			pw->held += frames;
+			set_buffer_frames(b, 0);
+		}
+		push_buffer(pw, b);
 	}
+}
 
-	areas = snd_pcm_ioplug_mmap_areas(io);
+/* forget all frames in our buffers, used when the ALSA pointers reset */
+static void reset_buffers(snd_pcm_pipewire_t *pw)
+{
+	uint32_t i;
 
-	xfer = 0;
-	while (xfer < nframes) {
-		snd_pcm_uframes_t frames = nframes - xfer;
-		snd_pcm_uframes_t offset = pw->hw_ptr % io->buffer_size;
-		snd_pcm_uframes_t cont = io->buffer_size - offset;
+	if (pw->io.stream == SND_PCM_STREAM_CAPTURE) {
+		struct pw_buffer *b;
+		while ((b = peek_buffer(pw)) != NULL) {
+			pop_buffer(pw);
+			pw_stream_queue_buffer(pw->stream, b);
+		}
+	}
+	for (i = 0; i < pw->n_buffers; i++)
+		set_buffer_frames(pw->buffers[i], 0);
+	pw->held = 0;
+}
 
-		if (cont < frames)
-			frames = cont;
+static snd_pcm_sframes_t snd_pcm_pipewire_pointer(snd_pcm_ioplug_t *io)
+{
+	snd_pcm_pipewire_t *pw = io->private_data;
+	snd_pcm_uframes_t hw_ptr;
 
-		snd_pcm_areas_copy(pwareas, xfer,
-				   areas, offset,
-				   io->channels, frames, io->format);
+	if (pw->error < 0)
+		return pw->error;
 
-		pw->hw_ptr += frames;
-		if (pw->hw_ptr > pw->boundary)
-			pw->hw_ptr -= pw->boundary;
-		xfer += frames;
+	pw_thread_loop_lock(pw->main_loop);
+	update_buffers(pw);
+
+	/* the hardware pointer is the application pointer minus the frames
+	 * that PipeWire did not consume yet (playback) or plus the frames that
+	 * the application did not read yet (capture) */
+	if (io->stream == SND_PCM_STREAM_PLAYBACK) {
+		hw_ptr = io->appl_ptr;
+		if (hw_ptr < pw->held)
+			hw_ptr += pw->boundary;
+		hw_ptr -= pw->held;
+	} else {
+		hw_ptr = io->appl_ptr + pw->held;
+		if (hw_ptr >= pw->boundary)
+			hw_ptr -= pw->boundary;
 	}
-	*hw_avail -= xfer;
+	pw->hw_ptr = hw_ptr;
+	pw_thread_loop_unlock(pw->main_loop);
 
-      done:
-	index += nbytes;
-	avail -= nbytes;
-	} while (avail > 0);
+	return hw_ptr;
+}
 
-	d[0].chunk->offset = 0;
-	d[0].chunk->size = index;
-	d[0].chunk->stride = 0;
+/* wait for PipeWire to recycle a playback buffer, called with the lock */
+static int wait_buffer(snd_pcm_pipewire_t *pw)
+{
+	snd_pcm_ioplug_t *io = &pw->io;
+	struct pollfd pfd = { .fd = pw->fd, .events = POLLIN };
+	int res, timeout;
+	uint64_t val;
 
+	/* when the buffers can't hold the start threshold, nothing would
+	 * ever be recycled before ALSA starts us, start early */
+	if (!pw->activated) {
+		pw_stream_set_active(pw->stream, true);
+		pw->activated = true;
+	}
+	timeout = SPA_MAX(1000lu * io->buffer_size * 2 / io->rate, 100lu);
+
+	pw_thread_loop_unlock(pw->main_loop);
+	res = poll(&pfd, 1, timeout);
+	if (res > 0)
+		spa_system_eventfd_read(pw->system, pw->fd, &val);
+	pw_thread_loop_lock(pw->main_loop);
+
+	if (pw->error < 0)
+		return pw->error;
+	if (res < 0)
+		return errno == EINTR ? 0 : -errno;
+	if (res == 0)
+		return -EIO;
+	update_buffers(pw);
 	return 0;
 }
 
-static int
-snd_pcm_pipewire_process_record(snd_pcm_pipewire_t *pw, struct pw_buffer *b, snd_pcm_uframes_t *hw_avail)
+/* copy the application frames straight into the PipeWire buffers */
+static snd_pcm_sframes_t
+snd_pcm_pipewire_transfer_playback(snd_pcm_pipewire_t *pw, const snd_pcm_channel_area_t *areas,
+		snd_pcm_uframes_t offset, snd_pcm_uframes_t size)
 {
 	snd_pcm_ioplug_t *io = &pw->io;
-	const snd_pcm_channel_area_t *areas;
 	snd_pcm_channel_area_t *pwareas;
 	snd_pcm_uframes_t xfer = 0;
-	unsigned int channel, bps, bpf;
-	snd_pcm_uframes_t nframes;
-	uint32_t offset, index = 0, nbytes, avail, maxsize;
-	struct spa_data *d;
-	void *ptr;
-
-	bps = io->channels * pw->sample_bits;
-	bpf = bps / 8;
+	uint32_t bpf = (io->channels * pw->sample_bits) / 8;
+	int res = 0;
 
 	pwareas = alloca(io->channels * sizeof(snd_pcm_channel_area_t));
 
-	d = b->buffer->datas;
+	while (xfer < size) {
+		struct pw_buffer *b;
+		struct spa_data *d;
+		uint32_t filled, max, frames;
 
-	maxsize = d[0].chunk->size;
-	avail = SPA_MIN(maxsize, *hw_avail * bpf);
-	index = d[0].chunk->offset;
+		if ((b = peek_buffer(pw)) == NULL) {
+			if (io->nonblock) {
+				res = -EAGAIN;
+				break;
+			}
+			if ((res = wait_buffer(pw)) < 0)
+				break;
+			continue;
+		}
+		d = b->buffer->datas;
+		filled = buffer_frames(b);
+		max = SPA_MIN(d[0].maxsize / bpf, pw->min_avail);
+		frames = SPA_MIN(size - xfer, max - filled);
 
-	do {
-	avail = SPA_MIN(avail, pw->min_avail * bpf);
-	offset = index % maxsize;
-	nbytes = SPA_MIN(avail, maxsize - offset);
-	ptr = SPA_MEMBER(d[0].data, offset, void);
+		make_areas(pw, d[0].data, pwareas);
+		snd_pcm_areas_copy(pwareas, filled, areas, offset + xfer,
+				io->channels, frames, io->format);
 
-	pw_log_trace(NAME" %p: %d %d %d %p", pw, nbytes, avail, offset, ptr);
-	nframes = nbytes / bpf;
+		set_buffer_frames(b, filled + frames);
+		pw->held += frames;
+		xfer += frames;
 
-	for (channel = 0; channel < io->channels; channel++) {
-		pwareas[channel].addr = ptr;
-		pwareas[channel].first = channel * pw->sample_bits;
-		pwareas[channel].step = bps;
+		if (filled + frames >= max)
+			queue_playback(pw);
 	}
+	pw_log_trace(NAME" %p: transfer %lu/%lu held:%lu", pw, xfer, size, pw->held);
 
-	areas = snd_pcm_ioplug_mmap_areas(io);
+	return xfer > 0 ? (snd_pcm_sframes_t)xfer : res;
+}
 
-	xfer = 0;
-	while (xfer < nframes) {
-		snd_pcm_uframes_t frames = nframes - xfer;
-		snd_pcm_uframes_t offset = pw->hw_ptr % io->buffer_size;
-		snd_pcm_uframes_t cont = io->buffer_size - offset;
+/* copy the captured frames straight out of the PipeWire buffers */
+static snd_pcm_sframes_t
+snd_pcm_pipewire_transfer_record(snd_pcm_pipewire_t *pw, const snd_pcm_channel_area_t *areas,
+		snd_pcm_uframes_t offset, snd_pcm_uframes_t size)
+{
+	snd_pcm_ioplug_t *io = &pw->io;
+	snd_pcm_channel_area_t *pwareas;
+	snd_pcm_uframes_t xfer = 0;
+	uint32_t bpf = (io->channels * pw->sample_bits) / 8;
+	struct pw_buffer *b;
 
-		if (cont < frames)
-			frames = cont;
+	pwareas = alloca(io->channels * sizeof(snd_pcm_channel_area_t));
+
+	while (xfer < size && (b = peek_buffer(pw)) != NULL) {
+		struct spa_data *d = b->buffer->datas;
+		uint32_t start = SPA_MIN(d[0].chunk->offset, d[0].maxsize);
+		uint32_t avail = SPA_MIN(d[0].chunk->size, d[0].maxsize - start) / bpf;
+		uint32_t done = buffer_frames(b), frames;
 
-		snd_pcm_areas_copy(areas, offset,
-				   pwareas, xfer,
-				   io->channels, frames, io->format);
+		frames = SPA_MIN(size - xfer, avail - done);
 
-		pw->hw_ptr += frames;
-		if (pw->hw_ptr > pw->boundary)
-			pw->hw_ptr -= pw->boundary;
+		make_areas(pw, SPA_MEMBER(d[0].data, start, void), pwareas);
+		snd_pcm_areas_copy(areas, offset + xfer, pwareas, done,
+				io->channels, frames, io->format);
+
+		pw->held -= frames;
 		xfer += frames;
+
+		if (done + frames >= avail) {
+			pop_buffer(pw);
+			pw_stream_queue_buffer(pw->stream, b);
+		} else {
+			set_buffer_frames(b, done + frames);
+		}
 	}
-	*hw_avail -= xfer;
-	avail -= nbytes;
-	index += nbytes;
-	} while (avail > 0);
+	pw_log_trace(NAME" %p: transfer %lu/%lu held:%lu", pw, xfer, size, pw->held);
 
-	return 0;
+	return xfer > 0 ? (snd_pcm_sframes_t)xfer : -EAGAIN;
+}
+
+static snd_pcm_sframes_t snd_pcm_pipewire_transfer(snd_pcm_ioplug_t *io,
+		const snd_pcm_channel_area_t *areas,
+		snd_pcm_uframes_t offset, snd_pcm_uframes_t size)
+{
+	snd_pcm_pipewire_t *pw = io->private_data;
+	snd_pcm_sframes_t res;
+
+	if (pw->error < 0)
+		return pw->error;
+
+	pw_thread_loop_lock(pw->main_loop);
+	if (pw->stream == NULL) {
+		res = -EBADFD;
+	} else {
+		update_buffers(pw);
+		if (io->stream == SND_PCM_STREAM_PLAYBACK)
+			res = snd_pcm_pipewire_transfer_playback(pw, areas, offset, size);
+		else
+			res = snd_pcm_pipewire_transfer_record(pw, areas, offset, size);
+	}
+	pw_thread_loop_unlock(pw->main_loop);
+
+	return res;
 }
 
 static void on_stream_param_changed(void *data, uint32_t id, const struct spa_pod *param)
@@ -333,7 +466,10 @@ static void on_stream_param_changed(void *data, uint32_t id, const struct spa_po
 		return;
 
 	io->period_size = pw->min_avail;
-	buffers = SPA_CLAMP(io->buffer_size / io->period_size, MIN_BUFFERS, MAX_BUFFERS);
+	/* enough buffers to hold the complete ALSA buffer and one that is
+	 * being filled */
+	buffers = SPA_CLAMP((io->buffer_size + io->period_size - 1) / io->period_size + 1,
+			MIN_BUFFERS, MAX_BUFFERS);
 	size = io->period_size * stride;
 
 	pw_log_info(NAME" %p: buffer_size:%lu period_size:%lu buffers:%u stride:%u size:%u min_avail:%lu",
@@ -350,44 +486,37 @@ static void on_stream_param_changed(void *data, uint32_t id, const struct spa_po
 	pw_stream_update_params(pw->stream, params, n_params);
 }
 
-static void on_stream_process(void *data)
+static void on_stream_add_buffer(void *data, struct pw_buffer *b)
 {
 	snd_pcm_pipewire_t *pw = data;
-	snd_pcm_ioplug_t *io = &pw->io;
-	struct pw_buffer *b;
-	snd_pcm_uframes_t hw_avail;
-
-	hw_avail = snd_pcm_ioplug_hw_avail(io, pw->hw_ptr, io->appl_ptr);
 
-	if (pw->drained) {
-		pcm_poll_unblock_check(io); /* unblock socket for polling if needed */
-		return;
-	}
-
-	b = pw_stream_dequeue_buffer(pw->stream);
-	if (b == NULL)
-		return;
+	set_buffer_frames(b, 0);
+	if (pw->n_buffers < MAX_BUFFERS)
+		pw->buffers[pw->n_buffers++] = b;
+}
 
-	if (io->stream == SND_PCM_STREAM_PLAYBACK)
-		snd_pcm_pipewire_process_playback(pw, b, &hw_avail);
-	else
-		snd_pcm_pipewire_process_record(pw, b, &hw_avail);
+static void on_stream_remove_buffer(void *data, struct pw_buffer *b)
+{
+	snd_pcm_pipewire_t *pw = data;
 
-	pw_stream_queue_buffer(pw->stream, b);
+	/* the buffers are renegotiated, the frames in them are lost */
+	pw->n_buffers = 0;
+	pw->n_queue = 0;
+	pw->held = 0;
+}
 
-	if (io->state == SND_PCM_STATE_DRAINING && !pw->draining && hw_avail == 0) {
-		pw_stream_flush(pw->stream, true);
-		pw->draining = true;
-		pw->drained = false;
-	}
-	pcm_poll_unblock_check(io); /* unblock socket for polling if needed */
+/* the data is exchanged in the application thread, we only need to wake
+ * it up here */
+static void on_stream_process(void *data)
+{
+	snd_pcm_pipewire_t *pw = data;
+	pcm_poll_unblock_check(&pw->io); /* unblock socket for polling if needed */
 }
 
 static void on_stream_drained(void *data)
 {
 	snd_pcm_pipewire_t *pw = data;
 	pw->drained = true;
-	pw->draining = false;
 	pw_log_debug(NAME" %p: drained", pw);
 	pw_thread_loop_signal(pw->main_loop, false);
 }
@@ -395,6 +524,8 @@ static void on_stream_drained(void *data)
 static const struct pw_stream_events stream_events = {
 	PW_VERSION_STREAM_EVENTS,
         .param_changed = on_stream_param_changed,
+        .add_buffer = on_stream_add_buffer,
+        .remove_buffer = on_stream_remove_buffer,
         .process = on_stream_process,
         .drained = on_stream_drained,
 };
@@ -406,7 +537,11 @@ static int snd_pcm_pipewire_drain(snd_pcm_ioplug_t *io)
 
 	pw_thread_loop_lock(pw->main_loop);
 	pw->drained = false;
-	pw->draining = false;
+	if (pw->stream != NULL && pw->activated) {
+		if (io->stream == SND_PCM_STREAM_PLAYBACK)
+			queue_playback(pw);
+		pw_stream_flush(pw->stream, true);
+	}
 	while (!pw->drained && pw->error >= 0 && pw->activated) {
 		pw_thread_loop_wait(pw->main_loop);
 	}
@@ -481,6 +616,7 @@ static int snd_pcm_pipewire_prepare(snd_pcm_ioplug_t *io)
 
 done:
 	pw->hw_ptr = 0;
+	reset_buffers(pw);
 
 	pw_thread_loop_unlock(pw->main_loop);
 
@@ -516,6 +652,9 @@ static int snd_pcm_pipewire_stop(snd_pcm_ioplug_t *io)
 	if (pw->activated && pw->stream != NULL) {
 		pw_stream_set_active(pw->stream, false);
 		pw->activated = false;
+		/* drop the queued frames, they are recycled as empty buffers */
+		if (io->stream == SND_PCM_STREAM_PLAYBACK)
+			pw_stream_flush(pw->stream, false);
 	}
 	pw_thread_loop_unlock(pw->main_loop);
 	return 0;
@@ -752,6 +891,7 @@ static snd_pcm_ioplug_callback_t pipewire_pcm_callback = {
 	.start = snd_pcm_pipewire_start,
 	.stop = snd_pcm_pipewire_stop,
 	.pointer = snd_pcm_pipewire_pointer,
+	.transfer = snd_pcm_pipewire_transfer,
 	.drain = snd_pcm_pipewire_drain,
 	.prepare = snd_pcm_pipewire_prepare,
 	.poll_revents = snd_pcm_pipewire_poll_revents,
@@ -950,7 +1090,7 @@ static int snd_pcm_pipewire_open(snd_pcm_t **pcmp, const char *name,
 	pw->io.private_data = pw;
 	pw->io.poll_fd = pw->fd;
 	pw->io.poll_events = POLLIN;
-	pw->io.mmap_rw = 1;
+	pw->io.mmap_rw = 0;
 
 	if ((err = snd_pcm_ioplug_create(&pw->io, name, stream, mode)) < 0)
 		goto error;
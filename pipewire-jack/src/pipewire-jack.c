@@ -41,9 +41,12 @@
 
 #include <spa/support/cpu.h>
 #include <spa/param/audio/format-utils.h>
+#include <spa/param/latency-utils.h>
+#include <spa/param/props.h>
 #include <spa/param/video/format-utils.h>
 #include <spa/debug/types.h>
 #include <spa/debug/pod.h>
+#include <spa/control/merge.h>
 
 #include <pipewire/pipewire.h>
 #include <pipewire/private.h>
@@ -130,6 +133,12 @@ struct object {
 			uint32_t monitor_requests;
 			jack_latency_range_t capture_latency;
 			jack_latency_range_t playback_latency;
+			/* total latency of our ports, set by the graph and
+			 * indexed by spa direction */
+			struct spa_latency_info latency[2];
+			bool have_latency[2];
+			/* latency our port adds, published to the graph */
+			jack_latency_range_t own_latency[2];
 			int32_t priority;
 		} port;
 	};
@@ -199,6 +208,9 @@ struct port {
 	unsigned int empty_out:1;
 	unsigned int zeroed:1;
 
+	uint32_t cycle;			/* cycle of out_ptr */
+	void *out_ptr;			/* output buffer handed out in cycle */
+
 	float *emptyptr;
 	float empty[MAX_BUFFER_FRAMES + MAX_ALIGN];
 };
@@ -303,6 +315,7 @@ struct client {
 	struct spa_io_position *position;
 	uint32_t sample_rate;
 	uint32_t buffer_frames;
+	uint32_t cycle;
 
 	struct mix mix_pool[MAX_MIX];
 	struct spa_list free_mix;
@@ -325,6 +338,8 @@ struct client {
 		struct spa_list target_links;
 	} rt;
 
+	const char *rt_affinity;		/* CPUs of the realtime threads */
+
 	unsigned int started:1;
 	unsigned int active:1;
 	unsigned int destroyed:1;
@@ -334,6 +349,7 @@ struct client {
 	unsigned int allow_mlock:1;
 	unsigned int timemaster_pending:1;
 	unsigned int timemaster_conditional:1;
+	unsigned int freewheeling:1;
 
 	jack_position_t jack_position;
 	jack_transport_state_t jack_state;
@@ -464,9 +480,13 @@ static struct port * alloc_port(struct client *c, enum spa_direction direction)
 	o->id = SPA_ID_INVALID;
 	o->port.node_id = c->node_id;
 	o->port.port_id = p->id;
+	o->port.have_latency[SPA_DIRECTION_INPUT] = false;
+	o->port.have_latency[SPA_DIRECTION_OUTPUT] = false;
+	spa_zero(o->port.own_latency);
 
 	p->valid = true;
 	p->zeroed = false;
+	p->out_ptr = NULL;
 	p->client = c;
 	p->object = o;
 	spa_list_init(&p->mix);
@@ -738,38 +758,20 @@ static void convert_from_midi(void *midi, void *buffer, size_t size)
 
 static void convert_to_midi(struct spa_pod_sequence **seq, uint32_t n_seq, void *midi)
 {
-	struct spa_pod_control *c[n_seq];
-	uint32_t i;
-
-	for (i = 0; i < n_seq; i++)
-		c[i] = spa_pod_control_first(&seq[i]->body);
-
-	while (true) {
-		struct spa_pod_control *next = NULL;
-		uint32_t next_index = 0;
-
-		for (i = 0; i < n_seq; i++) {
-			if (!spa_pod_control_is_inside(&seq[i]->body,
-						SPA_POD_BODY_SIZE(seq[i]), c[i]))
-				continue;
-
-			if (next == NULL || c[i]->offset < next->offset) {
-				next = c[i];
-				next_index = i;
-			}
-		}
-		if (SPA_UNLIKELY(next == NULL))
-			break;
+	struct spa_control_merge_item items[n_seq];
+	struct spa_control_merge merge;
+	struct spa_pod_control *c;
 
-		switch(next->type) {
+	spa_control_merge_init(&merge, items, seq, n_seq);
+	while ((c = spa_control_merge_next(&merge)) != NULL) {
+		switch(c->type) {
 		case SPA_CONTROL_Midi:
 			jack_midi_event_write(midi,
-					next->offset,
-					SPA_POD_BODY(&next->value),
-					SPA_POD_BODY_SIZE(&next->value));
+					c->offset,
+					SPA_POD_BODY(&c->value),
+					SPA_POD_BODY_SIZE(&c->value));
 			break;
 		}
-		c[next_index] = spa_pod_control_next(c[next_index]);
 	}
 }
 
@@ -990,6 +992,17 @@ static inline void check_sample_rate(struct client *c, struct spa_io_position *p
 	}
 }
 
+static inline void check_freewheel(struct client *c, struct spa_io_position *pos)
+{
+	bool freewheeling = SPA_FLAG_IS_SET(pos->clock.flags, SPA_IO_CLOCK_FLAG_FREEWHEEL);
+	if (SPA_UNLIKELY(freewheeling != c->freewheeling)) {
+		pw_log_info(NAME" %p: freewheel %d", c, freewheeling);
+		c->freewheeling = freewheeling;
+		if (c->freewheel_callback)
+			c->freewheel_callback(freewheeling, c->freewheel_arg);
+	}
+}
+
 static inline uint32_t cycle_run(struct client *c)
 {
 	uint64_t cmd;
@@ -1011,6 +1024,7 @@ static inline uint32_t cycle_run(struct client *c)
 	clock_gettime(CLOCK_MONOTONIC, &ts);
 	activation->status = PW_NODE_ACTIVATION_AWAKE;
 	activation->awake_time = SPA_TIMESPEC_TO_NSEC(&ts);
+	c->cycle++;
 
 	if (SPA_UNLIKELY(c->first)) {
 		if (c->thread_init_callback)
@@ -1025,6 +1039,7 @@ static inline uint32_t cycle_run(struct client *c)
 
 	check_buffer_frames(c, pos);
 	check_sample_rate(c, pos);
+	check_freewheel(c, pos);
 
 	if (SPA_LIKELY(driver)) {
 		c->jack_state = position_to_jack(driver, &c->jack_position);
@@ -1491,6 +1506,115 @@ static int param_io(struct client *c, struct port *p,
 	return 1;
 }
 
+/* the latency our port adds, the graph adds it to the totals */
+static int param_latency(struct client *c, struct port *p, enum spa_direction direction,
+		struct spa_pod **param, struct spa_pod_builder *b)
+{
+	jack_latency_range_t *range = &p->object->port.own_latency[direction];
+	struct spa_latency_info info;
+
+	info = SPA_LATENCY_INFO(direction,
+			.min_rate = range->min,
+			.max_rate = range->max);
+	*param = spa_latency_build(b, SPA_PARAM_Latency, &info);
+	return 1;
+}
+
+/* send all params of the port, they replace the ones the server has */
+static int port_update_params(struct client *c, struct port *p,
+		const struct spa_port_info *info)
+{
+	struct spa_pod *params[6];
+	uint8_t buffer[4096];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+
+	param_enum_format(c, p, &params[0], &b);
+	param_format(c, p, &params[1], &b);
+	param_buffers(c, p, &params[2], &b);
+	param_io(c, p, &params[3], &b);
+	param_latency(c, p, SPA_DIRECTION_INPUT, &params[4], &b);
+	param_latency(c, p, SPA_DIRECTION_OUTPUT, &params[5], &b);
+
+	return pw_client_node_port_update(c->node,
+					 p->direction,
+					 p->id,
+					 PW_CLIENT_NODE_PORT_UPDATE_PARAMS |
+					 (info ? PW_CLIENT_NODE_PORT_UPDATE_INFO : 0),
+					 6,
+					 (const struct spa_pod **) params,
+					 info);
+}
+
+/* JACK clients set the absolute latency of a port. For an output port in
+ * capture and an input port in playback it includes the totals of our
+ * ports on the other side, which the graph adds again. We publish only what
+ * the port adds itself. */
+static void port_own_latency(struct client *c, struct port *p,
+		enum spa_direction direction, jack_latency_range_t *own)
+{
+	struct object *o = p->object;
+	jack_latency_range_t *range = direction == SPA_DIRECTION_OUTPUT ?
+		&o->port.capture_latency : &o->port.playback_latency;
+	enum spa_direction other = SPA_DIRECTION_REVERSE(p->direction);
+	uint64_t min = 0, max = 0, qmin, qmax;
+	bool have = false;
+	int i;
+
+	own->min = own->max = 0;
+	if (p->direction != direction)
+		return;
+
+	for (i = 0; i < MAX_PORTS; i++) {
+		struct port *q = &c->port_pool[other][i];
+
+		if (!q->valid || !q->object->port.have_latency[direction])
+			continue;
+
+		spa_latency_info_get_samples(&q->object->port.latency[direction],
+				jack_get_buffer_size((jack_client_t *) c),
+				jack_get_sample_rate((jack_client_t *) c), &qmin, &qmax);
+		min = have ? SPA_MIN(min, qmin) : qmin;
+		max = SPA_MAX(max, qmax);
+		have = true;
+	}
+	own->min = range->min > min ? range->min - min : 0;
+	own->max = range->max > max ? range->max - max : 0;
+}
+
+/* publish a new own latency of the port, the graph recalculates the totals
+ * when the port info changes */
+static void port_update_latency(struct client *c, struct port *p,
+		enum spa_direction direction)
+{
+	struct object *o = p->object;
+	jack_latency_range_t own;
+	struct spa_port_info port_info;
+	struct spa_param_info port_params[5];
+
+	port_own_latency(c, p, direction, &own);
+	if (own.min == o->port.own_latency[direction].min &&
+	    own.max == o->port.own_latency[direction].max)
+		return;
+
+	o->port.own_latency[direction] = own;
+
+	pw_log_debug(NAME" %p: port %p own %s latency %u-%u", c, p,
+			direction == SPA_DIRECTION_OUTPUT ? "capture" : "playback",
+			own.min, own.max);
+
+	port_info = SPA_PORT_INFO_INIT();
+	port_info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
+	port_params[0] = SPA_PARAM_INFO(SPA_PARAM_EnumFormat, SPA_PARAM_INFO_READ);
+	port_params[1] = SPA_PARAM_INFO(SPA_PARAM_Buffers, SPA_PARAM_INFO_READ);
+	port_params[2] = SPA_PARAM_INFO(SPA_PARAM_IO, SPA_PARAM_INFO_READ);
+	port_params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
+	port_params[4] = SPA_PARAM_INFO(SPA_PARAM_Latency, SPA_PARAM_INFO_READ);
+	port_info.params = port_params;
+	port_info.n_params = 5;
+
+	port_update_params(c, p, &port_info);
+}
+
 static int port_set_format(struct client *c, struct port *p,
 		uint32_t flags, const struct spa_pod *param)
 {
@@ -1541,6 +1665,47 @@ static int port_set_format(struct client *c, struct port *p,
 	return 0;
 }
 
+static void port_set_latency(struct client *c, struct port *p, const struct spa_pod *param)
+{
+	struct object *o = p->object;
+	struct spa_latency_info info;
+
+	if (param == NULL) {
+		o->port.have_latency[SPA_DIRECTION_INPUT] = false;
+		o->port.have_latency[SPA_DIRECTION_OUTPUT] = false;
+		return;
+	}
+	if (spa_latency_parse(param, &info) < 0)
+		return;
+
+	if (o->port.have_latency[info.direction] &&
+	    spa_latency_info_is_equal(&o->port.latency[info.direction], &info))
+		return;
+
+	o->port.latency[info.direction] = info;
+	o->port.have_latency[info.direction] = true;
+
+	pw_log_debug(NAME" %p: port %p %s latency changed", c, p,
+			info.direction == SPA_DIRECTION_OUTPUT ? "capture" : "playback");
+
+	/* the ports on the other side include this total in their range */
+	if (p->direction != info.direction) {
+		enum spa_direction other = SPA_DIRECTION_REVERSE(p->direction);
+		int i;
+
+		for (i = 0; i < MAX_PORTS; i++) {
+			struct port *q = &c->port_pool[other][i];
+			if (q->valid)
+				port_update_latency(c, q, info.direction);
+		}
+	}
+
+	if (c->latency_callback)
+		c->latency_callback(info.direction == SPA_DIRECTION_OUTPUT ?
+				JackCaptureLatency : JackPlaybackLatency,
+				c->latency_arg);
+}
+
 static int client_node_port_set_param(void *object,
                                 enum spa_direction direction,
                                 uint32_t port_id,
@@ -1549,28 +1714,21 @@ static int client_node_port_set_param(void *object,
 {
 	struct client *c = (struct client *) object;
 	struct port *p = GET_PORT(c, direction, port_id);
-	struct spa_pod *params[4];
-	uint8_t buffer[4096];
-	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
 
 	pw_log_debug("port %p: %d.%d id:%d %p", p, direction, port_id, id, param);
 
+	/* the graph sets the total latency, it does not replace the latency
+	 * we publish in our params */
+	if (id == SPA_PARAM_Latency) {
+		port_set_latency(c, p, param);
+		return 0;
+	}
+
         if (id == SPA_PARAM_Format) {
 		port_set_format(c, p, flags, param);
 	}
 
-	param_enum_format(c, p, &params[0], &b);
-	param_format(c, p, &params[1], &b);
-	param_buffers(c, p, &params[2], &b);
-	param_io(c, p, &params[3], &b);
-
-	return pw_client_node_port_update(c->node,
-					 direction,
-					 port_id,
-					 PW_CLIENT_NODE_PORT_UPDATE_PARAMS,
-					 4,
-					 (const struct spa_pod **) params,
-					 NULL);
+	return port_update_params(c, p, NULL);
 }
 
 static void *init_buffer(struct port *p)
@@ -2222,7 +2380,12 @@ jack_client_t * jack_client_open (const char *client_name,
 
 	client->node_id = SPA_ID_INVALID;
 	strncpy(client->name, client_name, JACK_CLIENT_NAME_SIZE);
-	client->context.loop = pw_thread_loop_new(client_name, NULL);
+	client->rt_affinity = getenv("PIPEWIRE_RT_AFFINITY");
+
+	props = SPA_DICT_INIT(items, 0);
+	if (client->rt_affinity)
+		items[props.n_items++] = SPA_DICT_ITEM_INIT("loop.cpu-exclude", client->rt_affinity);
+	client->context.loop = pw_thread_loop_new(client_name, &props);
 	client->context.context = pw_context_new(
 			pw_thread_loop_get_loop(client->context.loop),
 			pw_properties_new(
@@ -2250,6 +2413,8 @@ jack_client_t * jack_client_open (const char *client_name,
 
 	props = SPA_DICT_INIT(items, 0);
 	items[props.n_items++] = SPA_DICT_ITEM_INIT("loop.cancel", "true");
+	if (client->rt_affinity)
+		items[props.n_items++] = SPA_DICT_ITEM_INIT("loop.cpu-affinity", client->rt_affinity);
 	client->loop = pw_data_loop_new(&props);
 	if (client->loop == NULL)
 		goto init_failed;
@@ -2894,11 +3059,85 @@ int jack_set_latency_callback (jack_client_t *client,
 	return 0;
 }
 
+static void freewheel_node_param(void *object, int seq,
+		uint32_t id, uint32_t index, uint32_t next,
+		const struct spa_pod *param)
+{
+	bool *supported = object;
+	uint32_t prop_id;
+
+	if (id != SPA_PARAM_PropInfo)
+		return;
+	if (spa_pod_parse_object(param,
+			SPA_TYPE_OBJECT_PropInfo, NULL,
+			SPA_PROP_INFO_id, SPA_POD_Id(&prop_id)) < 0)
+		return;
+	if (prop_id == SPA_PROP_freewheel)
+		*supported = true;
+}
+
+static const struct pw_node_events freewheel_node_events = {
+	PW_VERSION_NODE_EVENTS,
+	.param = freewheel_node_param,
+};
+
 SPA_EXPORT
 int jack_set_freewheel(jack_client_t* client, int onoff)
 {
-	pw_log_warn(NAME" %p: not implemented %d", client, onoff);
-	return -ENOTSUP;
+	struct client *c = (struct client *) client;
+	struct pw_proxy *proxy;
+	struct spa_hook listener;
+	uint8_t buffer[1024];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	bool supported = false;
+	int res = 0;
+
+	spa_return_val_if_fail(c != NULL, -EINVAL);
+
+	pw_log_info(NAME" %p: freewheel %d driver:%u", client, onoff, c->driver_id);
+
+	if (c->position == NULL || c->driver_id == SPA_ID_INVALID)
+		return -EIO;
+
+	/* freewheel is a property of the driver of our graph, the driver
+	 * tells us when it changed with the clock flags */
+	pw_thread_loop_lock(c->context.loop);
+	proxy = pw_registry_bind(c->registry, c->driver_id,
+			PW_TYPE_INTERFACE_Node, PW_VERSION_NODE, 0);
+	if (proxy == NULL) {
+		res = -errno;
+		goto done;
+	}
+
+	/* only drivers that know the freewheel property can do it */
+	spa_zero(listener);
+	pw_node_add_listener((struct pw_node*)proxy, &listener,
+			&freewheel_node_events, &supported);
+	pw_node_enum_params((struct pw_node*)proxy, 0,
+			SPA_PARAM_PropInfo, 0, UINT32_MAX, NULL);
+	if ((res = do_sync(c)) < 0)
+		goto done_proxy;
+
+	if (!supported) {
+		pw_log_warn(NAME" %p: driver %u can't freewheel", c, c->driver_id);
+		res = -ENOTSUP;
+		goto done_proxy;
+	}
+
+	pw_node_set_param((struct pw_node*)proxy,
+			SPA_PARAM_Props, 0,
+			spa_pod_builder_add_object(&b,
+				SPA_TYPE_OBJECT_Props, SPA_PARAM_Props,
+				SPA_PROP_freewheel, SPA_POD_Bool(onoff != 0)));
+	res = do_sync(c);
+
+done_proxy:
+	spa_hook_remove(&listener);
+	pw_proxy_destroy(proxy);
+done:
+	pw_thread_loop_unlock(c->context.loop);
+
+	return res;
 }
 
 SPA_EXPORT
@@ -2986,9 +3225,9 @@ jack_port_t * jack_port_register (jack_client_t *client,
 	struct spa_dict_item items[10];
 	struct object *o;
 	jack_port_type_id_t type_id;
-	uint8_t buffer[1024];
+	uint8_t buffer[2048];
 	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
-	struct spa_pod *params[4];
+	struct spa_pod *params[5];
 	uint32_t n_params = 0;
 	struct port *p;
 	int res;
@@ -3037,12 +3276,15 @@ jack_port_t * jack_port_register (jack_client_t *client,
 	port_params[1] = SPA_PARAM_INFO(SPA_PARAM_Buffers, SPA_PARAM_INFO_READ);
 	port_params[2] = SPA_PARAM_INFO(SPA_PARAM_IO, SPA_PARAM_INFO_READ);
 	port_params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
+	port_params[4] = SPA_PARAM_INFO(SPA_PARAM_Latency, SPA_PARAM_INFO_READ);
 	port_info.params = port_params;
-	port_info.n_params = 4;
+	port_info.n_params = 5;
 
 	param_enum_format(c, p, &params[n_params++], &b);
 	param_buffers(c, p, &params[n_params++], &b);
 	param_io(c, p, &params[n_params++], &b);
+	param_latency(c, p, SPA_DIRECTION_INPUT, &params[n_params++], &b);
+	param_latency(c, p, SPA_DIRECTION_OUTPUT, &params[n_params++], &b);
 
 	pw_thread_loop_lock(c->context.loop);
 
@@ -3173,6 +3415,11 @@ static inline void *get_buffer_output_float(struct client *c, struct port *p, ja
 {
 	void *ptr;
 
+	/* clients can ask for the buffer more than once in a cycle, they
+	 * must get the same memory each time */
+	if (p->cycle == c->cycle && p->out_ptr != NULL)
+		return p->out_ptr;
+
 	ptr = get_buffer_output(c, p, frames, sizeof(float));
 	if (SPA_UNLIKELY(ptr == NULL)) {
 		p->empty_out = true;
@@ -3180,6 +3427,8 @@ static inline void *get_buffer_output_float(struct client *c, struct port *p, ja
 	} else {
 		p->empty_out = false;
 	}
+	p->cycle = c->cycle;
+	p->out_ptr = ptr;
 	return ptr;
 }
 
@@ -3826,10 +4075,22 @@ SPA_EXPORT
 void jack_port_get_latency_range (jack_port_t *port, jack_latency_callback_mode_t mode, jack_latency_range_t *range)
 {
 	struct object *o = (struct object *) port;
+	enum spa_direction direction;
 
 	spa_return_if_fail(o != NULL);
 
-	if (mode == JackCaptureLatency) {
+	direction = mode == JackCaptureLatency ? SPA_DIRECTION_OUTPUT : SPA_DIRECTION_INPUT;
+
+	if (o->port.have_latency[direction]) {
+		jack_client_t *client = (jack_client_t *) o->client;
+		uint64_t min, max;
+
+		spa_latency_info_get_samples(&o->port.latency[direction],
+				jack_get_buffer_size(client), jack_get_sample_rate(client),
+				&min, &max);
+		range->min = min;
+		range->max = max;
+	} else if (mode == JackCaptureLatency) {
 		*range = o->port.capture_latency;
 	} else {
 		*range = o->port.playback_latency;
@@ -3840,20 +4101,50 @@ SPA_EXPORT
 void jack_port_set_latency_range (jack_port_t *port, jack_latency_callback_mode_t mode, jack_latency_range_t *range)
 {
 	struct object *o = (struct object *) port;
+	struct client *c;
+	enum spa_direction direction;
+	jack_latency_range_t *current;
+	struct port *p;
 
 	spa_return_if_fail(o != NULL);
+	spa_return_if_fail(range != NULL);
 
 	if (mode == JackCaptureLatency) {
-		o->port.capture_latency = *range;
+		direction = SPA_DIRECTION_OUTPUT;
+		current = &o->port.capture_latency;
 	} else {
-		o->port.playback_latency = *range;
+		direction = SPA_DIRECTION_INPUT;
+		current = &o->port.playback_latency;
 	}
+	if (current->min == range->min && current->max == range->max)
+		return;
+
+	*current = *range;
+
+	/* only our own ports publish a latency */
+	c = o->client;
+	if (o->type != INTERFACE_Port || o->port.port_id == SPA_ID_INVALID || c == NULL)
+		return;
+
+	/* report our range until the graph sends the new total */
+	o->port.have_latency[direction] = false;
+
+	pw_log_debug(NAME" %p: port %p %s latency %u-%u", c, o,
+			mode == JackCaptureLatency ? "capture" : "playback",
+			range->min, range->max);
+
+	pw_thread_loop_lock(c->context.loop);
+
+	p = GET_PORT(c, GET_DIRECTION(o->port.flags), o->port.port_id);
+	port_update_latency(c, p, direction);
+
+	pw_thread_loop_unlock(c->context.loop);
 }
 
 SPA_EXPORT
 int jack_recompute_total_latencies (jack_client_t *client)
 {
-	pw_log_warn(NAME" %p: not implemented", client);
+	/* the graph updates the totals when something changes */
 	return 0;
 }
 
@@ -3878,14 +4169,23 @@ SPA_EXPORT
 jack_nframes_t jack_port_get_total_latency (jack_client_t *client,
 					    jack_port_t *port)
 {
-	pw_log_warn(NAME" %p: not implemented %p", client, port);
-	return 0;
+	struct object *o = (struct object *) port;
+	jack_latency_range_t range;
+
+	spa_return_val_if_fail(o != NULL, 0);
+
+	if (o->port.flags & JackPortIsOutput)
+		jack_port_get_latency_range(port, JackCaptureLatency, &range);
+	else
+		jack_port_get_latency_range(port, JackPlaybackLatency, &range);
+
+	return range.max;
 }
 
 SPA_EXPORT
 int jack_recompute_total_latency (jack_client_t *client, jack_port_t* port)
 {
-	pw_log_warn(NAME" %p: not implemented %p", client, port);
+	/* the graph updates the totals when something changes */
 	return 0;
 }
 
@@ -4477,13 +4777,22 @@ int jack_client_create_thread (jack_client_t* client,
                                void *(*start_routine)(void*),
                                void *arg)
 {
+	struct client *c = (struct client *) client;
+	int res;
+
 	spa_return_val_if_fail(client != NULL, -EINVAL);
 
 	if (globals.creator == NULL)
 		globals.creator = pthread_create;
 
 	pw_log_debug("client %p: create thread", client);
-	return globals.creator(thread, NULL, start_routine, arg);
+	if ((res = globals.creator(thread, NULL, start_routine, arg)) != 0)
+		return res;
+
+	if (c->rt_affinity)
+		pw_thread_set_affinity(*thread, c->rt_affinity, !realtime);
+
+	return 0;
 }
 
 SPA_EXPORT
@@ -40,9 +40,94 @@ int pa_context_set_error(PA_CONST pa_context *c, int error) {
 	return error;
 }
 
+#define HASH_MIN_SIZE	64
+
+static inline uint32_t name_hash(const char *str)
+{
+	/* FNV-1a */
+	uint32_t h = 2166136261u;
+	while (*str)
+		h = (h ^ (uint8_t)*str++) * 16777619u;
+	return h;
+}
+
+/* true when a comes before b in the global list */
+static inline bool global_before(struct global *a, struct global *b)
+{
+	if (a->priority_master != b->priority_master)
+		return a->priority_master > b->priority_master;
+	return a->serial < b->serial;
+}
+
+static void hash_add(pa_context *c, struct global *g)
+{
+	uint32_t mask = c->hash_size - 1;
+	struct global **b;
+
+	b = &c->id_hash[g->id & mask];
+	g->id_next = *b;
+	*b = g;
+
+	if (g->name != NULL) {
+		b = &c->name_hash[g->name_hash & mask];
+		g->name_next = *b;
+		*b = g;
+	}
+}
+
+static void hash_remove(pa_context *c, struct global *g)
+{
+	uint32_t mask = c->hash_size - 1;
+	struct global **b;
+
+	for (b = &c->id_hash[g->id & mask]; *b; b = &(*b)->id_next) {
+		if (*b == g) {
+			*b = g->id_next;
+			break;
+		}
+	}
+	if (g->name != NULL) {
+		for (b = &c->name_hash[g->name_hash & mask]; *b; b = &(*b)->name_next) {
+			if (*b == g) {
+				*b = g->name_next;
+				break;
+			}
+		}
+	}
+}
+
+static int hash_resize(pa_context *c, uint32_t size)
+{
+	struct global **id_hash, **name_hash, *g;
+
+	id_hash = calloc(size, sizeof(struct global *));
+	name_hash = calloc(size, sizeof(struct global *));
+	if (id_hash == NULL || name_hash == NULL) {
+		free(id_hash);
+		free(name_hash);
+		return -errno;
+	}
+	free(c->id_hash);
+	free(c->name_hash);
+	c->id_hash = id_hash;
+	c->name_hash = name_hash;
+	c->hash_size = size;
+
+	spa_list_for_each(g, &c->globals, link)
+		hash_add(c, g);
+
+	return 0;
+}
+
 static void global_free(pa_context *c, struct global *g)
 {
+	uint32_t i;
+
 	spa_list_remove(&g->link);
+	for (i = 0; i < g->n_lists; i++)
+		spa_list_remove(&g->lists[i].link);
+	hash_remove(c, g);
+	c->n_globals--;
 
 	if (g->destroy)
 		g->destroy(g);
@@ -125,42 +210,49 @@ pa_context *pa_context_new(pa_mainloop_api *mainloop, const char *name)
 struct global *pa_context_find_global(pa_context *c, uint32_t id)
 {
 	struct global *g;
-	spa_list_for_each(g, &c->globals, link) {
+
+	for (g = c->id_hash[id & (c->hash_size - 1)]; g; g = g->id_next) {
 		if (g->id == id)
 			return g;
 	}
 	return NULL;
 }
 
-struct global *pa_context_find_global_by_name(pa_context *c, uint32_t mask, const char *name)
+static inline struct global *first_global(struct global *a, struct global *b)
 {
-	struct global *g;
-	const char *str;
-	uint32_t id = atoi(name);
+	return a == NULL || (b != NULL && global_before(b, a)) ? b : a;
+}
 
-	spa_list_for_each(g, &c->globals, link) {
-		if ((g->mask & mask) == 0)
+struct global *pa_context_find_global_by_name(pa_context *c, uint32_t mask, const char *name)
+{
+	struct global *g, *f = NULL;
+	uint32_t id = atoi(name), hash = name_hash(name);
+
+	/* return the first match in the global list, on the node name or
+	 * on the index */
+	for (g = c->name_hash[hash & (c->hash_size - 1)]; g; g = g->name_next) {
+		if ((g->mask & mask) == 0 || g->name_hash != hash ||
+		    strcmp(g->name, name) != 0)
 			continue;
-		if (g->props != NULL &&
-		    (str = pw_properties_get(g->props, PW_KEY_NODE_NAME)) != NULL &&
-		    strcmp(str, name) == 0)
-			return g;
-		if (g->id == id || (g->id == (id & PA_IDX_MASK_DSP)))
-			return g;
+		f = first_global(f, g);
 	}
-	return NULL;
+	if ((g = pa_context_find_global(c, id)) != NULL && (g->mask & mask))
+		f = first_global(f, g);
+	if ((g = pa_context_find_global(c, id & PA_IDX_MASK_DSP)) != NULL && (g->mask & mask))
+		f = first_global(f, g);
+
+	return f;
 }
 
 struct global *pa_context_find_linked(pa_context *c, uint32_t idx)
 {
+	struct global_link *l;
 	struct global *g, *f;
 
-	spa_list_for_each(g, &c->globals, link) {
+	spa_list_for_each(l, &c->global_lists[PA_GLOBAL_LIST_LINK], link) {
 		uint32_t src_node_id, dst_node_id;
 
-		if (strcmp(g->type, PW_TYPE_INTERFACE_Link) != 0)
-			continue;
-
+		g = l->global;
 		src_node_id = g->link_info.src->port_info.node_id;
 		dst_node_id = g->link_info.dst->port_info.node_id;
 
@@ -379,6 +471,15 @@ static void node_event_info(void *object, const struct pw_node_info *info)
 	pw_log_debug("update %d %"PRIu64, g->id, info->change_mask);
 	g->info = pw_node_info_update(g->info, info);
 
+	if (info->change_mask & PW_NODE_CHANGE_MASK_PROPS) {
+		/* the props are complete, drop the keys that were removed */
+		if (g->node_info.proplist) {
+			pa_proplist_clear(g->node_info.proplist);
+			pa_proplist_update_dict(g->node_info.proplist, info->props);
+		} else
+			g->node_info.proplist = pa_proplist_new_dict(info->props);
+	}
+
 	if (info->change_mask & PW_NODE_CHANGE_MASK_PARAMS && !g->subscribed) {
 		uint32_t subscribed[32], n_subscribed = 0;
 
@@ -463,6 +564,8 @@ static const struct pw_node_events node_events = {
 static void node_destroy(void *data)
 {
 	struct global *global = data;
+	if (global->node_info.proplist)
+		pa_proplist_free(global->node_info.proplist);
 	if (global->info)
 		pw_node_info_free(global->info);
 }
@@ -715,17 +818,45 @@ static int set_mask(pa_context *c, struct global *g)
 	return 1;
 }
 
+static void insert_global_list(pa_context *c, struct global *global, uint32_t index)
+{
+	struct global_link *l, *t;
+
+	l = &global->lists[global->n_lists++];
+	l->global = global;
+
+	spa_list_for_each(t, &c->global_lists[index], link) {
+		if (t->global->priority_master < global->priority_master)
+			break;
+	}
+	spa_list_append(&t->link, &l->link);
+}
+
 static inline void insert_global(pa_context *c, struct global *global)
 {
-	struct global *g, *t;
+	struct global *g;
+	uint32_t mask;
 
-	spa_list_for_each_safe(g, t, &c->globals, link) {
-		if (g->priority_master < global->priority_master) {
-			g = spa_list_prev(g, link);
+	if (c->n_globals >= c->hash_size)
+		hash_resize(c, c->hash_size * 2);
+
+	global->serial = c->serial++;
+	hash_add(c, global);
+	c->n_globals++;
+
+	/* keep the list sorted on priority, globals with the same priority
+	 * stay in the order they were added */
+	spa_list_for_each(g, &c->globals, link) {
+		if (g->priority_master < global->priority_master)
 			break;
-		}
 	}
-	spa_list_prepend(&g->link, &global->link);
+	spa_list_append(&g->link, &global->link);
+
+	for (mask = global->mask; mask && global->n_lists < SPA_N_ELEMENTS(global->lists);
+			mask &= mask - 1)
+		insert_global_list(c, global, __builtin_ctz(mask));
+	if (strcmp(global->type, PW_TYPE_INTERFACE_Link) == 0)
+		insert_global_list(c, global, PA_GLOBAL_LIST_LINK);
 }
 
 static void registry_event_global(void *data, uint32_t id,
@@ -743,6 +874,8 @@ static void registry_event_global(void *data, uint32_t id,
 	g->type = strdup(type);
 	g->init = true;
 	g->props = props ? pw_properties_new_dict(props) : NULL;
+	if (g->props && (g->name = pw_properties_get(g->props, PW_KEY_NODE_NAME)) != NULL)
+		g->name_hash = name_hash(g->name);
 
 	res = set_mask(c, g);
 	insert_global(c, g);
@@ -886,6 +1019,7 @@ pa_context *pa_context_new_with_proplist(pa_mainloop_api *mainloop, const char *
 	struct pw_loop *loop;
 	struct pw_properties *props;
 	pa_context *c;
+	uint32_t i;
 
 	pa_assert(mainloop);
 
@@ -902,6 +1036,15 @@ pa_context *pa_context_new_with_proplist(pa_mainloop_api *mainloop, const char *
 		return NULL;
 
 	c = pw_context_get_user_data(context);
+	spa_list_init(&c->globals);
+	for (i = 0; i < PA_GLOBAL_N_LISTS; i++)
+		spa_list_init(&c->global_lists[i]);
+	if (hash_resize(c, HASH_MIN_SIZE) < 0) {
+		pw_context_destroy(context);
+		pw_properties_free(props);
+		return NULL;
+	}
+
 	c->props = props;
 	c->loop = loop;
 	c->context = context;
@@ -916,8 +1059,6 @@ pa_context *pa_context_new_with_proplist(pa_mainloop_api *mainloop, const char *
 	c->error = 0;
 	c->state = PA_CONTEXT_UNCONNECTED;
 
-	spa_list_init(&c->globals);
-
 	spa_list_init(&c->streams);
 	spa_list_init(&c->operations);
 
@@ -941,6 +1082,8 @@ static void context_free(pa_context *c)
 		pa_proplist_free(c->proplist);
 	if (c->core_info)
 		pw_core_info_free(c->core_info);
+	free(c->id_hash);
+	free(c->name_hash);
 
 	pa_mainloop_api_once(c->mainloop, do_context_destroy, c);
 }
@@ -223,12 +223,30 @@ struct param {
 #define PA_IDX_FLAG_DSP		0x800000U
 #define PA_IDX_MASK_DSP		0x7fffffU
 
+/* globals are also kept in a list per subscription mask bit and in a
+ * list of links, in the same order as the global list */
+#define PA_GLOBAL_LIST_LINK	10
+#define PA_GLOBAL_N_LISTS	11
+
+struct global_link {
+	struct spa_list link;
+	struct global *global;
+};
+
 struct global {
 	struct spa_list link;
 	uint32_t id;
 	char *type;
 	struct pw_properties *props;
 
+	struct global *id_next;		/**< next global in the id hash bucket */
+	struct global *name_next;	/**< next global in the name hash bucket */
+	const char *name;		/**< the node name, owned by props */
+	uint32_t name_hash;
+	uint32_t serial;		/**< insertion order */
+	uint32_t n_lists;
+	struct global_link lists[2];
+
 	pa_context *context;
 	pa_subscription_mask_t mask;
 	pa_subscription_event_type_t event;
@@ -260,6 +278,7 @@ struct global {
 			uint32_t n_channel_volumes;
 			float channel_volumes[SPA_AUDIO_MAX_CHANNELS];
 			uint32_t device_id;
+			pa_proplist *proplist;	/**< properties for the info replies */
 		} node_info;
 		struct {
 			uint32_t node_id;
@@ -311,6 +330,12 @@ struct pa_context {
 	pa_subscription_mask_t subscribe_mask;
 
 	struct spa_list globals;
+	struct spa_list global_lists[PA_GLOBAL_N_LISTS];
+	struct global **id_hash;
+	struct global **name_hash;
+	uint32_t hash_size;
+	uint32_t n_globals;
+	uint32_t serial;
 
 	struct spa_list streams;
 	struct spa_list operations;
@@ -323,6 +348,11 @@ struct global *pa_context_find_global(pa_context *c, uint32_t id);
 struct global *pa_context_find_global_by_name(pa_context *c, uint32_t mask, const char *name);
 struct global *pa_context_find_linked(pa_context *c, uint32_t id);
 
+/** iterate the struct global_link of the globals with \a mask, which
+ * must be a single subscription mask bit */
+#define pa_context_for_each_global(c,mask,l)					\
+	spa_list_for_each(l, &(c)->global_lists[__builtin_ctz(mask)], link)
+
 struct pa_mem {
 	struct spa_list link;
 	void *data;
@@ -365,6 +395,7 @@ struct pa_stream {
 
 	pa_timing_info timing_info;
 	uint64_t ticks_base;
+	uint64_t timing_version;
 	size_t queued_bytes;
 
 	uint32_t direct_on_input;
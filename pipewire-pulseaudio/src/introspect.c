@@ -81,11 +81,9 @@ static int wait_global(pa_context *c, struct global *g, pa_operation *o)
 
 static int wait_globals(pa_context *c, pa_subscription_mask_t mask, pa_operation *o)
 {
-	struct global *g;
-	spa_list_for_each(g, &c->globals, link) {
-		if (!(g->mask & mask))
-			continue;
-		if (wait_global(c, g, o) < 0)
+	struct global_link *l;
+	pa_context_for_each_global(c, mask, l) {
+		if (wait_global(c, l->global, o) < 0)
 			return -EBUSY;
 	}
 	return 0;
@@ -133,7 +131,7 @@ static void sink_callback(struct sink_data *d)
 		  PA_SINK_HW_VOLUME_CTRL | PA_SINK_HW_MUTE_CTRL |
 		  PA_SINK_LATENCY | PA_SINK_DYNAMIC_LATENCY |
 		  PA_SINK_DECIBEL_VOLUME;
-	i.proplist = pa_proplist_new_dict(info->props);
+	i.proplist = g->node_info.proplist;
 	i.configured_latency = 0;
 	i.base_volume = PA_VOLUME_NORM;
 	i.state = node_state_to_sink(info->state);
@@ -148,7 +146,6 @@ static void sink_callback(struct sink_data *d)
 	ip[0] = ii;
 	i.formats = ip;
 	d->cb(d->context, &i, 0, d->userdata);
-	pa_proplist_free(i.proplist);
 	pa_proplist_free(ii[0].plist);
 }
 
@@ -229,14 +226,12 @@ static void sink_info_list(pa_operation *o, void *userdata)
 {
 	struct sink_data *d = userdata;
 	pa_context *c = d->context;
-	struct global *g;
+	struct global_link *l;
 
 	if (wait_globals(c, PA_SUBSCRIPTION_MASK_SINK, o) < 0)
 		return;
-	spa_list_for_each(g, &c->globals, link) {
-		if (!(g->mask & PA_SUBSCRIPTION_MASK_SINK))
-			continue;
-		d->global = g;
+	pa_context_for_each_global(c, PA_SUBSCRIPTION_MASK_SINK, l) {
+		d->global = l->global;
 		sink_callback(d);
 	}
 	d->cb(c, NULL, 1, d->userdata);
@@ -599,7 +594,7 @@ static void source_callback(struct source_data *d)
 	i.latency = 0;
 	i.driver = "PipeWire";
 	i.flags = flags;
-	i.proplist = pa_proplist_new_dict(info->props);
+	i.proplist = g->node_info.proplist;
 	i.configured_latency = 0;
 	i.base_volume = PA_VOLUME_NORM;
 	i.state = node_state_to_source(info->state);
@@ -614,7 +609,6 @@ static void source_callback(struct source_data *d)
 	ip[0] = ii;
 	i.formats = ip;
 	d->cb(d->context, &i, 0, d->userdata);
-	pa_proplist_free(i.proplist);
 	pa_proplist_free(ii[0].plist);
 }
 
@@ -698,14 +692,12 @@ static void source_info_list(pa_operation *o, void *userdata)
 {
 	struct source_data *d = userdata;
 	pa_context *c = d->context;
-	struct global *g;
+	struct global_link *l;
 
 	if (wait_globals(c, PA_SUBSCRIPTION_MASK_SOURCE, o) < 0)
 		return;
-	spa_list_for_each(g, &c->globals, link) {
-		if (!(g->mask & PA_SUBSCRIPTION_MASK_SOURCE))
-			continue;
-		d->global = g;
+	pa_context_for_each_global(c, PA_SUBSCRIPTION_MASK_SOURCE, l) {
+		d->global = l->global;
 		source_callback(d);
 	}
 	d->cb(c, NULL, 1, d->userdata);
@@ -1046,12 +1038,10 @@ static void module_info_list(pa_operation *o, void *userdata)
 {
 	struct module_data *d = userdata;
 	pa_context *c = d->context;
-	struct global *g;
+	struct global_link *l;
 
-	spa_list_for_each(g, &c->globals, link) {
-		if (!(g->mask & PA_SUBSCRIPTION_MASK_MODULE))
-			continue;
-		d->global = g;
+	pa_context_for_each_global(c, PA_SUBSCRIPTION_MASK_MODULE, l) {
+		d->global = l->global;
 		module_callback(d);
 	}
 	d->cb(c, NULL, 1, d->userdata);
@@ -1165,12 +1155,10 @@ static void client_info_list(pa_operation *o, void *userdata)
 {
 	struct client_data *d = userdata;
 	pa_context *c = d->context;
-	struct global *g;
+	struct global_link *l;
 
-	spa_list_for_each(g, &c->globals, link) {
-		if (!(g->mask & PA_SUBSCRIPTION_MASK_CLIENT))
-			continue;
-		d->global = g;
+	pa_context_for_each_global(c, PA_SUBSCRIPTION_MASK_CLIENT, l) {
+		d->global = l->global;
 		client_callback(d);
 	}
 	d->cb(c, NULL, 1, d->userdata);
@@ -1365,14 +1353,12 @@ static void card_info_list(pa_operation *o, void *userdata)
 {
 	struct card_data *d = userdata;
 	pa_context *c = d->context;
-	struct global *g;
+	struct global_link *l;
 
 	if (wait_globals(c, PA_SUBSCRIPTION_MASK_CARD, o) < 0)
 		return;
-	spa_list_for_each(g, &c->globals, link) {
-		if (!(g->mask & PA_SUBSCRIPTION_MASK_CARD))
-			continue;
-		d->global = g;
+	pa_context_for_each_global(c, PA_SUBSCRIPTION_MASK_CARD, l) {
+		d->global = l->global;
 		card_callback(d);
 	}
 	d->cb(c, NULL, 1, d->userdata);
@@ -1679,14 +1665,12 @@ static void sink_input_info_list(pa_operation *o, void *userdata)
 {
 	struct sink_input_data *d = userdata;
 	pa_context *c = d->context;
-	struct global *g;
+	struct global_link *l;
 
 	if (wait_globals(c, PA_SUBSCRIPTION_MASK_SINK_INPUT, o) < 0)
 		return;
-	spa_list_for_each(g, &c->globals, link) {
-		if (!(g->mask & PA_SUBSCRIPTION_MASK_SINK_INPUT))
-			continue;
-		d->global = g;
+	pa_context_for_each_global(c, PA_SUBSCRIPTION_MASK_SINK_INPUT, l) {
+		d->global = l->global;
 		sink_input_callback(d);
 	}
 	d->cb(c, NULL, 1, d->userdata);
@@ -1987,15 +1971,13 @@ static void source_output_info_list(pa_operation *o, void *userdata)
 {
 	struct source_output_data *d = userdata;
 	pa_context *c = d->context;
-	struct global *g;
+	struct global_link *l;
 
 	if (wait_globals(c, PA_SUBSCRIPTION_MASK_SOURCE_OUTPUT, o) < 0)
 		return;
 
-	spa_list_for_each(g, &c->globals, link) {
-		if (!(g->mask & PA_SUBSCRIPTION_MASK_SOURCE_OUTPUT))
-			continue;
-		d->global = g;
+	pa_context_for_each_global(c, PA_SUBSCRIPTION_MASK_SOURCE_OUTPUT, l) {
+		d->global = l->global;
 		source_output_callback(d);
 	}
 	d->cb(c, NULL, 1, d->userdata);
@@ -430,12 +430,19 @@ static void stream_remove_buffer(void *data, struct pw_buffer *buffer)
 
 static void update_timing_info(pa_stream *s)
 {
-	struct pw_time pwt;
+	struct pw_stream_timing pwt;
 	pa_timing_info *ti = &s->timing_info;
 	size_t stride = pa_frame_size(&s->sample_spec);
 	int64_t delay, pos;
 
-	pw_stream_get_time(s->stream, &pwt);
+	pw_stream_get_timing(s->stream, &pwt, sizeof(pwt));
+
+	/* only the queued data can change until the next cycle */
+	s->queued_bytes = pwt.queued;
+	if (s->timing_info_valid && pwt.version == s->timing_version)
+		return;
+
+	s->timing_version = pwt.version;
 	s->timing_info_valid = false;
 
 	pa_timeval_store(&ti->timestamp, pwt.now / SPA_NSEC_PER_USEC);
@@ -469,7 +476,6 @@ static void update_timing_info(pa_stream *s)
 	}
 	ti->since_underrun = 0;
 	s->timing_info_valid = true;
-	s->queued_bytes = pwt.queued;
 
 	pw_log_debug("stream %p: %"PRIu64" rate:%d/%d ticks:%"PRIu64" pos:%"PRIu64" delay:%"PRIi64 " read:%"PRIu64
 			" write:%"PRIu64" queued:%"PRIi64,
@@ -971,6 +977,11 @@ static int create_stream(pa_stream_direction_t direction,
 		fl |= PW_STREAM_FLAG_EXCLUSIVE;
 	if (flags & PA_STREAM_DONT_MOVE)
 		fl |= PW_STREAM_FLAG_DONT_RECONNECT;
+	/* playback without latency requirements can buffer up to maxlength,
+	 * only wake us up when the queue runs low */
+	if (direction == PA_STREAM_PLAYBACK &&
+	    !(flags & (PA_STREAM_ADJUST_LATENCY | PA_STREAM_EARLY_REQUESTS)))
+		fl |= PW_STREAM_FLAG_LOW_WAKEUP;
 	monitor = (flags & PA_STREAM_PEAK_DETECT);
 
 	if (pa_sample_spec_valid(&s->sample_spec)) {
@@ -0,0 +1,179 @@
+/* Simple Plugin API
+ *
+ * Copyright © 2020 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SPA_CONTROL_MERGE_H
+#define SPA_CONTROL_MERGE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <spa/utils/defs.h>
+#include <spa/pod/pod.h>
+#include <spa/pod/iter.h>
+
+/** Merge sequences
+ *
+ * Iterates the controls of a set of sequences in offset order. The
+ * sequences are kept in a binary min-heap on the offset of their next
+ * control so that getting the next control is O(log n_seq). Controls
+ * with the same offset are returned in the order of the sequences.
+ *
+ * With only a few sequences left, a linear scan over the sequences in
+ * index order is cheaper than the heap. The merge switches from the heap
+ * to the scan when sequences run out.
+ */
+
+#define SPA_CONTROL_MERGE_MAX_SCAN	4
+
+struct spa_control_merge_item {
+	uint64_t key;				/**< offset of control << 32 | index of seq */
+	struct spa_pod_control *control;	/**< next control of seq */
+	const void *end;			/**< end of seq */
+};
+
+struct spa_control_merge {
+	struct spa_control_merge_item *items;	/**< the heap, one item per sequence */
+	uint32_t n_items;
+};
+
+static inline uint64_t spa_control_merge_key(const struct spa_pod_control *control, uint32_t index)
+{
+	return ((uint64_t)control->offset << 32) | index;
+}
+
+static inline bool spa_control_merge_is_inside(const void *end,
+		const struct spa_pod_control *control)
+{
+	return SPA_POD_CONTENTS(struct spa_pod_control, control) <= end &&
+		SPA_MEMBER(control, SPA_POD_CONTROL_SIZE(control), void) <= end;
+}
+
+static inline void spa_control_merge_sift_down(struct spa_control_merge *merge, uint32_t i)
+{
+	struct spa_control_merge_item *items = merge->items, tmp = items[i];
+	uint32_t child, n = merge->n_items;
+
+	while ((child = 2 * i + 1) < n) {
+		if (child + 1 < n && items[child + 1].key < items[child].key)
+			child++;
+		if (tmp.key <= items[child].key)
+			break;
+		items[i] = items[child];
+		i = child;
+	}
+	items[i] = tmp;
+}
+
+/**
+ * Initialize \a merge for the \a n_seq sequences in \a seq. \a items
+ * must have space for \a n_seq items and stay valid while merging.
+ */
+static inline void spa_control_merge_init(struct spa_control_merge *merge,
+		struct spa_control_merge_item *items,
+		struct spa_pod_sequence **seq, uint32_t n_seq)
+{
+	uint32_t i, n = 0;
+
+	for (i = 0; i < n_seq; i++) {
+		struct spa_pod_control *c = spa_pod_control_first(&seq[i]->body);
+		const void *end = SPA_MEMBER(&seq[i]->body, SPA_POD_BODY_SIZE(seq[i]), void);
+
+		if (!spa_control_merge_is_inside(end, c))
+			continue;
+
+		items[n].key = spa_control_merge_key(c, i);
+		items[n].control = c;
+		items[n].end = end;
+		n++;
+	}
+	merge->items = items;
+	merge->n_items = n;
+
+	if (n > SPA_CONTROL_MERGE_MAX_SCAN) {
+		for (i = n / 2; i > 0; i--)
+			spa_control_merge_sift_down(merge, i - 1);
+	}
+}
+
+/* sort the items on the sequence index when switching to the scan */
+static inline void spa_control_merge_sort_index(struct spa_control_merge *merge)
+{
+	struct spa_control_merge_item *items = merge->items, tmp;
+	uint32_t i, j;
+
+	for (i = 1; i < merge->n_items; i++) {
+		tmp = items[i];
+		for (j = i; j > 0 && (uint32_t)items[j - 1].key > (uint32_t)tmp.key; j--)
+			items[j] = items[j - 1];
+		items[j] = tmp;
+	}
+}
+
+/** Get the next control in offset order or NULL when all sequences are done */
+static inline struct spa_pod_control *spa_control_merge_next(struct spa_control_merge *merge)
+{
+	struct spa_control_merge_item *items = merge->items;
+	struct spa_pod_control *c;
+	uint32_t i, min = 0;
+
+	if (merge->n_items > SPA_CONTROL_MERGE_MAX_SCAN) {
+		c = items[0].control;
+		items[0].control = spa_pod_control_next(c);
+		if (spa_control_merge_is_inside(items[0].end, items[0].control)) {
+			items[0].key = spa_control_merge_key(items[0].control, (uint32_t)items[0].key);
+		} else {
+			items[0] = items[--merge->n_items];
+			if (merge->n_items == SPA_CONTROL_MERGE_MAX_SCAN) {
+				spa_control_merge_sort_index(merge);
+				return c;
+			}
+		}
+		spa_control_merge_sift_down(merge, 0);
+		return c;
+	}
+
+	if (merge->n_items == 0)
+		return NULL;
+
+	/* the items are sorted on index, the first smallest offset wins */
+	for (i = 1; i < merge->n_items; i++)
+		if (items[i].control->offset < items[min].control->offset)
+			min = i;
+
+	c = items[min].control;
+	items[min].control = spa_pod_control_next(c);
+	if (!spa_control_merge_is_inside(items[min].end, items[min].control)) {
+		merge->n_items--;
+		for (i = min; i < merge->n_items; i++)
+			items[i] = items[i + 1];
+	}
+	return c;
+}
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif /* SPA_CONTROL_MERGE_H */
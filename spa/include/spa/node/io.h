@@ -54,6 +54,7 @@ enum spa_io_type {
 	SPA_IO_Position,	/**< position information in the graph, struct spa_io_position */
 	SPA_IO_RateMatch,	/**< rate matching between nodes, struct spa_io_rate_match */
 	SPA_IO_Memory,		/**< memory pointer, struct spa_io_memory */
+	SPA_IO_Meter,		/**< audio meter values, struct spa_io_meter */
 };
 
 /**
@@ -125,6 +126,9 @@ struct spa_io_range {
  * since the provider was last started.
  */
 struct spa_io_clock {
+#define SPA_IO_CLOCK_FLAG_FREEWHEEL	(1u<<0)		/**< the graph is not running in real time,
+							  *  cycles start as soon as the previous
+							  *  one completed */
 	uint32_t flags;			/**< clock flags */
 	uint32_t id;			/**< unique clock id, set by application */
 	char name[64];			/**< clock name prefixed with API, set by node. The clock name
@@ -287,6 +291,36 @@ struct spa_io_rate_match {
 	uint32_t padding[7];
 };
 
+/** meter values of one channel */
+struct spa_io_meter_channel {
+	float peak;			/**< max absolute sample value in the last interval */
+	float rms;			/**< RMS value of the last interval */
+	float momentary;		/**< EBU R128 momentary loudness of the channel in
+					  *  LUFS, the K-weighted power of the last 400ms */
+	uint32_t padding;
+};
+
+#define SPA_IO_METER_MAX_CHANNELS	64
+
+/**
+ * Audio meter values.
+ *
+ * The values are updated every interval by the data thread. Readers can
+ * poll the area at their own rate. \a seq is incremented before and after
+ * each update, readers should copy the values and retry when \a seq was
+ * odd or changed while copying.
+ */
+struct spa_io_meter {
+	uint32_t seq;			/**< update sequence number */
+	uint32_t n_channels;		/**< number of valid channels */
+	uint32_t rate;			/**< sample rate */
+	uint32_t interval;		/**< update interval in samples */
+	uint64_t count;			/**< number of updates */
+	float momentary;		/**< EBU R128 momentary loudness of all channels in LUFS */
+	uint32_t padding;
+	struct spa_io_meter_channel channels[SPA_IO_METER_MAX_CHANNELS];
+};
+
 #ifdef __cplusplus
 }  /* extern "C" */
 #endif
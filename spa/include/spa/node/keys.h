@@ -39,6 +39,7 @@ extern "C" {
 #define SPA_KEY_NODE_PAUSE_ON_IDLE	"node.pause-on-idle"	/**< if the node should be paused
 								  *  immediately when idle. */
 #define SPA_KEY_NODE_MONITOR		"node.monitor"		/**< the node has monitor ports */
+#define SPA_KEY_NODE_FREEWHEEL		"node.freewheel"	/**< the driver starts in freewheel mode */
 
 
 /** port keys */
@@ -46,6 +47,13 @@ extern "C" {
 #define SPA_KEY_PORT_ALIAS		"port.alias"		/**< a port alias */
 #define SPA_KEY_PORT_MONITOR		"port.monitor"		/**< this port is a monitor port */
 
+/** meter keys */
+#define SPA_KEY_METER_INTERVAL		"meter.interval"	/**< update interval of the meter values
+								  *  in milliseconds */
+#define SPA_KEY_METER_SHM		"meter.shm"		/**< name of the POSIX shared memory object
+								  *  with the struct spa_io_meter of a
+								  *  meter node */
+
 
 #ifdef __cplusplus
 }  /* extern "C" */
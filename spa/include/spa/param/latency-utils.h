@@ -0,0 +1,142 @@
+/* Simple Plugin API
+ *
+ * Copyright © 2020 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef SPA_PARAM_LATENCY_UTILS_H
+#define SPA_PARAM_LATENCY_UTILS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <spa/pod/parser.h>
+#include <spa/pod/builder.h>
+#include <spa/param/param.h>
+
+/** Latency of a port in one direction
+ *
+ * The latency is the sum of a part relative to the graph quantum, a part
+ * in samples and a part in nanoseconds. Only the quantum and the rate of
+ * the graph are needed to turn it into a number of samples.
+ */
+struct spa_latency_info {
+	enum spa_direction direction;
+	float min_quantum;
+	float max_quantum;
+	uint32_t min_rate;
+	uint32_t max_rate;
+	uint64_t min_ns;
+	uint64_t max_ns;
+};
+
+#define SPA_LATENCY_INFO(dir,...) (struct spa_latency_info) { .direction = (dir), ## __VA_ARGS__ }
+
+static inline bool
+spa_latency_info_is_equal(const struct spa_latency_info *a, const struct spa_latency_info *b)
+{
+	return a->direction == b->direction &&
+		a->min_quantum == b->min_quantum &&
+		a->max_quantum == b->max_quantum &&
+		a->min_rate == b->min_rate &&
+		a->max_rate == b->max_rate &&
+		a->min_ns == b->min_ns &&
+		a->max_ns == b->max_ns;
+}
+
+/** Add the latency of \a other to \a info, for ports in series */
+static inline void
+spa_latency_info_add(struct spa_latency_info *info, const struct spa_latency_info *other)
+{
+	info->min_quantum += other->min_quantum;
+	info->max_quantum += other->max_quantum;
+	info->min_rate += other->min_rate;
+	info->max_rate += other->max_rate;
+	info->min_ns += other->min_ns;
+	info->max_ns += other->max_ns;
+}
+
+/** Combine the latency of \a other with \a info, for parallel paths.
+ * The result covers the range of both. */
+static inline void
+spa_latency_info_combine(struct spa_latency_info *info, const struct spa_latency_info *other)
+{
+	info->min_quantum = SPA_MIN(info->min_quantum, other->min_quantum);
+	info->max_quantum = SPA_MAX(info->max_quantum, other->max_quantum);
+	info->min_rate = SPA_MIN(info->min_rate, other->min_rate);
+	info->max_rate = SPA_MAX(info->max_rate, other->max_rate);
+	info->min_ns = SPA_MIN(info->min_ns, other->min_ns);
+	info->max_ns = SPA_MAX(info->max_ns, other->max_ns);
+}
+
+/** Get the min and max latency in samples for \a quantum and \a rate */
+static inline void
+spa_latency_info_get_samples(const struct spa_latency_info *info,
+		uint32_t quantum, uint32_t rate, uint64_t *min, uint64_t *max)
+{
+	if (min)
+		*min = (uint64_t)(info->min_quantum * quantum) + info->min_rate +
+			info->min_ns * rate / SPA_NSEC_PER_SEC;
+	if (max)
+		*max = (uint64_t)(info->max_quantum * quantum) + info->max_rate +
+			info->max_ns * rate / SPA_NSEC_PER_SEC;
+}
+
+static inline int
+spa_latency_parse(const struct spa_pod *latency, struct spa_latency_info *info)
+{
+	int res;
+	spa_zero(*info);
+	if ((res = spa_pod_parse_object(latency,
+			SPA_TYPE_OBJECT_ParamLatency, NULL,
+			SPA_PARAM_LATENCY_direction, SPA_POD_Id(&info->direction),
+			SPA_PARAM_LATENCY_minQuantum, SPA_POD_OPT_Float(&info->min_quantum),
+			SPA_PARAM_LATENCY_maxQuantum, SPA_POD_OPT_Float(&info->max_quantum),
+			SPA_PARAM_LATENCY_minRate, SPA_POD_OPT_Int(&info->min_rate),
+			SPA_PARAM_LATENCY_maxRate, SPA_POD_OPT_Int(&info->max_rate),
+			SPA_PARAM_LATENCY_minNs, SPA_POD_OPT_Long(&info->min_ns),
+			SPA_PARAM_LATENCY_maxNs, SPA_POD_OPT_Long(&info->max_ns))) < 0)
+		return res;
+	info->direction = (enum spa_direction)(info->direction & 1);
+	return 0;
+}
+
+static inline struct spa_pod *
+spa_latency_build(struct spa_pod_builder *builder, uint32_t id, const struct spa_latency_info *info)
+{
+	return (struct spa_pod *)spa_pod_builder_add_object(builder,
+			SPA_TYPE_OBJECT_ParamLatency, id,
+			SPA_PARAM_LATENCY_direction, SPA_POD_Id(info->direction),
+			SPA_PARAM_LATENCY_minQuantum, SPA_POD_Float(info->min_quantum),
+			SPA_PARAM_LATENCY_maxQuantum, SPA_POD_Float(info->max_quantum),
+			SPA_PARAM_LATENCY_minRate, SPA_POD_Int(info->min_rate),
+			SPA_PARAM_LATENCY_maxRate, SPA_POD_Int(info->max_rate),
+			SPA_PARAM_LATENCY_minNs, SPA_POD_Long(info->min_ns),
+			SPA_PARAM_LATENCY_maxNs, SPA_POD_Long(info->max_ns));
+}
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif /* SPA_PARAM_LATENCY_UTILS_H */
@@ -48,6 +48,7 @@ enum spa_param_type {
 	SPA_PARAM_EnumRoute,		/**< routing enumeration as SPA_TYPE_OBJECT_ParamRoute */
 	SPA_PARAM_Route,		/**< routing configuration as SPA_TYPE_OBJECT_ParamRoute */
 	SPA_PARAM_Control,		/**< Control parameter, a SPA_TYPE_Sequence */
+	SPA_PARAM_Latency,		/**< latency reporting, a SPA_TYPE_OBJECT_ParamLatency */
 };
 
 /** information about a parameter */
@@ -119,6 +120,26 @@ enum spa_param_port_config {
 	SPA_PARAM_PORT_CONFIG_format,		/**< (Object) format filter */
 };
 
+/** properties for SPA_TYPE_OBJECT_ParamLatency
+ *
+ * With direction SPA_DIRECTION_OUTPUT this is the capture latency, the time
+ * since the data on the port was captured. With SPA_DIRECTION_INPUT it is
+ * the playback latency, the time until the data on the port is played.
+ *
+ * Nodes enumerate the latency they add themselves on their ports. The
+ * total latency of the path through a port is set on the port. The latency
+ * is the sum of the quantum, rate and ns parts. */
+enum spa_param_latency {
+	SPA_PARAM_LATENCY_START,
+	SPA_PARAM_LATENCY_direction,	/**< direction, input/output (Id enum spa_direction) */
+	SPA_PARAM_LATENCY_minQuantum,	/**< min latency relative to the quantum (Float) */
+	SPA_PARAM_LATENCY_maxQuantum,	/**< max latency relative to the quantum (Float) */
+	SPA_PARAM_LATENCY_minRate,	/**< min latency in samples (Int) */
+	SPA_PARAM_LATENCY_maxRate,	/**< max latency in samples (Int) */
+	SPA_PARAM_LATENCY_minNs,	/**< min latency in nanoseconds (Long) */
+	SPA_PARAM_LATENCY_maxNs,	/**< max latency in nanoseconds (Long) */
+};
+
 enum spa_param_route_availability {
 	SPA_PARAM_ROUTE_AVAILABILITY_unknown,	/**< unknown if route is available */
 	SPA_PARAM_ROUTE_AVAILABILITY_no,	/**< route is not available */
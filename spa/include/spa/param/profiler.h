@@ -39,6 +39,7 @@ enum spa_profiler {
 	SPA_PROFILER_info,				/**< Generic info, counter and CPU load */
 	SPA_PROFILER_clock,				/**< clock information */
 	SPA_PROFILER_driverBlock,			/**< generic driver info block */
+	SPA_PROFILER_dataThread,			/**< CPU and migrations of the data thread */
 
 	SPA_PROFILER_START_Follower	= 0x20000,	/**< follower related profiler properties */
 	SPA_PROFILER_followerBlock,			/**< generic follower info block */
@@ -63,6 +63,8 @@ extern "C" {
 					"audio.process.deinterleave"	/**< deinterleave raw audio channels */
 #define SPA_NAME_AUDIO_PROCESS_INTERLEAVE	\
 					"audio.process.interleave"	/**< interleave raw audio channels */
+#define SPA_NAME_AUDIO_METER		"audio.meter"			/**< measures the peak, RMS and loudness
+									  *  of raw audio channels */
 
 
 /** audio convert combines some of the audio processing */
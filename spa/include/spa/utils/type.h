@@ -87,6 +87,7 @@ enum {
 	SPA_TYPE_OBJECT_ParamPortConfig,
 	SPA_TYPE_OBJECT_ParamRoute,
 	SPA_TYPE_OBJECT_Profiler,
+	SPA_TYPE_OBJECT_ParamLatency,
 	SPA_TYPE_OBJECT_LAST,			/**< not part of ABI */
 
 	/* vendor extensions */
@@ -425,6 +425,13 @@ impl_node_port_enum_params(void *object, int seq,
 		}
 		break;
 
+	case SPA_PARAM_Latency:
+		if (result.index > 0)
+			return 0;
+
+		param = spa_latency_build(&b, id, &this->latency);
+		break;
+
 	default:
 		return -ENOENT;
 	}
@@ -761,8 +768,14 @@ impl_init(const struct spa_handle_factory *factory,
 	this->port_params[2] = SPA_PARAM_INFO(SPA_PARAM_IO, SPA_PARAM_INFO_READ);
 	this->port_params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
 	this->port_params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, 0);
+	this->port_params[5] = SPA_PARAM_INFO(SPA_PARAM_Latency, SPA_PARAM_INFO_READ);
 	this->port_info.params = this->port_params;
-	this->port_info.n_params = 5;
+	this->port_info.n_params = 6;
+	this->latency = SPA_LATENCY_INFO(SPA_DIRECTION_OUTPUT,
+			.min_quantum = 1.0f,
+			.max_quantum = 1.0f,
+			.min_rate = CAPTURE_HEADROOM,
+			.max_rate = CAPTURE_HEADROOM);
 
 	spa_list_init(&this->free);
 	spa_list_init(&this->ready);
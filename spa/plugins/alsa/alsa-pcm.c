@@ -630,13 +630,16 @@ static int get_status(struct state *state, snd_pcm_uframes_t *delay, snd_pcm_ufr
 	if (state->matching && state->rate_match) {
 		state->delay = state->rate_match->delay;
 		state->read_size = state->rate_match->size;
-		/* We try to compensate for the latency introduced by rate matching
-		 * by moving a little closer to the device read/write pointers.
-		 * Don't try to get closer than 48 samples but instead increase the
-		 * reported latency on the port (TODO). */
-		if (*target <= state->delay + 48)
-			state->delay = SPA_MAX(0, (int)(*target - 48 - state->delay));
-		*target -= state->delay;
+		/* The converter reports the latency introduced by rate matching
+		 * on its port and the graph adds it to ours, so in playback we
+		 * keep the fill level at the quantum. In capture we try to
+		 * compensate by moving a little closer to the device read
+		 * pointer, but not closer than 48 samples. */
+		if (state->stream == SND_PCM_STREAM_CAPTURE) {
+			if (*target <= state->delay + 48)
+				state->delay = SPA_MAX(0, (int)(*target - 48 - state->delay));
+			*target -= state->delay;
+		}
 	} else {
 		state->delay = state->read_size = 0;
 	}
@@ -660,7 +663,7 @@ static int update_time(struct state *state, uint64_t nsec, snd_pcm_sframes_t del
 	if (state->stream == SND_PCM_STREAM_PLAYBACK)
 		err = delay - target;
 	else
-		err = (target + 128) - delay;
+		err = (target + CAPTURE_HEADROOM) - delay;
 
 	if (SPA_UNLIKELY(state->bw == 0.0)) {
 		set_loop(state, BW_MAX);
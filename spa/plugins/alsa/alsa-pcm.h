@@ -44,10 +44,14 @@ extern "C" {
 #include <spa/node/io.h>
 #include <spa/param/param.h>
 #include <spa/param/audio/format-utils.h>
+#include <spa/param/latency-utils.h>
 
 #define MIN_LATENCY	16
 #define MAX_LATENCY	8192
 
+/* samples kept in the capture buffer on top of the quantum */
+#define CAPTURE_HEADROOM	128
+
 #define DEFAULT_RATE		48000u
 #define DEFAULT_CHANNELS	2u
 
@@ -114,6 +118,7 @@ struct state {
 	uint64_t port_info_all;
 	struct spa_port_info port_info;
 	struct spa_param_info port_params[8];
+	struct spa_latency_info latency;
 	struct spa_io_buffers *io;
 	struct spa_io_clock *clock;
 	struct spa_io_position *position;
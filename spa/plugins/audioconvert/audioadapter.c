@@ -37,11 +37,14 @@
 #include <spa/pod/filter.h>
 #include <spa/param/param.h>
 #include <spa/param/audio/format-utils.h>
+#include <spa/param/latency-utils.h>
 #include <spa/debug/format.h>
 #include <spa/debug/pod.h>
 
 #define NAME "audioadapter"
 
+#define MAX_BUFFERS	64
+
 /** \cond */
 
 struct impl {
@@ -71,6 +74,18 @@ struct impl {
 
 	struct spa_io_buffers io_buffers;
 	struct spa_io_rate_match io_rate_match;
+	struct spa_io_clock *clock;
+	struct spa_io_position *position;
+
+	/* what the peer configured on our port, moved between the converter
+	 * and the follower when we switch to passthrough automatically */
+	struct spa_pod *peer_format;
+	uint8_t peer_format_buffer[4096];
+	uint32_t peer_buffers_flags;
+	uint32_t n_peer_buffers;
+	struct spa_buffer *peer_buffers[MAX_BUFFERS];
+	struct spa_io_buffers *peer_io_buffers;
+	struct spa_io_rate_match *peer_io_rate_match;
 
 	uint64_t info_all;
 	struct spa_node_info info;
@@ -83,6 +98,9 @@ struct impl {
 	unsigned int have_format:1;
 	unsigned int started:1;
 	unsigned int master:1;
+	unsigned int removing:1;
+	unsigned int convert_mode:1;
+	unsigned int auto_passthrough:1;
 };
 
 /** \endcond */
@@ -112,8 +130,19 @@ next:
 	spa_pod_builder_init(&b, buffer, sizeof(buffer));
 
 	switch (id) {
-	case SPA_PARAM_EnumPortConfig:
 	case SPA_PARAM_PortConfig:
+		if (this->target != this->follower || this->auto_passthrough)
+			return spa_node_enum_params(this->convert, seq, id, start, num, filter);
+		if (result.index > 0)
+			return 0;
+		param = spa_pod_builder_add_object(&b,
+			SPA_TYPE_OBJECT_ParamPortConfig, id,
+			SPA_PARAM_PORT_CONFIG_direction, SPA_POD_Id(this->direction),
+			SPA_PARAM_PORT_CONFIG_mode,      SPA_POD_Id(SPA_PARAM_PORT_CONFIG_MODE_passthrough));
+		result.next++;
+		break;
+
+	case SPA_PARAM_EnumPortConfig:
 	case SPA_PARAM_PropInfo:
 	case SPA_PARAM_Props:
 		return spa_node_enum_params(this->convert, seq, id, start, num, filter);
@@ -374,6 +403,12 @@ static int configure_format(struct impl *this, uint32_t flags, const struct spa_
 	return res;
 }
 
+static int reconfigure_mode(struct impl *this, bool passthrough,
+		const struct spa_pod *format);
+static bool can_passthrough(struct impl *this, const struct spa_pod *format);
+static bool can_run_passthrough(struct impl *this);
+static int set_auto_passthrough(struct impl *this, bool passthrough);
+
 static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
 			       const struct spa_pod *param)
 {
@@ -399,20 +434,57 @@ static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
 			return -EINVAL;
 
 		this->follower_current_format = info;
+
+		/* the follower no longer runs at the format of the peer */
+		if (this->auto_passthrough && !can_passthrough(this, this->peer_format))
+			res = set_auto_passthrough(this, false);
 		break;
 
 	case SPA_PARAM_PortConfig:
+	{
+		enum spa_direction dir;
+		enum spa_param_port_config_mode mode;
+		struct spa_pod *format = NULL;
+
 		if (this->started)
 			return -EIO;
-		if (this->target != this->follower) {
+
+		if (spa_pod_parse_object(param,
+				SPA_TYPE_OBJECT_ParamPortConfig, NULL,
+				SPA_PARAM_PORT_CONFIG_direction,	SPA_POD_Id(&dir),
+				SPA_PARAM_PORT_CONFIG_mode,		SPA_POD_Id(&mode),
+				SPA_PARAM_PORT_CONFIG_format,		SPA_POD_OPT_Pod(&format)) < 0)
+			return -EINVAL;
+
+		if (dir != this->direction)
+			return -EINVAL;
+
+		if (this->auto_passthrough &&
+		    (res = set_auto_passthrough(this, false)) < 0)
+			return res;
+
+		if (mode == SPA_PARAM_PORT_CONFIG_MODE_passthrough) {
+			if ((res = reconfigure_mode(this, true, format)) < 0)
+				return res;
+		} else {
+			if ((res = reconfigure_mode(this, false, NULL)) < 0)
+				return res;
 			if ((res = spa_node_set_param(this->target, id, flags, param)) < 0)
 				return res;
 		}
+
+		/* the ports are recreated, forget what the peer configured */
+		this->peer_format = NULL;
+		this->n_peer_buffers = 0;
+		this->peer_io_buffers = NULL;
+		this->peer_io_rate_match = NULL;
+		this->convert_mode = mode == SPA_PARAM_PORT_CONFIG_MODE_convert;
 		break;
+	}
 
 	case SPA_PARAM_Props:
-		if (this->target != this->follower) {
-			if ((res = spa_node_set_param(this->target, id, flags, param)) < 0)
+		if (this->target != this->follower || this->auto_passthrough) {
+			if ((res = spa_node_set_param(this->convert, id, flags, param)) < 0)
 				return res;
 		}
 		break;
@@ -430,11 +502,27 @@ static int impl_node_set_io(void *object, uint32_t id, void *data, size_t size)
 
 	spa_return_val_if_fail(this != NULL, -EINVAL);
 
-	if (this->target)
-		res = spa_node_set_io(this->target, id, data, size);
+	/* the converter keeps the node io so that it can take over again
+	 * after an automatic passthrough */
+	if (this->convert)
+		spa_node_set_io(this->convert, id, data, size);
 
-	if (this->target != this->follower)
-		res = spa_node_set_io(this->follower, id, data, size);
+	res = spa_node_set_io(this->follower, id, data, size);
+
+	switch (id) {
+	case SPA_IO_Clock:
+		this->clock = data;
+		break;
+	case SPA_IO_Position:
+		this->position = data;
+		break;
+	default:
+		return res;
+	}
+
+	/* a follower of another driver needs the converter to match rates */
+	if (this->auto_passthrough && !this->started && !can_run_passthrough(this))
+		set_auto_passthrough(this, false);
 
 	return res;
 }
@@ -507,10 +595,15 @@ static int impl_node_send_command(void *object, const struct spa_command *comman
 
 	switch (SPA_NODE_COMMAND_ID(command)) {
 	case SPA_NODE_COMMAND_Start:
-		if ((res = negotiate_format(this)) < 0)
-			return res;
-		if ((res = negotiate_buffers(this)) < 0)
+		if (this->auto_passthrough && !can_run_passthrough(this) &&
+		    (res = set_auto_passthrough(this, false)) < 0)
 			return res;
+		if (this->target != this->follower) {
+			if ((res = negotiate_format(this)) < 0)
+				return res;
+			if ((res = negotiate_buffers(this)) < 0)
+				return res;
+		}
 		this->started = true;
 		break;
 	case SPA_NODE_COMMAND_Suspend:
@@ -569,6 +662,11 @@ static void convert_port_info(void *data,
 {
 	struct impl *this = data;
 
+	if (this->removing)
+		info = NULL;
+	else if (this->target == this->follower && !this->auto_passthrough)
+		return;
+
 	if (direction != this->direction) {
 		if (port_id == 0)
 			return;
@@ -641,6 +739,10 @@ static void follower_port_info(void *data,
 	}
 	if (!this->add_listener)
 		emit_node_info(this, false);
+
+	/* in passthrough the follower port is our port */
+	if (this->target == this->follower && !this->auto_passthrough)
+		spa_node_emit_port_info(&this->hooks, direction, port_id, info);
 }
 
 static const struct spa_node_events follower_node_events = {
@@ -657,7 +759,7 @@ static int follower_ready(void *data, int status)
 
 	this->master = true;
 
-	if (this->direction == SPA_DIRECTION_OUTPUT)
+	if (this->direction == SPA_DIRECTION_OUTPUT && this->target != this->follower)
 		status = spa_node_process(this->convert);
 
 	return spa_node_call_ready(&this->callbacks, status);
@@ -668,7 +770,7 @@ static int follower_reuse_buffer(void *data, uint32_t port_id, uint32_t buffer_i
 	int res;
 	struct impl *this = data;
 
-	if (this->convert)
+	if (this->target != this->follower)
 		res = spa_node_port_reuse_buffer(this->convert, port_id, buffer_id);
 	else
 		res = spa_node_call_reuse_buffer(&this->callbacks, port_id, buffer_id);
@@ -726,6 +828,199 @@ static int impl_node_add_listener(void *object,
 	return 0;
 }
 
+/* Switch between running the follower through the converter and exposing
+ * the follower port directly. In passthrough the follower uses the buffers
+ * and io areas of its peer and the converter is not processed at all. */
+static int reconfigure_mode(struct impl *this, bool passthrough,
+		const struct spa_pod *format)
+{
+	struct spa_node *target = passthrough ? this->follower : this->convert;
+	struct spa_hook l;
+	int res;
+
+	if (passthrough && format != NULL) {
+		uint8_t buffer[4096];
+		struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+		struct spa_pod *param;
+		uint32_t state = 0;
+
+		/* the follower must take the format as is */
+		if ((res = spa_node_port_enum_params_sync(this->follower,
+					this->direction, 0,
+					SPA_PARAM_EnumFormat, &state,
+					format, &param, &b)) != 1) {
+			res = res < 0 ? res : -ENOTSUP;
+			spa_log_debug(this->log, NAME " %p: no passthrough for format: %s",
+					this, spa_strerror(res));
+			return res;
+		}
+	}
+
+	if (this->target == target)
+		return 0;
+
+	spa_log_debug(this->log, NAME " %p: passthrough %d", this, passthrough);
+
+	/* unlink follower and converter */
+	configure_format(this, 0, NULL);
+
+	if (passthrough) {
+		/* remove the converter ports */
+		this->removing = true;
+		spa_zero(l);
+		spa_node_add_listener(this->convert, &l, &convert_node_events, this);
+		spa_hook_remove(&l);
+		this->removing = false;
+
+		spa_node_port_set_io(this->follower, this->direction, 0,
+				SPA_IO_Buffers, NULL, 0);
+		spa_node_port_set_io(this->follower, this->direction, 0,
+				SPA_IO_RateMatch, NULL, 0);
+
+		this->target = this->follower;
+
+		/* and add the follower port */
+		spa_zero(l);
+		spa_node_add_listener(this->follower, &l, &follower_node_events, this);
+		spa_hook_remove(&l);
+	} else {
+		spa_node_emit_port_info(&this->hooks, this->direction, 0, NULL);
+
+		this->target = this->convert;
+
+		if ((res = link_io(this)) < 0)
+			return res;
+
+		spa_zero(l);
+		spa_node_add_listener(this->convert, &l, &convert_node_events, this);
+		spa_hook_remove(&l);
+	}
+	return 0;
+}
+
+/* without the converter nothing matches the rate of the follower to that of
+ * the driver, it must be the driver itself and not be rate matching */
+static bool can_run_passthrough(struct impl *this)
+{
+	if (this->position && this->clock &&
+	    this->position->clock.id != this->clock->id)
+		return false;
+	return !SPA_FLAG_IS_SET(this->io_rate_match.flags, SPA_IO_RATE_MATCH_FLAG_ACTIVE);
+}
+
+/* check if the follower can run at the format of the peer without
+ * converting, it must take the format as is and match the format and
+ * rate the follower was configured with */
+static bool can_passthrough(struct impl *this, const struct spa_pod *format)
+{
+	struct spa_audio_info info = { 0 };
+	struct spa_audio_info_raw *cur = &this->follower_current_format.info.raw;
+	uint8_t buffer[4096];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	struct spa_pod *param;
+	uint32_t state = 0;
+
+	if (format == NULL ||
+	    SPA_POD_SIZE(format) > sizeof(this->peer_format_buffer) ||
+	    !can_run_passthrough(this))
+		return false;
+
+	if (spa_format_parse(format, &info.media_type, &info.media_subtype) < 0 ||
+	    info.media_type != SPA_MEDIA_TYPE_audio ||
+	    info.media_subtype != SPA_MEDIA_SUBTYPE_raw ||
+	    spa_format_audio_raw_parse(format, &info.info.raw) < 0)
+		return false;
+
+	if (cur->format != SPA_AUDIO_FORMAT_UNKNOWN &&
+	    cur->format != info.info.raw.format)
+		return false;
+	if (cur->rate != 0 && cur->rate != info.info.raw.rate)
+		return false;
+	if (cur->channels != 0) {
+		if (cur->channels != info.info.raw.channels)
+			return false;
+		if (!SPA_FLAG_IS_SET(cur->flags, SPA_AUDIO_FLAG_UNPOSITIONED) &&
+		    !SPA_FLAG_IS_SET(info.info.raw.flags, SPA_AUDIO_FLAG_UNPOSITIONED) &&
+		    memcmp(cur->position, info.info.raw.position,
+			    cur->channels * sizeof(uint32_t)) != 0)
+			return false;
+	}
+
+	return spa_node_port_enum_params_sync(this->follower,
+				this->direction, 0,
+				SPA_PARAM_EnumFormat, &state,
+				format, &param, &b) == 1;
+}
+
+/* Switch between the converter and the follower for our port without
+ * changing the port we expose. The format, buffers and io areas of the
+ * peer are moved to the new target. */
+static int set_auto_passthrough(struct impl *this, bool passthrough)
+{
+	struct spa_node *from = this->target;
+	struct spa_node *to = passthrough ? this->follower : this->convert;
+	int res;
+
+	if (from == to)
+		return 0;
+
+	spa_log_info(this->log, NAME " %p: %s passthrough", this,
+			passthrough ? "enter" : "leave");
+
+	/* unlink follower and converter */
+	configure_format(this, 0, NULL);
+
+	spa_node_port_set_io(from, this->direction, 0,
+			SPA_IO_Buffers, NULL, 0);
+	spa_node_port_set_io(from, this->direction, 0,
+			SPA_IO_RateMatch, NULL, 0);
+	spa_node_port_set_param(from, this->direction, 0,
+			SPA_PARAM_Format, 0, NULL);
+
+	this->target = to;
+	this->auto_passthrough = passthrough;
+
+	if (!passthrough && (res = link_io(this)) < 0)
+		return res;
+
+	if (this->peer_format != NULL &&
+	    (res = spa_node_port_set_param(to, this->direction, 0,
+			SPA_PARAM_Format, 0, this->peer_format)) < 0)
+		return res;
+
+	if (this->n_peer_buffers > 0 &&
+	    (res = spa_node_port_use_buffers(to, this->direction, 0,
+			this->peer_buffers_flags,
+			this->peer_buffers, this->n_peer_buffers)) < 0)
+		return res;
+
+	spa_node_port_set_io(to, this->direction, 0, SPA_IO_Buffers,
+			this->peer_io_buffers, sizeof(struct spa_io_buffers));
+
+	if (passthrough) {
+		/* the follower keeps our rate match, it tells us when it
+		 * starts matching rates and needs the converter again */
+		spa_zero(this->io_rate_match);
+		this->io_rate_match.rate = 1.0;
+		spa_node_port_set_io(to, this->direction, 0, SPA_IO_RateMatch,
+				&this->io_rate_match, sizeof(this->io_rate_match));
+	} else {
+		spa_node_port_set_io(to, this->direction, 0, SPA_IO_RateMatch,
+				this->peer_io_rate_match, sizeof(struct spa_io_rate_match));
+	}
+
+	return 0;
+}
+
+/* in automatic passthrough only our port is on the follower, the other
+ * ports stay on the converter */
+static struct spa_node *port_target(struct impl *this, enum spa_direction direction)
+{
+	if (this->auto_passthrough && direction != this->direction)
+		return this->convert;
+	return this->target;
+}
+
 static int
 impl_node_set_callbacks(void *object,
 			const struct spa_node_callbacks *callbacks,
@@ -777,6 +1072,57 @@ impl_node_remove_port(void *object, enum spa_direction direction, uint32_t port_
 	return spa_node_remove_port(this->target, direction, port_id);
 }
 
+/* add the latency of the port of node to info, when it has any */
+static void add_port_latency(struct spa_node *node, enum spa_direction direction,
+		uint32_t port_id, struct spa_latency_info *info)
+{
+	struct spa_latency_info latency;
+	struct spa_pod *param;
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	uint32_t index = 0;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	if (spa_node_port_enum_params_sync(node, direction, port_id,
+				SPA_PARAM_Latency, &index, NULL, &param, &b) != 1)
+		return;
+	if (spa_latency_parse(param, &latency) < 0 ||
+	    latency.direction != info->direction)
+		return;
+	spa_latency_info_add(info, &latency);
+}
+
+/* our ports add the latency of the converter to that of the follower */
+static int port_enum_latency(struct impl *this, int seq,
+		enum spa_direction direction, uint32_t port_id,
+		uint32_t start, const struct spa_pod *filter)
+{
+	struct spa_latency_info info = SPA_LATENCY_INFO(direction);
+	struct spa_pod *param;
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_result_node_params result;
+
+	if (start > 0)
+		return 0;
+
+	add_port_latency(this->follower, this->direction, 0, &info);
+	add_port_latency(this->convert, direction, port_id, &info);
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	param = spa_latency_build(&b, SPA_PARAM_Latency, &info);
+
+	result.id = SPA_PARAM_Latency;
+	result.index = 0;
+	result.next = 1;
+	if (spa_pod_filter(&b, &result.param, param, filter) < 0)
+		return 0;
+
+	spa_node_emit_result(&this->hooks, seq, 0, SPA_RESULT_TYPE_NODE_PARAMS, &result);
+
+	return 0;
+}
+
 static int
 impl_node_port_enum_params(void *object, int seq,
 			   enum spa_direction direction, uint32_t port_id,
@@ -793,8 +1139,17 @@ impl_node_port_enum_params(void *object, int seq,
 
 	spa_log_debug(this->log, NAME" %p: %d %u", this, seq, id);
 
-	return spa_node_port_enum_params(this->target, seq, direction, port_id, id,
-			start, num, filter);
+	if (id == SPA_PARAM_Latency && direction == this->direction &&
+	    this->target != this->follower)
+		return port_enum_latency(this, seq, direction, port_id, start, filter);
+
+	/* keep offering the formats of the converter */
+	if (id == SPA_PARAM_EnumFormat && this->auto_passthrough)
+		return spa_node_port_enum_params(this->convert, seq, direction, port_id, id,
+				start, num, filter);
+
+	return spa_node_port_enum_params(port_target(this, direction), seq,
+			direction, port_id, id, start, num, filter);
 }
 
 static int
@@ -810,11 +1165,42 @@ impl_node_port_set_param(void *object,
 
 	spa_log_debug(this->log, " %d %d %d %d", port_id, id, direction, this->direction);
 
+	/* the follower wants to know the latency of the path */
+	if (id == SPA_PARAM_Latency && direction == this->direction &&
+	    this->target != this->follower)
+		return spa_node_port_set_param(this->follower, direction, 0, id,
+				flags, param);
+
 	if (direction != this->direction)
 		port_id++;
+	else if (id == SPA_PARAM_Format && port_id == 0) {
+		if (param != NULL &&
+		    SPA_POD_SIZE(param) <= sizeof(this->peer_format_buffer)) {
+			memcpy(this->peer_format_buffer, param, SPA_POD_SIZE(param));
+			this->peer_format = (struct spa_pod *)this->peer_format_buffer;
+		} else {
+			this->peer_format = NULL;
+		}
+		this->n_peer_buffers = 0;
+
+		/* run the follower at the format of the peer when we can */
+		if (this->convert_mode) {
+			bool passthrough = can_passthrough(this, param);
+
+			if (passthrough != this->auto_passthrough) {
+				res = set_auto_passthrough(this, passthrough);
+				if (res < 0 && passthrough) {
+					spa_log_warn(this->log, NAME " %p: passthrough failed: %s",
+							this, spa_strerror(res));
+					res = set_auto_passthrough(this, false);
+				}
+				return res;
+			}
+		}
+	}
 
-	if ((res = spa_node_port_set_param(this->target, direction, port_id, id,
-			flags, param)) < 0)
+	if ((res = spa_node_port_set_param(port_target(this, direction),
+			direction, port_id, id, flags, param)) < 0)
 		return res;
 
 	return res;
@@ -835,8 +1221,19 @@ impl_node_port_set_io(void *object,
 
 	if (direction != this->direction)
 		port_id++;
+	else if (port_id == 0) {
+		switch (id) {
+		case SPA_IO_Buffers:
+			this->peer_io_buffers = data;
+			break;
+		case SPA_IO_RateMatch:
+			this->peer_io_rate_match = data;
+			break;
+		}
+	}
 
-	return spa_node_port_set_io(this->target, direction, port_id, id, data, size);
+	return spa_node_port_set_io(port_target(this, direction),
+			direction, port_id, id, data, size);
 }
 
 static int
@@ -854,11 +1251,20 @@ impl_node_port_use_buffers(void *object,
 
 	if (direction != this->direction)
 		port_id++;
+	else if (port_id == 0) {
+		if (buffers != NULL && n_buffers <= MAX_BUFFERS) {
+			memcpy(this->peer_buffers, buffers, n_buffers * sizeof(struct spa_buffer *));
+			this->n_peer_buffers = n_buffers;
+			this->peer_buffers_flags = flags;
+		} else {
+			this->n_peer_buffers = 0;
+		}
+	}
 
 	spa_log_debug(this->log, NAME" %p: %d %d:%d", this,
 			n_buffers, direction, port_id);
 
-	if ((res = spa_node_port_use_buffers(this->target,
+	if ((res = spa_node_port_use_buffers(port_target(this, direction),
 					direction, port_id, flags, buffers, n_buffers)) < 0)
 		return res;
 
@@ -872,7 +1278,8 @@ impl_node_port_reuse_buffer(void *object, uint32_t port_id, uint32_t buffer_id)
 
 	spa_return_val_if_fail(this != NULL, -EINVAL);
 
-	return spa_node_port_reuse_buffer(this->target, port_id, buffer_id);
+	return spa_node_port_reuse_buffer(port_target(this, SPA_DIRECTION_OUTPUT),
+			port_id, buffer_id);
 }
 
 static int impl_node_process(void *object)
@@ -884,7 +1291,7 @@ static int impl_node_process(void *object)
 			this, this->convert, this->master);
 
 	if (this->direction == SPA_DIRECTION_INPUT) {
-		if (this->convert)
+		if (this->target != this->follower)
 			status = spa_node_process(this->convert);
 	}
 
@@ -892,7 +1299,7 @@ static int impl_node_process(void *object)
 		status = spa_node_process(this->follower);
 
 	if (this->direction == SPA_DIRECTION_OUTPUT &&
-	    !this->master && this->convert) {
+	    !this->master && this->target != this->follower) {
 		while (status > 0) {
 			status = spa_node_process(this->convert);
 			if (status & (SPA_STATUS_HAVE_DATA | SPA_STATUS_DRAINED))
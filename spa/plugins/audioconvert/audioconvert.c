@@ -932,6 +932,12 @@ impl_node_port_enum_params(void *object, int seq,
 			return 0;
 		}
 		break;
+	case SPA_PARAM_Latency:
+		if (IS_MONITOR_PORT(this, direction, port_id))
+			return 0;
+		/* only the resampler adds latency */
+		return spa_node_port_enum_params(this->resample, seq, direction, 0,
+			id, start, num, filter);
 	default:
 	{
 		struct spa_node *target;
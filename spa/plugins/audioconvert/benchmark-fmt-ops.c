@@ -29,16 +29,16 @@
 #include <errno.h>
 #include <time.h>
 
-#include "fmt-ops.h"
+#include <spa/debug/types.h>
+#include <spa/param/audio/type-info.h>
 
-typedef void (*convert_func_t) (struct convert *conv, void * SPA_RESTRICT dst[],
-		const void * SPA_RESTRICT src[], uint32_t n_samples);
+#include "fmt-ops.c"
 
 struct stats {
 	uint32_t n_samples;
 	uint32_t n_channels;
 	uint64_t perf;
-	const char *name;
+	char name[64];
 	const char *impl;
 };
 
@@ -53,13 +53,27 @@ static uint8_t samp_out[MAX_SAMPLES * MAX_CHANNELS * 4];
 static const int sample_sizes[] = { 0, 1, 128, 513, 4096 };
 static const int channel_counts[] = { 1, 2, 4, 6, 8, 11 };
 
-#define MAX_RESULTS	SPA_N_ELEMENTS(sample_sizes) * SPA_N_ELEMENTS(channel_counts) * 70
+#define MAX_RESULTS	SPA_N_ELEMENTS(sample_sizes) * SPA_N_ELEMENTS(channel_counts) * SPA_N_ELEMENTS(conv_table)
 
 static uint32_t n_results = 0;
 static struct stats results[MAX_RESULTS];
 
-static void run_test1(const char *name, const char *impl, bool in_packed, bool out_packed,
-		convert_func_t func, int n_channels, int n_samples)
+static const char *cpu_flags_name(uint32_t flags)
+{
+	if (flags & SPA_CPU_FLAG_AVX2)
+		return "avx2";
+	if (flags & SPA_CPU_FLAG_SSE41)
+		return "sse41";
+	if (flags & SPA_CPU_FLAG_SSSE3)
+		return "ssse3";
+	if (flags & SPA_CPU_FLAG_SSE2)
+		return "sse2";
+	if (flags & SPA_CPU_FLAG_NEON)
+		return "neon";
+	return "c";
+}
+
+static void run_test1(const struct conv_info *info, int n_channels, int n_samples)
 {
 	int i, j;
 	const void *ip[n_channels];
@@ -67,7 +81,9 @@ static void run_test1(const char *name, const char *impl, bool in_packed, bool o
 	struct timespec ts;
 	uint64_t count, t1, t2;
 	struct convert conv;
+	struct stats *s;
 
+	spa_zero(conv);
 	conv.n_channels = n_channels;
 
 	for (j = 0; j < n_channels; j++) {
@@ -80,7 +96,7 @@ static void run_test1(const char *name, const char *impl, bool in_packed, bool o
 
 	count = 0;
 	for (i = 0; i < MAX_COUNT; i++) {
-		func(&conv, op, ip, n_samples);
+		info->process(&conv, op, ip, n_samples);
 		count++;
 	}
 	clock_gettime(CLOCK_MONOTONIC, &ts);
@@ -88,172 +104,37 @@ static void run_test1(const char *name, const char *impl, bool in_packed, bool o
 
 	spa_assert(n_results < MAX_RESULTS);
 
-	results[n_results++] = (struct stats) {
-		.n_samples = n_samples,
-		.n_channels = n_channels,
-		.perf = count * (uint64_t)SPA_NSEC_PER_SEC / (t2 - t1),
-		.name = name,
-		.impl = impl
-	};
+	s = &results[n_results++];
+	s->n_samples = n_samples;
+	s->n_channels = n_channels;
+	s->perf = count * (uint64_t)SPA_NSEC_PER_SEC / SPA_MAX(t2 - t1, 1u);
+	snprintf(s->name, sizeof(s->name), "%s->%s%s",
+			spa_debug_type_find_short_name(spa_type_audio_format, info->src_fmt),
+			spa_debug_type_find_short_name(spa_type_audio_format, info->dst_fmt),
+			info->n_channels ? " (fixed)" : "");
+	s->impl = cpu_flags_name(info->cpu_flags);
 }
 
-static void run_testc(const char *name, const char *impl, bool in_packed, bool out_packed, convert_func_t func,
-		int channel_count)
+/* run every conversion in the table, including the SIMD variants, for
+ * all the channel counts it handles */
+static void run_conv_table(void)
 {
-	size_t i;
-	for (i = 0; i < SPA_N_ELEMENTS(sample_sizes); i++) {
-		run_test1(name, impl, in_packed, out_packed, func, channel_count,
-				(sample_sizes[i] + (channel_count -1)) / channel_count);
-	}
-}
+	size_t i, j, k;
 
-static void run_test(const char *name, const char *impl, bool in_packed, bool out_packed, convert_func_t func)
-{
-	size_t i, j;
+	for (i = 0; i < SPA_N_ELEMENTS(conv_table); i++) {
+		const struct conv_info *info = &conv_table[i];
 
-	for (i = 0; i < SPA_N_ELEMENTS(sample_sizes); i++) {
 		for (j = 0; j < SPA_N_ELEMENTS(channel_counts); j++) {
-			run_test1(name, impl, in_packed, out_packed, func, channel_counts[j],
-				(sample_sizes[i] + (channel_counts[j] -1)) / channel_counts[j]);
-		}
-	}
-}
-
-static void test_f32_u8(void)
-{
-	run_test("test_f32_u8", "c", true, true, conv_f32_to_u8_c);
-	run_test("test_f32d_u8", "c", false, true, conv_f32d_to_u8_c);
-	run_test("test_f32_u8d", "c", true, false, conv_f32_to_u8d_c);
-	run_test("test_f32d_u8d", "c", false, false, conv_f32d_to_u8d_c);
-}
-
-static void test_u8_f32(void)
-{
-	run_test("test_u8_f32", "c", true, true, conv_u8_to_f32_c);
-	run_test("test_u8d_f32", "c", false, true, conv_u8d_to_f32_c);
-	run_test("test_u8_f32d", "c", true, false, conv_u8_to_f32d_c);
-	run_test("test_u8d_f32d", "c", false, false, conv_u8d_to_f32d_c);
-}
-
-static void test_f32_s16(void)
-{
-	run_test("test_f32_s16", "c", true, true, conv_f32_to_s16_c);
-	run_test("test_f32d_s16", "c", false, true, conv_f32d_to_s16_c);
-#if defined (HAVE_SSE2)
-	run_test("test_f32d_s16", "sse2", false, true, conv_f32d_to_s16_sse2);
-	run_testc("test_f32d_s16_2", "sse2", false, true, conv_f32d_to_s16_2_sse2, 2);
-#endif
-#if defined (HAVE_AVX2)
-	run_test("test_f32d_s16", "avx2", false, true, conv_f32d_to_s16_avx2);
-	run_testc("test_f32d_s16_2", "avx2", false, true, conv_f32d_to_s16_2_avx2, 2);
-	run_testc("test_f32d_s16_4", "avx2", false, true, conv_f32d_to_s16_4_avx2, 4);
-#endif
-	run_test("test_f32_s16d", "c", true, false, conv_f32_to_s16d_c);
-	run_test("test_f32d_s16d", "c", false, false, conv_f32d_to_s16d_c);
-}
-
-static void test_s16_f32(void)
-{
-	run_test("test_s16_f32", "c", true, true, conv_s16_to_f32_c);
-	run_test("test_s16d_f32", "c", false, true, conv_s16d_to_f32_c);
-	run_test("test_s16_f32d", "c", true, false, conv_s16_to_f32d_c);
-#if defined (HAVE_SSE2)
-	run_test("test_s16_f32d", "sse2", true, false, conv_s16_to_f32d_sse2);
-	run_testc("test_s16_f32d_2", "sse2", true, false, conv_s16_to_f32d_2_sse2, 2);
-#endif
-#if defined (HAVE_AVX2)
-	run_test("test_s16_f32d", "avx2", true, false, conv_s16_to_f32d_avx2);
-	run_testc("test_s16_f32d_2", "avx2", true, false, conv_s16_to_f32d_2_avx2, 2);
-#endif
-	run_test("test_s16d_f32d", "c", false, false, conv_s16d_to_f32d_c);
-}
-
-static void test_f32_s32(void)
-{
-	run_test("test_f32_s32", "c", true, true, conv_f32_to_s32_c);
-	run_test("test_f32d_s32", "c", false, true, conv_f32d_to_s32_c);
-#if defined (HAVE_SSE2)
-	run_test("test_f32d_s32", "sse2", false, true, conv_f32d_to_s32_sse2);
-#endif
-#if defined (HAVE_AVX2)
-	run_test("test_f32d_s32", "avx2", false, true, conv_f32d_to_s32_avx2);
-#endif
-	run_test("test_f32_s32d", "c", true, false, conv_f32_to_s32d_c);
-	run_test("test_f32d_s32d", "c", false, false, conv_f32d_to_s32d_c);
-}
-
-static void test_s32_f32(void)
-{
-	run_test("test_s32_f32", "c", true, true, conv_s32_to_f32_c);
-	run_test("test_s32d_f32", "c", false, true, conv_s32d_to_f32_c);
-#if defined (HAVE_SSE2)
-	run_test("test_s32_f32d", "sse2", true, false, conv_s32_to_f32d_sse2);
-#endif
-#if defined (HAVE_AVX2)
-	run_test("test_s32_f32d", "avx2", true, false, conv_s32_to_f32d_avx2);
-#endif
-	run_test("test_s32_f32d", "c", true, false, conv_s32_to_f32d_c);
-	run_test("test_s32d_f32d", "c", false, false, conv_s32d_to_f32d_c);
-}
-
-static void test_f32_s24(void)
-{
-	run_test("test_f32_s24", "c", true, true, conv_f32_to_s24_c);
-	run_test("test_f32d_s24", "c", false, true, conv_f32d_to_s24_c);
-	run_test("test_f32_s24d", "c", true, false, conv_f32_to_s24d_c);
-	run_test("test_f32d_s24d", "c", false, false, conv_f32d_to_s24d_c);
-}
-
-static void test_s24_f32(void)
-{
-	run_test("test_s24_f32", "c", true, true, conv_s24_to_f32_c);
-	run_test("test_s24d_f32", "c", false, true, conv_s24d_to_f32_c);
-	run_test("test_s24_f32d", "c", true, false, conv_s24_to_f32d_c);
-#if defined (HAVE_SSE2)
-	run_test("test_s24_f32d", "sse2", true, false, conv_s24_to_f32d_sse2);
-#endif
-#if defined (HAVE_AVX2)
-	run_test("test_s24_f32d", "avx2", true, false, conv_s24_to_f32d_avx2);
-#endif
-#if defined (HAVE_SSSE3)
-	run_test("test_s24_f32d", "ssse3", true, false, conv_s24_to_f32d_ssse3);
-#endif
-#if defined (HAVE_SSE41)
-	run_test("test_s24_f32d", "sse41", true, false, conv_s24_to_f32d_sse41);
-#endif
-	run_test("test_s24d_f32d", "c", false, false, conv_s24d_to_f32d_c);
-}
+			int n_channels = channel_counts[j];
 
-static void test_f32_s24_32(void)
-{
-	run_test("test_f32_s24_32", "c", true, true, conv_f32_to_s24_32_c);
-	run_test("test_f32d_s24_32", "c", false, true, conv_f32d_to_s24_32_c);
-	run_test("test_f32_s24_32d", "c", true, false, conv_f32_to_s24_32d_c);
-	run_test("test_f32d_s24_32d", "c", false, false, conv_f32d_to_s24_32d_c);
-}
-
-static void test_s24_32_f32(void)
-{
-	run_test("test_s24_32_f32", "c", true, true, conv_s24_32_to_f32_c);
-	run_test("test_s24_32d_f32", "c", false, true, conv_s24_32d_to_f32_c);
-	run_test("test_s24_32_f32d", "c", true, false, conv_s24_32_to_f32d_c);
-	run_test("test_s24_32d_f32d", "c", false, false, conv_s24_32d_to_f32d_c);
-}
+			if (!MATCH_CHAN(info->n_channels, (uint32_t)n_channels))
+				continue;
 
-static void test_interleave(void)
-{
-	run_test("test_interleave_8", "c", false, true, conv_interleave_8_c);
-	run_test("test_interleave_16", "c", false, true, conv_interleave_16_c);
-	run_test("test_interleave_24", "c", false, true, conv_interleave_24_c);
-	run_test("test_interleave_32", "c", false, true, conv_interleave_32_c);
-}
-
-static void test_deinterleave(void)
-{
-	run_test("test_deinterleave_8", "c", true, false, conv_deinterleave_8_c);
-	run_test("test_deinterleave_16", "c", true, false, conv_deinterleave_16_c);
-	run_test("test_deinterleave_24", "c", true, false, conv_deinterleave_24_c);
-	run_test("test_deinterleave_32", "c", true, false, conv_deinterleave_32_c);
+			for (k = 0; k < SPA_N_ELEMENTS(sample_sizes); k++)
+				run_test1(info, n_channels,
+					(sample_sizes[k] + (n_channels - 1)) / n_channels);
+		}
+	}
 }
 
 static int compare_func(const void *_a, const void *_b)
@@ -271,18 +152,7 @@ int main(int argc, char *argv[])
 {
 	uint32_t i;
 
-	test_f32_u8();
-	test_u8_f32();
-	test_f32_s16();
-	test_s16_f32();
-	test_f32_s32();
-	test_s32_f32();
-	test_f32_s24();
-	test_s24_f32();
-	test_f32_s24_32();
-	test_s24_32_f32();
-	test_interleave();
-	test_deinterleave();
+	run_conv_table();
 
 	qsort(results, n_results, sizeof(struct stats), compare_func);
 
@@ -32,7 +32,7 @@
 #include "resample.h"
 
 #define MAX_SAMPLES	4096
-#define MAX_CHANNELS	11
+#define MAX_CHANNELS	32
 
 #define MAX_COUNT 200
 
@@ -52,12 +52,34 @@ static float samp_out[MAX_SAMPLES * MAX_CHANNELS];
 static const int sample_sizes[] = { 0, 1, 128, 513, 4096 };
 static const int in_rates[] = { 44100, 44100, 48000, 96000, 22050, 96000 };
 static const int out_rates[] = { 44100, 48000, 44100, 48000, 48000, 44100 };
+static const int n_channels[] = { 2, 16, 32 };
 
+struct impl {
+	const char *name;
+	uint32_t cpu_flags;
+};
+
+static const struct impl impls[] = {
+	{ "c", 0 },
+#if defined (HAVE_SSE)
+	{ "sse", SPA_CPU_FLAG_SSE },
+#endif
+#if defined (HAVE_SSSE3)
+	{ "ssse3", SPA_CPU_FLAG_SSSE3 | SPA_CPU_FLAG_SLOW_UNALIGNED },
+#endif
+#if defined (HAVE_AVX) && defined(HAVE_FMA)
+	{ "avx", SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3 },
+#endif
+#if defined (HAVE_AVX512)
+	{ "avx512", SPA_CPU_FLAG_AVX512 },
+#endif
+};
 
-#define MAX_RESAMPLER	5
+#define MAX_RESAMPLER	SPA_N_ELEMENTS(impls)
 #define MAX_SIZES	SPA_N_ELEMENTS(sample_sizes)
 #define MAX_RATES	SPA_N_ELEMENTS(in_rates)
-#define MAX_RESULTS	MAX_RESAMPLER * MAX_SIZES * MAX_RATES
+#define MAX_N_CHANNELS	SPA_N_ELEMENTS(n_channels)
+#define MAX_RESULTS	MAX_RESAMPLER * MAX_SIZES * MAX_RATES * MAX_N_CHANNELS
 
 static uint32_t n_results = 0;
 static struct stats results[MAX_RESULTS];
@@ -125,58 +147,23 @@ static int compare_func(const void *_a, const void *_b)
 int main(int argc, char *argv[])
 {
 	struct resample r;
-	uint32_t i;
-
-	for (i = 0; i < SPA_N_ELEMENTS(in_rates); i++) {
-		spa_zero(r);
-		r.channels = 2;
-		r.cpu_flags = 0;
-		r.i_rate = in_rates[i];
-		r.o_rate = out_rates[i];
-		r.quality = RESAMPLE_DEFAULT_QUALITY;
-		resample_native_init(&r);
-		run_test("native", "c", &r);
-		resample_free(&r);
-	}
-#if defined (HAVE_SSE)
-	for (i = 0; i < SPA_N_ELEMENTS(in_rates); i++) {
-		spa_zero(r);
-		r.channels = 2;
-		r.cpu_flags = SPA_CPU_FLAG_SSE;
-		r.i_rate = in_rates[i];
-		r.o_rate = out_rates[i];
-		r.quality = RESAMPLE_DEFAULT_QUALITY;
-		resample_native_init(&r);
-		run_test("native", "sse", &r);
-		resample_free(&r);
-	}
-#endif
-#if defined (HAVE_SSSE3)
-	for (i = 0; i < SPA_N_ELEMENTS(in_rates); i++) {
-		spa_zero(r);
-		r.channels = 2;
-		r.cpu_flags = SPA_CPU_FLAG_SSSE3 | SPA_CPU_FLAG_SLOW_UNALIGNED;
-		r.i_rate = in_rates[i];
-		r.o_rate = out_rates[i];
-		r.quality = RESAMPLE_DEFAULT_QUALITY;
-		resample_native_init(&r);
-		run_test("native", "ssse3", &r);
-		resample_free(&r);
+	uint32_t i, j, k;
+
+	for (i = 0; i < SPA_N_ELEMENTS(impls); i++) {
+		for (j = 0; j < SPA_N_ELEMENTS(n_channels); j++) {
+			for (k = 0; k < SPA_N_ELEMENTS(in_rates); k++) {
+				spa_zero(r);
+				r.channels = n_channels[j];
+				r.cpu_flags = impls[i].cpu_flags;
+				r.i_rate = in_rates[k];
+				r.o_rate = out_rates[k];
+				r.quality = RESAMPLE_DEFAULT_QUALITY;
+				resample_native_init(&r);
+				run_test("native", impls[i].name, &r);
+				resample_free(&r);
+			}
+		}
 	}
-#endif
-#if defined (HAVE_AVX) && defined(HAVE_FMA)
-	for (i = 0; i < SPA_N_ELEMENTS(in_rates); i++) {
-		spa_zero(r);
-		r.channels = 2;
-		r.cpu_flags = SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3;
-		r.i_rate = in_rates[i];
-		r.o_rate = out_rates[i];
-		r.quality = RESAMPLE_DEFAULT_QUALITY;
-		resample_native_init(&r);
-		run_test("native", "avx", &r);
-		resample_free(&r);
-	}
-#endif
 
 	qsort(results, n_results, sizeof(struct stats), compare_func);
 
@@ -28,6 +28,8 @@
 
 #include "fmt-ops.h"
 
+#include <arm_neon.h>
+
 static void
 conv_s16_to_f32d_2s_neon(void *data, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src,
 		uint32_t n_channels, uint32_t n_samples)
@@ -361,3 +363,161 @@ conv_f32d_to_s16_neon(struct convert *conv, void * SPA_RESTRICT dst[], const voi
 	for(; i < n_channels; i++)
 		conv_f32d_to_s16_1s_neon(conv, &d[i], &src[i], n_channels, n_samples);
 }
+
+static void
+conv_deinterleave_32_4s_neon(void *data, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src,
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s = src;
+	float *d0 = dst[0], *d1 = dst[1], *d2 = dst[2], *d3 = dst[3];
+	uint32_t n, unrolled = n_samples & ~3;
+	float32x4x2_t t[2];
+
+	for(n = 0; n < unrolled; n += 4) {
+		t[0] = vtrnq_f32(vld1q_f32(&s[0*n_channels]), vld1q_f32(&s[1*n_channels]));
+		t[1] = vtrnq_f32(vld1q_f32(&s[2*n_channels]), vld1q_f32(&s[3*n_channels]));
+
+		vst1q_f32(&d0[n], vcombine_f32(vget_low_f32(t[0].val[0]), vget_low_f32(t[1].val[0])));
+		vst1q_f32(&d1[n], vcombine_f32(vget_low_f32(t[0].val[1]), vget_low_f32(t[1].val[1])));
+		vst1q_f32(&d2[n], vcombine_f32(vget_high_f32(t[0].val[0]), vget_high_f32(t[1].val[0])));
+		vst1q_f32(&d3[n], vcombine_f32(vget_high_f32(t[0].val[1]), vget_high_f32(t[1].val[1])));
+		s += 4*n_channels;
+	}
+	for(; n < n_samples; n++) {
+		d0[n] = s[0];
+		d1[n] = s[1];
+		d2[n] = s[2];
+		d3[n] = s[3];
+		s += n_channels;
+	}
+}
+
+static void
+conv_deinterleave_32_2s_neon(void *data, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src,
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s = src;
+	float *d0 = dst[0], *d1 = dst[1];
+	uint32_t n, unrolled = n_samples & ~3;
+	float32x4x2_t t;
+
+	if (n_channels == 2) {
+		for(n = 0; n < unrolled; n += 4) {
+			t = vld2q_f32(&s[2*n]);
+			vst1q_f32(&d0[n], t.val[0]);
+			vst1q_f32(&d1[n], t.val[1]);
+		}
+		s += 2*n;
+	} else {
+		for(n = 0; n < unrolled; n += 4) {
+			t = vuzpq_f32(
+				vcombine_f32(vld1_f32(&s[0*n_channels]), vld1_f32(&s[1*n_channels])),
+				vcombine_f32(vld1_f32(&s[2*n_channels]), vld1_f32(&s[3*n_channels])));
+			vst1q_f32(&d0[n], t.val[0]);
+			vst1q_f32(&d1[n], t.val[1]);
+			s += 4*n_channels;
+		}
+	}
+	for(; n < n_samples; n++) {
+		d0[n] = s[0];
+		d1[n] = s[1];
+		s += n_channels;
+	}
+}
+
+void
+conv_deinterleave_32_neon(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	const float *s = src[0];
+	uint32_t i = 0, j, n_channels = conv->n_channels;
+
+	for(; i + 3 < n_channels; i += 4)
+		conv_deinterleave_32_4s_neon(conv, &dst[i], &s[i], n_channels, n_samples);
+	for(; i + 1 < n_channels; i += 2)
+		conv_deinterleave_32_2s_neon(conv, &dst[i], &s[i], n_channels, n_samples);
+	for(; i < n_channels; i++) {
+		float *d = dst[i];
+		for(j = 0; j < n_samples; j++)
+			d[j] = s[j * n_channels + i];
+	}
+}
+
+static void
+conv_interleave_32_4s_neon(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s0 = src[0], *s1 = src[1], *s2 = src[2], *s3 = src[3];
+	float *d = dst;
+	uint32_t n, unrolled = n_samples & ~3;
+	float32x4x2_t t[2];
+
+	for(n = 0; n < unrolled; n += 4) {
+		t[0] = vtrnq_f32(vld1q_f32(&s0[n]), vld1q_f32(&s1[n]));
+		t[1] = vtrnq_f32(vld1q_f32(&s2[n]), vld1q_f32(&s3[n]));
+
+		vst1q_f32(&d[0*n_channels], vcombine_f32(vget_low_f32(t[0].val[0]), vget_low_f32(t[1].val[0])));
+		vst1q_f32(&d[1*n_channels], vcombine_f32(vget_low_f32(t[0].val[1]), vget_low_f32(t[1].val[1])));
+		vst1q_f32(&d[2*n_channels], vcombine_f32(vget_high_f32(t[0].val[0]), vget_high_f32(t[1].val[0])));
+		vst1q_f32(&d[3*n_channels], vcombine_f32(vget_high_f32(t[0].val[1]), vget_high_f32(t[1].val[1])));
+		d += 4*n_channels;
+	}
+	for(; n < n_samples; n++) {
+		d[0] = s0[n];
+		d[1] = s1[n];
+		d[2] = s2[n];
+		d[3] = s3[n];
+		d += n_channels;
+	}
+}
+
+static void
+conv_interleave_32_2s_neon(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s0 = src[0], *s1 = src[1];
+	float *d = dst;
+	uint32_t n, unrolled = n_samples & ~3;
+	float32x4x2_t t;
+
+	if (n_channels == 2) {
+		for(n = 0; n < unrolled; n += 4) {
+			t.val[0] = vld1q_f32(&s0[n]);
+			t.val[1] = vld1q_f32(&s1[n]);
+			vst2q_f32(&d[2*n], t);
+		}
+		d += 2*n;
+	} else {
+		for(n = 0; n < unrolled; n += 4) {
+			t = vzipq_f32(vld1q_f32(&s0[n]), vld1q_f32(&s1[n]));
+			vst1_f32(&d[0*n_channels], vget_low_f32(t.val[0]));
+			vst1_f32(&d[1*n_channels], vget_high_f32(t.val[0]));
+			vst1_f32(&d[2*n_channels], vget_low_f32(t.val[1]));
+			vst1_f32(&d[3*n_channels], vget_high_f32(t.val[1]));
+			d += 4*n_channels;
+		}
+	}
+	for(; n < n_samples; n++) {
+		d[0] = s0[n];
+		d[1] = s1[n];
+		d += n_channels;
+	}
+}
+
+void
+conv_interleave_32_neon(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	float *d = dst[0];
+	uint32_t i = 0, j, n_channels = conv->n_channels;
+
+	for(; i + 3 < n_channels; i += 4)
+		conv_interleave_32_4s_neon(conv, &d[i], &src[i], n_channels, n_samples);
+	for(; i + 1 < n_channels; i += 2)
+		conv_interleave_32_2s_neon(conv, &d[i], &src[i], n_channels, n_samples);
+	for(; i < n_channels; i++) {
+		const float *s = src[i];
+		for(j = 0; j < n_samples; j++)
+			d[j * n_channels + i] = s[j];
+	}
+}
@@ -22,6 +22,8 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#include <string.h>
+
 #include "fmt-ops.h"
 
 #include <emmintrin.h>
@@ -763,3 +765,612 @@ conv_f32d_to_s16_2_sse2(struct convert *conv, void * SPA_RESTRICT dst[], const v
 		d += 2;
 	}
 }
+
+void
+conv_s24_32_to_f32d_sse2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	const int32_t *s0 = src[0];
+	uint32_t i, n, unrolled, n_channels = conv->n_channels;
+	__m128i in;
+	__m128 out, factor = _mm_set1_ps(1.0f / S24_SCALE);
+
+	for(i = 0; i < n_channels; i++) {
+		const int32_t *s = &s0[i];
+		float *d0 = dst[i];
+
+		if (SPA_IS_ALIGNED(d0, 16))
+			unrolled = n_samples & ~3;
+		else
+			unrolled = 0;
+
+		for(n = 0; n < unrolled; n += 4) {
+			in = _mm_setr_epi32(s[0*n_channels],
+					    s[1*n_channels],
+					    s[2*n_channels],
+					    s[3*n_channels]);
+			out = _mm_mul_ps(_mm_cvtepi32_ps(in), factor);
+			_mm_store_ps(&d0[n], out);
+			s += 4*n_channels;
+		}
+		for(; n < n_samples; n++) {
+			out = _mm_cvtsi32_ss(out, s[0]);
+			out = _mm_mul_ss(out, factor);
+			_mm_store_ss(&d0[n], out);
+			s += n_channels;
+		}
+	}
+}
+
+static void
+conv_f32d_to_s24_32_1s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s0 = src[0];
+	int32_t *d = dst;
+	uint32_t n, unrolled;
+	__m128 in;
+	__m128i out;
+	__m128 scale = _mm_set1_ps(S24_SCALE);
+	__m128 max = _mm_set1_ps(1.0f), min = _mm_set1_ps(-1.0f);
+
+	if (SPA_IS_ALIGNED(s0, 16))
+		unrolled = n_samples & ~3;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 4) {
+		in = _mm_min_ps(max, _mm_max_ps(_mm_load_ps(&s0[n]), min));
+		out = _mm_cvttps_epi32(_mm_mul_ps(in, scale));
+		d[0*n_channels] = _mm_cvtsi128_si32(out);
+		d[1*n_channels] = _mm_cvtsi128_si32(_mm_srli_si128(out, 4));
+		d[2*n_channels] = _mm_cvtsi128_si32(_mm_srli_si128(out, 8));
+		d[3*n_channels] = _mm_cvtsi128_si32(_mm_srli_si128(out, 12));
+		d += 4*n_channels;
+	}
+	for(; n < n_samples; n++) {
+		in = _mm_min_ss(max, _mm_max_ss(_mm_load_ss(&s0[n]), min));
+		*d = _mm_cvttss_si32(_mm_mul_ss(in, scale));
+		d += n_channels;
+	}
+}
+
+static void
+conv_f32d_to_s24_32_4s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s0 = src[0], *s1 = src[1], *s2 = src[2], *s3 = src[3];
+	int32_t *d = dst;
+	uint32_t n, unrolled;
+	__m128 in[4];
+	__m128 scale = _mm_set1_ps(S24_SCALE);
+	__m128 max = _mm_set1_ps(1.0f), min = _mm_set1_ps(-1.0f);
+
+	if (SPA_IS_ALIGNED(s0, 16) &&
+	    SPA_IS_ALIGNED(s1, 16) &&
+	    SPA_IS_ALIGNED(s2, 16) &&
+	    SPA_IS_ALIGNED(s3, 16))
+		unrolled = n_samples & ~3;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 4) {
+		in[0] = _mm_min_ps(max, _mm_max_ps(_mm_load_ps(&s0[n]), min));
+		in[1] = _mm_min_ps(max, _mm_max_ps(_mm_load_ps(&s1[n]), min));
+		in[2] = _mm_min_ps(max, _mm_max_ps(_mm_load_ps(&s2[n]), min));
+		in[3] = _mm_min_ps(max, _mm_max_ps(_mm_load_ps(&s3[n]), min));
+
+		_MM_TRANSPOSE4_PS(in[0], in[1], in[2], in[3]);
+
+		_mm_storeu_si128((__m128i*)(d + 0*n_channels), _mm_cvttps_epi32(_mm_mul_ps(in[0], scale)));
+		_mm_storeu_si128((__m128i*)(d + 1*n_channels), _mm_cvttps_epi32(_mm_mul_ps(in[1], scale)));
+		_mm_storeu_si128((__m128i*)(d + 2*n_channels), _mm_cvttps_epi32(_mm_mul_ps(in[2], scale)));
+		_mm_storeu_si128((__m128i*)(d + 3*n_channels), _mm_cvttps_epi32(_mm_mul_ps(in[3], scale)));
+		d += 4*n_channels;
+	}
+	for(; n < n_samples; n++) {
+		in[0] = _mm_setr_ps(s0[n], s1[n], s2[n], s3[n]);
+		in[0] = _mm_min_ps(max, _mm_max_ps(in[0], min));
+		_mm_storeu_si128((__m128i*)d, _mm_cvttps_epi32(_mm_mul_ps(in[0], scale)));
+		d += n_channels;
+	}
+}
+
+void
+conv_f32d_to_s24_32_sse2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	int32_t *d = dst[0];
+	uint32_t i = 0, n_channels = conv->n_channels;
+
+	for(; i + 3 < n_channels; i += 4)
+		conv_f32d_to_s24_32_4s_sse2(conv, &d[i], &src[i], n_channels, n_samples);
+	for(; i < n_channels; i++)
+		conv_f32d_to_s24_32_1s_sse2(conv, &d[i], &src[i], n_channels, n_samples);
+}
+
+void
+conv_u8_to_f32d_sse2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	const uint8_t *s0 = src[0];
+	uint32_t i, n, unrolled, n_channels = conv->n_channels;
+	__m128i in;
+	__m128 out, factor = _mm_set1_ps(1.0f / U8_OFFS), one = _mm_set1_ps(1.0f);
+
+	for(i = 0; i < n_channels; i++) {
+		const uint8_t *s = &s0[i];
+		float *d0 = dst[i];
+
+		if (SPA_IS_ALIGNED(d0, 16))
+			unrolled = n_samples & ~3;
+		else
+			unrolled = 0;
+
+		for(n = 0; n < unrolled; n += 4) {
+			in = _mm_setr_epi32(s[0*n_channels],
+					    s[1*n_channels],
+					    s[2*n_channels],
+					    s[3*n_channels]);
+			out = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(in), factor), one);
+			_mm_store_ps(&d0[n], out);
+			s += 4*n_channels;
+		}
+		for(; n < n_samples; n++) {
+			d0[n] = U8_TO_F32(s[0]);
+			s += n_channels;
+		}
+	}
+}
+
+void
+conv_f32d_to_u8_sse2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint8_t *d0 = dst[0];
+	uint32_t i, n, unrolled, n_channels = conv->n_channels;
+	__m128 in, scale = _mm_set1_ps(U8_SCALE), offs = _mm_set1_ps(U8_OFFS);
+	__m128 max = _mm_set1_ps(1.0f), min = _mm_set1_ps(-1.0f);
+	__m128i out;
+
+	for(i = 0; i < n_channels; i++) {
+		const float *s = src[i];
+		uint8_t *d = &d0[i];
+
+		if (SPA_IS_ALIGNED(s, 16))
+			unrolled = n_samples & ~3;
+		else
+			unrolled = 0;
+
+		for(n = 0; n < unrolled; n += 4) {
+			in = _mm_min_ps(max, _mm_max_ps(_mm_load_ps(&s[n]), min));
+			out = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(in, scale), offs));
+			d[0*n_channels] = _mm_cvtsi128_si32(out);
+			d[1*n_channels] = _mm_cvtsi128_si32(_mm_srli_si128(out, 4));
+			d[2*n_channels] = _mm_cvtsi128_si32(_mm_srli_si128(out, 8));
+			d[3*n_channels] = _mm_cvtsi128_si32(_mm_srli_si128(out, 12));
+			d += 4*n_channels;
+		}
+		for(; n < n_samples; n++) {
+			*d = F32_TO_U8(s[n]);
+			d += n_channels;
+		}
+	}
+}
+
+static void
+conv_deinterleave_32_4s_sse2(void *data, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src,
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s = src;
+	float *d0 = dst[0], *d1 = dst[1], *d2 = dst[2], *d3 = dst[3];
+	uint32_t n, unrolled;
+	__m128 in[4];
+
+	if (SPA_IS_ALIGNED(d0, 16) &&
+	    SPA_IS_ALIGNED(d1, 16) &&
+	    SPA_IS_ALIGNED(d2, 16) &&
+	    SPA_IS_ALIGNED(d3, 16))
+		unrolled = n_samples & ~3;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 4) {
+		in[0] = _mm_loadu_ps(&s[0*n_channels]);
+		in[1] = _mm_loadu_ps(&s[1*n_channels]);
+		in[2] = _mm_loadu_ps(&s[2*n_channels]);
+		in[3] = _mm_loadu_ps(&s[3*n_channels]);
+
+		_MM_TRANSPOSE4_PS(in[0], in[1], in[2], in[3]);
+
+		_mm_store_ps(&d0[n], in[0]);
+		_mm_store_ps(&d1[n], in[1]);
+		_mm_store_ps(&d2[n], in[2]);
+		_mm_store_ps(&d3[n], in[3]);
+		s += 4*n_channels;
+	}
+	for(; n < n_samples; n++) {
+		d0[n] = s[0];
+		d1[n] = s[1];
+		d2[n] = s[2];
+		d3[n] = s[3];
+		s += n_channels;
+	}
+}
+
+static void
+conv_deinterleave_32_2s_sse2(void *data, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src,
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s = src;
+	float *d0 = dst[0], *d1 = dst[1];
+	uint32_t n, unrolled;
+	__m128 in[2];
+
+	if (SPA_IS_ALIGNED(d0, 16) &&
+	    SPA_IS_ALIGNED(d1, 16))
+		unrolled = n_samples & ~3;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 4) {
+		in[0] = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (__m64*)&s[0*n_channels]),
+				(__m64*)&s[1*n_channels]);
+		in[1] = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (__m64*)&s[2*n_channels]),
+				(__m64*)&s[3*n_channels]);
+
+		_mm_store_ps(&d0[n], _mm_shuffle_ps(in[0], in[1], _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_store_ps(&d1[n], _mm_shuffle_ps(in[0], in[1], _MM_SHUFFLE(3, 1, 3, 1)));
+		s += 4*n_channels;
+	}
+	for(; n < n_samples; n++) {
+		d0[n] = s[0];
+		d1[n] = s[1];
+		s += n_channels;
+	}
+}
+
+static void
+conv_deinterleave_32_1s_sse2(void *data, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src,
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s = src;
+	float *d0 = dst[0];
+	uint32_t n;
+
+	for(n = 0; n < n_samples; n++) {
+		d0[n] = s[0];
+		s += n_channels;
+	}
+}
+
+void
+conv_deinterleave_32_sse2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	const float *s = src[0];
+	uint32_t i = 0, n_channels = conv->n_channels;
+
+	if (n_channels == 1) {
+		spa_memcpy(dst[0], s, n_samples * sizeof(float));
+		return;
+	}
+	for(; i + 3 < n_channels; i += 4)
+		conv_deinterleave_32_4s_sse2(conv, &dst[i], &s[i], n_channels, n_samples);
+	for(; i + 1 < n_channels; i += 2)
+		conv_deinterleave_32_2s_sse2(conv, &dst[i], &s[i], n_channels, n_samples);
+	for(; i < n_channels; i++)
+		conv_deinterleave_32_1s_sse2(conv, &dst[i], &s[i], n_channels, n_samples);
+}
+
+static void
+conv_interleave_32_4s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s0 = src[0], *s1 = src[1], *s2 = src[2], *s3 = src[3];
+	float *d = dst;
+	uint32_t n, unrolled;
+	__m128 in[4];
+
+	if (SPA_IS_ALIGNED(s0, 16) &&
+	    SPA_IS_ALIGNED(s1, 16) &&
+	    SPA_IS_ALIGNED(s2, 16) &&
+	    SPA_IS_ALIGNED(s3, 16))
+		unrolled = n_samples & ~3;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 4) {
+		in[0] = _mm_load_ps(&s0[n]);
+		in[1] = _mm_load_ps(&s1[n]);
+		in[2] = _mm_load_ps(&s2[n]);
+		in[3] = _mm_load_ps(&s3[n]);
+
+		_MM_TRANSPOSE4_PS(in[0], in[1], in[2], in[3]);
+
+		_mm_storeu_ps(&d[0*n_channels], in[0]);
+		_mm_storeu_ps(&d[1*n_channels], in[1]);
+		_mm_storeu_ps(&d[2*n_channels], in[2]);
+		_mm_storeu_ps(&d[3*n_channels], in[3]);
+		d += 4*n_channels;
+	}
+	for(; n < n_samples; n++) {
+		d[0] = s0[n];
+		d[1] = s1[n];
+		d[2] = s2[n];
+		d[3] = s3[n];
+		d += n_channels;
+	}
+}
+
+static void
+conv_interleave_32_2s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s0 = src[0], *s1 = src[1];
+	float *d = dst;
+	uint32_t n, unrolled;
+	__m128 in[2], t[2];
+
+	if (SPA_IS_ALIGNED(s0, 16) &&
+	    SPA_IS_ALIGNED(s1, 16))
+		unrolled = n_samples & ~3;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 4) {
+		in[0] = _mm_load_ps(&s0[n]);
+		in[1] = _mm_load_ps(&s1[n]);
+
+		t[0] = _mm_unpacklo_ps(in[0], in[1]);
+		t[1] = _mm_unpackhi_ps(in[0], in[1]);
+
+		_mm_storel_pi((__m64*)&d[0*n_channels], t[0]);
+		_mm_storeh_pi((__m64*)&d[1*n_channels], t[0]);
+		_mm_storel_pi((__m64*)&d[2*n_channels], t[1]);
+		_mm_storeh_pi((__m64*)&d[3*n_channels], t[1]);
+		d += 4*n_channels;
+	}
+	for(; n < n_samples; n++) {
+		d[0] = s0[n];
+		d[1] = s1[n];
+		d += n_channels;
+	}
+}
+
+static void
+conv_interleave_32_1s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s0 = src[0];
+	float *d = dst;
+	uint32_t n;
+
+	for(n = 0; n < n_samples; n++) {
+		d[0] = s0[n];
+		d += n_channels;
+	}
+}
+
+void
+conv_interleave_32_sse2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	float *d = dst[0];
+	uint32_t i = 0, n_channels = conv->n_channels;
+
+	if (n_channels == 1) {
+		spa_memcpy(d, src[0], n_samples * sizeof(float));
+		return;
+	}
+	for(; i + 3 < n_channels; i += 4)
+		conv_interleave_32_4s_sse2(conv, &d[i], &src[i], n_channels, n_samples);
+	for(; i + 1 < n_channels; i += 2)
+		conv_interleave_32_2s_sse2(conv, &d[i], &src[i], n_channels, n_samples);
+	for(; i < n_channels; i++)
+		conv_interleave_32_1s_sse2(conv, &d[i], &src[i], n_channels, n_samples);
+}
+
+static inline __m128i load_32(const void *p)
+{
+	int32_t v;
+	memcpy(&v, p, sizeof(v));
+	return _mm_cvtsi32_si128(v);
+}
+
+static inline void store_32(void *p, __m128i v)
+{
+	int32_t t = _mm_cvtsi128_si32(v);
+	memcpy(p, &t, sizeof(t));
+}
+
+static void
+conv_deinterleave_16_4s_sse2(void *data, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src,
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const int16_t *s = src;
+	int16_t *d0 = dst[0], *d1 = dst[1], *d2 = dst[2], *d3 = dst[3];
+	uint32_t n, unrolled = n_samples & ~3;
+	__m128i in[4], t[2];
+
+	for(n = 0; n < unrolled; n += 4) {
+		in[0] = _mm_loadl_epi64((__m128i*)&s[0*n_channels]);
+		in[1] = _mm_loadl_epi64((__m128i*)&s[1*n_channels]);
+		in[2] = _mm_loadl_epi64((__m128i*)&s[2*n_channels]);
+		in[3] = _mm_loadl_epi64((__m128i*)&s[3*n_channels]);
+
+		t[0] = _mm_unpacklo_epi16(in[0], in[1]);
+		t[1] = _mm_unpacklo_epi16(in[2], in[3]);
+		in[0] = _mm_unpacklo_epi32(t[0], t[1]);
+		in[1] = _mm_unpackhi_epi32(t[0], t[1]);
+
+		_mm_storel_epi64((__m128i*)&d0[n], in[0]);
+		_mm_storel_epi64((__m128i*)&d1[n], _mm_srli_si128(in[0], 8));
+		_mm_storel_epi64((__m128i*)&d2[n], in[1]);
+		_mm_storel_epi64((__m128i*)&d3[n], _mm_srli_si128(in[1], 8));
+		s += 4*n_channels;
+	}
+	for(; n < n_samples; n++) {
+		d0[n] = s[0];
+		d1[n] = s[1];
+		d2[n] = s[2];
+		d3[n] = s[3];
+		s += n_channels;
+	}
+}
+
+static void
+conv_deinterleave_16_2s_sse2(void *data, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src,
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const int16_t *s = src;
+	int16_t *d0 = dst[0], *d1 = dst[1];
+	uint32_t n, unrolled = n_samples & ~3;
+	__m128i in[2];
+
+	for(n = 0; n < unrolled; n += 4) {
+		in[0] = _mm_unpacklo_epi32(load_32(&s[0*n_channels]), load_32(&s[1*n_channels]));
+		in[1] = _mm_unpacklo_epi32(load_32(&s[2*n_channels]), load_32(&s[3*n_channels]));
+		in[0] = _mm_unpacklo_epi64(in[0], in[1]);
+
+		in[0] = _mm_shufflelo_epi16(in[0], _MM_SHUFFLE(3, 1, 2, 0));
+		in[0] = _mm_shufflehi_epi16(in[0], _MM_SHUFFLE(3, 1, 2, 0));
+		in[0] = _mm_shuffle_epi32(in[0], _MM_SHUFFLE(3, 1, 2, 0));
+
+		_mm_storel_epi64((__m128i*)&d0[n], in[0]);
+		_mm_storel_epi64((__m128i*)&d1[n], _mm_srli_si128(in[0], 8));
+		s += 4*n_channels;
+	}
+	for(; n < n_samples; n++) {
+		d0[n] = s[0];
+		d1[n] = s[1];
+		s += n_channels;
+	}
+}
+
+static void
+conv_deinterleave_16_1s_sse2(void *data, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src,
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const int16_t *s = src;
+	int16_t *d0 = dst[0];
+	uint32_t n;
+
+	for(n = 0; n < n_samples; n++) {
+		d0[n] = s[0];
+		s += n_channels;
+	}
+}
+
+void
+conv_deinterleave_16_sse2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	const int16_t *s = src[0];
+	uint32_t i = 0, n_channels = conv->n_channels;
+
+	if (n_channels == 1) {
+		spa_memcpy(dst[0], s, n_samples * sizeof(int16_t));
+		return;
+	}
+	for(; i + 3 < n_channels; i += 4)
+		conv_deinterleave_16_4s_sse2(conv, &dst[i], &s[i], n_channels, n_samples);
+	for(; i + 1 < n_channels; i += 2)
+		conv_deinterleave_16_2s_sse2(conv, &dst[i], &s[i], n_channels, n_samples);
+	for(; i < n_channels; i++)
+		conv_deinterleave_16_1s_sse2(conv, &dst[i], &s[i], n_channels, n_samples);
+}
+
+static void
+conv_interleave_16_4s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const int16_t *s0 = src[0], *s1 = src[1], *s2 = src[2], *s3 = src[3];
+	int16_t *d = dst;
+	uint32_t n, unrolled = n_samples & ~3;
+	__m128i in[4], t[2];
+
+	for(n = 0; n < unrolled; n += 4) {
+		in[0] = _mm_loadl_epi64((__m128i*)&s0[n]);
+		in[1] = _mm_loadl_epi64((__m128i*)&s1[n]);
+		in[2] = _mm_loadl_epi64((__m128i*)&s2[n]);
+		in[3] = _mm_loadl_epi64((__m128i*)&s3[n]);
+
+		t[0] = _mm_unpacklo_epi16(in[0], in[1]);
+		t[1] = _mm_unpacklo_epi16(in[2], in[3]);
+		in[0] = _mm_unpacklo_epi32(t[0], t[1]);
+		in[1] = _mm_unpackhi_epi32(t[0], t[1]);
+
+		_mm_storel_epi64((__m128i*)&d[0*n_channels], in[0]);
+		_mm_storel_epi64((__m128i*)&d[1*n_channels], _mm_srli_si128(in[0], 8));
+		_mm_storel_epi64((__m128i*)&d[2*n_channels], in[1]);
+		_mm_storel_epi64((__m128i*)&d[3*n_channels], _mm_srli_si128(in[1], 8));
+		d += 4*n_channels;
+	}
+	for(; n < n_samples; n++) {
+		d[0] = s0[n];
+		d[1] = s1[n];
+		d[2] = s2[n];
+		d[3] = s3[n];
+		d += n_channels;
+	}
+}
+
+static void
+conv_interleave_16_2s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const int16_t *s0 = src[0], *s1 = src[1];
+	int16_t *d = dst;
+	uint32_t n, unrolled = n_samples & ~3;
+	__m128i t;
+
+	for(n = 0; n < unrolled; n += 4) {
+		t = _mm_unpacklo_epi16(_mm_loadl_epi64((__m128i*)&s0[n]),
+				_mm_loadl_epi64((__m128i*)&s1[n]));
+
+		store_32(&d[0*n_channels], t);
+		store_32(&d[1*n_channels], _mm_srli_si128(t, 4));
+		store_32(&d[2*n_channels], _mm_srli_si128(t, 8));
+		store_32(&d[3*n_channels], _mm_srli_si128(t, 12));
+		d += 4*n_channels;
+	}
+	for(; n < n_samples; n++) {
+		d[0] = s0[n];
+		d[1] = s1[n];
+		d += n_channels;
+	}
+}
+
+static void
+conv_interleave_16_1s_sse2(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const int16_t *s0 = src[0];
+	int16_t *d = dst;
+	uint32_t n;
+
+	for(n = 0; n < n_samples; n++) {
+		d[0] = s0[n];
+		d += n_channels;
+	}
+}
+
+void
+conv_interleave_16_sse2(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	int16_t *d = dst[0];
+	uint32_t i = 0, n_channels = conv->n_channels;
+
+	if (n_channels == 1) {
+		spa_memcpy(d, src[0], n_samples * sizeof(int16_t));
+		return;
+	}
+	for(; i + 3 < n_channels; i += 4)
+		conv_interleave_16_4s_sse2(conv, &d[i], &src[i], n_channels, n_samples);
+	for(; i + 1 < n_channels; i += 2)
+		conv_interleave_16_2s_sse2(conv, &d[i], &src[i], n_channels, n_samples);
+	for(; i < n_channels; i++)
+		conv_interleave_16_1s_sse2(conv, &d[i], &src[i], n_channels, n_samples);
+}
@@ -22,6 +22,8 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#include <string.h>
+
 #include "fmt-ops.h"
 
 #include <tmmintrin.h>
@@ -109,3 +111,157 @@ conv_s24_to_f32d_ssse3(struct convert *conv, void * SPA_RESTRICT dst[], const vo
 	for(; i < n_channels; i++)
 		conv_s24_to_f32d_1s_sse2(conv, &dst[i], &s[3*i], n_channels, n_samples);
 }
+
+/* pack the low 24 bits of the 4 samples in the low 12 bytes */
+static inline __m128i pack_s24_ssse3(__m128i v)
+{
+	const __m128i mask = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	return _mm_shuffle_epi8(v, mask);
+}
+
+static inline void store_s24x2_ssse3(uint8_t *d, __m128i v)
+{
+	int32_t t0 = _mm_cvtsi128_si32(v);
+	int16_t t1 = _mm_extract_epi16(v, 2);
+	memcpy(d, &t0, sizeof(t0));
+	memcpy(d + 4, &t1, sizeof(t1));
+}
+
+static inline void store_s24x4_ssse3(uint8_t *d, __m128i v)
+{
+	int32_t t = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+	_mm_storel_epi64((__m128i*)d, v);
+	memcpy(d + 8, &t, sizeof(t));
+}
+
+static void
+conv_f32d_to_s24_4s_ssse3(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s0 = src[0], *s1 = src[1], *s2 = src[2], *s3 = src[3];
+	uint8_t *d = dst;
+	uint32_t n, unrolled;
+	__m128 in[4];
+	__m128 scale = _mm_set1_ps(S24_SCALE);
+	__m128 max = _mm_set1_ps(1.0f), min = _mm_set1_ps(-1.0f);
+
+	if (SPA_IS_ALIGNED(s0, 16) &&
+	    SPA_IS_ALIGNED(s1, 16) &&
+	    SPA_IS_ALIGNED(s2, 16) &&
+	    SPA_IS_ALIGNED(s3, 16))
+		unrolled = n_samples & ~3;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 4) {
+		in[0] = _mm_min_ps(max, _mm_max_ps(_mm_load_ps(&s0[n]), min));
+		in[1] = _mm_min_ps(max, _mm_max_ps(_mm_load_ps(&s1[n]), min));
+		in[2] = _mm_min_ps(max, _mm_max_ps(_mm_load_ps(&s2[n]), min));
+		in[3] = _mm_min_ps(max, _mm_max_ps(_mm_load_ps(&s3[n]), min));
+
+		_MM_TRANSPOSE4_PS(in[0], in[1], in[2], in[3]);
+
+		store_s24x4_ssse3(d + 0*n_channels, pack_s24_ssse3(_mm_cvttps_epi32(_mm_mul_ps(in[0], scale))));
+		store_s24x4_ssse3(d + 3*n_channels, pack_s24_ssse3(_mm_cvttps_epi32(_mm_mul_ps(in[1], scale))));
+		store_s24x4_ssse3(d + 6*n_channels, pack_s24_ssse3(_mm_cvttps_epi32(_mm_mul_ps(in[2], scale))));
+		store_s24x4_ssse3(d + 9*n_channels, pack_s24_ssse3(_mm_cvttps_epi32(_mm_mul_ps(in[3], scale))));
+		d += 12 * n_channels;
+	}
+	for(; n < n_samples; n++) {
+		in[0] = _mm_setr_ps(s0[n], s1[n], s2[n], s3[n]);
+		in[0] = _mm_min_ps(max, _mm_max_ps(in[0], min));
+		store_s24x4_ssse3(d, pack_s24_ssse3(_mm_cvttps_epi32(_mm_mul_ps(in[0], scale))));
+		d += 3 * n_channels;
+	}
+}
+
+static void
+conv_f32d_to_s24_2s_ssse3(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s0 = src[0], *s1 = src[1];
+	uint8_t *d = dst;
+	uint32_t n, unrolled;
+	__m128 in[2];
+	__m128i out[2];
+	__m128 scale = _mm_set1_ps(S24_SCALE);
+	__m128 max = _mm_set1_ps(1.0f), min = _mm_set1_ps(-1.0f);
+
+	if (SPA_IS_ALIGNED(s0, 16) &&
+	    SPA_IS_ALIGNED(s1, 16))
+		unrolled = n_samples & ~3;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 4) {
+		in[0] = _mm_min_ps(max, _mm_max_ps(_mm_load_ps(&s0[n]), min));
+		in[1] = _mm_min_ps(max, _mm_max_ps(_mm_load_ps(&s1[n]), min));
+
+		out[0] = _mm_cvttps_epi32(_mm_mul_ps(_mm_unpacklo_ps(in[0], in[1]), scale));
+		out[1] = _mm_cvttps_epi32(_mm_mul_ps(_mm_unpackhi_ps(in[0], in[1]), scale));
+		out[0] = pack_s24_ssse3(out[0]);
+		out[1] = pack_s24_ssse3(out[1]);
+
+		store_s24x2_ssse3(d + 0*n_channels, out[0]);
+		store_s24x2_ssse3(d + 3*n_channels, _mm_srli_si128(out[0], 6));
+		store_s24x2_ssse3(d + 6*n_channels, out[1]);
+		store_s24x2_ssse3(d + 9*n_channels, _mm_srli_si128(out[1], 6));
+		d += 12 * n_channels;
+	}
+	for(; n < n_samples; n++) {
+		write_s24(d, F32_TO_S24(s0[n]));
+		write_s24(d + 3, F32_TO_S24(s1[n]));
+		d += 3 * n_channels;
+	}
+}
+
+static void
+conv_f32d_to_s24_1s_ssse3(void *data, void * SPA_RESTRICT dst, const void * SPA_RESTRICT src[],
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const float *s0 = src[0];
+	uint8_t *d = dst;
+	uint32_t n, unrolled;
+	__m128 in;
+	__m128i out;
+	__m128 scale = _mm_set1_ps(S24_SCALE);
+	__m128 max = _mm_set1_ps(1.0f), min = _mm_set1_ps(-1.0f);
+
+	if (SPA_IS_ALIGNED(s0, 16))
+		unrolled = n_samples & ~3;
+	else
+		unrolled = 0;
+
+	for(n = 0; n < unrolled; n += 4) {
+		in = _mm_min_ps(max, _mm_max_ps(_mm_load_ps(&s0[n]), min));
+		out = _mm_cvttps_epi32(_mm_mul_ps(in, scale));
+		if (n_channels == 1) {
+			store_s24x4_ssse3(d, pack_s24_ssse3(out));
+		} else {
+			write_s24(d + 0*n_channels, _mm_cvtsi128_si32(out));
+			write_s24(d + 3*n_channels, _mm_cvtsi128_si32(_mm_srli_si128(out, 4)));
+			write_s24(d + 6*n_channels, _mm_cvtsi128_si32(_mm_srli_si128(out, 8)));
+			write_s24(d + 9*n_channels, _mm_cvtsi128_si32(_mm_srli_si128(out, 12)));
+		}
+		d += 12 * n_channels;
+	}
+	for(; n < n_samples; n++) {
+		write_s24(d, F32_TO_S24(s0[n]));
+		d += 3 * n_channels;
+	}
+}
+
+void
+conv_f32d_to_s24_ssse3(struct convert *conv, void * SPA_RESTRICT dst[], const void * SPA_RESTRICT src[],
+		uint32_t n_samples)
+{
+	uint8_t *d = dst[0];
+	uint32_t i = 0, n_channels = conv->n_channels;
+
+	for(; i + 3 < n_channels; i += 4)
+		conv_f32d_to_s24_4s_ssse3(conv, &d[3*i], &src[i], n_channels, n_samples);
+	for(; i + 1 < n_channels; i += 2)
+		conv_f32d_to_s24_2s_ssse3(conv, &d[3*i], &src[i], n_channels, n_samples);
+	for(; i < n_channels; i++)
+		conv_f32d_to_s24_1s_ssse3(conv, &d[3*i], &src[i], n_channels, n_samples);
+}
@@ -189,6 +189,8 @@ DEFINE_FUNCTION(interleave_32, c);
 #if defined(HAVE_NEON)
 DEFINE_FUNCTION(s16_to_f32d, neon);
 DEFINE_FUNCTION(f32d_to_s16, neon);
+DEFINE_FUNCTION(deinterleave_32, neon);
+DEFINE_FUNCTION(interleave_32, neon);
 #endif
 #if defined(HAVE_SSE2)
 DEFINE_FUNCTION(s16_to_f32d_2, sse2);
@@ -198,9 +200,18 @@ DEFINE_FUNCTION(s32_to_f32d, sse2);
 DEFINE_FUNCTION(f32d_to_s32, sse2);
 DEFINE_FUNCTION(f32d_to_s16_2, sse2);
 DEFINE_FUNCTION(f32d_to_s16, sse2);
+DEFINE_FUNCTION(u8_to_f32d, sse2);
+DEFINE_FUNCTION(f32d_to_u8, sse2);
+DEFINE_FUNCTION(s24_32_to_f32d, sse2);
+DEFINE_FUNCTION(f32d_to_s24_32, sse2);
+DEFINE_FUNCTION(deinterleave_16, sse2);
+DEFINE_FUNCTION(deinterleave_32, sse2);
+DEFINE_FUNCTION(interleave_16, sse2);
+DEFINE_FUNCTION(interleave_32, sse2);
 #endif
 #if defined(HAVE_SSSE3)
 DEFINE_FUNCTION(s24_to_f32d, ssse3);
+DEFINE_FUNCTION(f32d_to_s24, ssse3);
 #endif
 #if defined(HAVE_SSE41)
 DEFINE_FUNCTION(s24_to_f32d, sse41);
@@ -0,0 +1,80 @@
+/* Spa
+ *
+ * Copyright © 2020 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <math.h>
+
+#include "meter-ops.h"
+
+void meter_peak_sumsq_c(struct meter *m, const float * SPA_RESTRICT src[],
+		uint32_t offset, uint32_t n_samples)
+{
+	uint32_t c, n;
+
+	for (c = 0; c < m->channels; c++) {
+		const float *s = &src[c][offset];
+		float peak = m->peak[c], sumsq = m->sumsq[c];
+
+		for (n = 0; n < n_samples; n++) {
+			peak = SPA_MAX(peak, fabsf(s[n]));
+			sumsq += s[n] * s[n];
+		}
+		m->peak[c] = peak;
+		m->sumsq[c] = sumsq;
+	}
+}
+
+void meter_kweight_c(struct meter *m, const float * SPA_RESTRICT src[],
+		uint32_t offset, uint32_t n_samples)
+{
+	const struct meter_biquad *k0 = &m->kw[0], *k1 = &m->kw[1];
+	uint32_t c, n;
+
+	for (c = 0; c < m->channels; c++) {
+		const float *s = &src[c][offset];
+		float z0 = m->z[0][c], z1 = m->z[1][c];
+		float z2 = m->z[2][c], z3 = m->z[3][c];
+		float sumsq = m->kwsumsq[c];
+
+		for (n = 0; n < n_samples; n++) {
+			float x = s[n], y;
+
+			/* transposed direct form II */
+			y = k0->b0 * x + z0;
+			z0 = k0->b1 * x - k0->a1 * y + z1;
+			z1 = k0->b2 * x - k0->a2 * y;
+			x = y;
+			y = k1->b0 * x + z2;
+			z2 = k1->b1 * x - k1->a1 * y + z3;
+			z3 = k1->b2 * x - k1->a2 * y;
+
+			sumsq += y * y;
+		}
+		m->z[0][c] = z0;
+		m->z[1][c] = z1;
+		m->z[2][c] = z2;
+		m->z[3][c] = z3;
+		m->kwsumsq[c] = sumsq;
+	}
+}
@@ -0,0 +1,150 @@
+/* Spa
+ *
+ * Copyright © 2020 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <math.h>
+
+#include <xmmintrin.h>
+
+#include "meter-ops.h"
+
+static inline float hmax_ps(__m128 val)
+{
+	__m128 t = _mm_movehl_ps(val, val);
+	t = _mm_max_ps(t, val);
+	val = _mm_shuffle_ps(t, t, 0x55);
+	val = _mm_max_ss(t, val);
+	return _mm_cvtss_f32(val);
+}
+
+static inline float hadd_ps(__m128 val)
+{
+	__m128 t = _mm_movehl_ps(val, val);
+	t = _mm_add_ps(t, val);
+	val = _mm_shuffle_ps(t, t, 0x55);
+	val = _mm_add_ss(t, val);
+	return _mm_cvtss_f32(val);
+}
+
+void meter_peak_sumsq_sse(struct meter *m, const float * SPA_RESTRICT src[],
+		uint32_t offset, uint32_t n_samples)
+{
+	uint32_t c, n, unrolled;
+	const __m128 mask = _mm_andnot_ps(_mm_set_ps1(-0.0f),
+			_mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps()));
+
+	for (c = 0; c < m->channels; c++) {
+		const float *s = &src[c][offset];
+		float peak = m->peak[c], sumsq = 0.0f;
+		__m128 in[2], max[2], sum[2];
+
+		max[0] = max[1] = _mm_set1_ps(peak);
+		sum[0] = sum[1] = _mm_setzero_ps();
+
+		unrolled = n_samples & ~7;
+
+		for (n = 0; n < unrolled; n += 8) {
+			in[0] = _mm_loadu_ps(&s[n]);
+			in[1] = _mm_loadu_ps(&s[n+4]);
+			sum[0] = _mm_add_ps(sum[0], _mm_mul_ps(in[0], in[0]));
+			sum[1] = _mm_add_ps(sum[1], _mm_mul_ps(in[1], in[1]));
+			max[0] = _mm_max_ps(max[0], _mm_and_ps(mask, in[0]));
+			max[1] = _mm_max_ps(max[1], _mm_and_ps(mask, in[1]));
+		}
+		for (; n < n_samples; n++) {
+			peak = SPA_MAX(peak, fabsf(s[n]));
+			sumsq += s[n] * s[n];
+		}
+		m->peak[c] = SPA_MAX(peak, hmax_ps(_mm_max_ps(max[0], max[1])));
+		m->sumsq[c] += sumsq + hadd_ps(_mm_add_ps(sum[0], sum[1]));
+	}
+}
+
+/* run the two biquads on 4 channels at once */
+#define KWEIGHT_STEP(x)									\
+do {											\
+	__m128 _y;									\
+	_y = _mm_add_ps(_mm_mul_ps(b0[0], x), z0);					\
+	z0 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1[0], x), _mm_mul_ps(a1[0], _y)), z1);	\
+	z1 = _mm_sub_ps(_mm_mul_ps(b2[0], x), _mm_mul_ps(a2[0], _y));			\
+	x = _y;										\
+	_y = _mm_add_ps(_mm_mul_ps(b0[1], x), z2);					\
+	z2 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1[1], x), _mm_mul_ps(a1[1], _y)), z3);	\
+	z3 = _mm_sub_ps(_mm_mul_ps(b2[1], x), _mm_mul_ps(a2[1], _y));			\
+	sum = _mm_add_ps(sum, _mm_mul_ps(_y, _y));					\
+} while (0)
+
+void meter_kweight_sse(struct meter *m, const float * SPA_RESTRICT src[],
+		uint32_t offset, uint32_t n_samples)
+{
+	uint32_t c, i, n, unrolled;
+	__m128 b0[2], b1[2], b2[2], a1[2], a2[2];
+
+	for (i = 0; i < 2; i++) {
+		b0[i] = _mm_set1_ps(m->kw[i].b0);
+		b1[i] = _mm_set1_ps(m->kw[i].b1);
+		b2[i] = _mm_set1_ps(m->kw[i].b2);
+		a1[i] = _mm_set1_ps(m->kw[i].a1);
+		a2[i] = _mm_set1_ps(m->kw[i].a2);
+	}
+
+	/* the state has room for a multiple of 4 channels, the lanes after
+	 * the last channel filter a copy of it and are ignored */
+	for (c = 0; c < m->channels; c += 4) {
+		const float *s[4];
+		__m128 x[4], z0, z1, z2, z3, sum;
+
+		for (i = 0; i < 4; i++)
+			s[i] = &src[SPA_MIN(c + i, m->channels - 1)][offset];
+
+		z0 = _mm_load_ps(&m->z[0][c]);
+		z1 = _mm_load_ps(&m->z[1][c]);
+		z2 = _mm_load_ps(&m->z[2][c]);
+		z3 = _mm_load_ps(&m->z[3][c]);
+		sum = _mm_load_ps(&m->kwsumsq[c]);
+
+		unrolled = n_samples & ~3;
+
+		for (n = 0; n < unrolled; n += 4) {
+			x[0] = _mm_loadu_ps(&s[0][n]);
+			x[1] = _mm_loadu_ps(&s[1][n]);
+			x[2] = _mm_loadu_ps(&s[2][n]);
+			x[3] = _mm_loadu_ps(&s[3][n]);
+			_MM_TRANSPOSE4_PS(x[0], x[1], x[2], x[3]);
+			KWEIGHT_STEP(x[0]);
+			KWEIGHT_STEP(x[1]);
+			KWEIGHT_STEP(x[2]);
+			KWEIGHT_STEP(x[3]);
+		}
+		for (; n < n_samples; n++) {
+			x[0] = _mm_setr_ps(s[0][n], s[1][n], s[2][n], s[3][n]);
+			KWEIGHT_STEP(x[0]);
+		}
+		_mm_store_ps(&m->z[0][c], z0);
+		_mm_store_ps(&m->z[1][c], z1);
+		_mm_store_ps(&m->z[2][c], z2);
+		_mm_store_ps(&m->z[3][c], z3);
+		_mm_store_ps(&m->kwsumsq[c], sum);
+	}
+}
@@ -0,0 +1,185 @@
+/* Spa
+ *
+ * Copyright © 2020 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <spa/support/cpu.h>
+#include <spa/utils/defs.h>
+
+#include "meter-ops.h"
+
+/* K-weighting filter of ITU-R BS.1770, the coefficients are derived from
+ * the analog prototype so that they are valid for any sample rate */
+static void make_kweight(struct meter *m)
+{
+	double f0, G, Q, K, Vh, Vb, a0;
+
+	/* high shelf */
+	f0 = 1681.974450955533;
+	G = 3.999843853973347;
+	Q = 0.7071752369554196;
+	K = tan(M_PI * f0 / m->rate);
+	Vh = pow(10.0, G / 20.0);
+	Vb = pow(Vh, 0.4996667741545416);
+	a0 = 1.0 + K / Q + K * K;
+	m->kw[0].b0 = (Vh + Vb * K / Q + K * K) / a0;
+	m->kw[0].b1 = 2.0 * (K * K - Vh) / a0;
+	m->kw[0].b2 = (Vh - Vb * K / Q + K * K) / a0;
+	m->kw[0].a1 = 2.0 * (K * K - 1.0) / a0;
+	m->kw[0].a2 = (1.0 - K / Q + K * K) / a0;
+
+	/* high pass */
+	f0 = 38.13547087602444;
+	Q = 0.5003270373238773;
+	K = tan(M_PI * f0 / m->rate);
+	a0 = 1.0 + K / Q + K * K;
+	m->kw[1].b0 = 1.0;
+	m->kw[1].b1 = -2.0;
+	m->kw[1].b2 = 1.0;
+	m->kw[1].a1 = 2.0 * (K * K - 1.0) / a0;
+	m->kw[1].a2 = (1.0 - K / Q + K * K) / a0;
+}
+
+static float channel_weight(uint32_t position)
+{
+	switch (position) {
+	case SPA_AUDIO_CHANNEL_LFE:
+	case SPA_AUDIO_CHANNEL_LFE2:
+		return 0.0f;
+	case SPA_AUDIO_CHANNEL_SL:
+	case SPA_AUDIO_CHANNEL_SR:
+	case SPA_AUDIO_CHANNEL_RL:
+	case SPA_AUDIO_CHANNEL_RR:
+		return 1.41f;
+	default:
+		return 1.0f;
+	}
+}
+
+static inline float power_to_lufs(float power)
+{
+	return -0.691f + 10.0f * log10f(power);
+}
+
+void meter_reset(struct meter *m)
+{
+	m->fill = 0;
+	m->n_blocks = SPA_CLAMP((m->rate * 4 / 10 + m->interval / 2) / m->interval,
+			1u, (uint32_t)METER_MAX_BLOCKS);
+	m->block = 0;
+	memset(m->peak, 0, sizeof(m->peak));
+	memset(m->sumsq, 0, sizeof(m->sumsq));
+	memset(m->kwsumsq, 0, sizeof(m->kwsumsq));
+	memset(m->z, 0, sizeof(m->z));
+	memset(m->power, 0, sizeof(m->power));
+}
+
+int meter_init(struct meter *m)
+{
+	uint32_t c;
+
+	if (m->channels == 0 || m->channels > METER_MAX_CHANNELS || m->rate == 0)
+		return -EINVAL;
+
+	if (m->interval == 0)
+		m->interval = m->rate / 10;
+	m->interval = SPA_MAX(m->interval, SPA_MAX(m->rate / 100, 1u));
+
+	make_kweight(m);
+	for (c = 0; c < m->channels; c++)
+		m->weight[c] = channel_weight(m->position[c]);
+
+#if defined (HAVE_SSE)
+	if (m->cpu_flags & SPA_CPU_FLAG_SSE) {
+		m->peak_sumsq = meter_peak_sumsq_sse;
+		m->kweight = meter_kweight_sse;
+		m->cpu_flags = SPA_CPU_FLAG_SSE;
+	} else
+#endif
+	{
+		m->peak_sumsq = meter_peak_sumsq_c;
+		m->kweight = meter_kweight_c;
+		m->cpu_flags = 0;
+	}
+	meter_reset(m);
+	return 0;
+}
+
+static void finish_interval(struct meter *m)
+{
+	uint32_t b, c;
+	float total = 0.0f;
+
+	for (c = 0; c < m->channels; c++) {
+		float power = 0.0f;
+
+		m->out_peak[c] = m->peak[c];
+		m->out_rms[c] = sqrtf(m->sumsq[c] / m->interval);
+		m->power[m->block][c] = m->kwsumsq[c] / m->interval;
+
+		for (b = 0; b < m->n_blocks; b++)
+			power += m->power[b][c];
+		power /= m->n_blocks;
+
+		m->out_momentary[c] = power_to_lufs(power);
+		total += m->weight[c] * power;
+
+		/* avoid denormals in the filter state on silence */
+		for (b = 0; b < 4; b++)
+			if (fabsf(m->z[b][c]) < 1e-20f)
+				m->z[b][c] = 0.0f;
+	}
+	m->momentary = power_to_lufs(total);
+
+	m->block = (m->block + 1) % m->n_blocks;
+	memset(m->peak, 0, sizeof(m->peak));
+	memset(m->sumsq, 0, sizeof(m->sumsq));
+	memset(m->kwsumsq, 0, sizeof(m->kwsumsq));
+}
+
+uint32_t meter_process(struct meter *m, const void * SPA_RESTRICT src[], uint32_t n_samples)
+{
+	const float **s = (const float **)src;
+	uint32_t offset = 0, chunk, done = 0;
+
+	while (offset < n_samples) {
+		chunk = SPA_MIN(n_samples - offset, m->interval - m->fill);
+
+		m->peak_sumsq(m, s, offset, chunk);
+		m->kweight(m, s, offset, chunk);
+
+		offset += chunk;
+		m->fill += chunk;
+		if (m->fill == m->interval) {
+			finish_interval(m);
+			m->fill = 0;
+			done++;
+		}
+	}
+	return done;
+}
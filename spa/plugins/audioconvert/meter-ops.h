@@ -0,0 +1,99 @@
+/* Spa
+ *
+ * Copyright © 2020 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <string.h>
+#include <stdio.h>
+
+#include <spa/utils/defs.h>
+#include <spa/param/audio/raw.h>
+
+#define METER_MAX_CHANNELS	SPA_AUDIO_MAX_CHANNELS
+/** max number of intervals in the EBU R128 momentary window of 400ms */
+#define METER_MAX_BLOCKS	40
+
+struct meter_biquad {
+	float b0, b1, b2, a1, a2;
+};
+
+/**
+ * Measures peak, RMS and EBU R128 momentary loudness per channel.
+ *
+ * Set channels, rate, interval, position and cpu_flags and call meter_init().
+ * Samples are accumulated until \a interval samples were seen, then the
+ * results are computed and meter_process() returns the number of
+ * completed intervals.
+ */
+struct meter {
+	uint32_t channels;
+	uint32_t rate;
+	uint32_t interval;		/* update interval in samples */
+	uint32_t position[METER_MAX_CHANNELS];
+	uint32_t cpu_flags;
+
+	/* K-weighting filter, a high shelf followed by a high pass */
+	struct meter_biquad kw[2];
+	float weight[METER_MAX_CHANNELS];
+
+	/* accumulators of the current interval */
+	uint32_t fill;
+	float peak[METER_MAX_CHANNELS];
+	float sumsq[METER_MAX_CHANNELS];
+	float kwsumsq[METER_MAX_CHANNELS] SPA_ALIGNED(16);
+	/* filter state, [stage * 2 + n][channel] */
+	float z[4][METER_MAX_CHANNELS] SPA_ALIGNED(16);
+
+	/* K-weighted power of the last intervals */
+	float power[METER_MAX_BLOCKS][METER_MAX_CHANNELS];
+	uint32_t n_blocks;
+	uint32_t block;
+
+	/* results of the last completed interval */
+	float out_peak[METER_MAX_CHANNELS];
+	float out_rms[METER_MAX_CHANNELS];
+	float out_momentary[METER_MAX_CHANNELS];
+	float momentary;
+
+	void (*peak_sumsq) (struct meter *m, const float * SPA_RESTRICT src[],
+			uint32_t offset, uint32_t n_samples);
+	void (*kweight) (struct meter *m, const float * SPA_RESTRICT src[],
+			uint32_t offset, uint32_t n_samples);
+};
+
+int meter_init(struct meter *m);
+void meter_reset(struct meter *m);
+uint32_t meter_process(struct meter *m, const void * SPA_RESTRICT src[], uint32_t n_samples);
+
+#define DEFINE_FUNCTION(name,arch)					\
+void meter_##name##_##arch(struct meter *m,				\
+		const float * SPA_RESTRICT src[],			\
+		uint32_t offset, uint32_t n_samples);
+
+DEFINE_FUNCTION(peak_sumsq, c);
+DEFINE_FUNCTION(kweight, c);
+
+#if defined (HAVE_SSE)
+DEFINE_FUNCTION(peak_sumsq, sse);
+DEFINE_FUNCTION(kweight, sse);
+#endif
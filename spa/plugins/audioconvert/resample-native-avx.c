@@ -90,5 +90,70 @@ static void inner_product_ip_avx(float *d, const float * SPA_RESTRICT s,
 	_mm_store_ss(d, sx[0]);
 }
 
-MAKE_RESAMPLER_FULL(avx);
-MAKE_RESAMPLER_INTER(avx);
+/* sum the 8 floats of each of the 4 vectors into one vector of 4 sums */
+static inline __m128 hsum4_avx(__m256 a, __m256 b, __m256 c, __m256 d)
+{
+	__m256 t = _mm256_hadd_ps(_mm256_hadd_ps(a, b), _mm256_hadd_ps(c, d));
+	return _mm_add_ps(_mm256_castps256_ps128(t), _mm256_extractf128_ps(t, 1));
+}
+
+static inline void store4_avx(float **d, uint32_t o, __m128 sum)
+{
+	float t[4];
+	_mm_storeu_ps(t, sum);
+	d[0][o] = t[0];
+	d[1][o] = t[1];
+	d[2][o] = t[2];
+	d[3][o] = t[3];
+}
+
+static void inner_product_block_avx(float **d, uint32_t o,
+		const float **s, uint32_t index,
+		const float * SPA_RESTRICT taps, uint32_t n_taps)
+{
+	__m256 sy[4] = { _mm256_setzero_ps(), _mm256_setzero_ps(),
+		_mm256_setzero_ps(), _mm256_setzero_ps() }, ty;
+	const float *s0 = s[0] + index, *s1 = s[1] + index;
+	const float *s2 = s[2] + index, *s3 = s[3] + index;
+	uint32_t i;
+
+	for (i = 0; i < n_taps; i += 8) {
+		ty = _mm256_load_ps(taps + i);
+		sy[0] = _mm256_fmadd_ps(_mm256_loadu_ps(s0 + i), ty, sy[0]);
+		sy[1] = _mm256_fmadd_ps(_mm256_loadu_ps(s1 + i), ty, sy[1]);
+		sy[2] = _mm256_fmadd_ps(_mm256_loadu_ps(s2 + i), ty, sy[2]);
+		sy[3] = _mm256_fmadd_ps(_mm256_loadu_ps(s3 + i), ty, sy[3]);
+	}
+	store4_avx(d, o, hsum4_avx(sy[0], sy[1], sy[2], sy[3]));
+}
+
+static void inner_product_ip_block_avx(float **d, uint32_t o,
+		const float **s, uint32_t index,
+		const float * SPA_RESTRICT t0, const float * SPA_RESTRICT t1,
+		float x, uint32_t n_taps)
+{
+	__m256 sy[4] = { _mm256_setzero_ps(), _mm256_setzero_ps(),
+		_mm256_setzero_ps(), _mm256_setzero_ps() };
+	__m256 sz[4] = { _mm256_setzero_ps(), _mm256_setzero_ps(),
+		_mm256_setzero_ps(), _mm256_setzero_ps() };
+	__m256 ty, tz, v;
+	__m128 r0, r1;
+	uint32_t i, k;
+
+	for (i = 0; i < n_taps; i += 8) {
+		ty = _mm256_load_ps(t0 + i);
+		tz = _mm256_load_ps(t1 + i);
+		for (k = 0; k < 4; k++) {
+			v = _mm256_loadu_ps(s[k] + index + i);
+			sy[k] = _mm256_fmadd_ps(v, ty, sy[k]);
+			sz[k] = _mm256_fmadd_ps(v, tz, sz[k]);
+		}
+	}
+	r0 = hsum4_avx(sy[0], sy[1], sy[2], sy[3]);
+	r1 = hsum4_avx(sz[0], sz[1], sz[2], sz[3]);
+	r0 = _mm_fmadd_ps(_mm_sub_ps(r1, r0), _mm_set1_ps(x), r0);
+	store4_avx(d, o, r0);
+}
+
+MAKE_RESAMPLER_FULL_BLOCK(avx);
+MAKE_RESAMPLER_INTER_BLOCK(avx);
@@ -0,0 +1,168 @@
+/* Spa
+ *
+ * Copyright © 2020 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "resample-native-impl.h"
+
+#include <immintrin.h>
+
+/* fold the upper half of a 512 bit sum into the lower half */
+static inline __m256 fold_avx512(__m512 v)
+{
+	return _mm256_add_ps(_mm512_castps512_ps256(v),
+			_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1)));
+}
+
+static inline float hsum_avx512(__m256 v)
+{
+	__m128 x = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	x = _mm_hadd_ps(x, x);
+	x = _mm_hadd_ps(x, x);
+	return _mm_cvtss_f32(x);
+}
+
+static inline __m128 hsum4_avx512(__m256 a, __m256 b, __m256 c, __m256 d)
+{
+	__m256 t = _mm256_hadd_ps(_mm256_hadd_ps(a, b), _mm256_hadd_ps(c, d));
+	return _mm_add_ps(_mm256_castps256_ps128(t), _mm256_extractf128_ps(t, 1));
+}
+
+static inline void store4_avx512(float **d, uint32_t o, __m128 sum)
+{
+	float t[4];
+	_mm_storeu_ps(t, sum);
+	d[0][o] = t[0];
+	d[1][o] = t[1];
+	d[2][o] = t[2];
+	d[3][o] = t[3];
+}
+
+/* n_taps is a multiple of 8, do 16 taps at a time and the last 8 taps
+ * with 256 bit vectors */
+static void inner_product_avx512(float *d, const float * SPA_RESTRICT s,
+		const float * SPA_RESTRICT taps, uint32_t n_taps)
+{
+	__m512 sz = _mm512_setzero_ps();
+	__m256 sy;
+	uint32_t i, n_taps16 = n_taps & ~0xf;
+
+	for (i = 0; i < n_taps16; i += 16)
+		sz = _mm512_fmadd_ps(_mm512_loadu_ps(s + i), _mm512_load_ps(taps + i), sz);
+	sy = fold_avx512(sz);
+	if (i < n_taps)
+		sy = _mm256_fmadd_ps(_mm256_loadu_ps(s + i), _mm256_load_ps(taps + i), sy);
+	*d = hsum_avx512(sy);
+}
+
+static void inner_product_ip_avx512(float *d, const float * SPA_RESTRICT s,
+	const float * SPA_RESTRICT t0, const float * SPA_RESTRICT t1, float x,
+	uint32_t n_taps)
+{
+	__m512 sz[2] = { _mm512_setzero_ps(), _mm512_setzero_ps() }, tz;
+	__m256 sy[2], ty;
+	uint32_t i, n_taps16 = n_taps & ~0xf;
+
+	for (i = 0; i < n_taps16; i += 16) {
+		tz = _mm512_loadu_ps(s + i);
+		sz[0] = _mm512_fmadd_ps(tz, _mm512_load_ps(t0 + i), sz[0]);
+		sz[1] = _mm512_fmadd_ps(tz, _mm512_load_ps(t1 + i), sz[1]);
+	}
+	sy[0] = fold_avx512(sz[0]);
+	sy[1] = fold_avx512(sz[1]);
+	if (i < n_taps) {
+		ty = _mm256_loadu_ps(s + i);
+		sy[0] = _mm256_fmadd_ps(ty, _mm256_load_ps(t0 + i), sy[0]);
+		sy[1] = _mm256_fmadd_ps(ty, _mm256_load_ps(t1 + i), sy[1]);
+	}
+	sy[1] = _mm256_fmadd_ps(_mm256_sub_ps(sy[1], sy[0]), _mm256_set1_ps(x), sy[0]);
+	*d = hsum_avx512(sy[1]);
+}
+
+static void inner_product_block_avx512(float **d, uint32_t o,
+		const float **s, uint32_t index,
+		const float * SPA_RESTRICT taps, uint32_t n_taps)
+{
+	__m512 sz[4] = { _mm512_setzero_ps(), _mm512_setzero_ps(),
+		_mm512_setzero_ps(), _mm512_setzero_ps() }, tz;
+	__m256 sy[4], ty;
+	uint32_t i, k, n_taps16 = n_taps & ~0xf;
+
+	for (i = 0; i < n_taps16; i += 16) {
+		tz = _mm512_load_ps(taps + i);
+		for (k = 0; k < 4; k++)
+			sz[k] = _mm512_fmadd_ps(_mm512_loadu_ps(s[k] + index + i), tz, sz[k]);
+	}
+	for (k = 0; k < 4; k++)
+		sy[k] = fold_avx512(sz[k]);
+	if (i < n_taps) {
+		ty = _mm256_load_ps(taps + i);
+		for (k = 0; k < 4; k++)
+			sy[k] = _mm256_fmadd_ps(_mm256_loadu_ps(s[k] + index + i), ty, sy[k]);
+	}
+	store4_avx512(d, o, hsum4_avx512(sy[0], sy[1], sy[2], sy[3]));
+}
+
+static void inner_product_ip_block_avx512(float **d, uint32_t o,
+		const float **s, uint32_t index,
+		const float * SPA_RESTRICT t0, const float * SPA_RESTRICT t1,
+		float x, uint32_t n_taps)
+{
+	__m512 sz[4] = { _mm512_setzero_ps(), _mm512_setzero_ps(),
+		_mm512_setzero_ps(), _mm512_setzero_ps() };
+	__m512 sw[4] = { _mm512_setzero_ps(), _mm512_setzero_ps(),
+		_mm512_setzero_ps(), _mm512_setzero_ps() };
+	__m512 tz, tw, v;
+	__m256 sy[4], sx[4], ty, tx, u;
+	__m128 r0, r1;
+	uint32_t i, k, n_taps16 = n_taps & ~0xf;
+
+	for (i = 0; i < n_taps16; i += 16) {
+		tz = _mm512_load_ps(t0 + i);
+		tw = _mm512_load_ps(t1 + i);
+		for (k = 0; k < 4; k++) {
+			v = _mm512_loadu_ps(s[k] + index + i);
+			sz[k] = _mm512_fmadd_ps(v, tz, sz[k]);
+			sw[k] = _mm512_fmadd_ps(v, tw, sw[k]);
+		}
+	}
+	for (k = 0; k < 4; k++) {
+		sy[k] = fold_avx512(sz[k]);
+		sx[k] = fold_avx512(sw[k]);
+	}
+	if (i < n_taps) {
+		ty = _mm256_load_ps(t0 + i);
+		tx = _mm256_load_ps(t1 + i);
+		for (k = 0; k < 4; k++) {
+			u = _mm256_loadu_ps(s[k] + index + i);
+			sy[k] = _mm256_fmadd_ps(u, ty, sy[k]);
+			sx[k] = _mm256_fmadd_ps(u, tx, sx[k]);
+		}
+	}
+	r0 = hsum4_avx512(sy[0], sy[1], sy[2], sy[3]);
+	r1 = hsum4_avx512(sx[0], sx[1], sx[2], sx[3]);
+	r0 = _mm_fmadd_ps(_mm_sub_ps(r1, r0), _mm_set1_ps(x), r0);
+	store4_avx512(d, o, r0);
+}
+
+MAKE_RESAMPLER_FULL_BLOCK(avx512);
+MAKE_RESAMPLER_INTER_BLOCK(avx512);
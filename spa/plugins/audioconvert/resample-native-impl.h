@@ -52,6 +52,9 @@ struct native_data {
 	uint32_t filter_stride;
 	uint32_t filter_stride_os;
 	uint32_t hist;
+	uint32_t hist_reset;		/**< history size after a reset */
+	uint32_t copy_offset;		/**< offset of the current sample in the taps */
+	uint32_t delay;
 	float **history;
 	resample_func_t func;
 	float *filter;
@@ -68,7 +71,7 @@ void do_resample_##type##_##arch(struct resample *r,				\
 DEFINE_RESAMPLER(copy,arch)							\
 {										\
 	struct native_data *data = r->data;					\
-	uint32_t index, n_taps = data->n_taps, n_taps2 = n_taps/2;		\
+	uint32_t index, n_taps = data->n_taps, offset = data->copy_offset;	\
 	uint32_t c, olen = *out_len, ilen = *in_len;				\
 										\
 	if (r->channels == 0)							\
@@ -81,7 +84,7 @@ DEFINE_RESAMPLER(copy,arch)							\
 		for (c = 0; c < r->channels; c++) {				\
 			const float *s = src[c];				\
 			float *d = dst[c];					\
-			spa_memcpy(&d[ooffs], &s[index + n_taps2],		\
+			spa_memcpy(&d[ooffs], &s[index + offset],		\
 					to_copy * sizeof(float));		\
 		}								\
 		index += to_copy;						\
@@ -176,6 +179,106 @@ DEFINE_RESAMPLER(inter,arch)							\
 }
 
 
+/* channel blocked variants, the filter taps of a phase are loaded once
+ * for RESAMPLE_BLOCK channels. Needs inner_product_block_##arch and
+ * inner_product_ip_block_##arch for a full block of channels, the
+ * remaining channels use the single channel inner product. */
+#define RESAMPLE_BLOCK	4u
+
+#define MAKE_RESAMPLER_FULL_BLOCK(arch)						\
+DEFINE_RESAMPLER(full,arch)							\
+{										\
+	struct native_data *data = r->data;					\
+	uint32_t n_taps = data->n_taps, stride = data->filter_stride_os;	\
+	uint32_t index, phase, n_phases = data->out_rate;			\
+	uint32_t c, k, n, o, olen = *out_len, ilen = *in_len;			\
+	uint32_t inc = data->inc, frac = data->frac;				\
+	const float **s = (const float **)src;					\
+	float **d = (float **)dst;						\
+										\
+	if (r->channels == 0)							\
+		return;								\
+										\
+	for (c = 0; c < r->channels; c += n) {					\
+		n = SPA_MIN(r->channels - c, RESAMPLE_BLOCK);			\
+		index = ioffs;							\
+		phase = data->phase;						\
+										\
+		for (o = ooffs; o < olen && index + n_taps <= ilen; o++) {	\
+			const float *taps = &data->filter[phase * stride];	\
+										\
+			if (n == RESAMPLE_BLOCK)				\
+				inner_product_block_##arch(&d[c], o,		\
+						&s[c], index, taps, n_taps);	\
+			else							\
+				for (k = c; k < c + n; k++)			\
+					inner_product_##arch(&d[k][o],		\
+						&s[k][index], taps, n_taps);	\
+			index += inc;						\
+			phase += frac;						\
+			if (phase >= n_phases) {				\
+				phase -= n_phases;				\
+				index += 1;					\
+			}							\
+		}								\
+	}									\
+	*in_len = index;							\
+	*out_len = o;								\
+	data->phase = phase;							\
+}
+
+#define MAKE_RESAMPLER_INTER_BLOCK(arch)					\
+DEFINE_RESAMPLER(inter,arch)							\
+{										\
+	struct native_data *data = r->data;					\
+	uint32_t index, phase, stride = data->filter_stride;			\
+	uint32_t n_phases = data->n_phases, out_rate = data->out_rate;		\
+	uint32_t n_taps = data->n_taps;						\
+	uint32_t c, k, n, o, olen = *out_len, ilen = *in_len;			\
+	uint32_t inc = data->inc, frac = data->frac;				\
+	const float **s = (const float **)src;					\
+	float **d = (float **)dst;						\
+										\
+	if (r->channels == 0)							\
+		return;								\
+										\
+	for (c = 0; c < r->channels; c += n) {					\
+		n = SPA_MIN(r->channels - c, RESAMPLE_BLOCK);			\
+		index = ioffs;							\
+		phase = data->phase;						\
+										\
+		for (o = ooffs; o < olen && index + n_taps <= ilen; o++) {	\
+			const float *t0, *t1;					\
+			float ph, x;						\
+			uint32_t offset;					\
+										\
+			ph = (float)phase * n_phases / out_rate;		\
+			offset = floor(ph);					\
+			x = ph - (float)offset;					\
+										\
+			t0 = &data->filter[(offset + 0) * stride];		\
+			t1 = &data->filter[(offset + 1) * stride];		\
+			if (n == RESAMPLE_BLOCK)				\
+				inner_product_ip_block_##arch(&d[c], o,		\
+					&s[c], index, t0, t1, x, n_taps);	\
+			else							\
+				for (k = c; k < c + n; k++)			\
+					inner_product_ip_##arch(&d[k][o],	\
+						&s[k][index], t0, t1, x, n_taps); \
+			index += inc;						\
+			phase += frac;						\
+			if (phase >= out_rate) {				\
+				phase -= out_rate;				\
+				index += 1;					\
+			}							\
+		}								\
+	}									\
+	*in_len = index;							\
+	*out_len = o;								\
+	data->phase = phase;							\
+}
+
+
 DEFINE_RESAMPLER(copy,c);
 DEFINE_RESAMPLER(full,c);
 DEFINE_RESAMPLER(inter,c);
@@ -196,3 +299,7 @@ DEFINE_RESAMPLER(inter,ssse3);
 DEFINE_RESAMPLER(full,avx);
 DEFINE_RESAMPLER(inter,avx);
 #endif
+#if defined (HAVE_AVX512)
+DEFINE_RESAMPLER(full,avx512);
+DEFINE_RESAMPLER(inter,avx512);
+#endif
@@ -51,8 +51,12 @@ static const struct quality blackman_qualities[] = {
 	{ 1024, 0.998, },
 };
 
+/* oversampling of the prototype filter for the minimum phase design */
+#define MIN_PHASE_OVERSAMPLE	32
+
 static inline double sinc(double x)
 {
+	x = fabs(x);
 	if (x < 1e-6) return 1.0;
 	x *= M_PI;
 	return sin(x) / x;
@@ -81,6 +85,136 @@ static int build_filter(float *taps, uint32_t stride, uint32_t n_taps, uint32_t
 	return 0;
 }
 
+/* in place radix 2 FFT, n must be a power of 2 */
+static void fft(double *re, double *im, const double *tw_re, const double *tw_im,
+		uint32_t n, bool inverse)
+{
+	uint32_t i, j, k, len, bit;
+	double tr, ti;
+
+	for (i = 1, j = 0; i < n; i++) {
+		for (bit = n >> 1; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if (i < j) {
+			SPA_SWAP(re[i], re[j]);
+			SPA_SWAP(im[i], im[j]);
+		}
+	}
+	for (len = 2; len <= n; len <<= 1) {
+		uint32_t half = len / 2, step = n / len;
+		for (i = 0; i < n; i += len) {
+			for (k = 0; k < half; k++) {
+				uint32_t p = i + k, q = p + half;
+				double wr = tw_re[k * step];
+				double wi = inverse ? -tw_im[k * step] : tw_im[k * step];
+
+				tr = re[q] * wr - im[q] * wi;
+				ti = re[q] * wi + im[q] * wr;
+				re[q] = re[p] - tr;
+				im[q] = im[p] - ti;
+				re[p] += tr;
+				im[p] += ti;
+			}
+		}
+	}
+	if (inverse) {
+		for (i = 0; i < n; i++) {
+			re[i] /= n;
+			im[i] /= n;
+		}
+	}
+}
+
+static inline double cubic(const double *y, uint32_t n, double x)
+{
+	int32_t i = floor(x);
+	double t = x - i, y0, y1, y2, y3;
+
+	y0 = i >= 1 && i - 1 < (int32_t)n ? y[i - 1] : 0.0;
+	y1 = i >= 0 && i < (int32_t)n ? y[i] : 0.0;
+	y2 = i + 1 < (int32_t)n ? y[i + 1] : 0.0;
+	y3 = i + 2 < (int32_t)n ? y[i + 2] : 0.0;
+
+	/* Catmull-Rom */
+	return y1 + 0.5 * t * (y2 - y0 + t * (2.0 * y0 - 5.0 * y1 + 4.0 * y2 - y3 +
+				t * (3.0 * (y1 - y2) + y3 - y0)));
+}
+
+/* Make a minimum phase version of the windowed sinc with the cepstrum of
+ * an oversampled prototype. Tap k of a phase is the prototype response
+ * (n_taps - 1 - k + phase) samples after the input so that the last tap
+ * is the current sample and no lookahead is needed. The delay is set to
+ * the group delay at DC, in input samples. */
+static int build_filter_min_phase(float *taps, uint32_t stride, uint32_t n_taps,
+		uint32_t n_phases, double cutoff, uint32_t *delay)
+{
+	uint32_t i, j, n_fft, len = n_taps * MIN_PHASE_OVERSAMPLE;
+	double *re, *im, *tw_re, *tw_im, max, sum, moment;
+
+	for (n_fft = 1; n_fft < 8 * len; n_fft <<= 1);
+
+	if ((re = calloc(3 * n_fft, sizeof(double))) == NULL)
+		return -errno;
+	im = re + n_fft;
+	tw_re = im + n_fft;
+	tw_im = tw_re + n_fft / 2;
+
+	for (i = 0; i < n_fft / 2; i++) {
+		tw_re[i] = cos(2.0 * M_PI * i / n_fft);
+		tw_im[i] = -sin(2.0 * M_PI * i / n_fft);
+	}
+
+	for (i = 0; i <= len; i++) {
+		double t = ((double)i - len / 2) / MIN_PHASE_OVERSAMPLE;
+		re[i] = cutoff * sinc(t * cutoff) * blackman(t, n_taps);
+	}
+	fft(re, im, tw_re, tw_im, n_fft, false);
+
+	/* log magnitude, limited to avoid the zeros in the stopband */
+	for (i = 0, max = 0.0; i < n_fft; i++) {
+		re[i] = hypot(re[i], im[i]);
+		max = SPA_MAX(max, re[i]);
+	}
+	for (i = 0; i < n_fft; i++) {
+		re[i] = log(SPA_MAX(re[i], max * 1e-8));
+		im[i] = 0.0;
+	}
+	fft(re, im, tw_re, tw_im, n_fft, true);
+
+	/* fold the cepstrum to make it causal */
+	for (i = 1; i < n_fft / 2; i++) {
+		re[i] *= 2.0;
+		re[n_fft - i] = 0.0;
+	}
+	for (i = 0; i < n_fft; i++)
+		im[i] = 0.0;
+	fft(re, im, tw_re, tw_im, n_fft, false);
+
+	for (i = 0; i < n_fft; i++) {
+		double m = exp(re[i]);
+		re[i] = m * cos(im[i]);
+		im[i] = m * sin(im[i]);
+	}
+	fft(re, im, tw_re, tw_im, n_fft, true);
+
+	for (i = 0, sum = moment = 0.0; i <= len; i++) {
+		sum += re[i];
+		moment += re[i] * i;
+	}
+	*delay = sum != 0.0 ?
+		(uint32_t)lrint(SPA_MAX(moment / sum, 0.0) / MIN_PHASE_OVERSAMPLE) : 0;
+
+	for (i = 0; i <= n_phases; i++) {
+		for (j = 0; j < n_taps; j++) {
+			double t = (n_taps - 1 - j) + (double) i / (double) n_phases;
+			taps[i * stride + j] = cubic(re, len + 1, t * MIN_PHASE_OVERSAMPLE);
+		}
+	}
+	free(re);
+	return 0;
+}
+
 static void inner_product_c(float *d, const float * SPA_RESTRICT s,
 		const float * SPA_RESTRICT taps, uint32_t n_taps)
 {
@@ -116,6 +250,10 @@ static struct resample_info resample_table[] =
 	{ SPA_AUDIO_FORMAT_F32, SPA_CPU_FLAG_NEON,
 		do_resample_copy_c, do_resample_full_neon, do_resample_inter_neon },
 #endif
+#if defined(HAVE_AVX512)
+	{ SPA_AUDIO_FORMAT_F32, SPA_CPU_FLAG_AVX512,
+		do_resample_copy_c, do_resample_full_avx512, do_resample_inter_avx512 },
+#endif
 #if defined(HAVE_AVX) && defined(HAVE_FMA)
 	{ SPA_AUDIO_FORMAT_F32, SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3,
 		do_resample_copy_c, do_resample_full_avx, do_resample_inter_avx },
@@ -305,14 +443,14 @@ static void impl_native_reset (struct resample *r)
 {
 	struct native_data *d = r->data;
 	memset(d->hist_mem, 0, r->channels * sizeof(float) * d->n_taps * 2);
-	d->hist = (d->n_taps / 2) - 1;
+	d->hist = d->hist_reset;
 	d->phase = 0;
 }
 
 static uint32_t impl_native_delay (struct resample *r)
 {
 	struct native_data *d = r->data;
-	return d->n_taps / 2;
+	return d->delay;
 }
 
 int resample_native_init(struct resample *r)
@@ -322,6 +460,7 @@ int resample_native_init(struct resample *r)
 	double scale;
 	uint32_t c, n_taps, n_phases, filter_size, in_rate, out_rate, gcd, filter_stride;
 	uint32_t history_stride, history_size, oversample;
+	int res;
 
 	r->quality = SPA_CLAMP(r->quality, 0, (int) SPA_N_ELEMENTS(blackman_qualities) - 1);
 	r->free = impl_native_free;
@@ -375,13 +514,27 @@ int resample_native_init(struct resample *r)
 	for (c = 0; c < r->channels; c++)
 		d->history[c] = SPA_MEMBER(d->hist_mem, c * history_stride, float);
 
-	build_filter(d->filter, d->filter_stride, n_taps, n_phases, scale);
+	if (r->options & RESAMPLE_OPTION_MINIMUM_PHASE) {
+		if ((res = build_filter_min_phase(d->filter, d->filter_stride,
+				n_taps, n_phases, scale, &d->delay)) < 0) {
+			free(d);
+			r->data = NULL;
+			return res;
+		}
+		d->hist_reset = n_taps - 1;
+		d->copy_offset = n_taps - 1;
+	} else {
+		build_filter(d->filter, d->filter_stride, n_taps, n_phases, scale);
+		d->hist_reset = n_taps / 2 - 1;
+		d->copy_offset = n_taps / 2;
+		d->delay = n_taps / 2;
+	}
 
 	d->info = find_resample_info(SPA_AUDIO_FORMAT_F32, r->cpu_flags);
 
-	spa_log_debug(r->log, "native %p: q:%d in:%d out:%d n_taps:%d n_phases:%d features:%08x:%08x",
-			r, r->quality, in_rate, out_rate, n_taps, n_phases,
-			r->cpu_flags, d->info->cpu_flags);
+	spa_log_debug(r->log, "native %p: q:%d in:%d out:%d n_taps:%d n_phases:%d delay:%d "
+			"features:%08x:%08x", r, r->quality, in_rate, out_rate, n_taps,
+			n_phases, d->delay, r->cpu_flags, d->info->cpu_flags);
 
 	r->cpu_flags = d->info->cpu_flags;
 
@@ -32,7 +32,7 @@ static inline float hmax_ps(__m128 val)
 {
 	__m128 t = _mm_movehl_ps(val, val);
 	t = _mm_max_ps(t, val);
-	val = _mm_shuffle_ps(val, t, 0x55);
+	val = _mm_shuffle_ps(t, t, 0x55);
 	val = _mm_max_ss(t, val);
 	return _mm_cvtss_f32(val);
 }
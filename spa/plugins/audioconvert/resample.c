@@ -34,6 +34,7 @@
 #include <spa/node/io.h>
 #include <spa/node/utils.h>
 #include <spa/param/audio/format-utils.h>
+#include <spa/param/latency-utils.h>
 #include <spa/param/param.h>
 #include <spa/pod/filter.h>
 #include <spa/debug/types.h>
@@ -118,6 +119,7 @@ struct impl {
 	int mode;
 	unsigned int started:1;
 	unsigned int peaks:1;
+	unsigned int minimum_phase:1;
 	unsigned int drained:1;
 
 	struct resample resample;
@@ -162,6 +164,7 @@ static int setup_convert(struct impl *this,
 	this->resample.o_rate = dst_info->info.raw.rate;
 	this->resample.log = this->log;
 	this->resample.quality = this->props.quality;
+	this->resample.options = this->minimum_phase ? RESAMPLE_OPTION_MINIMUM_PHASE : 0;
 
 	if (this->peaks)
 		err = resample_peaks_init(&this->resample);
@@ -171,6 +174,21 @@ static int setup_convert(struct impl *this,
 	return err;
 }
 
+/* the filter delay, in the direction of the port. It is the same both ways
+ * so it is reported as capture latency on the output port and as playback
+ * latency on the input port. */
+static void get_latency(struct impl *this, enum spa_direction direction,
+		struct spa_latency_info *info)
+{
+	uint64_t ns = 0;
+
+	if (this->resample.delay && this->resample.i_rate > 0)
+		ns = (uint64_t)resample_delay(&this->resample) * SPA_NSEC_PER_SEC /
+			this->resample.i_rate;
+
+	*info = SPA_LATENCY_INFO(direction, .min_ns = ns, .max_ns = ns);
+}
+
 static int impl_node_enum_params(void *object, int seq,
 				 uint32_t id, uint32_t start, uint32_t num,
 				 const struct spa_pod *filter)
@@ -470,6 +488,17 @@ impl_node_port_enum_params(void *object, int seq,
 			return 0;
 		}
 		break;
+	case SPA_PARAM_Latency:
+	{
+		struct spa_latency_info info;
+
+		if (result.index > 0)
+			return 0;
+
+		get_latency(this, direction, &info);
+		param = spa_latency_build(&b, id, &info);
+		break;
+	}
 	default:
 		return -ENOENT;
 	}
@@ -535,6 +564,9 @@ static int port_set_format(void *object,
 		if (other->have_format) {
 			if ((res = setup_convert(this, direction, &info)) < 0)
 				return res;
+			/* the delay of the new resampler */
+			other->info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
+			emit_port_info(this, other, false);
 		}
 		port->format = info;
 		port->have_format = true;
@@ -949,6 +981,8 @@ impl_init(const struct spa_handle_factory *factory,
 			this->props.quality = atoi(str);
 		if ((str = spa_dict_lookup(info, "resample.peaks")) != NULL)
 			this->peaks = strcmp(str, "true") == 0 || atoi(str) == 1;
+		if ((str = spa_dict_lookup(info, "resample.minimum-phase")) != NULL)
+			this->minimum_phase = strcmp(str, "true") == 0 || atoi(str) == 1;
 		if ((str = spa_dict_lookup(info, "factory.mode")) != NULL) {
 			if (strcmp(str, "split") == 0)
 				this->mode = MODE_SPLIT;
@@ -983,8 +1017,9 @@ impl_init(const struct spa_handle_factory *factory,
 	port->params[2] = SPA_PARAM_INFO(SPA_PARAM_IO, SPA_PARAM_INFO_READ);
 	port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
 	port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, 0);
+	port->params[5] = SPA_PARAM_INFO(SPA_PARAM_Latency, SPA_PARAM_INFO_READ);
 	port->info.params = port->params;
-	port->info.n_params = 5;
+	port->info.n_params = 6;
 	spa_list_init(&port->queue);
 
 	port = GET_IN_PORT(this, 0);
@@ -999,8 +1034,9 @@ impl_init(const struct spa_handle_factory *factory,
 	port->params[2] = SPA_PARAM_INFO(SPA_PARAM_IO, SPA_PARAM_INFO_READ);
 	port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
 	port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, 0);
+	port->params[5] = SPA_PARAM_INFO(SPA_PARAM_Latency, SPA_PARAM_INFO_READ);
 	port->info.params = port->params;
-	port->info.n_params = 5;
+	port->info.n_params = 6;
 	spa_list_init(&port->queue);
 
 	return 0;
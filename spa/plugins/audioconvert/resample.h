@@ -38,6 +38,8 @@ struct resample {
 	struct spa_log *log;
 	double rate;
 	int quality;
+#define RESAMPLE_OPTION_MINIMUM_PHASE	(1 << 0)	/**< minimum phase filter without lookahead */
+	uint32_t options;
 
 	void (*free)		(struct resample *r);
 	void (*update_rate)	(struct resample *r, double rate);
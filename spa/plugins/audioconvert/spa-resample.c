@@ -48,6 +48,7 @@ struct data {
 	int rate;
 	int format;
 	int quality;
+	bool minimum_phase;
 
 	const char *iname;
 	SF_INFO iinfo;
@@ -60,7 +61,7 @@ struct data {
 
 #define STR_FMTS "(s8|s16|s32|f32|f64)"
 
-#define OPTIONS		"hvr:f:q:"
+#define OPTIONS		"hvr:f:q:m"
 static const struct option long_options[] = {
 	{ "help",	no_argument,		NULL, 'h'},
 	{ "verbose",	no_argument,		NULL, 'v'},
@@ -68,6 +69,7 @@ static const struct option long_options[] = {
 	{ "rate",	required_argument,	NULL, 'r' },
 	{ "format",	required_argument,	NULL, 'f' },
 	{ "quality",	required_argument,	NULL, 'q' },
+	{ "minimum-phase", no_argument,		NULL, 'm' },
 
         { NULL, 0, NULL, 0 }
 };
@@ -87,6 +89,7 @@ static void show_usage(const char *name, bool is_error)
 		"  -r  --rate                            Output sample rate (default as input)\n"
 		"  -f  --format                          Output sample format %s (default as input)\n"
 		"  -q  --quality                         Resampler quality (default %u)\n"
+		"  -m  --minimum-phase                   Minimum phase filter without lookahead\n"
 		"\n",
 		STR_FMTS, DEFAULT_QUALITY);
 }
@@ -165,6 +168,8 @@ static int do_conversion(struct data *d)
 	r.i_rate = d->iinfo.samplerate;
 	r.o_rate = d->oinfo.samplerate;
 	r.quality = d->quality < 0 ? DEFAULT_QUALITY : d->quality;
+	if (d->minimum_phase)
+		r.options |= RESAMPLE_OPTION_MINIMUM_PHASE;
 	resample_native_init(&r);
 
 	for (j = 0; j < channels; j++)
@@ -258,6 +263,9 @@ int main(int argc, char *argv[])
 			}
 			data.quality = ret;
 			break;
+		case 'm':
+			data.minimum_phase = true;
+			break;
                 default:
 			fprintf(stderr, "error: unknown option '%c'\n", c);
 			goto error_usage;
@@ -35,6 +35,8 @@
 #include <spa/param/audio/format.h>
 #include <spa/param/audio/format-utils.h>
 #include <spa/node/node.h>
+#include <spa/node/utils.h>
+#include <spa/node/io.h>
 #include <spa/debug/mem.h>
 #include <spa/support/log-impl.h>
 
@@ -233,6 +235,183 @@ static int test_split_setup(struct context *ctx)
 }
 
 
+static void port_info_passthrough(void *data,
+		enum spa_direction direction, uint32_t port,
+		const struct spa_port_info *info)
+{
+	uint32_t *n_ports = data;
+
+	spa_assert(direction == SPA_DIRECTION_OUTPUT);
+	spa_assert(port == 0);
+	spa_assert(info != NULL);
+	(*n_ports)++;
+}
+
+static int set_port_config(struct context *ctx, enum spa_param_port_config_mode mode,
+		struct spa_audio_info_raw *info)
+{
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_pod *param;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	param = spa_format_audio_raw_build(&b, SPA_PARAM_Format, info);
+	param = spa_pod_builder_add_object(&b,
+		SPA_TYPE_OBJECT_ParamPortConfig, SPA_PARAM_PortConfig,
+		SPA_PARAM_PORT_CONFIG_direction,	SPA_POD_Id(SPA_DIRECTION_OUTPUT),
+		SPA_PARAM_PORT_CONFIG_mode,		SPA_POD_Id(mode),
+		SPA_PARAM_PORT_CONFIG_format,		SPA_POD_Pod(param));
+
+	return spa_node_set_param(ctx->adapter_node, SPA_PARAM_PortConfig, 0, param);
+}
+
+static int test_passthrough_setup(struct context *ctx)
+{
+	struct spa_audio_info_raw info;
+	struct spa_hook listener;
+	uint32_t n_ports = 0;
+	int res;
+	static const struct spa_node_events node_events = {
+		SPA_VERSION_NODE_EVENTS,
+		.port_info = port_info_passthrough,
+	};
+
+	spa_zero(info);
+	info.format = SPA_AUDIO_FORMAT_F32P;
+	info.channels = 2;
+	info.rate = 48000;
+	info.position[0] = SPA_AUDIO_CHANNEL_FL;
+	info.position[1] = SPA_AUDIO_CHANNEL_FR;
+
+	/* the follower can't do F32P, we need the converter */
+	res = set_port_config(ctx, SPA_PARAM_PORT_CONFIG_MODE_passthrough, &info);
+	spa_assert(res == -ENOTSUP);
+
+	/* the follower takes S16 as is, expose the follower port */
+	info.format = SPA_AUDIO_FORMAT_S16;
+	res = set_port_config(ctx, SPA_PARAM_PORT_CONFIG_MODE_passthrough, &info);
+	spa_assert(res == 0);
+
+	spa_zero(listener);
+	spa_node_add_listener(ctx->adapter_node,
+			&listener, &node_events, &n_ports);
+	spa_hook_remove(&listener);
+	spa_assert(n_ports == 1);
+
+	/* and back to dsp ports */
+	info.format = SPA_AUDIO_FORMAT_F32P;
+	res = set_port_config(ctx, SPA_PARAM_PORT_CONFIG_MODE_dsp, &info);
+	spa_assert(res == 0);
+
+	return 0;
+}
+
+static int set_port_format(struct context *ctx, struct spa_audio_info_raw *info)
+{
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_pod *param;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	param = spa_format_audio_raw_build(&b, SPA_PARAM_Format, info);
+
+	return spa_node_port_set_param(ctx->adapter_node, SPA_DIRECTION_OUTPUT, 0,
+			SPA_PARAM_Format, 0, param);
+}
+
+static bool follower_has_format(struct context *ctx)
+{
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_pod *param;
+	uint32_t state = 0;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	return spa_node_port_enum_params_sync(ctx->follower_node,
+			SPA_DIRECTION_OUTPUT, 0, SPA_PARAM_Format,
+			&state, NULL, &param, &b) == 1;
+}
+
+static int test_auto_passthrough(struct context *ctx)
+{
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_pod *param;
+	struct spa_audio_info_raw info;
+	struct spa_io_clock clock;
+	struct spa_io_position position;
+	int res;
+
+	spa_zero(info);
+	info.format = SPA_AUDIO_FORMAT_F32;
+	info.channels = 2;
+	info.rate = 44100;
+	info.position[0] = SPA_AUDIO_CHANNEL_FL;
+	info.position[1] = SPA_AUDIO_CHANNEL_FR;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	param = spa_pod_builder_add_object(&b,
+		SPA_TYPE_OBJECT_ParamPortConfig, SPA_PARAM_PortConfig,
+		SPA_PARAM_PORT_CONFIG_direction,	SPA_POD_Id(SPA_DIRECTION_OUTPUT),
+		SPA_PARAM_PORT_CONFIG_mode,		SPA_POD_Id(SPA_PARAM_PORT_CONFIG_MODE_convert));
+	res = spa_node_set_param(ctx->adapter_node, SPA_PARAM_PortConfig, 0, param);
+	spa_assert(res >= 0);
+
+	/* the follower can't do F32, run the converter */
+	res = set_port_format(ctx, &info);
+	spa_assert(res >= 0);
+	spa_assert(!follower_has_format(ctx));
+
+	/* the follower takes S16 as is, it gets the format directly */
+	info.format = SPA_AUDIO_FORMAT_S16;
+	res = set_port_format(ctx, &info);
+	spa_assert(res >= 0);
+	spa_assert(follower_has_format(ctx));
+
+	/* a follower at another rate needs the converter again */
+	info.rate = 48000;
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	param = spa_format_audio_raw_build(&b, SPA_PARAM_Format, &info);
+	res = spa_node_set_param(ctx->adapter_node, SPA_PARAM_Format, 0, param);
+	spa_assert(res >= 0);
+	spa_assert(!follower_has_format(ctx));
+
+	/* and a peer at that rate can use the follower again */
+	res = set_port_format(ctx, &info);
+	spa_assert(res >= 0);
+	spa_assert(follower_has_format(ctx));
+
+	/* a follower of another driver needs the converter to match rates */
+	spa_zero(clock);
+	clock.id = 1;
+	spa_zero(position);
+	position.clock.id = 2;
+	spa_node_set_io(ctx->adapter_node, SPA_IO_Clock, &clock, sizeof(clock));
+	spa_node_set_io(ctx->adapter_node, SPA_IO_Position, &position, sizeof(position));
+	spa_assert(!follower_has_format(ctx));
+
+	res = set_port_format(ctx, &info);
+	spa_assert(res >= 0);
+	spa_assert(!follower_has_format(ctx));
+
+	/* and can use the follower again when it drives the graph */
+	position.clock.id = 1;
+	res = set_port_format(ctx, &info);
+	spa_assert(res >= 0);
+	spa_assert(follower_has_format(ctx));
+
+	spa_node_set_io(ctx->adapter_node, SPA_IO_Position, NULL, 0);
+	spa_node_set_io(ctx->adapter_node, SPA_IO_Clock, NULL, 0);
+
+	/* back to dsp ports */
+	info.format = SPA_AUDIO_FORMAT_F32P;
+	res = set_port_config(ctx, SPA_PARAM_PORT_CONFIG_MODE_dsp, &info);
+	spa_assert(res >= 0);
+	spa_assert(!follower_has_format(ctx));
+
+	return 0;
+}
+
 int main(int argc, char *argv[])
 {
 	struct context ctx;
@@ -243,6 +422,10 @@ int main(int argc, char *argv[])
 
 	test_init_state(&ctx);
 	test_split_setup(&ctx);
+	test_passthrough_setup(&ctx);
+	test_split_setup(&ctx);
+	test_auto_passthrough(&ctx);
+	test_split_setup(&ctx);
 
 	clean_context(&ctx);
 
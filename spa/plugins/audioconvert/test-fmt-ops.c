@@ -30,6 +30,8 @@
 #include <time.h>
 
 #include <spa/debug/mem.h>
+#include <spa/debug/types.h>
+#include <spa/param/audio/type-info.h>
 
 #include "fmt-ops.c"
 
@@ -126,6 +128,10 @@ static void test_f32_u8(void)
 			true, true, conv_f32_to_u8_c);
 	run_test("test_f32d_u8", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
 			false, true, conv_f32d_to_u8_c);
+#if defined (HAVE_SSE2)
+	run_test("test_f32d_u8_sse2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, true, conv_f32d_to_u8_sse2);
+#endif
 	run_test("test_f32_u8d", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
 			true, false, conv_f32_to_u8d_c);
 	run_test("test_f32d_u8d", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
@@ -143,6 +149,10 @@ static void test_u8_f32(void)
 			false, true, conv_u8d_to_f32_c);
 	run_test("test_u8_f32d", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
 			true, false, conv_u8_to_f32d_c);
+#if defined (HAVE_SSE2)
+	run_test("test_u8_f32d_sse2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, false, conv_u8_to_f32d_sse2);
+#endif
 	run_test("test_u8d_f32d", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
 			false, false, conv_u8d_to_f32d_c);
 }
@@ -239,6 +249,10 @@ static void test_f32_s24(void)
 			true, true, conv_f32_to_s24_c);
 	run_test("test_f32d_s24", in, sizeof(in[0]), out, 3, SPA_N_ELEMENTS(in),
 			false, true, conv_f32d_to_s24_c);
+#if defined (HAVE_SSSE3)
+	run_test("test_f32d_s24_ssse3", in, sizeof(in[0]), out, 3, SPA_N_ELEMENTS(in),
+			false, true, conv_f32d_to_s24_ssse3);
+#endif
 	run_test("test_f32_s24d", in, sizeof(in[0]), out, 3, SPA_N_ELEMENTS(in),
 			true, false, conv_f32_to_s24d_c);
 	run_test("test_f32d_s24d", in, sizeof(in[0]), out, 3, SPA_N_ELEMENTS(in),
@@ -288,6 +302,10 @@ static void test_f32_s24_32(void)
 			true, true, conv_f32_to_s24_32_c);
 	run_test("test_f32d_s24_32", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
 			false, true, conv_f32d_to_s24_32_c);
+#if defined (HAVE_SSE2)
+	run_test("test_f32d_s24_32_sse2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			false, true, conv_f32d_to_s24_32_sse2);
+#endif
 	run_test("test_f32_s24_32d", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
 			true, false, conv_f32_to_s24_32d_c);
 	run_test("test_f32d_s24_32d", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
@@ -301,6 +319,10 @@ static void test_s24_32_f32(void)
 
 	run_test("test_s24_32_f32d", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
 			true, false, conv_s24_32_to_f32d_c);
+#if defined (HAVE_SSE2)
+	run_test("test_s24_32_f32d_sse2", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
+			true, false, conv_s24_32_to_f32d_sse2);
+#endif
 	run_test("test_s24_32d_f32", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
 			false, true, conv_s24_32d_to_f32_c);
 	run_test("test_s24_32_f32", in, sizeof(in[0]), out, sizeof(out[0]), SPA_N_ELEMENTS(out),
@@ -309,6 +331,252 @@ static void test_s24_32_f32(void)
 			false, false, conv_s24_32d_to_f32d_c);
 }
 
+/* cross check every optimized conversion in conv_table against the plain
+ * C version of the same conversion, for all channel counts */
+#define N_CHECK_SAMPLES		259
+#define N_CHECK_CHANNELS	11
+
+static const uint32_t check_channels[] = { 1, 2, 3, 4, 5, 6, 8, 11 };
+
+static uint32_t format_size(uint32_t format)
+{
+	switch (format) {
+	case SPA_AUDIO_FORMAT_U8:
+	case SPA_AUDIO_FORMAT_U8P:
+		return 1;
+	case SPA_AUDIO_FORMAT_S16:
+	case SPA_AUDIO_FORMAT_S16P:
+		return 2;
+	case SPA_AUDIO_FORMAT_S24:
+	case SPA_AUDIO_FORMAT_S24P:
+	case SPA_AUDIO_FORMAT_S24_OE:
+		return 3;
+	default:
+		return 4;
+	}
+}
+
+static void fill_sample(uint32_t format, void *d)
+{
+	switch (format) {
+	case SPA_AUDIO_FORMAT_F32:
+	case SPA_AUDIO_FORMAT_F32P:
+		*(float*)d = (drand48() - 0.5) * 2.4;
+		break;
+	case SPA_AUDIO_FORMAT_S24_32:
+	case SPA_AUDIO_FORMAT_S24_32P:
+		*(int32_t*)d = (int32_t)(lrand48() & 0xffffff) - 0x800000;
+		break;
+	default:
+	{
+		uint32_t i, v = mrand48();
+		for (i = 0; i < format_size(format); i++)
+			((uint8_t*)d)[i] = v >> (i * 8);
+		break;
+	}
+	}
+}
+
+/* sample value scaled to [-1.0, 1.0] and the allowed error, the SIMD
+ * versions are allowed to round instead of truncate */
+static double read_sample(uint32_t format, const void *s, double *tolerance)
+{
+	switch (format) {
+	case SPA_AUDIO_FORMAT_U8:
+	case SPA_AUDIO_FORMAT_U8P:
+		*tolerance = 1.0 / U8_SCALE;
+		return U8_TO_F32(*(uint8_t*)s);
+	case SPA_AUDIO_FORMAT_S16:
+	case SPA_AUDIO_FORMAT_S16P:
+		*tolerance = 1.0 / S16_SCALE;
+		return S16_TO_F32(*(int16_t*)s);
+	case SPA_AUDIO_FORMAT_S24:
+	case SPA_AUDIO_FORMAT_S24P:
+		*tolerance = 1.0 / S24_SCALE;
+		return S24_TO_F32(read_s24(s));
+	case SPA_AUDIO_FORMAT_S24_OE:
+		*tolerance = 1.0 / S24_SCALE;
+		return S24_TO_F32(read_s24s(s));
+	case SPA_AUDIO_FORMAT_S24_32:
+	case SPA_AUDIO_FORMAT_S24_32P:
+		*tolerance = 1.0 / S24_SCALE;
+		return S24_TO_F32(*(int32_t*)s);
+	case SPA_AUDIO_FORMAT_S32:
+	case SPA_AUDIO_FORMAT_S32P:
+		*tolerance = 2.0 / S24_SCALE;
+		return *(int32_t*)s / S32_SCALE;
+	default:
+		*tolerance = 1e-6;
+		return *(float*)s;
+	}
+}
+
+static const char *format_name(uint32_t format)
+{
+	return spa_debug_type_find_short_name(spa_type_audio_format, format);
+}
+
+static const char *cpu_flags_name(uint32_t flags)
+{
+	if (flags & SPA_CPU_FLAG_AVX2)
+		return "avx2";
+	if (flags & SPA_CPU_FLAG_SSE41)
+		return "sse41";
+	if (flags & SPA_CPU_FLAG_SSSE3)
+		return "ssse3";
+	if (flags & SPA_CPU_FLAG_SSE2)
+		return "sse2";
+	if (flags & SPA_CPU_FLAG_NEON)
+		return "neon";
+	return "c";
+}
+
+#define CHECK_SIZE	(N_CHECK_SAMPLES * N_CHECK_CHANNELS * 4)
+
+static uint8_t check_in[N_CHECK_CHANNELS][CHECK_SIZE] __attribute__((aligned(16)));
+static uint8_t check_ref[N_CHECK_CHANNELS][CHECK_SIZE] __attribute__((aligned(16)));
+static uint8_t check_out[N_CHECK_CHANNELS][CHECK_SIZE] __attribute__((aligned(16)));
+
+static void check_conv(const struct conv_info *info, const struct conv_info *ref,
+		uint32_t n_channels, uint32_t n_samples)
+{
+	const void *ip[N_CHECK_CHANNELS];
+	void *rp[N_CHECK_CHANNELS], *op[N_CHECK_CHANNELS];
+	bool in_planar = SPA_AUDIO_FORMAT_IS_PLANAR(info->src_fmt);
+	bool out_planar = SPA_AUDIO_FORMAT_IS_PLANAR(info->dst_fmt);
+	uint32_t in_size = format_size(info->src_fmt), out_size = format_size(info->dst_fmt);
+	uint32_t i, j, n_in, n_out, stride;
+	struct convert conv;
+
+	spa_zero(conv);
+	conv.src_fmt = info->src_fmt;
+	conv.dst_fmt = info->dst_fmt;
+	conv.n_channels = n_channels;
+
+	n_in = in_planar ? n_channels : 1;
+	n_out = out_planar ? n_channels : 1;
+
+	stride = in_planar ? 1 : n_channels;
+	for (i = 0; i < n_in; i++) {
+		for (j = 0; j < n_samples * stride; j++)
+			fill_sample(info->src_fmt, &check_in[i][j * in_size]);
+		ip[i] = check_in[i];
+	}
+	for (i = 0; i < n_out; i++) {
+		memset(check_ref[i], 0, sizeof(check_ref[i]));
+		memset(check_out[i], 0, sizeof(check_out[i]));
+		rp[i] = check_ref[i];
+		op[i] = check_out[i];
+	}
+
+	ref->process(&conv, rp, ip, n_samples);
+	info->process(&conv, op, ip, n_samples);
+
+	stride = out_planar ? 1 : n_channels;
+	for (i = 0; i < n_out; i++) {
+		for (j = 0; j < n_samples * stride; j++) {
+			double r, o, tol;
+			r = read_sample(info->dst_fmt, &check_ref[i][j * out_size], &tol);
+			o = read_sample(info->dst_fmt, &check_out[i][j * out_size], &tol);
+			if (fabs(r - o) > tol * 1.01) {
+				fprintf(stderr, "%s -> %s %s channels:%d: sample %d/%d: %f != %f\n",
+						format_name(info->src_fmt), format_name(info->dst_fmt),
+						cpu_flags_name(info->cpu_flags), n_channels, i, j, o, r);
+				spa_assert_not_reached();
+			}
+		}
+		/* nothing may be written after the last sample */
+		for (j = n_samples * stride * out_size; j < sizeof(check_out[i]); j++)
+			spa_assert(check_out[i][j] == 0);
+	}
+}
+
+/* the SIMD flags of the CPU we run on, the table has versions that this
+ * CPU might not be able to run */
+static uint32_t get_cpu_flags(void)
+{
+	uint32_t flags = 0;
+#if defined (__i386__) || defined (__x86_64__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse"))
+		flags |= SPA_CPU_FLAG_SSE;
+	if (__builtin_cpu_supports("sse2"))
+		flags |= SPA_CPU_FLAG_SSE2;
+	if (__builtin_cpu_supports("sse3"))
+		flags |= SPA_CPU_FLAG_SSE3;
+	if (__builtin_cpu_supports("ssse3"))
+		flags |= SPA_CPU_FLAG_SSSE3;
+	if (__builtin_cpu_supports("sse4.1"))
+		flags |= SPA_CPU_FLAG_SSE41;
+	if (__builtin_cpu_supports("sse4.2"))
+		flags |= SPA_CPU_FLAG_SSE42;
+	if (__builtin_cpu_supports("avx"))
+		flags |= SPA_CPU_FLAG_AVX;
+	if (__builtin_cpu_supports("avx2"))
+		flags |= SPA_CPU_FLAG_AVX2;
+	if (__builtin_cpu_supports("fma"))
+		flags |= SPA_CPU_FLAG_FMA3;
+#elif defined (__aarch64__) || defined (__ARM_NEON)
+	flags |= SPA_CPU_FLAG_NEON;
+#endif
+	return flags;
+}
+
+static bool has_simd(uint32_t src_fmt, uint32_t dst_fmt)
+{
+	size_t i;
+	for (i = 0; i < SPA_N_ELEMENTS(conv_table); i++) {
+		if (conv_table[i].src_fmt == src_fmt &&
+		    conv_table[i].dst_fmt == dst_fmt &&
+		    conv_table[i].cpu_flags != 0)
+			return true;
+	}
+	return false;
+}
+
+static void test_conv_table(void)
+{
+	uint32_t cpu_flags = get_cpu_flags();
+	size_t i, j, k;
+
+	for (i = 0; i < SPA_N_ELEMENTS(conv_table); i++) {
+		const struct conv_info *info = &conv_table[i], *ref;
+
+		if (info->cpu_flags == 0) {
+			/* the C version is last, report the conversions that
+			 * don't have an optimized version */
+			if (!has_simd(info->src_fmt, info->dst_fmt))
+				fprintf(stderr, "no SIMD conversion %s -> %s\n",
+						format_name(info->src_fmt),
+						format_name(info->dst_fmt));
+			continue;
+		}
+		if (!MATCH_CPU_FLAGS(info->cpu_flags, cpu_flags)) {
+			fprintf(stderr, "skip %s -> %s %s, not supported by the CPU\n",
+					format_name(info->src_fmt), format_name(info->dst_fmt),
+					cpu_flags_name(info->cpu_flags));
+			continue;
+		}
+
+		for (j = 0; j < SPA_N_ELEMENTS(check_channels); j++) {
+			uint32_t n_channels = check_channels[j];
+
+			if (!MATCH_CHAN(info->n_channels, n_channels))
+				continue;
+
+			ref = find_conv_info(info->src_fmt, info->dst_fmt, n_channels, 0);
+			spa_assert(ref != NULL);
+
+			fprintf(stderr, "check %s -> %s %s channels:%d\n",
+					format_name(info->src_fmt), format_name(info->dst_fmt),
+					cpu_flags_name(info->cpu_flags), n_channels);
+
+			for (k = 1; k <= N_CHECK_SAMPLES; k += 37)
+				check_conv(info, ref, n_channels, k);
+		}
+	}
+}
+
 int main(int argc, char *argv[])
 {
 
@@ -322,5 +590,6 @@ int main(int argc, char *argv[])
 	test_s24_f32();
 	test_f32_s24_32();
 	test_s24_32_f32();
+	test_conv_table();
 	return 0;
 }
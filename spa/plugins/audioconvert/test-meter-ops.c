@@ -0,0 +1,128 @@
+/* Spa
+ *
+ * Copyright © 2020 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <spa/support/cpu.h>
+
+#include "meter-ops.c"
+
+#define RATE		48000
+#define N_SAMPLES	(RATE / 2)
+#define N_CHANNELS	7
+
+static float samples[N_CHANNELS][N_SAMPLES];
+
+static void init_meter(struct meter *m, uint32_t channels, uint32_t cpu_flags)
+{
+	uint32_t c;
+
+	spa_zero(*m);
+	m->channels = channels;
+	m->rate = RATE;
+	m->cpu_flags = cpu_flags;
+	for (c = 0; c < channels; c++)
+		m->position[c] = SPA_AUDIO_CHANNEL_FL + (c & 1);
+	spa_assert(meter_init(m) == 0);
+}
+
+static void run_meter(struct meter *m, uint32_t n_samples, uint32_t chunk)
+{
+	const void *src[N_CHANNELS];
+	uint32_t c, n;
+
+	for (n = 0; n < n_samples; n += chunk) {
+		for (c = 0; c < m->channels; c++)
+			src[c] = &samples[c][n];
+		meter_process(m, src, SPA_MIN(chunk, n_samples - n));
+	}
+}
+
+static void fill_sine(uint32_t channels, float freq, float amp)
+{
+	uint32_t c, n;
+
+	for (c = 0; c < channels; c++)
+		for (n = 0; n < N_SAMPLES; n++)
+			samples[c][n] = amp * sinf(2.0f * M_PI * freq * n / RATE);
+}
+
+static void test_sine(uint32_t cpu_flags)
+{
+	struct meter m;
+	float amp = powf(10.0f, -23.0f / 20.0f);
+
+	/* a stereo 1kHz sine at -23 dBFS measures -23 LUFS */
+	fill_sine(2, 1000.0f, amp);
+	init_meter(&m, 2, cpu_flags);
+	run_meter(&m, N_SAMPLES, 256);
+
+	fprintf(stderr, "%08x: peak %f rms %f momentary %f %f\n", m.cpu_flags,
+			m.out_peak[0], m.out_rms[0], m.out_momentary[0], m.momentary);
+
+	spa_assert(fabsf(m.out_peak[0] - amp) < 1e-4f);
+	spa_assert(fabsf(m.out_rms[0] - amp * (float)M_SQRT1_2) < 1e-4f);
+	spa_assert(fabsf(m.out_momentary[0] - m.out_momentary[1]) < 1e-4f);
+	spa_assert(fabsf(m.momentary + 23.0f) < 0.1f);
+	spa_assert(fabsf(m.out_momentary[0] + 26.01f) < 0.1f);
+}
+
+#if defined (HAVE_SSE)
+static void test_compare(void)
+{
+	struct meter mc, ms;
+	uint32_t c, n;
+
+	srand(0);
+	for (c = 0; c < N_CHANNELS; c++)
+		for (n = 0; n < N_SAMPLES; n++)
+			samples[c][n] = (float)rand() / RAND_MAX * 2.0f - 1.0f;
+
+	init_meter(&mc, N_CHANNELS, 0);
+	init_meter(&ms, N_CHANNELS, SPA_CPU_FLAG_SSE);
+	run_meter(&mc, N_SAMPLES, 253);
+	run_meter(&ms, N_SAMPLES, 253);
+
+	for (c = 0; c < N_CHANNELS; c++) {
+		spa_assert(mc.out_peak[c] == ms.out_peak[c]);
+		spa_assert(fabsf(mc.out_rms[c] - ms.out_rms[c]) < 1e-4f);
+		spa_assert(fabsf(mc.out_momentary[c] - ms.out_momentary[c]) < 1e-3f);
+	}
+	spa_assert(fabsf(mc.momentary - ms.momentary) < 1e-3f);
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+	test_sine(0);
+#if defined (HAVE_SSE)
+	test_sine(SPA_CPU_FLAG_SSE);
+	test_compare();
+#endif
+	return 0;
+}
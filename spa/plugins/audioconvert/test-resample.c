@@ -28,8 +28,10 @@
 #include <unistd.h>
 #include <errno.h>
 #include <time.h>
+#include <math.h>
 
 #include <spa/support/log-impl.h>
+#include <spa/support/cpu.h>
 #include <spa/debug/mem.h>
 
 SPA_LOG_IMPL(logger);
@@ -150,12 +152,207 @@ static void test_in_len(void)
 	pull_blocks(&r, 1024);
 }
 
+static void check_step(uint32_t i_rate, uint32_t o_rate)
+{
+	struct resample r, lin;
+	float in[256], out[1024], step[4096];
+	const void *src[1];
+	void *dst[1];
+	uint32_t i, n_out = 0, first = 0;
+
+	spa_zero(lin);
+	lin.log = &logger.log;
+	lin.channels = 1;
+	lin.i_rate = i_rate;
+	lin.o_rate = o_rate;
+	lin.quality = RESAMPLE_DEFAULT_QUALITY;
+	spa_assert(resample_native_init(&lin) == 0);
+
+	spa_zero(r);
+	r.log = &logger.log;
+	r.channels = 1;
+	r.i_rate = i_rate;
+	r.o_rate = o_rate;
+	r.quality = RESAMPLE_DEFAULT_QUALITY;
+	r.options = RESAMPLE_OPTION_MINIMUM_PHASE;
+	spa_assert(resample_native_init(&r) == 0);
+
+	fprintf(stderr, "%d->%d delay linear:%d minimum phase:%d\n", i_rate, o_rate,
+			resample_delay(&lin), resample_delay(&r));
+	spa_assert(resample_delay(&r) < resample_delay(&lin));
+
+	for (i = 0; i < SPA_N_ELEMENTS(in); i++)
+		in[i] = 1.0f;
+
+	src[0] = in;
+	dst[0] = out;
+	while (n_out < 2048) {
+		uint32_t in_len = SPA_N_ELEMENTS(in), out_len = SPA_N_ELEMENTS(out);
+
+		resample_process(&r, src, &in_len, dst, &out_len);
+		spa_assert(n_out + out_len <= SPA_N_ELEMENTS(step));
+		memcpy(&step[n_out], out, out_len * sizeof(float));
+		n_out += out_len;
+	}
+	/* without lookahead, the step shows up after the group delay */
+	while (step[first] < 0.5f)
+		first++;
+	fprintf(stderr, "step at %d\n", first);
+	spa_assert(first <= (resample_delay(&r) + 2) * o_rate / i_rate + 1);
+
+	for (i = 1024; i < n_out; i++)
+		spa_assert(fabsf(step[i] - 1.0f) < 0.001f);
+
+	resample_free(&lin);
+	resample_free(&r);
+}
+
+static void test_minimum_phase(void)
+{
+	check_step(44100, 48000);
+	check_step(48000, 44100);
+	check_step(32000, 48000);
+}
+
+/* the SIMD flags of the CPU we run on */
+static uint32_t get_cpu_flags(void)
+{
+	uint32_t flags = 0;
+#if defined (__i386__) || defined (__x86_64__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse"))
+		flags |= SPA_CPU_FLAG_SSE;
+	if (__builtin_cpu_supports("ssse3"))
+		flags |= SPA_CPU_FLAG_SSSE3;
+	if (__builtin_cpu_supports("avx"))
+		flags |= SPA_CPU_FLAG_AVX;
+	if (__builtin_cpu_supports("fma"))
+		flags |= SPA_CPU_FLAG_FMA3;
+	if (__builtin_cpu_supports("avx512f"))
+		flags |= SPA_CPU_FLAG_AVX512;
+#elif defined (__aarch64__) || defined (__ARM_NEON)
+	flags |= SPA_CPU_FLAG_NEON;
+#endif
+	return flags;
+}
+
+static const struct {
+	const char *name;
+	uint32_t cpu_flags;
+} simd_impls[] = {
+#if defined (HAVE_NEON)
+	{ "neon", SPA_CPU_FLAG_NEON },
+#endif
+#if defined (HAVE_AVX512)
+	{ "avx512", SPA_CPU_FLAG_AVX512 },
+#endif
+#if defined (HAVE_AVX) && defined (HAVE_FMA)
+	{ "avx", SPA_CPU_FLAG_AVX | SPA_CPU_FLAG_FMA3 },
+#endif
+#if defined (HAVE_SSSE3)
+	{ "ssse3", SPA_CPU_FLAG_SSSE3 | SPA_CPU_FLAG_SLOW_UNALIGNED },
+#endif
+#if defined (HAVE_SSE)
+	{ "sse", SPA_CPU_FLAG_SSE },
+#endif
+};
+
+#define MC_CHANNELS	7
+#define MC_IN		256
+#define MC_OUT		1024
+
+static float mc_in[MC_CHANNELS][MC_IN];
+static float mc_ref[MC_CHANNELS][MC_OUT];
+static float mc_out[MC_CHANNELS][MC_OUT];
+
+/* run \a cpu_flags and the C version on the same multichannel input, with
+ * more channels than a block so that the blocked and the tail kernels run */
+static void compare_simd(const char *name, uint32_t cpu_flags,
+		uint32_t i_rate, uint32_t o_rate, double rate)
+{
+	struct resample ref, r;
+	const void *src[MC_CHANNELS];
+	void *rdst[MC_CHANNELS], *dst[MC_CHANNELS];
+	uint32_t i, c, n;
+	float max_diff = 0.0f;
+
+	spa_zero(ref);
+	ref.log = &logger.log;
+	ref.channels = MC_CHANNELS;
+	ref.i_rate = i_rate;
+	ref.o_rate = o_rate;
+	ref.quality = RESAMPLE_DEFAULT_QUALITY;
+	spa_assert(resample_native_init(&ref) == 0);
+	spa_assert(ref.cpu_flags == 0);
+
+	r = ref;
+	r.cpu_flags = cpu_flags;
+	spa_assert(resample_native_init(&r) == 0);
+	spa_assert(r.cpu_flags == cpu_flags);
+
+	if (rate != 1.0) {
+		resample_update_rate(&ref, rate);
+		resample_update_rate(&r, rate);
+	}
+
+	for (c = 0; c < MC_CHANNELS; c++) {
+		src[c] = mc_in[c];
+		rdst[c] = mc_ref[c];
+		dst[c] = mc_out[c];
+	}
+
+	srand(0);
+	for (n = 0; n < 40; n++) {
+		uint32_t ref_in = MC_IN, ref_out = MC_OUT, in_len = MC_IN, out_len = MC_OUT;
+
+		for (c = 0; c < MC_CHANNELS; c++)
+			for (i = 0; i < MC_IN; i++)
+				mc_in[c][i] = (float)rand() / RAND_MAX * 2.0f - 1.0f;
+
+		resample_process(&ref, src, &ref_in, rdst, &ref_out);
+		resample_process(&r, src, &in_len, dst, &out_len);
+		spa_assert(ref_in == in_len);
+		spa_assert(ref_out == out_len);
+
+		for (c = 0; c < MC_CHANNELS; c++)
+			for (i = 0; i < out_len; i++)
+				max_diff = SPA_MAX(max_diff, fabsf(mc_ref[c][i] - mc_out[c][i]));
+	}
+	fprintf(stderr, "%s %d->%d rate:%f channels:%d max diff %g\n",
+			name, i_rate, o_rate, rate, MC_CHANNELS, max_diff);
+	spa_assert(max_diff < 1e-5f);
+
+	resample_free(&ref);
+	resample_free(&r);
+}
+
+static void test_simd_multichannel(void)
+{
+	uint32_t i, cpu_flags = get_cpu_flags();
+
+	for (i = 0; i < SPA_N_ELEMENTS(simd_impls); i++) {
+		uint32_t flags = simd_impls[i].cpu_flags & ~SPA_CPU_FLAG_SLOW_UNALIGNED;
+
+		if ((cpu_flags & flags) != flags) {
+			fprintf(stderr, "skip %s, not supported by the CPU\n",
+					simd_impls[i].name);
+			continue;
+		}
+		/* full and interpolated filter */
+		compare_simd(simd_impls[i].name, simd_impls[i].cpu_flags, 44100, 48000, 1.0);
+		compare_simd(simd_impls[i].name, simd_impls[i].cpu_flags, 48000, 44100, 1.0);
+		compare_simd(simd_impls[i].name, simd_impls[i].cpu_flags, 44100, 48000, 1.01);
+	}
+}
+
 int main(int argc, char *argv[])
 {
 	logger.log.level = SPA_LOG_LEVEL_TRACE;
 
 	test_native();
 	test_in_len();
+	test_minimum_phase();
+	test_simd_multichannel();
 
 	return 0;
 }
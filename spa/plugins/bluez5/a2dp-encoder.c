@@ -0,0 +1,372 @@
+/* Spa A2DP SBC encoder thread
+ *
+ * Copyright © 2020 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+#include <arpa/inet.h>
+
+#include <spa/utils/defs.h>
+#include <spa/utils/result.h>
+
+#include "rtp.h"
+#include "a2dp-encoder.h"
+
+#define NAME "a2dp-encoder"
+
+#define PCM_MASK	(A2DP_ENCODER_PCM_SIZE - 1)
+#define PACKET_MASK	(A2DP_ENCODER_MAX_PACKETS - 1)
+#define HEADER_SIZE	(sizeof(struct rtp_header) + sizeof(struct rtp_payload))
+#define MAX_CODESIZE	1024
+
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static inline void signal_fd(struct a2dp_encoder *enc, int fd)
+{
+	spa_system_eventfd_write(enc->system, fd, 1);
+}
+
+static void update_bitpool(struct a2dp_encoder *enc)
+{
+	int bitpool = __atomic_load_n(&enc->bitpool, __ATOMIC_RELAXED);
+
+	if (bitpool == enc->sbc.bitpool)
+		return;
+
+	enc->sbc.bitpool = bitpool;
+	enc->frame_length = sbc_get_frame_length(&enc->sbc);
+
+	spa_log_debug(enc->log, NAME" %p: bitpool %d frame_length %d",
+			enc, bitpool, enc->frame_length);
+}
+
+/* encode one full packet, returns 1 when a packet was produced, 0 when
+ * there is not enough PCM or no free packet and < 0 on error */
+static int encode_packet(struct a2dp_encoder *enc)
+{
+	uint8_t tmp[MAX_CODESIZE];
+	struct rtp_header *header;
+	struct rtp_payload *payload;
+	struct a2dp_packet *p;
+	uint32_t index, pindex, n_sbc, used, i;
+	int32_t avail, filled;
+	uint64_t t1, t2;
+
+	filled = spa_ringbuffer_get_write_index(&enc->packet_ring, &pindex);
+	if (filled >= A2DP_ENCODER_MAX_PACKETS)
+		return 0;
+
+	update_bitpool(enc);
+
+	n_sbc = SPA_MIN((enc->write_size - HEADER_SIZE) / enc->frame_length,
+			A2DP_ENCODER_MAX_FRAME_COUNT);
+	if (n_sbc == 0)
+		return -EINVAL;
+
+	avail = spa_ringbuffer_get_read_index(&enc->pcm_ring, &index);
+	if (avail < (int32_t)(n_sbc * enc->codesize))
+		return 0;
+
+	t1 = get_time_ns();
+
+	p = &enc->packets[pindex & PACKET_MASK];
+	used = HEADER_SIZE;
+
+	for (i = 0; i < n_sbc; i++) {
+		uint32_t offs = index & PCM_MASK;
+		const void *src;
+		ssize_t processed, out_encoded;
+
+		if (offs + enc->codesize > A2DP_ENCODER_PCM_SIZE) {
+			spa_ringbuffer_read_data(&enc->pcm_ring, enc->pcm, A2DP_ENCODER_PCM_SIZE,
+					offs, tmp, enc->codesize);
+			src = tmp;
+		} else {
+			src = &enc->pcm[offs];
+		}
+		processed = sbc_encode(&enc->sbc, src, enc->codesize,
+				&p->data[used], sizeof(p->data) - used, &out_encoded);
+		if (processed <= 0) {
+			spa_log_error(enc->log, NAME" %p: encode error %zd", enc, processed);
+			return processed < 0 ? processed : -EIO;
+		}
+		index += processed;
+		used += out_encoded;
+	}
+	spa_ringbuffer_read_update(&enc->pcm_ring, index);
+
+	header = (struct rtp_header *)p->data;
+	payload = (struct rtp_payload *)(p->data + sizeof(struct rtp_header));
+	memset(p->data, 0, HEADER_SIZE);
+
+	payload->frame_count = n_sbc;
+	header->v = 2;
+	header->pt = 1;
+	header->sequence_number = htons(enc->seqnum);
+	header->timestamp = htonl(enc->timestamp);
+	header->ssrc = htonl(1);
+
+	p->size = used;
+	p->n_frames = n_sbc * enc->codesize / enc->frame_size;
+
+	enc->seqnum++;
+	enc->timestamp += p->n_frames;
+
+	spa_ringbuffer_write_update(&enc->packet_ring, pindex + 1);
+	signal_fd(enc, enc->packet_fd);
+
+	t2 = get_time_ns();
+	enc->stats.n_packets++;
+	enc->stats.encode_time += t2 - t1;
+	enc->stats.max_encode_time = SPA_MAX(enc->stats.max_encode_time, t2 - t1);
+
+	return 1;
+}
+
+static void *encoder_thread(void *data)
+{
+	struct a2dp_encoder *enc = data;
+	uint64_t count;
+	int res = 0;
+
+	spa_log_debug(enc->log, NAME" %p: enter thread", enc);
+
+	while (__atomic_load_n(&enc->running, __ATOMIC_ACQUIRE)) {
+		if ((res = encode_packet(enc)) > 0)
+			continue;
+		if (res < 0)
+			break;
+		/* wait for more PCM or a free packet */
+		if ((res = spa_system_eventfd_read(enc->system, enc->wakeup_fd, &count)) < 0 &&
+		    res != -EINTR && res != -EAGAIN) {
+			spa_log_error(enc->log, NAME" %p: wakeup error: %s",
+					enc, spa_strerror(res));
+			break;
+		}
+		res = 0;
+	}
+	if (res < 0) {
+		/* wake up the data thread, it finds the error when it
+		 * sends the next packets */
+		__atomic_store_n(&enc->error, res, __ATOMIC_RELEASE);
+		signal_fd(enc, enc->packet_fd);
+	}
+	spa_log_debug(enc->log, NAME" %p: leave thread: %d", enc, res);
+
+	return NULL;
+}
+
+/* the encoder must keep up with the data thread, try to make it realtime.
+ * Without RLIMIT_RTPRIO this fails and the thread keeps the normal
+ * priority. */
+static void set_rt_priority(struct a2dp_encoder *enc)
+{
+	struct sched_param sp;
+	int res;
+
+	spa_zero(sp);
+	sp.sched_priority = SPA_MIN(A2DP_ENCODER_RT_PRIO, sched_get_priority_max(SCHED_FIFO));
+
+	if ((res = pthread_setschedparam(enc->thread, SCHED_FIFO | SCHED_RESET_ON_FORK, &sp)) != 0)
+		spa_log_info(enc->log, NAME" %p: can't set SCHED_FIFO priority %d: %s",
+				enc, sp.sched_priority, strerror(res));
+	else
+		spa_log_debug(enc->log, NAME" %p: SCHED_FIFO priority %d",
+				enc, sp.sched_priority);
+}
+
+int a2dp_encoder_start(struct a2dp_encoder *enc, struct spa_log *log,
+		struct spa_system *system,
+		const sbc_t *sbc, uint32_t frame_size, uint32_t write_size)
+{
+	int res;
+
+	if (enc->started)
+		return -EBUSY;
+	if (system == NULL)
+		return -EINVAL;
+
+	enc->log = log;
+	enc->system = system;
+
+	sbc_init(&enc->sbc, 0);
+	enc->sbc.frequency = sbc->frequency;
+	enc->sbc.blocks = sbc->blocks;
+	enc->sbc.subbands = sbc->subbands;
+	enc->sbc.mode = sbc->mode;
+	enc->sbc.allocation = sbc->allocation;
+	enc->sbc.bitpool = sbc->bitpool;
+	enc->sbc.endian = sbc->endian;
+
+	enc->bitpool = sbc->bitpool;
+	enc->frame_size = frame_size;
+	enc->write_size = SPA_MIN(write_size, A2DP_ENCODER_MAX_PACKET);
+	enc->codesize = sbc_get_codesize(&enc->sbc);
+	enc->frame_length = sbc_get_frame_length(&enc->sbc);
+
+	if (enc->codesize == 0 || enc->codesize > MAX_CODESIZE ||
+	    enc->frame_length == 0 || frame_size == 0 ||
+	    enc->write_size <= HEADER_SIZE) {
+		res = -EINVAL;
+		goto error_sbc;
+	}
+
+	spa_ringbuffer_init(&enc->pcm_ring);
+	spa_ringbuffer_init(&enc->packet_ring);
+	enc->seqnum = 0;
+	enc->timestamp = 0;
+	enc->error = 0;
+	spa_zero(enc->stats);
+
+	if ((res = spa_system_eventfd_create(system, SPA_FD_CLOEXEC)) < 0)
+		goto error_sbc;
+	enc->wakeup_fd = res;
+	if ((res = spa_system_eventfd_create(system, SPA_FD_CLOEXEC | SPA_FD_NONBLOCK)) < 0)
+		goto error_wakeup;
+	enc->packet_fd = res;
+
+	enc->running = true;
+	if ((res = pthread_create(&enc->thread, NULL, encoder_thread, enc)) != 0) {
+		res = -res;
+		goto error_packet;
+	}
+	pthread_setname_np(enc->thread, "a2dp-encoder");
+	set_rt_priority(enc);
+	enc->started = true;
+
+	spa_log_debug(enc->log, NAME" %p: started codesize:%d frame_length:%d write_size:%d",
+			enc, enc->codesize, enc->frame_length, enc->write_size);
+
+	return 0;
+
+error_packet:
+	enc->running = false;
+	spa_system_close(system, enc->packet_fd);
+error_wakeup:
+	spa_system_close(system, enc->wakeup_fd);
+error_sbc:
+	sbc_finish(&enc->sbc);
+	return res;
+}
+
+int a2dp_encoder_stop(struct a2dp_encoder *enc)
+{
+	if (!enc->started)
+		return 0;
+
+	__atomic_store_n(&enc->running, false, __ATOMIC_RELEASE);
+	signal_fd(enc, enc->wakeup_fd);
+	pthread_join(enc->thread, NULL);
+
+	spa_system_close(enc->system, enc->packet_fd);
+	spa_system_close(enc->system, enc->wakeup_fd);
+	sbc_finish(&enc->sbc);
+	enc->started = false;
+
+	spa_log_debug(enc->log, NAME" %p: stopped packets:%"PRIu64" sent:%"PRIu64
+			" overruns:%"PRIu64, enc, enc->stats.n_packets,
+			enc->stats.n_sent, enc->stats.n_overruns);
+	return 0;
+}
+
+int a2dp_encoder_get_error(struct a2dp_encoder *enc)
+{
+	return __atomic_load_n(&enc->error, __ATOMIC_ACQUIRE);
+}
+
+void a2dp_encoder_set_bitpool(struct a2dp_encoder *enc, int bitpool)
+{
+	__atomic_store_n(&enc->bitpool, bitpool, __ATOMIC_RELAXED);
+}
+
+int a2dp_encoder_write(struct a2dp_encoder *enc, const void *data, uint32_t size)
+{
+	uint32_t index, avail;
+	int32_t filled;
+	int res;
+
+	if (!enc->started)
+		return -EIO;
+	if ((res = a2dp_encoder_get_error(enc)) < 0)
+		return res;
+
+	filled = spa_ringbuffer_get_write_index(&enc->pcm_ring, &index);
+	avail = A2DP_ENCODER_PCM_SIZE - filled;
+	if (size > avail) {
+		enc->stats.n_overruns++;
+		size = avail - (avail % enc->frame_size);
+	}
+	if (size == 0)
+		return 0;
+
+	spa_ringbuffer_write_data(&enc->pcm_ring, enc->pcm, A2DP_ENCODER_PCM_SIZE,
+			index & PCM_MASK, data, size);
+	spa_ringbuffer_write_update(&enc->pcm_ring, index + size);
+
+	signal_fd(enc, enc->wakeup_fd);
+
+	return size;
+}
+
+int a2dp_encoder_send(struct a2dp_encoder *enc, int fd)
+{
+	uint32_t index;
+	int32_t avail;
+	uint64_t count;
+	int res, written, total = 0;
+
+	if (!enc->started)
+		return -EIO;
+
+	if ((res = spa_system_eventfd_read(enc->system, enc->packet_fd, &count)) < 0 &&
+	    res != -EAGAIN)
+		spa_log_warn(enc->log, NAME" %p: read error: %s", enc, spa_strerror(res));
+
+	if ((res = a2dp_encoder_get_error(enc)) < 0)
+		return res;
+
+	while ((avail = spa_ringbuffer_get_read_index(&enc->packet_ring, &index)) > 0) {
+		struct a2dp_packet *p = &enc->packets[index & PACKET_MASK];
+
+		written = write(fd, p->data, p->size);
+		if (written < 0)
+			return -errno;
+
+		spa_ringbuffer_read_update(&enc->packet_ring, index + 1);
+		enc->stats.n_sent++;
+		total += written;
+
+		/* the encoder might be waiting for a free packet */
+		if (avail == A2DP_ENCODER_MAX_PACKETS)
+			signal_fd(enc, enc->wakeup_fd);
+	}
+	return total;
+}
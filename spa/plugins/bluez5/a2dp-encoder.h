@@ -0,0 +1,127 @@
+/* Spa A2DP SBC encoder thread
+ *
+ * Copyright © 2020 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SPA_BLUEZ5_A2DP_ENCODER_H
+#define SPA_BLUEZ5_A2DP_ENCODER_H
+
+#include <stdbool.h>
+#include <pthread.h>
+
+#include <spa/support/log.h>
+#include <spa/support/system.h>
+#include <spa/utils/ringbuffer.h>
+
+#include <sbc/sbc.h>
+
+/** the PCM lookahead, must be a power of 2 */
+#define A2DP_ENCODER_PCM_SIZE		(64 * 1024)
+/** the number of encoded packets that can be queued, must be a power of 2 */
+#define A2DP_ENCODER_MAX_PACKETS	8
+#define A2DP_ENCODER_MAX_PACKET		4096
+/** the frame_count field in the RTP payload header has 4 bits */
+#define A2DP_ENCODER_MAX_FRAME_COUNT	15
+/** SCHED_FIFO priority of the encoder thread, below the default of the
+ * data thread so that the data thread can always queue PCM */
+#define A2DP_ENCODER_RT_PRIO		19
+
+struct a2dp_packet {
+	uint32_t size;
+	uint32_t n_frames;		/**< number of PCM frames in the packet */
+	uint8_t data[A2DP_ENCODER_MAX_PACKET];
+};
+
+struct a2dp_encoder_stats {
+	uint64_t n_packets;		/**< packets encoded */
+	uint64_t n_sent;		/**< packets written to the socket */
+	uint64_t encode_time;		/**< total time spent encoding in nsec */
+	uint64_t max_encode_time;	/**< max time spent encoding one packet */
+	uint64_t n_overruns;		/**< times PCM did not fit in the ring */
+};
+
+/**
+ * Encodes SBC in a separate thread.
+ *
+ * The data thread writes PCM with a2dp_encoder_write() and sends the
+ * encoded RTP packets with a2dp_encoder_send() when packet_fd becomes
+ * readable. The PCM and packet queues are single producer, single
+ * consumer ringbuffers so neither side ever blocks on the other.
+ *
+ * When encoding fails, the thread stops and signals packet_fd. After
+ * that a2dp_encoder_write() and a2dp_encoder_send() return the error.
+ */
+struct a2dp_encoder {
+	struct spa_log *log;
+	struct spa_system *system;
+
+	sbc_t sbc;
+	uint32_t frame_size;		/**< size of one PCM frame in bytes */
+	uint32_t write_size;		/**< max size of the encoded payload */
+	uint32_t codesize;
+	uint32_t frame_length;
+	int bitpool;			/**< bitpool requested by the data thread */
+
+	int wakeup_fd;			/**< wakes up the encoder thread */
+	int packet_fd;			/**< signals encoded packets to the data thread */
+
+	pthread_t thread;
+	int running;
+	int error;			/**< < 0 when the encoder thread failed */
+	unsigned int started:1;
+
+	struct spa_ringbuffer pcm_ring;
+	uint8_t pcm[A2DP_ENCODER_PCM_SIZE];
+
+	struct spa_ringbuffer packet_ring;
+	struct a2dp_packet packets[A2DP_ENCODER_MAX_PACKETS];
+
+	/* only used in the encoder thread */
+	uint16_t seqnum;
+	uint32_t timestamp;
+
+	struct a2dp_encoder_stats stats;
+};
+
+/** start the encoder thread with the configuration of \a sbc, the eventfds
+ * are made with \a system */
+int a2dp_encoder_start(struct a2dp_encoder *enc, struct spa_log *log,
+		struct spa_system *system,
+		const sbc_t *sbc, uint32_t frame_size, uint32_t write_size);
+int a2dp_encoder_stop(struct a2dp_encoder *enc);
+
+/** get the error of the encoder thread, 0 when it is running fine */
+int a2dp_encoder_get_error(struct a2dp_encoder *enc);
+
+/** change the bitpool, used from the next packet */
+void a2dp_encoder_set_bitpool(struct a2dp_encoder *enc, int bitpool);
+
+/** queue PCM for encoding, returns the number of bytes accepted or the
+ * error of the encoder thread */
+int a2dp_encoder_write(struct a2dp_encoder *enc, const void *data, uint32_t size);
+
+/** send queued packets to \a fd, returns the number of bytes sent,
+ * -EAGAIN when the socket is full, the error of the encoder thread or
+ * another negative errno */
+int a2dp_encoder_send(struct a2dp_encoder *enc, int fd);
+
+#endif /* SPA_BLUEZ5_A2DP_ENCODER_H */
@@ -45,6 +45,7 @@
 #include <spa/param/param.h>
 #include <spa/param/audio/format.h>
 #include <spa/param/audio/format-utils.h>
+#include <spa/param/latency-utils.h>
 #include <spa/pod/filter.h>
 
 #include <sbc/sbc.h>
@@ -52,6 +53,7 @@
 #include "defs.h"
 #include "rtp.h"
 #include "a2dp-codecs.h"
+#include "a2dp-encoder.h"
 
 struct props {
 	uint32_t min_latency;
@@ -59,7 +61,6 @@ struct props {
 };
 
 #define FILL_FRAMES 2
-#define MAX_FRAME_COUNT 32
 #define MAX_BUFFERS 32
 
 struct buffer {
@@ -95,6 +96,7 @@ struct impl {
 	struct spa_node node;
 
 	struct spa_log *log;
+	struct spa_loop *main_loop;
 	struct spa_loop *data_loop;
 	struct spa_system *data_system;
 
@@ -118,6 +120,7 @@ struct impl {
 	int timerfd;
 	int threshold;
 	struct spa_source flush_source;
+	struct spa_source encoder_source;
 
 	struct spa_io_clock *clock;
 	struct spa_io_position *position;
@@ -128,11 +131,6 @@ struct impl {
 	int write_samples;
 	int frame_length;
 	int codesize;
-	uint8_t buffer[4096];
-	int buffer_used;
-	int frame_count;
-	uint16_t seqnum;
-	uint32_t timestamp;
 
 	int min_bitpool;
 	int max_bitpool;
@@ -142,12 +140,13 @@ struct impl {
 
 	struct timespec now;
 	uint64_t start_time;
-	uint64_t sample_count;
 	uint64_t sample_time;
 	uint64_t last_ticks;
 	uint64_t last_monotonic;
 
 	uint64_t underrun;
+
+	struct a2dp_encoder encoder;
 };
 
 #define NAME "a2dp-sink"
@@ -348,142 +347,40 @@ static inline void calc_timeout(size_t target, size_t current,
 	}
 }
 
-static int reset_buffer(struct impl *this)
-{
-	this->buffer_used = sizeof(struct rtp_header) + sizeof(struct rtp_payload);
-	this->frame_count = 0;
-	return 0;
-}
-
-static int send_buffer(struct impl *this)
-{
-	int val, written;
-	struct rtp_header *header;
-	struct rtp_payload *payload;
-
-	spa_return_val_if_fail(this->transport, -EIO);
-
-	header = (struct rtp_header *)this->buffer;
-	payload = (struct rtp_payload *)(this->buffer + sizeof(struct rtp_header));
-	memset(this->buffer, 0, sizeof(struct rtp_header)+sizeof(struct rtp_payload));
-
-	payload->frame_count = this->frame_count;
-	header->v = 2;
-	header->pt = 1;
-	header->sequence_number = htons(this->seqnum);
-	header->timestamp = htonl(this->timestamp);
-	header->ssrc = htonl(1);
-
-	ioctl(this->transport->fd, TIOCOUTQ, &val);
-
-	spa_log_trace(this->log, NAME " %p: send %d %u %u %u %"PRIu64" %d",
-			this, this->frame_count, this->seqnum, this->timestamp, this->buffer_used,
-			this->sample_time, val);
-
-	written = write(this->transport->fd, this->buffer, this->buffer_used);
-	spa_log_trace(this->log, NAME " %p: send %d", this, written);
-	if (written < 0)
-		return -errno;
-
-	this->timestamp = this->sample_count;
-	this->seqnum++;
-	reset_buffer(this);
-
-	return written;
-}
-
-static int encode_buffer(struct impl *this, const void *data, int size)
-{
-	int processed;
-	ssize_t out_encoded;
-	struct port *port = &this->port;
-
-	spa_log_trace(this->log, NAME " %p: encode %d used %d, %d %d %d/%d",
-			this, size, this->buffer_used, port->frame_size, this->write_size,
-			this->frame_count, MAX_FRAME_COUNT);
-
-	if (this->frame_count > MAX_FRAME_COUNT)
-		return -ENOSPC;
-
-	processed = sbc_encode(&this->sbc, data, size,
-			       this->buffer + this->buffer_used,
-			       this->write_size - this->buffer_used,
-			       &out_encoded);
-	if (processed < 0)
-		return processed;
-
-	this->sample_count += processed / port->frame_size;
-	this->sample_time += processed / port->frame_size;
-	this->frame_count += processed / this->codesize;
-	this->buffer_used += out_encoded;
-
-	spa_log_trace(this->log, NAME " %p: processed %d %zd used %d",
-			this, processed, out_encoded, this->buffer_used);
-
-	return processed;
-}
-
-static bool need_flush(struct impl *this)
+static int add_data(struct impl *this, const void *data, int size)
 {
-	return (this->buffer_used + this->frame_length > this->write_size) ||
-		this->frame_count > MAX_FRAME_COUNT;
-}
+	int res;
 
-static int flush_buffer(struct impl *this, bool force)
-{
-	spa_log_trace(this->log, NAME" %p: %d %d %d", this,
-			this->buffer_used, this->frame_length, this->write_size);
+	res = a2dp_encoder_write(&this->encoder, data, size);
+	if (res > 0)
+		this->sample_time += res / this->port.frame_size;
 
-	if (force || need_flush(this))
-		return send_buffer(this);
+	spa_log_trace(this->log, NAME " %p: queued %d/%d", this, res, size);
 
-	return 0;
+	return res;
 }
 
 static int fill_socket(struct impl *this, uint64_t now_time)
 {
 	static const uint8_t zero_buffer[1024 * 4] = { 0, };
-	int frames = 0;
-
-	while (frames < FILL_FRAMES) {
-		int processed, written;
+	int size, res;
 
-		processed = encode_buffer(this, zero_buffer, sizeof(zero_buffer));
-		if (processed < 0)
-			return processed;
-		if (processed == 0)
-			break;
-
-		written = flush_buffer(this, false);
-		if (written == -EAGAIN)
-			break;
-		else if (written < 0)
-			return written;
-		else if (written > 0)
-			frames++;
+	size = FILL_FRAMES * this->write_samples * this->port.frame_size;
+	while (size > 0) {
+		res = add_data(this, zero_buffer, SPA_MIN(size, (int)sizeof(zero_buffer)));
+		if (res <= 0)
+			return res;
+		size -= res;
 	}
-	reset_buffer(this);
-	this->sample_count = this->timestamp;
-
 	return 0;
 }
 
-static int add_data(struct impl *this, const void *data, int size)
-{
-	int processed, total = 0;
-
-	while (size > 0) {
-		processed = encode_buffer(this, data, size);
-
-		if (processed <= 0)
-			return total > 0 ? total : processed;
-
-		data = SPA_MEMBER(data, processed, void);
-		size -= processed;
-		total += processed;
-	}
-	return total;
-}
+static int do_emit_latency(struct spa_loop *loop,
+			   bool async,
+			   uint32_t seq,
+			   const void *data,
+			   size_t size,
+			   void *user_data);
 
 static int set_bitpool(struct impl *this, int bitpool)
 {
@@ -500,6 +397,7 @@ static int set_bitpool(struct impl *this, int bitpool)
 		return 0;
 
 	this->sbc.bitpool = bitpool;
+	a2dp_encoder_set_bitpool(&this->encoder, bitpool);
 
 	spa_log_debug(this->log, NAME" %p: set bitpool %d", this, this->sbc.bitpool);
 
@@ -513,6 +411,11 @@ static int set_bitpool(struct impl *this, int bitpool)
 	this->write_samples = (this->write_size / this->frame_length) *
 		(this->codesize / port->frame_size);
 
+	/* the latency depends on write_samples, let the graph read it again.
+	 * Start emits it once the first bitpool is set. */
+	if (this->started)
+		spa_loop_invoke(this->main_loop, do_emit_latency, 0, NULL, 0, false, this);
+
 	return 0;
 }
 
@@ -526,6 +429,53 @@ static int increase_bitpool(struct impl *this)
 	return set_bitpool(this, this->sbc.bitpool + 1);
 }
 
+static int do_remove_source(struct spa_loop *loop,
+			    bool async,
+			    uint32_t seq,
+			    const void *data,
+			    size_t size,
+			    void *user_data);
+
+static int do_emit_error(struct spa_loop *loop,
+			 bool async,
+			 uint32_t seq,
+			 const void *data,
+			 size_t size,
+			 void *user_data)
+{
+	struct impl *this = user_data;
+	struct spa_event event = SPA_NODE_EVENT_INIT(SPA_NODE_EVENT_Error);
+
+	spa_node_emit_event(&this->hooks, &event);
+	return 0;
+}
+
+/* called from the data thread when the encoder thread failed. Stop the
+ * timers and let the main thread put the node in the error state. */
+static void encoder_error(struct impl *this, int res)
+{
+	spa_log_error(this->log, NAME" %p: encoder error: %s", this, spa_strerror(res));
+
+	do_remove_source(this->data_loop, false, 0, NULL, 0, this);
+	spa_loop_invoke(this->main_loop, do_emit_error, 0, NULL, 0, false, this);
+}
+
+static int send_packets(struct impl *this, uint64_t now_time)
+{
+	int written;
+
+	spa_return_val_if_fail(this->transport, -EIO);
+
+	written = a2dp_encoder_send(&this->encoder, this->transport->fd);
+	spa_log_trace(this->log, NAME " %p: sent %d", this, written);
+
+	if (written > 0 && now_time - this->last_error > SPA_NSEC_PER_SEC * 3) {
+		increase_bitpool(this);
+		this->last_error = now_time;
+	}
+	return written;
+}
+
 static int flush_data(struct impl *this, uint64_t now_time)
 {
 	int written;
@@ -560,11 +510,11 @@ static int flush_data(struct impl *this, uint64_t now_time)
 		l1 = n_bytes - l0;
 
 		written = add_data(this, src + offs, l0);
-		if (written > 0 && l1 > 0)
-			written += add_data(this, src, l1);
+		if (written == (int)l0 && l1 > 0)
+			written += SPA_MAX(add_data(this, src, l1), 0);
 		if (written <= 0) {
 			port->need_data = true;
-			if (written < 0 && written != -ENOSPC) {
+			if (written < 0) {
 				spa_list_remove(&b->link);
 				b->outstanding = true;
 				spa_log_trace(this->log, NAME " %p: error %s, reuse buffer %u",
@@ -592,7 +542,7 @@ static int flush_data(struct impl *this, uint64_t now_time)
 		spa_log_trace(this->log, NAME " %p: written %u frames", this, total_frames);
 	}
 
-	written = flush_buffer(this, false);
+	written = send_packets(this, now_time);
 	if (written == -EAGAIN) {
 		spa_log_trace(this->log, NAME" %p: delay flush %"PRIu64, this, this->sample_time);
 		if ((this->flush_source.mask & SPA_IO_OUT) == 0) {
@@ -606,14 +556,10 @@ static int flush_data(struct impl *this, uint64_t now_time)
 	else if (written < 0) {
 		spa_log_trace(this->log, NAME" %p: error flushing %s", this,
 				spa_strerror(written));
+		if (a2dp_encoder_get_error(&this->encoder) < 0)
+			encoder_error(this, written);
 		return written;
 	}
-	else if (written > 0) {
-		if (now_time - this->last_error > SPA_NSEC_PER_SEC * 3) {
-			increase_bitpool(this);
-			this->last_error = now_time;
-		}
-	}
 
 	this->flush_source.mask = 0;
 	spa_loop_update_source(this->data_loop, &this->flush_source);
@@ -681,6 +627,31 @@ static void a2dp_on_flush(struct spa_source *source)
 	flush_data(this, now_time);
 }
 
+static void a2dp_on_encoded(struct spa_source *source)
+{
+	struct impl *this = source->data;
+	uint64_t now_time;
+	int res;
+
+	spa_system_clock_gettime(this->data_system, CLOCK_MONOTONIC, &this->now);
+	now_time = SPA_TIMESPEC_TO_NSEC(&this->now);
+
+	res = send_packets(this, now_time);
+	if (res == -EAGAIN) {
+		/* a2dp_on_flush sends the remaining packets */
+		if ((this->flush_source.mask & SPA_IO_OUT) == 0) {
+			this->flush_source.mask = SPA_IO_OUT;
+			spa_loop_update_source(this->data_loop, &this->flush_source);
+		}
+	}
+	else if (res < 0) {
+		spa_log_trace(this->log, NAME" %p: error sending %s", this,
+				spa_strerror(res));
+		if (a2dp_encoder_get_error(&this->encoder) < 0)
+			encoder_error(this, res);
+	}
+}
+
 static void a2dp_on_timeout(struct spa_source *source)
 {
 	struct impl *this = source->data;
@@ -788,8 +759,6 @@ static int init_sbc(struct impl *this)
 
 	set_bitpool(this, conf->max_bitpool);
 
-	this->seqnum = 0;
-
         spa_log_debug(this->log, NAME " %p: codesize %d frame_length %d size %d:%d %d",
 			this, this->codesize, this->frame_length, this->read_size, this->write_size,
 			this->sbc.bitpool);
@@ -816,6 +785,15 @@ static int do_start(struct impl *this)
 
 	init_sbc(this);
 
+	if ((res = a2dp_encoder_start(&this->encoder, this->log, this->data_system, &this->sbc,
+					this->port.frame_size, this->write_size)) < 0) {
+		spa_log_error(this->log, NAME " %p: can't start encoder: %s",
+				this, spa_strerror(res));
+		sbc_finish(&this->sbc);
+		spa_bt_transport_release(this->transport);
+		return res;
+	}
+
 	val = FILL_FRAMES * this->transport->write_mtu;
 	if (setsockopt(this->transport->fd, SOL_SOCKET, SO_SNDBUF, &val, sizeof(val)) < 0)
 		spa_log_warn(this->log, NAME " %p: SO_SNDBUF %m", this);
@@ -836,8 +814,6 @@ static int do_start(struct impl *this)
 	if (setsockopt(this->transport->fd, SOL_SOCKET, SO_PRIORITY, &val, sizeof(val)) < 0)
 		spa_log_warn(this->log, "SO_PRIORITY failed: %m");
 
-	reset_buffer(this);
-
 	this->source.data = this;
 	this->source.fd = this->timerfd;
 	this->source.func = a2dp_on_timeout;
@@ -852,6 +828,13 @@ static int do_start(struct impl *this)
 	this->flush_source.rmask = 0;
 	spa_loop_add_source(this->data_loop, &this->flush_source);
 
+	this->encoder_source.data = this;
+	this->encoder_source.fd = this->encoder.packet_fd;
+	this->encoder_source.func = a2dp_on_encoded;
+	this->encoder_source.mask = SPA_IO_IN;
+	this->encoder_source.rmask = 0;
+	spa_loop_add_source(this->data_loop, &this->encoder_source);
+
 	set_timers(this);
 	this->started = true;
 
@@ -877,6 +860,8 @@ static int do_remove_source(struct spa_loop *loop,
 	spa_system_timerfd_settime(this->data_system, this->timerfd, 0, &ts, NULL);
 	if (this->flush_source.loop)
 		spa_loop_remove_source(this->data_loop, &this->flush_source);
+	if (this->encoder_source.loop)
+		spa_loop_remove_source(this->data_loop, &this->encoder_source);
 
 	return 0;
 }
@@ -892,6 +877,9 @@ static int do_stop(struct impl *this)
 
 	spa_loop_invoke(this->data_loop, do_remove_source, 0, NULL, 0, true, this);
 
+	a2dp_encoder_stop(&this->encoder);
+	sbc_finish(&this->sbc);
+
 	this->started = false;
 
 	if (this->transport)
@@ -900,6 +888,8 @@ static int do_stop(struct impl *this)
 	return res;
 }
 
+static void emit_port_info(struct impl *this, struct port *port, bool full);
+
 static int impl_node_send_command(void *object, const struct spa_command *command)
 {
 	struct impl *this = object;
@@ -920,6 +910,9 @@ static int impl_node_send_command(void *object, const struct spa_command *comman
 
 		if ((res = do_start(this)) < 0)
 			return res;
+		/* the latency follows write_samples, known only now */
+		port->info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
+		emit_port_info(this, port, false);
 		break;
 	case SPA_NODE_COMMAND_Suspend:
 	case SPA_NODE_COMMAND_Pause:
@@ -960,6 +953,21 @@ static void emit_port_info(struct impl *this, struct port *port, bool full)
 	}
 }
 
+static int do_emit_latency(struct spa_loop *loop,
+			   bool async,
+			   uint32_t seq,
+			   const void *data,
+			   size_t size,
+			   void *user_data)
+{
+	struct impl *this = user_data;
+	struct port *port = &this->port;
+
+	port->info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
+	emit_port_info(this, port, false);
+	return 0;
+}
+
 static int
 impl_node_add_listener(void *object,
 		struct spa_hook *listener,
@@ -1017,6 +1025,20 @@ static int impl_node_remove_port(void *object, enum spa_direction direction, uin
 	return -ENOTSUP;
 }
 
+/* the quantum we encode, the packets queued in the socket and the link */
+static void get_latency(struct impl *this, struct spa_latency_info *info)
+{
+	uint32_t samples = FILL_FRAMES * this->write_samples;
+
+	*info = SPA_LATENCY_INFO(SPA_DIRECTION_INPUT,
+			.min_quantum = 1.0f,
+			.max_quantum = 1.0f,
+			.min_rate = samples,
+			.max_rate = samples,
+			.min_ns = FIXED_LATENCY_NS,
+			.max_ns = FIXED_LATENCY_NS);
+}
+
 static int
 impl_node_port_enum_params(void *object, int seq,
 			enum spa_direction direction, uint32_t port_id,
@@ -1135,6 +1157,18 @@ impl_node_port_enum_params(void *object, int seq,
 		}
 		break;
 
+	case SPA_PARAM_Latency:
+	{
+		struct spa_latency_info info;
+
+		if (result.index > 0)
+			return 0;
+
+		get_latency(this, &info);
+		param = spa_latency_build(&b, id, &info);
+		break;
+	}
+
 	default:
 		return -ENOENT;
 	}
@@ -1428,9 +1462,14 @@ impl_init(const struct spa_handle_factory *factory,
 	this = (struct impl *) handle;
 
 	this->log = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_Log);
+	this->main_loop = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_Loop);
 	this->data_loop = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_DataLoop);
 	this->data_system = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_DataSystem);
 
+	if (this->main_loop == NULL) {
+		spa_log_error(this->log, "a main loop is needed");
+		return -EINVAL;
+	}
 	if (this->data_loop == NULL) {
 		spa_log_error(this->log, "a data loop is needed");
 		return -EINVAL;
@@ -1470,8 +1509,9 @@ impl_init(const struct spa_handle_factory *factory,
 	port->params[2] = SPA_PARAM_INFO(SPA_PARAM_IO, SPA_PARAM_INFO_READ);
 	port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
 	port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, 0);
+	port->params[5] = SPA_PARAM_INFO(SPA_PARAM_Latency, SPA_PARAM_INFO_READ);
 	port->info.params = port->params;
-	port->info.n_params = 5;
+	port->info.n_params = 6;
 	spa_list_init(&port->ready);
 
 	if (info && (str = spa_dict_lookup(info, SPA_KEY_API_BLUEZ5_TRANSPORT)))
@@ -0,0 +1,401 @@
+/* Spa A2DP encoder benchmark
+ *
+ * Copyright © 2020 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Feeds PCM through the SBC encoder into a socketpair that stands in for
+ * the L2CAP socket, once encoding inline like the old data path and once
+ * with the encoder thread. Reports the time spent in the process path per
+ * quantum and the jitter of the packets seen by the receiving end. */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <math.h>
+#include <poll.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <spa/utils/type.h>
+#include <spa/support/plugin.h>
+#include <spa/support/system.h>
+
+#include "rtp.h"
+#include "a2dp-encoder.h"
+
+#define RATE		44100
+#define CHANNELS	2
+#define FRAME_SIZE	(CHANNELS * sizeof(int16_t))
+#define MAX_QUANTUM	8192
+#define HEADER_SIZE	(sizeof(struct rtp_header) + sizeof(struct rtp_payload))
+
+struct receiver {
+	int fd;
+	pthread_t thread;
+	uint64_t n_packets;
+	uint64_t n_lost;
+	uint64_t last_time;
+	double sum, sum2, max;
+};
+
+struct stats {
+	const char *name;
+	uint64_t n_quantum;
+	uint64_t process_time;
+	uint64_t max_process_time;
+	uint64_t elapsed;
+	uint64_t n_full;
+};
+
+static int bitpool = 53;
+static int mtu = 895;
+static int quantum = 1024;
+static int n_quantum = 200;
+static bool flat_out = false;
+
+static int16_t pcm[MAX_QUANTUM * CHANNELS];
+
+static struct spa_system *system_iface;
+
+extern const struct spa_handle_factory spa_support_system_factory;
+
+static struct spa_system *make_system(void)
+{
+	const struct spa_handle_factory *factory = &spa_support_system_factory;
+	struct spa_handle *handle;
+	void *iface;
+	int res;
+
+	handle = calloc(1, spa_handle_factory_get_size(factory, NULL));
+	if (handle == NULL)
+		return NULL;
+	if ((res = spa_handle_factory_init(factory, handle, NULL, NULL, 0)) < 0 ||
+	    (res = spa_handle_get_interface(handle, SPA_TYPE_INTERFACE_System, &iface)) < 0) {
+		fprintf(stderr, "can't make system: %s\n", strerror(-res));
+		free(handle);
+		return NULL;
+	}
+	return iface;
+}
+
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static void *receiver_thread(void *data)
+{
+	struct receiver *r = data;
+	uint8_t buffer[A2DP_ENCODER_MAX_PACKET];
+	uint16_t seq = 0;
+	ssize_t len;
+
+	while ((len = read(r->fd, buffer, sizeof(buffer))) > 0) {
+		struct rtp_header *header = (struct rtp_header *)buffer;
+		uint64_t now = get_time_ns();
+
+		if (r->n_packets > 0) {
+			double delta = (now - r->last_time) / 1000.0;
+			r->sum += delta;
+			r->sum2 += delta * delta;
+			r->max = SPA_MAX(r->max, delta);
+			if (ntohs(header->sequence_number) != (uint16_t)(seq + 1))
+				r->n_lost++;
+		}
+		seq = ntohs(header->sequence_number);
+		r->last_time = now;
+		r->n_packets++;
+	}
+	return NULL;
+}
+
+static void init_sbc(sbc_t *sbc)
+{
+	sbc_init(sbc, 0);
+	sbc->frequency = SBC_FREQ_44100;
+	sbc->mode = SBC_MODE_JOINT_STEREO;
+	sbc->subbands = SBC_SB_8;
+	sbc->blocks = SBC_BLK_16;
+	sbc->allocation = SBC_AM_LOUDNESS;
+	sbc->endian = SBC_LE;
+	sbc->bitpool = bitpool;
+}
+
+static inline void wait_next(uint64_t *next, uint64_t period)
+{
+	struct timespec ts;
+
+	*next += period;
+	ts.tv_sec = *next / SPA_NSEC_PER_SEC;
+	ts.tv_nsec = *next % SPA_NSEC_PER_SEC;
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+/* the old data path, encode and send from the process function */
+static void run_sync(int fd, struct stats *s)
+{
+	uint8_t packet[A2DP_ENCODER_MAX_PACKET];
+	struct rtp_header *header = (struct rtp_header *)packet;
+	struct rtp_payload *payload = (struct rtp_payload *)(packet + sizeof(struct rtp_header));
+	uint32_t used = HEADER_SIZE, frame_count = 0, timestamp = 0, write_size;
+	uint64_t period, next, start;
+	uint16_t seqnum = 0;
+	sbc_t sbc;
+	int i;
+
+	init_sbc(&sbc);
+	write_size = mtu - HEADER_SIZE - 24;
+	period = (uint64_t)quantum * SPA_NSEC_PER_SEC / RATE;
+
+	start = next = get_time_ns();
+	for (i = 0; i < n_quantum; i++) {
+		const uint8_t *data = (const uint8_t *)pcm;
+		uint32_t size = quantum * FRAME_SIZE;
+		uint64_t t1, t2;
+
+		t1 = get_time_ns();
+		while (size > 0) {
+			ssize_t processed, out;
+
+			processed = sbc_encode(&sbc, data, size, packet + used,
+					sizeof(packet) - used, &out);
+			if (processed <= 0)
+				break;
+			data += processed;
+			size -= processed;
+			used += out;
+			frame_count++;
+
+			if (used + sbc_get_frame_length(&sbc) > write_size ||
+			    frame_count >= A2DP_ENCODER_MAX_FRAME_COUNT) {
+				memset(packet, 0, HEADER_SIZE);
+				payload->frame_count = frame_count;
+				header->v = 2;
+				header->pt = 1;
+				header->sequence_number = htons(seqnum++);
+				header->timestamp = htonl(timestamp);
+				if (write(fd, packet, used) < 0)
+					s->n_full++;
+				timestamp += frame_count * sbc_get_codesize(&sbc) / FRAME_SIZE;
+				used = HEADER_SIZE;
+				frame_count = 0;
+			}
+		}
+		t2 = get_time_ns();
+
+		s->process_time += t2 - t1;
+		s->max_process_time = SPA_MAX(s->max_process_time, t2 - t1);
+		s->n_quantum++;
+
+		if (!flat_out)
+			wait_next(&next, period);
+	}
+	s->elapsed = get_time_ns() - start;
+	sbc_finish(&sbc);
+}
+
+static int send_packets(struct a2dp_encoder *enc, int fd, struct stats *s)
+{
+	int res = a2dp_encoder_send(enc, fd);
+	if (res == -EAGAIN)
+		s->n_full++;
+	return res;
+}
+
+/* the encoder thread, the process function only queues PCM and the
+ * packets are sent when the encoder signals them */
+static void run_thread(int fd, struct stats *s)
+{
+	static struct a2dp_encoder enc;
+	uint64_t period, next, start;
+	sbc_t sbc;
+	int i, res;
+
+	init_sbc(&sbc);
+	if ((res = a2dp_encoder_start(&enc, NULL, system_iface, &sbc, FRAME_SIZE,
+					mtu - HEADER_SIZE - 24)) < 0) {
+		fprintf(stderr, "can't start encoder: %s\n", strerror(-res));
+		exit(1);
+	}
+	period = (uint64_t)quantum * SPA_NSEC_PER_SEC / RATE;
+
+	start = next = get_time_ns();
+	for (i = 0; i < n_quantum; i++) {
+		const uint8_t *data = (const uint8_t *)pcm;
+		uint32_t size = quantum * FRAME_SIZE;
+		struct pollfd pfd = { enc.packet_fd, POLLIN, 0 };
+		uint64_t t1, t2;
+
+		t1 = get_time_ns();
+		res = a2dp_encoder_write(&enc, data, size);
+		send_packets(&enc, fd, s);
+		t2 = get_time_ns();
+
+		s->process_time += t2 - t1;
+		s->max_process_time = SPA_MAX(s->max_process_time, t2 - t1);
+		s->n_quantum++;
+
+		if (flat_out) {
+			/* wait until the encoder made room for the rest */
+			while (res >= 0 && (uint32_t)res < size) {
+				data += res;
+				size -= res;
+				poll(&pfd, 1, -1);
+				send_packets(&enc, fd, s);
+				res = a2dp_encoder_write(&enc, data, size);
+			}
+			continue;
+		}
+		/* the flush path, send packets until the next quantum */
+		next += period;
+		while (true) {
+			int64_t timeout = (int64_t)(next - get_time_ns());
+			if (timeout <= 0)
+				break;
+			if (poll(&pfd, 1, SPA_MAX(timeout / SPA_NSEC_PER_MSEC, 1)) > 0)
+				send_packets(&enc, fd, s);
+		}
+	}
+	/* send what is left in the encoder */
+	while (poll(&(struct pollfd) { enc.packet_fd, POLLIN, 0 }, 1, 50) > 0)
+		a2dp_encoder_send(&enc, fd);
+	s->elapsed = get_time_ns() - start;
+
+	a2dp_encoder_stop(&enc);
+	sbc_finish(&sbc);
+
+	printf("  encoder thread: %"PRIu64" packets, avg %.2f max %.2f us/packet\n",
+			enc.stats.n_packets,
+			enc.stats.n_packets ? enc.stats.encode_time / 1000.0 / enc.stats.n_packets : 0.0,
+			enc.stats.max_encode_time / 1000.0);
+}
+
+static void run(const char *name, void (*func)(int fd, struct stats *s))
+{
+	struct receiver r;
+	struct stats s;
+	int fds[2], val;
+	double avg, dev;
+
+	spa_zero(r);
+	spa_zero(s);
+	s.name = name;
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) < 0) {
+		perror("socketpair");
+		exit(1);
+	}
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	val = 2 * mtu;
+	setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &val, sizeof(val));
+
+	r.fd = fds[1];
+	pthread_create(&r.thread, NULL, receiver_thread, &r);
+
+	func(fds[0], &s);
+
+	close(fds[0]);
+	pthread_join(r.thread, NULL);
+	close(fds[1]);
+
+	avg = r.n_packets > 1 ? r.sum / (r.n_packets - 1) : 0.0;
+	dev = r.n_packets > 1 ? sqrt(SPA_MAX(r.sum2 / (r.n_packets - 1) - avg * avg, 0.0)) : 0.0;
+
+	printf("%s: quantum %d bitpool %d mtu %d: %.2fx realtime\n", s.name, quantum,
+			bitpool, mtu, ((double)n_quantum * quantum / RATE) /
+			((double)s.elapsed / SPA_NSEC_PER_SEC));
+	printf("  process: avg %.2f max %.2f us/quantum, socket full %"PRIu64" times\n",
+			s.process_time / 1000.0 / s.n_quantum,
+			s.max_process_time / 1000.0, s.n_full);
+	printf("  receiver: %"PRIu64" packets, %"PRIu64" lost, interval avg %.1f "
+			"stddev %.1f max %.1f us\n", r.n_packets, r.n_lost, avg, dev, r.max);
+}
+
+static void show_help(const char *name)
+{
+	fprintf(stdout, "%s [options]\n"
+		"  -h, --help                            Show this help\n"
+		"  -b, --bitpool                         SBC bitpool (default %d)\n"
+		"  -m, --mtu                             Write MTU (default %d)\n"
+		"  -q, --quantum                         Frames per quantum (default %d)\n"
+		"  -n, --count                           Number of quanta (default %d)\n"
+		"  -f, --flat-out                        Don't pace in realtime\n",
+		name, bitpool, mtu, quantum, n_quantum);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{ "help",	no_argument,		NULL, 'h' },
+		{ "bitpool",	required_argument,	NULL, 'b' },
+		{ "mtu",	required_argument,	NULL, 'm' },
+		{ "quantum",	required_argument,	NULL, 'q' },
+		{ "count",	required_argument,	NULL, 'n' },
+		{ "flat-out",	no_argument,		NULL, 'f' },
+		{ NULL, 0, NULL, 0}
+	};
+	int c, i;
+
+	while ((c = getopt_long(argc, argv, "hb:m:q:n:f", long_options, NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			show_help(argv[0]);
+			return 0;
+		case 'b':
+			bitpool = atoi(optarg);
+			break;
+		case 'm':
+			mtu = atoi(optarg);
+			break;
+		case 'q':
+			quantum = SPA_CLAMP(atoi(optarg), 64, MAX_QUANTUM);
+			break;
+		case 'n':
+			n_quantum = SPA_MAX(atoi(optarg), 1);
+			break;
+		case 'f':
+			flat_out = true;
+			break;
+		default:
+			show_help(argv[0]);
+			return -1;
+		}
+	}
+
+	for (i = 0; i < quantum * CHANNELS; i++)
+		pcm[i] = (int16_t)(sin(i * M_PI * 2 * 440 / RATE) * 16000);
+
+	if ((system_iface = make_system()) == NULL)
+		return -1;
+
+	run("inline", run_sync);
+	run("thread", run_thread);
+
+	return 0;
+}
@@ -43,6 +43,9 @@ extern "C" {
 #define MIN_LATENCY	128
 #define MAX_LATENCY	1024
 
+/* latency of the link and the remote device that we can't measure */
+#define FIXED_LATENCY_NS	(25 * SPA_NSEC_PER_MSEC)
+
 #define ENDPOINT_INTROSPECT_XML                                             \
 	DBUS_INTROSPECT_1_0_XML_DOCTYPE_DECL_NODE                           \
 	"<node>"                                                            \
@@ -44,6 +44,7 @@
 #include <spa/param/param.h>
 #include <spa/param/audio/format.h>
 #include <spa/param/audio/format-utils.h>
+#include <spa/param/latency-utils.h>
 #include <spa/pod/filter.h>
 
 #include "defs.h"
@@ -603,6 +604,8 @@ static int do_stop(struct impl *this)
 	return res;
 }
 
+static void emit_port_info(struct impl *this, struct port *port, bool full);
+
 static int impl_node_send_command(void *object, const struct spa_command *command)
 {
 	struct impl *this = object;
@@ -622,6 +625,9 @@ static int impl_node_send_command(void *object, const struct spa_command *comman
 			return -EIO;
 		if ((res = do_start(this)) < 0)
 			return res;
+		/* the latency follows the write MTU, known only now */
+		port->info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
+		emit_port_info(this, port, false);
 		break;
 	case SPA_NODE_COMMAND_Pause:
 		if ((res = do_stop(this)) < 0)
@@ -718,6 +724,22 @@ static int impl_node_remove_port(void *object, enum spa_direction direction, uin
 	return -ENOTSUP;
 }
 
+/* the packets queued in the socket and the link */
+static void get_latency(struct impl *this, struct spa_latency_info *info)
+{
+	struct port *port = &this->port;
+	uint32_t samples = 0;
+
+	if (port->frame_size > 0)
+		samples = FILL_FRAMES * this->write_mtu / port->frame_size;
+
+	*info = SPA_LATENCY_INFO(SPA_DIRECTION_INPUT,
+			.min_rate = samples,
+			.max_rate = samples,
+			.min_ns = FIXED_LATENCY_NS,
+			.max_ns = FIXED_LATENCY_NS);
+}
+
 static int
 impl_node_port_enum_params(void *object, int seq,
 			enum spa_direction direction, uint32_t port_id,
@@ -809,6 +831,18 @@ impl_node_port_enum_params(void *object, int seq,
 		}
 		break;
 
+	case SPA_PARAM_Latency:
+	{
+		struct spa_latency_info info;
+
+		if (result.index > 0)
+			return 0;
+
+		get_latency(this, &info);
+		param = spa_latency_build(&b, id, &info);
+		break;
+	}
+
 	default:
 		return -ENOENT;
 	}
@@ -1145,8 +1179,9 @@ impl_init(const struct spa_handle_factory *factory,
 	port->params[2] = SPA_PARAM_INFO(SPA_PARAM_IO, SPA_PARAM_INFO_READ);
 	port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
 	port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, 0);
+	port->params[5] = SPA_PARAM_INFO(SPA_PARAM_Latency, SPA_PARAM_INFO_READ);
 	port->info.params = port->params;
-	port->info.n_params = 5;
+	port->info.n_params = 6;
 	spa_list_init(&port->ready);
 
 	if (info && (str = spa_dict_lookup(info, SPA_KEY_API_BLUEZ5_TRANSPORT)))
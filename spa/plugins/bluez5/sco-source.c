@@ -46,6 +46,7 @@
 #include <spa/param/param.h>
 #include <spa/param/audio/format.h>
 #include <spa/param/audio/format-utils.h>
+#include <spa/param/latency-utils.h>
 #include <spa/pod/filter.h>
 
 #include "defs.h"
@@ -615,6 +616,22 @@ static int impl_node_remove_port(void *object, enum spa_direction direction, uin
 	return -ENOTSUP;
 }
 
+/* the packet we read and the link */
+static void get_latency(struct impl *this, struct spa_latency_info *info)
+{
+	struct port *port = &this->port;
+	uint32_t samples = 0;
+
+	if (port->frame_size > 0)
+		samples = this->read_mtu / port->frame_size;
+
+	*info = SPA_LATENCY_INFO(SPA_DIRECTION_OUTPUT,
+			.min_rate = samples,
+			.max_rate = samples,
+			.min_ns = FIXED_LATENCY_NS,
+			.max_ns = FIXED_LATENCY_NS);
+}
+
 static int
 impl_node_port_enum_params(void *object, int seq,
 			enum spa_direction direction, uint32_t port_id,
@@ -705,6 +722,18 @@ impl_node_port_enum_params(void *object, int seq,
 		}
 		break;
 
+	case SPA_PARAM_Latency:
+	{
+		struct spa_latency_info info;
+
+		if (result.index > 0)
+			return 0;
+
+		get_latency(this, &info);
+		param = spa_latency_build(&b, id, &info);
+		break;
+	}
+
 	default:
 		return -ENOENT;
 	}
@@ -1052,8 +1081,9 @@ impl_init(const struct spa_handle_factory *factory,
 	port->params[2] = SPA_PARAM_INFO(SPA_PARAM_IO, SPA_PARAM_INFO_READ);
 	port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
 	port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, 0);
+	port->params[5] = SPA_PARAM_INFO(SPA_PARAM_Latency, SPA_PARAM_INFO_READ);
 	port->info.params = port->params;
-	port->info.n_params = 5;
+	port->info.n_params = 6;
 
 	/* Init the buffer lists */
 	spa_list_init(&port->ready);
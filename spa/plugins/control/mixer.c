@@ -37,6 +37,7 @@
 #include <spa/param/audio/format-utils.h>
 #include <spa/param/param.h>
 #include <spa/pod/filter.h>
+#include <spa/control/merge.h>
 
 #define NAME "control-mixer"
 
@@ -50,6 +51,7 @@ struct buffer {
 
 	struct spa_list link;
 	struct spa_buffer *buffer;
+	struct spa_buffer buf;		/* the buffer as it was given to us */
 };
 
 struct port {
@@ -505,6 +507,7 @@ impl_node_port_use_buffers(void *object,
 
 		b = &port->buffers[i];
 		b->buffer = buffers[i];
+		b->buf = *buffers[i];
 		b->flags = 0;
 		b->id = i;
 
@@ -568,10 +571,12 @@ static int impl_node_process(void *object)
 	struct spa_io_buffers *outio;
 	uint32_t n_seq, i;
         struct spa_pod_sequence **seq;
-        struct spa_pod_control **ctrl;
+	struct spa_control_merge_item *items;
+	struct spa_control_merge merge;
+	struct spa_pod_control *c;
 	struct spa_pod_builder builder;
 	struct spa_pod_frame f;
-        struct buffer *outb;
+        struct buffer *outb, *inb = NULL;
 	struct spa_data *d;
 
 	spa_return_val_if_fail(this != NULL, -EINVAL);
@@ -598,7 +603,7 @@ static int impl_node_process(void *object)
                 return -EPIPE;
         }
 
-	ctrl = alloca(MAX_PORTS * sizeof(struct spa_pod_control *));
+	items = alloca(MAX_PORTS * sizeof(struct spa_control_merge_item));
 	seq = alloca(MAX_PORTS * sizeof(struct spa_pod_sequence *));
         n_seq = 0;
 
@@ -632,47 +637,36 @@ static int impl_node_process(void *object)
 		if (!spa_pod_is_sequence(pod))
 			continue;
 
-		seq[n_seq] = pod;
-		ctrl[n_seq] = spa_pod_control_first(&seq[n_seq]->body);
+		inb = &inport->buffers[inio->buffer_id];
+		seq[n_seq++] = pod;
 		inio->status = SPA_STATUS_NEED_DATA;
-		n_seq++;
 	}
 
-	d = outb->buffer->datas;
-
-	/* prepare to write into output */
-	spa_pod_builder_init(&builder, d->data, d->maxsize);
-	spa_pod_builder_push_sequence(&builder, &f, 0);
-
-	/* merge sort all sequences into output buffer */
-	while (true) {
-		struct spa_pod_control *next = NULL;
-		uint32_t next_index = 0;
-
-		for (i = 0; i < n_seq; i++) {
-			if (!spa_pod_control_is_inside(&seq[i]->body,
-					SPA_POD_BODY_SIZE(seq[i]), ctrl[i]))
-				continue;
-
-			if (next == NULL || ctrl[i]->offset < next->offset) {
-				next = ctrl[i];
-				next_index = i;
-			}
+	if (n_seq == 1) {
+		/* only one input, pass its buffer on as is */
+		*outb->buffer = *inb->buffer;
+	} else {
+		/* a previous cycle might have passed on an input buffer */
+		*outb->buffer = outb->buf;
+		d = outb->buffer->datas;
+
+		/* prepare to write into output */
+		spa_pod_builder_init(&builder, d->data, d->maxsize);
+		spa_pod_builder_push_sequence(&builder, &f, 0);
+
+		/* merge sort all sequences into output buffer */
+		spa_control_merge_init(&merge, items, seq, n_seq);
+		while ((c = spa_control_merge_next(&merge)) != NULL) {
+			spa_pod_builder_control(&builder, c->offset, c->type);
+			spa_pod_builder_primitive(&builder, &c->value);
 		}
-		if (next == NULL)
-			break;
+		spa_pod_builder_pop(&builder, &f);
 
-		spa_pod_builder_control(&builder, next->offset, next->type);
-		spa_pod_builder_primitive(&builder, &next->value);
-
-		ctrl[next_index] = spa_pod_control_next(ctrl[next_index]);
+		d->chunk->offset = 0;
+		d->chunk->size = builder.state.offset;
+		d->chunk->stride = 1;
+		d->chunk->flags = 0;
 	}
-	spa_pod_builder_pop(&builder, &f);
-
-	d->chunk->offset = 0;
-	d->chunk->size = builder.state.offset;
-	d->chunk->stride = 1;
-	d->chunk->flags = 0;
 
 	outio->buffer_id = outb->id;
 	outio->status = SPA_STATUS_HAVE_DATA;
@@ -24,30 +24,52 @@
 
 #include <errno.h>
 #include <stddef.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
+#include <pthread.h>
 
 #include <spa/support/plugin.h>
 #include <spa/support/log.h>
 #include <spa/node/node.h>
 #include <spa/node/utils.h>
 #include <spa/node/io.h>
+#include <spa/buffer/meta.h>
+#include <spa/param/param.h>
 #include <spa/param/video/format-utils.h>
-#include <spa/param/video/format.h>
 #include <spa/pod/filter.h>
 
+#include <libavcodec/avcodec.h>
+#include <libavutil/common.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+
+#include "ffmpeg.h"
+
+#define NAME "ffmpeg-dec"
+
 #define IS_VALID_PORT(this,d,id)	((id) == 0)
 #define GET_IN_PORT(this,p)		(&this->in_ports[p])
 #define GET_OUT_PORT(this,p)		(&this->out_ports[p])
 #define GET_PORT(this,d,p)		(d == SPA_DIRECTION_INPUT ? GET_IN_PORT(this,p) : GET_OUT_PORT(this,p))
 
 #define MAX_BUFFERS    32
+#define MAX_PLANES     4
+
+#define BUFFER_ALIGN   64
+/* the largest STRIDE_ALIGN of libavcodec, the SIMD code can read this
+ * much past the end of a plane */
+#define STRIDE_ALIGN   64
+#define PLANE_PADDING  (16 + STRIDE_ALIGN - 1)
+
+#define BUFFER_FLAG_OUT	(1<<0)
+
+struct impl;
 
 struct buffer {
 	uint32_t id;
 	uint32_t flags;
+	int refs;			/**< planes referenced by the codec, protected by the lock */
+	struct impl *impl;
 	struct spa_buffer *outbuf;
+	struct spa_meta_header *h;
 	struct spa_list link;
 };
 
@@ -68,7 +90,6 @@ struct port {
 	struct spa_io_buffers *io;
 
 	struct spa_list free;
-	struct spa_list ready;
 };
 
 struct impl {
@@ -86,6 +107,17 @@ struct impl {
 	struct port in_ports[1];
 	struct port out_ports[1];
 
+	const AVCodec *codec;
+	AVCodecContext *context;
+	AVPacket *packet;
+	AVFrame *frame;
+	int thread_count;
+	int thread_type;
+
+	/* protects the free list of the output port, the codec threads
+	 * allocate and release frames */
+	pthread_mutex_t lock;
+
 	bool started;
 };
 
@@ -108,20 +140,234 @@ static int impl_node_set_io(void *object, uint32_t id, void *data, size_t size)
 	return -ENOTSUP;
 }
 
+static void release_buffer(void *opaque, uint8_t *data)
+{
+	struct buffer *b = opaque;
+	struct impl *this = b->impl;
+	struct port *port = GET_OUT_PORT(this, 0);
+
+	pthread_mutex_lock(&this->lock);
+	if (--b->refs == 0 && !SPA_FLAG_IS_SET(b->flags, BUFFER_FLAG_OUT))
+		spa_list_append(&port->free, &b->link);
+	pthread_mutex_unlock(&this->lock);
+}
+
+static void recycle_buffer(struct impl *this, struct port *port, uint32_t id)
+{
+	struct buffer *b = &port->buffers[id];
+
+	pthread_mutex_lock(&this->lock);
+	if (SPA_FLAG_IS_SET(b->flags, BUFFER_FLAG_OUT)) {
+		SPA_FLAG_CLEAR(b->flags, BUFFER_FLAG_OUT);
+		/* the codec might still use it as a reference frame */
+		if (b->refs == 0)
+			spa_list_append(&port->free, &b->link);
+		spa_log_trace_fp(this->log, NAME " %p: recycle buffer %d", this, id);
+	}
+	pthread_mutex_unlock(&this->lock);
+}
+
+static struct buffer *dequeue_buffer(struct impl *this, struct port *port)
+{
+	struct buffer *b = NULL;
+
+	pthread_mutex_lock(&this->lock);
+	if (!spa_list_is_empty(&port->free)) {
+		b = spa_list_first(&port->free, struct buffer, link);
+		spa_list_remove(&b->link);
+	}
+	pthread_mutex_unlock(&this->lock);
+	return b;
+}
+
+static int plane_height(enum AVPixelFormat pix_fmt, int plane, int height)
+{
+	const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(pix_fmt);
+
+	if (desc && (plane == 1 || plane == 2))
+		return AV_CEIL_RSHIFT(height, desc->log2_chroma_h);
+	return height;
+}
+
+/* get the strides and plane sizes of a frame of \a width and \a height
+ * like avcodec_default_get_buffer2() does: the width is grown until all
+ * strides are a multiple of \a linesize_align and each plane gets the
+ * padding the SIMD code needs. Returns the number of planes */
+static int get_layout(enum AVPixelFormat pix_fmt, int width, int height,
+		const int linesize_align[AV_NUM_DATA_POINTERS],
+		int linesizes[4], size_t sizes[4])
+{
+	int i, n_planes, unaligned;
+
+	n_planes = av_pix_fmt_count_planes(pix_fmt);
+	if (n_planes <= 0 || n_planes > MAX_PLANES || width <= 0)
+		return -EINVAL;
+	do {
+		if (av_image_fill_linesizes(linesizes, pix_fmt, width) < 0)
+			return -EINVAL;
+		/* grow by the lowest set bit, this keeps the alignment */
+		width += width & ~(width - 1);
+		unaligned = 0;
+		for (i = 0; i < n_planes; i++) {
+			if (linesize_align[i] > 0)
+				unaligned |= linesizes[i] % linesize_align[i];
+		}
+	} while (unaligned);
+
+	for (i = 0; i < n_planes; i++)
+		sizes[i] = (size_t)linesizes[i] * plane_height(pix_fmt, i, height)
+			+ PLANE_PADDING;
+	return n_planes;
+}
+
+/* decode directly into the buffers of the output port when the layout
+ * of the frame fits, the codec can keep them as reference frames */
+static int get_buffer2(AVCodecContext *context, AVFrame *frame, int flags)
+{
+	struct impl *this = context->opaque;
+	struct port *port = GET_OUT_PORT(this, 0);
+	struct spa_video_info_raw *raw = &port->current_format.info.raw;
+	struct spa_buffer *outb;
+	struct buffer *b;
+	int i, n_planes, w, h, linesize_align[AV_NUM_DATA_POINTERS];
+	size_t sizes[MAX_PLANES];
+
+	if (!(context->codec->capabilities & AV_CODEC_CAP_DR1) ||
+	    spa_ffmpeg_pix_fmt_to_format(frame->format) != raw->format)
+		goto fallback;
+
+	w = frame->width;
+	h = frame->height;
+	avcodec_align_dimensions2(context, &w, &h, linesize_align);
+
+	if ((n_planes = get_layout(frame->format, w, h, linesize_align,
+					frame->linesize, sizes)) < 0)
+		goto fallback;
+
+	if ((b = dequeue_buffer(this, port)) == NULL)
+		goto fallback;
+
+	outb = b->outbuf;
+	if ((int)outb->n_datas < n_planes)
+		goto fallback_recycle;
+	for (i = 0; i < n_planes; i++) {
+		if (sizes[i] > outb->datas[i].maxsize ||
+		    !SPA_IS_ALIGNED(outb->datas[i].data, BUFFER_ALIGN))
+			goto fallback_recycle;
+	}
+
+	b->refs = n_planes;
+	for (i = 0; i < n_planes; i++) {
+		frame->data[i] = outb->datas[i].data;
+		frame->buf[i] = av_buffer_create(frame->data[i], sizes[i],
+				release_buffer, b, 0);
+		if (frame->buf[i] == NULL) {
+			int j;
+			/* drop the refs of the planes we could not wrap, the
+			 * buffer goes back to the free list with the last one */
+			for (j = i; j < n_planes; j++)
+				release_buffer(b, NULL);
+			while (i-- > 0)
+				av_buffer_unref(&frame->buf[i]);
+			return AVERROR(ENOMEM);
+		}
+	}
+	frame->extended_data = frame->data;
+
+	return 0;
+
+fallback_recycle:
+	pthread_mutex_lock(&this->lock);
+	spa_list_prepend(&port->free, &b->link);
+	pthread_mutex_unlock(&this->lock);
+fallback:
+	spa_log_trace_fp(this->log, NAME " %p: fallback to default buffer", this);
+	return avcodec_default_get_buffer2(context, frame, flags);
+}
+
+static enum AVPixelFormat get_format(AVCodecContext *context, const enum AVPixelFormat *fmts)
+{
+	struct impl *this = context->opaque;
+	struct port *port = GET_OUT_PORT(this, 0);
+	const enum AVPixelFormat *f;
+
+	for (f = fmts; *f != AV_PIX_FMT_NONE; f++) {
+		if (spa_ffmpeg_pix_fmt_to_format(*f) == port->current_format.info.raw.format)
+			return *f;
+	}
+	return avcodec_default_get_format(context, fmts);
+}
+
+static void close_codec(struct impl *this)
+{
+	if (this->context == NULL)
+		return;
+	spa_log_debug(this->log, NAME " %p: close codec", this);
+	avcodec_free_context(&this->context);
+}
+
+static int open_codec(struct impl *this)
+{
+	struct port *inport = GET_IN_PORT(this, 0);
+	struct port *outport = GET_OUT_PORT(this, 0);
+	AVCodecContext *context;
+	int res;
+
+	if (this->context != NULL)
+		return 0;
+
+	if (!inport->have_format || !outport->have_format)
+		return -EIO;
+
+	if ((context = avcodec_alloc_context3(this->codec)) == NULL)
+		return -ENOMEM;
+
+	context->opaque = this;
+	context->width = outport->current_format.info.raw.size.width;
+	context->height = outport->current_format.info.raw.size.height;
+	context->pix_fmt = spa_ffmpeg_format_to_pix_fmt(outport->current_format.info.raw.format);
+	context->get_format = get_format;
+	context->get_buffer2 = get_buffer2;
+#if LIBAVCODEC_VERSION_MAJOR < 60
+	context->thread_safe_callbacks = 1;
+#endif
+	spa_ffmpeg_configure_threads(context, this->codec,
+			this->thread_count, this->thread_type);
+
+	if ((res = avcodec_open2(context, this->codec, NULL)) < 0) {
+		spa_log_error(this->log, NAME " %p: can't open codec %s: %d",
+				this, this->codec->name, res);
+		avcodec_free_context(&context);
+		return -EIO;
+	}
+	this->context = context;
+
+	spa_log_debug(this->log, NAME " %p: opened %s threads:%d type:%d", this,
+			this->codec->name, context->thread_count, context->thread_type);
+	return 0;
+}
+
 static int impl_node_send_command(void *object, const struct spa_command *command)
 {
 	struct impl *this = object;
+	int res;
 
 	if (this == NULL || command == NULL)
 		return -EINVAL;
 
 	switch (SPA_NODE_COMMAND_ID(command)) {
 	case SPA_NODE_COMMAND_Start:
+		if ((res = open_codec(this)) < 0)
+			return res;
 		this->started = true;
 		break;
 	case SPA_NODE_COMMAND_Pause:
 		this->started = false;
 		break;
+	case SPA_NODE_COMMAND_Flush:
+		if (this->context)
+			avcodec_flush_buffers(this->context);
+		break;
 	default:
 		return -ENOTSUP;
 	}
@@ -201,15 +447,28 @@ static int port_enum_formats(void *object,
 			     struct spa_pod **param,
 			     struct spa_pod_builder *builder)
 {
+	struct impl *this = object;
+	struct port *inport = GET_IN_PORT(this, 0);
+	struct spa_rectangle *size = NULL;
+	struct spa_fraction *framerate = NULL;
+
 	if (!IS_VALID_PORT(object, direction, port_id))
 		return -EINVAL;
 
-	switch (index) {
-	case 0:
-		*param = NULL;
-		break;
-	default:
+	if (index > 0)
 		return 0;
+
+	if (direction == SPA_DIRECTION_INPUT) {
+		*param = spa_ffmpeg_build_encoded_format(builder, SPA_PARAM_EnumFormat,
+				this->codec, NULL, NULL);
+	} else {
+		/* the output follows the size of the compressed input */
+		if (inport->have_format) {
+			size = &inport->current_format.info.mjpg.size;
+			framerate = &inport->current_format.info.mjpg.framerate;
+		}
+		*param = spa_ffmpeg_build_raw_format(builder, SPA_PARAM_EnumFormat,
+				this->codec, size, framerate);
 	}
 	return 1;
 }
@@ -232,8 +491,67 @@ static int port_get_format(void *object,
 	if (index > 0)
 		return 0;
 
-	*param = NULL;
+	if (direction == SPA_DIRECTION_INPUT)
+		*param = spa_ffmpeg_build_encoded_format(builder, SPA_PARAM_Format,
+				this->codec, &port->current_format.info.mjpg.size,
+				&port->current_format.info.mjpg.framerate);
+	else
+		*param = spa_format_video_raw_build(builder, SPA_PARAM_Format,
+				&port->current_format.info.raw);
+
+	return 1;
+}
+
+/* the planes of the output buffers are in separate blocks with the
+ * strides and padding of the codec so that we can decode into them */
+static int port_get_buffers(struct impl *this, struct port *port,
+		struct spa_pod **param, struct spa_pod_builder *builder)
+{
+	struct spa_video_info_raw *raw = &port->current_format.info.raw;
+	enum AVPixelFormat pix_fmt;
+	AVCodecContext *context;
+	int i, n_planes, w, h, linesize_align[AV_NUM_DATA_POINTERS], linesizes[4];
+	size_t sizes[4], size = 0;
+
+	if (port->direction == SPA_DIRECTION_INPUT) {
+		*param = spa_pod_builder_add_object(builder,
+			SPA_TYPE_OBJECT_ParamBuffers, SPA_PARAM_Buffers,
+			SPA_PARAM_BUFFERS_buffers, SPA_POD_CHOICE_RANGE_Int(4, 1, MAX_BUFFERS),
+			SPA_PARAM_BUFFERS_blocks,  SPA_POD_Int(1),
+			SPA_PARAM_BUFFERS_size,    SPA_POD_CHOICE_RANGE_Int(
+							512 * 1024, 4096, INT32_MAX),
+			SPA_PARAM_BUFFERS_stride,  SPA_POD_Int(0),
+			SPA_PARAM_BUFFERS_align,   SPA_POD_Int(16));
+		return 1;
+	}
 
+	pix_fmt = spa_ffmpeg_format_to_pix_fmt(raw->format);
+	if (pix_fmt == AV_PIX_FMT_NONE)
+		return -EINVAL;
+
+	if ((context = avcodec_alloc_context3(this->codec)) == NULL)
+		return -ENOMEM;
+	context->pix_fmt = pix_fmt;
+	w = raw->size.width;
+	h = raw->size.height;
+	avcodec_align_dimensions2(context, &w, &h, linesize_align);
+	avcodec_free_context(&context);
+
+	if ((n_planes = get_layout(pix_fmt, w, h, linesize_align, linesizes, sizes)) < 0)
+		return n_planes;
+	for (i = 0; i < n_planes; i++)
+		size = SPA_MAX(size, sizes[i]);
+
+	*param = spa_pod_builder_add_object(builder,
+		SPA_TYPE_OBJECT_ParamBuffers, SPA_PARAM_Buffers,
+		/* frame threading keeps one frame per thread in flight */
+		SPA_PARAM_BUFFERS_buffers, SPA_POD_CHOICE_RANGE_Int(
+						SPA_MIN(16 + this->thread_count, MAX_BUFFERS),
+						8, MAX_BUFFERS),
+		SPA_PARAM_BUFFERS_blocks,  SPA_POD_Int(n_planes),
+		SPA_PARAM_BUFFERS_size,    SPA_POD_Int(size),
+		SPA_PARAM_BUFFERS_stride,  SPA_POD_Int(linesizes[0]),
+		SPA_PARAM_BUFFERS_align,   SPA_POD_Int(BUFFER_ALIGN));
 	return 1;
 }
 
@@ -248,9 +566,16 @@ impl_node_port_enum_params(void *object, int seq,
 	uint8_t buffer[1024];
 	struct spa_pod *param;
 	struct spa_result_node_params result;
+	struct port *port;
 	uint32_t count = 0;
 	int res;
 
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+	spa_return_val_if_fail(num != 0, -EINVAL);
+	spa_return_val_if_fail(IS_VALID_PORT(this, direction, port_id), -EINVAL);
+
+	port = GET_PORT(this, direction, port_id);
+
 	result.id = id;
 	result.next = start;
       next:
@@ -271,6 +596,41 @@ impl_node_port_enum_params(void *object, int seq,
 			return res;
 		break;
 
+	case SPA_PARAM_Buffers:
+		if (!port->have_format)
+			return -EIO;
+		if (result.index > 0)
+			return 0;
+		if ((res = port_get_buffers(this, port, &param, &b)) <= 0)
+			return res;
+		break;
+
+	case SPA_PARAM_Meta:
+		switch (result.index) {
+		case 0:
+			param = spa_pod_builder_add_object(&b,
+				SPA_TYPE_OBJECT_ParamMeta, id,
+				SPA_PARAM_META_type, SPA_POD_Id(SPA_META_Header),
+				SPA_PARAM_META_size, SPA_POD_Int(sizeof(struct spa_meta_header)));
+			break;
+		default:
+			return 0;
+		}
+		break;
+
+	case SPA_PARAM_IO:
+		switch (result.index) {
+		case 0:
+			param = spa_pod_builder_add_object(&b,
+				SPA_TYPE_OBJECT_ParamIO, id,
+				SPA_PARAM_IO_id,   SPA_POD_Id(SPA_IO_Buffers),
+				SPA_PARAM_IO_size, SPA_POD_Int(sizeof(struct spa_io_buffers)));
+			break;
+		default:
+			return 0;
+		}
+		break;
+
 	default:
 		return -ENOENT;
 	}
@@ -286,6 +646,19 @@ impl_node_port_enum_params(void *object, int seq,
 	return 0;
 }
 
+static int clear_buffers(struct impl *this, struct port *port)
+{
+	if (port->n_buffers > 0) {
+		spa_log_debug(this->log, NAME " %p: clear buffers", this);
+		/* the codec must drop its references to our buffers */
+		if (port->direction == SPA_DIRECTION_OUTPUT)
+			close_codec(this);
+		port->n_buffers = 0;
+		spa_list_init(&port->free);
+	}
+	return 0;
+}
+
 static int port_set_format(void *object,
 			   enum spa_direction direction, uint32_t port_id,
 			   uint32_t flags,
@@ -295,7 +668,7 @@ static int port_set_format(void *object,
 	struct port *port;
 	int res;
 
-	if (this == NULL || format == NULL)
+	if (this == NULL)
 		return -EINVAL;
 
 	if (!IS_VALID_PORT(this, direction, port_id))
@@ -304,25 +677,46 @@ static int port_set_format(void *object,
 	port = GET_PORT(this, direction, port_id);
 
 	if (format == NULL) {
+		close_codec(this);
+		clear_buffers(this, port);
 		port->have_format = false;
 	} else {
 		struct spa_video_info info = { 0 };
 
-		if ((res = spa_format_parse(format, &info.media_type, &info.media_subtype)) < 0)
+		if ((res = spa_ffmpeg_parse_format(format,
+				direction == SPA_DIRECTION_INPUT ?
+					spa_ffmpeg_codec_to_media_subtype(this->codec->id) :
+					SPA_MEDIA_SUBTYPE_raw, &info)) < 0)
 			return res;
 
-		if (info.media_type != SPA_MEDIA_TYPE_video &&
-		    info.media_subtype != SPA_MEDIA_SUBTYPE_raw)
-			return -EINVAL;
-
-		if (spa_format_video_raw_parse(format, &info.info.raw) < 0)
+		if (direction == SPA_DIRECTION_OUTPUT &&
+		    spa_ffmpeg_format_to_pix_fmt(info.info.raw.format) == AV_PIX_FMT_NONE)
 			return -EINVAL;
 
 		if (!(flags & SPA_NODE_PARAM_FLAG_TEST_ONLY)) {
+			close_codec(this);
 			port->current_format = info;
 			port->have_format = true;
 		}
 	}
+
+	port->info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
+	if (port->have_format) {
+		port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_READWRITE);
+		port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, SPA_PARAM_INFO_READ);
+	} else {
+		port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
+		port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, 0);
+	}
+	emit_port_info(this, port, false);
+
+	if (direction == SPA_DIRECTION_INPUT) {
+		/* the output formats follow the input */
+		port = GET_OUT_PORT(this, 0);
+		port->info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
+		port->params[0].flags ^= SPA_PARAM_INFO_SERIAL;
+		emit_port_info(this, port, false);
+	}
 	return 0;
 }
 
@@ -347,13 +741,48 @@ impl_node_port_use_buffers(void *object,
 				     struct spa_buffer **buffers,
 				     uint32_t n_buffers)
 {
-	if (object == NULL)
+	struct impl *this = object;
+	struct port *port;
+	uint32_t i, j;
+
+	if (this == NULL)
 		return -EINVAL;
 
-	if (!IS_VALID_PORT(object, direction, port_id))
+	if (!IS_VALID_PORT(this, direction, port_id))
 		return -EINVAL;
 
-	return -ENOTSUP;
+	port = GET_PORT(this, direction, port_id);
+
+	if (!port->have_format)
+		return -EIO;
+
+	if (n_buffers > MAX_BUFFERS)
+		return -ENOSPC;
+
+	clear_buffers(this, port);
+
+	for (i = 0; i < n_buffers; i++) {
+		struct buffer *b = &port->buffers[i];
+
+		b->id = i;
+		b->flags = 0;
+		b->refs = 0;
+		b->impl = this;
+		b->outbuf = buffers[i];
+		b->h = spa_buffer_find_meta_data(buffers[i], SPA_META_Header, sizeof(*b->h));
+
+		for (j = 0; j < buffers[i]->n_datas; j++) {
+			if (buffers[i]->datas[j].data == NULL) {
+				spa_log_error(this->log, NAME " %p: need mapped memory", this);
+				return -EINVAL;
+			}
+		}
+		if (direction == SPA_DIRECTION_OUTPUT)
+			spa_list_append(&port->free, &b->link);
+	}
+	port->n_buffers = n_buffers;
+
+	return 0;
 }
 
 static int
@@ -382,39 +811,199 @@ impl_node_port_set_io(void *object,
 	return 0;
 }
 
+static int send_packet(struct impl *this, struct spa_io_buffers *inio)
+{
+	struct port *port = GET_IN_PORT(this, 0);
+	struct buffer *b;
+	struct spa_data *d;
+	uint32_t offs, size;
+	int res;
+
+	if (inio->buffer_id >= port->n_buffers)
+		return -EINVAL;
+
+	b = &port->buffers[inio->buffer_id];
+	d = &b->outbuf->datas[0];
+
+	offs = SPA_MIN(d->chunk->offset, d->maxsize);
+	size = SPA_MIN(d->chunk->size, d->maxsize - offs);
+
+	this->packet->data = SPA_MEMBER(d->data, offs, uint8_t);
+	this->packet->size = size;
+	this->packet->pts = b->h ? b->h->pts : AV_NOPTS_VALUE;
+	this->packet->dts = b->h ? b->h->dts_offset + b->h->pts : AV_NOPTS_VALUE;
+
+	/* the packet is not refcounted, the codec copies what it needs */
+	res = avcodec_send_packet(this->context, this->packet);
+
+	this->packet->data = NULL;
+	this->packet->size = 0;
+
+	return res;
+}
+
+/* the frame is either in one of our buffers or the codec could not use
+ * them and we need to copy. We also copy when the codec outputs a
+ * reference frame again while its buffer is still out. */
+static struct buffer *frame_buffer(struct impl *this, struct port *port, AVFrame *frame)
+{
+	struct buffer *b;
+	void *opaque;
+	int i, n_planes;
+
+	opaque = frame->buf[0] ? av_buffer_get_opaque(frame->buf[0]) : NULL;
+	if ((uintptr_t)opaque >= (uintptr_t)&port->buffers[0] &&
+	    (uintptr_t)opaque < (uintptr_t)&port->buffers[port->n_buffers]) {
+		b = opaque;
+		if (frame->data[0] == b->outbuf->datas[0].data &&
+		    !SPA_FLAG_IS_SET(b->flags, BUFFER_FLAG_OUT))
+			return b;
+	}
+
+	if ((b = dequeue_buffer(this, port)) == NULL)
+		return NULL;
+
+	n_planes = av_pix_fmt_count_planes(frame->format);
+	for (i = 0; i < n_planes && i < (int)b->outbuf->n_datas; i++) {
+		struct spa_data *d = &b->outbuf->datas[i];
+		int stride = frame->linesize[i];
+		int height = plane_height(frame->format, i, frame->height);
+
+		if ((uint32_t)(stride * height) > d->maxsize)
+			height = d->maxsize / stride;
+		av_image_copy_plane(d->data, stride, frame->data[i], frame->linesize[i],
+				SPA_MIN(stride, frame->linesize[i]), height);
+	}
+	spa_log_trace_fp(this->log, NAME " %p: copied frame into %d", this, b->id);
+	return b;
+}
+
+static int receive_frame(struct impl *this, struct spa_io_buffers *outio)
+{
+	struct port *port = GET_OUT_PORT(this, 0);
+	struct spa_video_info_raw *raw = &port->current_format.info.raw;
+	struct buffer *b;
+	struct spa_buffer *outb;
+	int res, i, n_planes, height;
+
+	if ((res = avcodec_receive_frame(this->context, this->frame)) < 0)
+		return res;
+
+	if (spa_ffmpeg_pix_fmt_to_format(this->frame->format) != raw->format) {
+		spa_log_error(this->log, NAME " %p: decoder produced format %s",
+				this, av_get_pix_fmt_name(this->frame->format));
+		av_frame_unref(this->frame);
+		return -ENOTSUP;
+	}
+
+	if ((b = frame_buffer(this, port, this->frame)) == NULL) {
+		spa_log_warn(this->log, NAME " %p: out of buffers", this);
+		av_frame_unref(this->frame);
+		return -EPIPE;
+	}
+
+	outb = b->outbuf;
+	n_planes = av_pix_fmt_count_planes(this->frame->format);
+	for (i = 0; i < (int)outb->n_datas; i++) {
+		struct spa_chunk *c = outb->datas[i].chunk;
+
+		height = plane_height(this->frame->format, i, this->frame->height);
+
+		c->offset = 0;
+		c->stride = i < n_planes ? this->frame->linesize[i] : 0;
+		c->size = i < n_planes ? SPA_MIN(c->stride * height, (int)outb->datas[i].maxsize) : 0;
+	}
+	if (b->h) {
+		b->h->pts = this->frame->best_effort_timestamp;
+		b->h->dts_offset = 0;
+		b->h->flags = 0;
+	}
+
+	pthread_mutex_lock(&this->lock);
+	SPA_FLAG_SET(b->flags, BUFFER_FLAG_OUT);
+	pthread_mutex_unlock(&this->lock);
+
+	/* drops our references, the codec keeps the buffer when it is a
+	 * reference frame and it goes back to the free list when both the
+	 * codec and the consumer are done with it */
+	av_frame_unref(this->frame);
+
+	outio->buffer_id = b->id;
+	outio->status = SPA_STATUS_HAVE_DATA;
+
+	return 0;
+}
+
 static int impl_node_process(void *object)
 {
 	struct impl *this = object;
-	struct port *port;
-	struct spa_io_buffers *output;
+	struct port *inport, *outport;
+	struct spa_io_buffers *inio, *outio;
+	int res;
 
 	if (this == NULL)
 		return -EINVAL;
 
-	port = &this->out_ports[0];
+	inport = GET_IN_PORT(this, 0);
+	outport = GET_OUT_PORT(this, 0);
 
-	if ((output = port->io) == NULL)
+	if ((outio = outport->io) == NULL || (inio = inport->io) == NULL)
 		return -EIO;
 
-	if (!port->have_format) {
-		output->status = -EIO;
+	if (!outport->have_format || this->context == NULL) {
+		outio->status = -EIO;
 		return -EIO;
 	}
-	output->status = SPA_STATUS_OK;
 
-	return SPA_STATUS_OK;
+	if (outio->status == SPA_STATUS_HAVE_DATA)
+		return SPA_STATUS_HAVE_DATA;
+
+	if (outio->buffer_id < outport->n_buffers) {
+		recycle_buffer(this, outport, outio->buffer_id);
+		outio->buffer_id = SPA_ID_INVALID;
+	}
+
+	if (inio->status == SPA_STATUS_HAVE_DATA) {
+		res = send_packet(this, inio);
+		if (res == AVERROR(EAGAIN)) {
+			/* the codec is full, keep the packet until a frame is out */
+			spa_log_trace_fp(this->log, NAME " %p: codec full", this);
+		} else {
+			if (res < 0)
+				spa_log_warn(this->log, NAME " %p: decode error %d", this, res);
+			inio->status = SPA_STATUS_NEED_DATA;
+		}
+	}
+
+	res = receive_frame(this, outio);
+	if (res == AVERROR(EAGAIN))
+		return inio->status;
+	if (res < 0)
+		return outio->status = res == AVERROR_EOF ? SPA_STATUS_OK : res;
+
+	return inio->status | SPA_STATUS_HAVE_DATA;
 }
 
 static int
 impl_node_port_reuse_buffer(void *object, uint32_t port_id, uint32_t buffer_id)
 {
-	if (object == NULL)
+	struct impl *this = object;
+	struct port *port;
+
+	if (this == NULL)
 		return -EINVAL;
 
 	if (port_id != 0)
 		return -EINVAL;
 
-	return -ENOTSUP;
+	port = GET_OUT_PORT(this, port_id);
+
+	if (buffer_id >= port->n_buffers)
+		return -EINVAL;
+
+	recycle_buffer(this, port, buffer_id);
+
+	return 0;
 }
 
 static const struct spa_node_methods impl_node = {
@@ -453,20 +1042,71 @@ impl_get_interface(struct spa_handle *handle, const char *type, void **interface
 	return 0;
 }
 
+static int impl_clear(struct spa_handle *handle)
+{
+	struct impl *this;
+
+	if (handle == NULL)
+		return -EINVAL;
+
+	this = (struct impl *) handle;
+
+	close_codec(this);
+	av_packet_free(&this->packet);
+	av_frame_free(&this->frame);
+	pthread_mutex_destroy(&this->lock);
+
+	return 0;
+}
+
+size_t spa_ffmpeg_dec_get_size(void)
+{
+	return sizeof(struct impl);
+}
+
+static void init_port(struct port *port, enum spa_direction direction)
+{
+	port->direction = direction;
+	port->id = 0;
+	port->info_all = SPA_PORT_CHANGE_MASK_FLAGS |
+			SPA_PORT_CHANGE_MASK_PARAMS;
+	port->info = SPA_PORT_INFO_INIT();
+	port->info.flags = direction == SPA_DIRECTION_OUTPUT ? SPA_PORT_FLAG_NO_REF : 0;
+	port->params[0] = SPA_PARAM_INFO(SPA_PARAM_EnumFormat, SPA_PARAM_INFO_READ);
+	port->params[1] = SPA_PARAM_INFO(SPA_PARAM_Meta, SPA_PARAM_INFO_READ);
+	port->params[2] = SPA_PARAM_INFO(SPA_PARAM_IO, SPA_PARAM_INFO_READ);
+	port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
+	port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, 0);
+	port->info.params = port->params;
+	port->info.n_params = 5;
+	spa_list_init(&port->free);
+}
+
 int
 spa_ffmpeg_dec_init(struct spa_handle *handle,
 		    const struct spa_dict *info,
 		    const struct spa_support *support,
-		    uint32_t n_support)
+		    uint32_t n_support,
+		    const AVCodec *codec)
 {
 	struct impl *this;
-	struct port *port;
 
 	handle->get_interface = impl_get_interface;
+	handle->clear = impl_clear;
 
 	this = (struct impl *) handle;
 
 	this->log = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_Log);
+	this->codec = codec;
+
+	spa_ffmpeg_parse_threads(info, &this->thread_count, &this->thread_type);
+
+	if ((this->packet = av_packet_alloc()) == NULL ||
+	    (this->frame = av_frame_alloc()) == NULL) {
+		av_packet_free(&this->packet);
+		return -ENOMEM;
+	}
+	pthread_mutex_init(&this->lock, NULL);
 
 	spa_hook_list_init(&this->hooks);
 
@@ -481,29 +1121,11 @@ spa_ffmpeg_dec_init(struct spa_handle *handle,
 	this->info.flags = SPA_NODE_FLAG_RT;
 	this->info.params = this->params;
 
-	port = GET_IN_PORT(this, 0);
-	port->direction = SPA_DIRECTION_INPUT;
-	port->id = 0;
-	port->info_all = SPA_PORT_CHANGE_MASK_FLAGS |
-			SPA_PORT_CHANGE_MASK_PARAMS;
-	port->info = SPA_PORT_INFO_INIT();
-	port->info.flags = 0;
-	port->params[0] = SPA_PARAM_INFO(SPA_PARAM_EnumFormat, SPA_PARAM_INFO_READ);
-	port->params[1] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
-	port->info.params = port->params;
-	port->info.n_params = 2;
+	init_port(GET_IN_PORT(this, 0), SPA_DIRECTION_INPUT);
+	init_port(GET_OUT_PORT(this, 0), SPA_DIRECTION_OUTPUT);
 
-	port = GET_OUT_PORT(this, 0);
-	port->direction = SPA_DIRECTION_OUTPUT;
-	port->id = 0;
-	port->info_all = SPA_PORT_CHANGE_MASK_FLAGS |
-			SPA_PORT_CHANGE_MASK_PARAMS;
-	port->info = SPA_PORT_INFO_INIT();
-	port->info.flags = 0;
-	port->params[0] = SPA_PARAM_INFO(SPA_PARAM_EnumFormat, SPA_PARAM_INFO_READ);
-	port->params[1] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
-	port->info.params = port->params;
-	port->info.n_params = 2;
+	spa_log_debug(this->log, NAME " %p: %s threads:%d type:%d", this,
+			codec->name, this->thread_count, this->thread_type);
 
 	return 0;
 }
@@ -24,18 +24,25 @@
 
 #include <errno.h>
 #include <stddef.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
 
 #include <spa/support/plugin.h>
 #include <spa/support/log.h>
 #include <spa/node/node.h>
 #include <spa/node/utils.h>
 #include <spa/node/io.h>
+#include <spa/buffer/meta.h>
+#include <spa/param/param.h>
 #include <spa/param/video/format-utils.h>
 #include <spa/pod/filter.h>
 
+#include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+
+#include "ffmpeg.h"
+
+#define NAME "ffmpeg-enc"
+
 #define IS_VALID_PORT(this,d,id)	((id) == 0)
 #define GET_IN_PORT(this,p)		(&this->in_ports[p])
 #define GET_OUT_PORT(this,p)		(&this->out_ports[p])
@@ -43,10 +50,17 @@
 
 #define MAX_BUFFERS    32
 
+/* the worst case size of a coded 16x16 macroblock, libavcodec allocates
+ * the packets of the intra codecs with this */
+#define MAX_MB_BYTES   (30 * 16 * 16 * 3 / 8 + 120)
+
+#define BUFFER_FLAG_OUT	(1<<0)
+
 struct buffer {
 	uint32_t id;
 	uint32_t flags;
 	struct spa_buffer *outbuf;
+	struct spa_meta_header *h;
 	struct spa_list link;
 };
 
@@ -67,7 +81,6 @@ struct port {
 	struct spa_io_buffers *io;
 
 	struct spa_list free;
-	struct spa_list ready;
 };
 
 struct impl {
@@ -85,6 +98,13 @@ struct impl {
 	struct port in_ports[1];
 	struct port out_ports[1];
 
+	const AVCodec *codec;
+	AVCodecContext *context;
+	AVPacket *packet;
+	AVFrame *frame;
+	int thread_count;
+	int thread_type;
+
 	bool started;
 };
 
@@ -106,20 +126,77 @@ static int impl_node_set_io(void *object, uint32_t id, void *data, size_t size)
 	return -ENOTSUP;
 }
 
+static void close_codec(struct impl *this)
+{
+	if (this->context == NULL)
+		return;
+	spa_log_debug(this->log, NAME " %p: close codec", this);
+	avcodec_free_context(&this->context);
+}
+
+static int open_codec(struct impl *this)
+{
+	struct port *inport = GET_IN_PORT(this, 0);
+	struct port *outport = GET_OUT_PORT(this, 0);
+	struct spa_video_info_raw *raw = &inport->current_format.info.raw;
+	AVCodecContext *context;
+	int res;
+
+	if (this->context != NULL)
+		return 0;
+
+	if (!inport->have_format || !outport->have_format)
+		return -EIO;
+
+	if ((context = avcodec_alloc_context3(this->codec)) == NULL)
+		return -ENOMEM;
+
+	context->width = raw->size.width;
+	context->height = raw->size.height;
+	context->pix_fmt = spa_ffmpeg_format_to_pix_fmt(raw->format);
+	if (raw->framerate.num && raw->framerate.denom) {
+		context->framerate = (AVRational) { raw->framerate.num, raw->framerate.denom };
+		context->time_base = (AVRational) { raw->framerate.denom, raw->framerate.num };
+	} else {
+		context->time_base = (AVRational) { 1, 25 };
+	}
+	spa_ffmpeg_configure_threads(context, this->codec,
+			this->thread_count, this->thread_type);
+
+	if ((res = avcodec_open2(context, this->codec, NULL)) < 0) {
+		spa_log_error(this->log, NAME " %p: can't open codec %s: %d",
+				this, this->codec->name, res);
+		avcodec_free_context(&context);
+		return -EIO;
+	}
+	this->context = context;
+
+	spa_log_debug(this->log, NAME " %p: opened %s threads:%d type:%d", this,
+			this->codec->name, context->thread_count, context->thread_type);
+	return 0;
+}
+
 static int impl_node_send_command(void *object, const struct spa_command *command)
 {
 	struct impl *this = object;
+	int res;
 
 	if (this == NULL || command == NULL)
 		return -EINVAL;
 
 	switch (SPA_NODE_COMMAND_ID(command)) {
 	case SPA_NODE_COMMAND_Start:
+		if ((res = open_codec(this)) < 0)
+			return res;
 		this->started = true;
 		break;
 	case SPA_NODE_COMMAND_Pause:
 		this->started = false;
 		break;
+	case SPA_NODE_COMMAND_Flush:
+		if (this->context)
+			avcodec_flush_buffers(this->context);
+		break;
 	default:
 		return -ENOTSUP;
 	}
@@ -186,7 +263,8 @@ impl_node_add_port(void *object, enum spa_direction direction, uint32_t port_id,
 
 static int
 impl_node_remove_port(void *object,
-				enum spa_direction direction, uint32_t port_id)
+				enum spa_direction direction,
+				uint32_t port_id)
 {
 	return -ENOTSUP;
 }
@@ -198,7 +276,28 @@ static int port_enum_formats(void *object,
 			struct spa_pod **param,
 			struct spa_pod_builder *builder)
 {
-	return -ENOTSUP;
+	struct impl *this = object;
+	struct port *inport = GET_IN_PORT(this, 0);
+
+	if (!IS_VALID_PORT(object, direction, port_id))
+		return -EINVAL;
+
+	if (index > 0)
+		return 0;
+
+	if (direction == SPA_DIRECTION_INPUT) {
+		*param = spa_ffmpeg_build_raw_format(builder, SPA_PARAM_EnumFormat,
+				this->codec, NULL, NULL);
+	} else if (inport->have_format) {
+		/* encode with the size of the raw input */
+		*param = spa_ffmpeg_build_encoded_format(builder, SPA_PARAM_EnumFormat,
+				this->codec, &inport->current_format.info.raw.size,
+				&inport->current_format.info.raw.framerate);
+	} else {
+		*param = spa_ffmpeg_build_encoded_format(builder, SPA_PARAM_EnumFormat,
+				this->codec, NULL, NULL);
+	}
+	return 1;
 }
 
 static int port_get_format(void *object,
@@ -219,8 +318,56 @@ static int port_get_format(void *object,
 	if (index > 0)
 		return 0;
 
-	*param = NULL;
+	if (direction == SPA_DIRECTION_INPUT)
+		*param = spa_format_video_raw_build(builder, SPA_PARAM_Format,
+				&port->current_format.info.raw);
+	else
+		*param = spa_ffmpeg_build_encoded_format(builder, SPA_PARAM_Format,
+				this->codec, &port->current_format.info.mjpg.size,
+				&port->current_format.info.mjpg.framerate);
+
+	return 1;
+}
+
+static int port_get_buffers(struct impl *this, struct port *port,
+		struct spa_pod **param, struct spa_pod_builder *builder)
+{
+	struct spa_video_info_raw *raw = &GET_IN_PORT(this, 0)->current_format.info.raw;
+	enum AVPixelFormat pix_fmt;
+	int size, linesizes[4];
+
+	pix_fmt = spa_ffmpeg_format_to_pix_fmt(raw->format);
+	if (pix_fmt == AV_PIX_FMT_NONE)
+		return -EIO;
+
+	size = av_image_get_buffer_size(pix_fmt, raw->size.width, raw->size.height, 1);
+	if (size < 0 || av_image_fill_linesizes(linesizes, pix_fmt, raw->size.width) < 0)
+		return -EINVAL;
 
+	if (port->direction == SPA_DIRECTION_INPUT) {
+		*param = spa_pod_builder_add_object(builder,
+			SPA_TYPE_OBJECT_ParamBuffers, SPA_PARAM_Buffers,
+			SPA_PARAM_BUFFERS_buffers, SPA_POD_CHOICE_RANGE_Int(4, 1, MAX_BUFFERS),
+			SPA_PARAM_BUFFERS_blocks,  SPA_POD_Int(1),
+			SPA_PARAM_BUFFERS_size,    SPA_POD_Int(size),
+			SPA_PARAM_BUFFERS_stride,  SPA_POD_Int(linesizes[0]),
+			SPA_PARAM_BUFFERS_align,   SPA_POD_Int(16));
+	} else {
+		/* room for the largest packet the codec can make, packets
+		 * that still don't fit are dropped */
+		int64_t mbs = (int64_t)((raw->size.width + 15) / 16) * ((raw->size.height + 15) / 16);
+		int64_t max_size = mbs * MAX_MB_BYTES + AV_INPUT_BUFFER_MIN_SIZE;
+
+		size = SPA_MAX(size, (int)SPA_MIN(max_size, (int64_t)INT32_MAX));
+
+		*param = spa_pod_builder_add_object(builder,
+			SPA_TYPE_OBJECT_ParamBuffers, SPA_PARAM_Buffers,
+			SPA_PARAM_BUFFERS_buffers, SPA_POD_CHOICE_RANGE_Int(4, 1, MAX_BUFFERS),
+			SPA_PARAM_BUFFERS_blocks,  SPA_POD_Int(1),
+			SPA_PARAM_BUFFERS_size,    SPA_POD_Int(size),
+			SPA_PARAM_BUFFERS_stride,  SPA_POD_Int(0),
+			SPA_PARAM_BUFFERS_align,   SPA_POD_Int(16));
+	}
 	return 1;
 }
 
@@ -235,9 +382,16 @@ impl_node_port_enum_params(void *object, int seq,
 	uint8_t buffer[1024];
 	struct spa_pod *param;
 	struct spa_result_node_params result;
+	struct port *port;
 	uint32_t count = 0;
 	int res;
 
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+	spa_return_val_if_fail(num != 0, -EINVAL);
+	spa_return_val_if_fail(IS_VALID_PORT(this, direction, port_id), -EINVAL);
+
+	port = GET_PORT(this, direction, port_id);
+
 	result.id = id;
 	result.next = start;
       next:
@@ -258,6 +412,41 @@ impl_node_port_enum_params(void *object, int seq,
 			return res;
 		break;
 
+	case SPA_PARAM_Buffers:
+		if (!port->have_format)
+			return -EIO;
+		if (result.index > 0)
+			return 0;
+		if ((res = port_get_buffers(this, port, &param, &b)) <= 0)
+			return res;
+		break;
+
+	case SPA_PARAM_Meta:
+		switch (result.index) {
+		case 0:
+			param = spa_pod_builder_add_object(&b,
+				SPA_TYPE_OBJECT_ParamMeta, id,
+				SPA_PARAM_META_type, SPA_POD_Id(SPA_META_Header),
+				SPA_PARAM_META_size, SPA_POD_Int(sizeof(struct spa_meta_header)));
+			break;
+		default:
+			return 0;
+		}
+		break;
+
+	case SPA_PARAM_IO:
+		switch (result.index) {
+		case 0:
+			param = spa_pod_builder_add_object(&b,
+				SPA_TYPE_OBJECT_ParamIO, id,
+				SPA_PARAM_IO_id,   SPA_POD_Id(SPA_IO_Buffers),
+				SPA_PARAM_IO_size, SPA_POD_Int(sizeof(struct spa_io_buffers)));
+			break;
+		default:
+			return 0;
+		}
+		break;
+
 	default:
 		return -ENOENT;
 	}
@@ -273,6 +462,16 @@ impl_node_port_enum_params(void *object, int seq,
 	return 0;
 }
 
+static int clear_buffers(struct impl *this, struct port *port)
+{
+	if (port->n_buffers > 0) {
+		spa_log_debug(this->log, NAME " %p: clear buffers", this);
+		port->n_buffers = 0;
+		spa_list_init(&port->free);
+	}
+	return 0;
+}
+
 static int port_set_format(void *object,
 			   enum spa_direction direction, uint32_t port_id,
 			   uint32_t flags, const struct spa_pod *format)
@@ -281,36 +480,64 @@ static int port_set_format(void *object,
 	struct port *port;
 	int res;
 
+	if (this == NULL)
+		return -EINVAL;
+
+	if (!IS_VALID_PORT(this, direction, port_id))
+		return -EINVAL;
+
 	port = GET_PORT(this, direction, port_id);
 
 	if (format == NULL) {
+		close_codec(this);
+		clear_buffers(this, port);
 		port->have_format = false;
 	} else {
 		struct spa_video_info info = { 0 };
 
-		if ((res = spa_format_parse(format, &info.media_type, &info.media_subtype)) < 0)
+		if ((res = spa_ffmpeg_parse_format(format,
+				direction == SPA_DIRECTION_INPUT ?
+					SPA_MEDIA_SUBTYPE_raw :
+					spa_ffmpeg_codec_to_media_subtype(this->codec->id),
+				&info)) < 0)
 			return res;
 
-		if (info.media_type != SPA_MEDIA_TYPE_video &&
-		    info.media_subtype != SPA_MEDIA_SUBTYPE_raw)
-			return -EINVAL;
-
-		if (spa_format_video_raw_parse(format, &info.info.raw) < 0)
+		if (direction == SPA_DIRECTION_INPUT &&
+		    spa_ffmpeg_format_to_pix_fmt(info.info.raw.format) == AV_PIX_FMT_NONE)
 			return -EINVAL;
 
 		if (!(flags & SPA_NODE_PARAM_FLAG_TEST_ONLY)) {
+			close_codec(this);
 			port->current_format = info;
 			port->have_format = true;
 		}
 	}
+
+	port->info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
+	if (port->have_format) {
+		port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_READWRITE);
+		port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, SPA_PARAM_INFO_READ);
+	} else {
+		port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
+		port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, 0);
+	}
+	emit_port_info(this, port, false);
+
+	if (direction == SPA_DIRECTION_INPUT) {
+		/* the output formats follow the input */
+		port = GET_OUT_PORT(this, 0);
+		port->info.change_mask |= SPA_PORT_CHANGE_MASK_PARAMS;
+		port->params[0].flags ^= SPA_PARAM_INFO_SERIAL;
+		emit_port_info(this, port, false);
+	}
 	return 0;
 }
 
 static int
 impl_node_port_set_param(void *object,
-				   enum spa_direction direction, uint32_t port_id,
-				   uint32_t id, uint32_t flags,
-				   const struct spa_pod *param)
+			 enum spa_direction direction, uint32_t port_id,
+			 uint32_t id, uint32_t flags,
+			 const struct spa_pod *param)
 {
 	if (id == SPA_PARAM_Format) {
 		return port_set_format(object, direction, port_id, flags, param);
@@ -326,13 +553,44 @@ impl_node_port_use_buffers(void *object,
 				     uint32_t flags,
 				     struct spa_buffer **buffers, uint32_t n_buffers)
 {
-	if (object == NULL)
+	struct impl *this = object;
+	struct port *port;
+	uint32_t i;
+
+	if (this == NULL)
 		return -EINVAL;
 
-	if (!IS_VALID_PORT(object, direction, port_id))
+	if (!IS_VALID_PORT(this, direction, port_id))
 		return -EINVAL;
 
-	return -ENOTSUP;
+	port = GET_PORT(this, direction, port_id);
+
+	if (!port->have_format)
+		return -EIO;
+
+	if (n_buffers > MAX_BUFFERS)
+		return -ENOSPC;
+
+	clear_buffers(this, port);
+
+	for (i = 0; i < n_buffers; i++) {
+		struct buffer *b = &port->buffers[i];
+
+		b->id = i;
+		b->flags = 0;
+		b->outbuf = buffers[i];
+		b->h = spa_buffer_find_meta_data(buffers[i], SPA_META_Header, sizeof(*b->h));
+
+		if (buffers[i]->n_datas == 0 || buffers[i]->datas[0].data == NULL) {
+			spa_log_error(this->log, NAME " %p: need mapped memory", this);
+			return -EINVAL;
+		}
+		if (direction == SPA_DIRECTION_OUTPUT)
+			spa_list_append(&port->free, &b->link);
+	}
+	port->n_buffers = n_buffers;
+
+	return 0;
 }
 
 static int
@@ -361,39 +619,195 @@ impl_node_port_set_io(void *object,
 	return 0;
 }
 
+static void recycle_buffer(struct impl *this, struct port *port, uint32_t id)
+{
+	struct buffer *b = &port->buffers[id];
+
+	if (SPA_FLAG_IS_SET(b->flags, BUFFER_FLAG_OUT)) {
+		spa_list_append(&port->free, &b->link);
+		SPA_FLAG_CLEAR(b->flags, BUFFER_FLAG_OUT);
+		spa_log_trace_fp(this->log, NAME " %p: recycle buffer %d", this, id);
+	}
+}
+
+static inline struct buffer *dequeue_buffer(struct impl *this, struct port *port)
+{
+	struct buffer *b;
+
+	if (spa_list_is_empty(&port->free))
+		return NULL;
+	b = spa_list_first(&port->free, struct buffer, link);
+	spa_list_remove(&b->link);
+	SPA_FLAG_SET(b->flags, BUFFER_FLAG_OUT);
+	return b;
+}
+
 static int
 impl_node_port_reuse_buffer(void *object, uint32_t port_id, uint32_t buffer_id)
 {
-	if (object == NULL)
+	struct impl *this = object;
+	struct port *port;
+
+	if (this == NULL)
 		return -EINVAL;
 
 	if (port_id != 0)
 		return -EINVAL;
 
-	return -ENOTSUP;
+	port = GET_OUT_PORT(this, port_id);
+
+	if (buffer_id >= port->n_buffers)
+		return -EINVAL;
+
+	recycle_buffer(this, port, buffer_id);
+
+	return 0;
+}
+
+static int send_frame(struct impl *this, struct spa_io_buffers *inio)
+{
+	struct port *port = GET_IN_PORT(this, 0);
+	AVFrame *frame = this->frame;
+	struct buffer *b;
+	struct spa_buffer *inb;
+	uint32_t i, offs;
+	int res, n_planes;
+
+	if (inio->buffer_id >= port->n_buffers)
+		return -EINVAL;
+
+	b = &port->buffers[inio->buffer_id];
+	inb = b->outbuf;
+
+	frame->format = this->context->pix_fmt;
+	frame->width = this->context->width;
+	frame->height = this->context->height;
+	frame->pts = b->h ? b->h->pts : AV_NOPTS_VALUE;
+
+	n_planes = av_pix_fmt_count_planes(frame->format);
+	if (n_planes > 1 && inb->n_datas >= (uint32_t)n_planes) {
+		/* one plane per block */
+		for (i = 0; i < (uint32_t)n_planes; i++) {
+			offs = SPA_MIN(inb->datas[i].chunk->offset, inb->datas[i].maxsize);
+			frame->data[i] = SPA_MEMBER(inb->datas[i].data, offs, uint8_t);
+			frame->linesize[i] = inb->datas[i].chunk->stride;
+		}
+	} else {
+		offs = SPA_MIN(inb->datas[0].chunk->offset, inb->datas[0].maxsize);
+		if (inb->datas[0].chunk->size < (uint32_t)av_image_get_buffer_size(frame->format,
+						frame->width, frame->height, 1))
+			return -EINVAL;
+		av_image_fill_arrays(frame->data, frame->linesize,
+				SPA_MEMBER(inb->datas[0].data, offs, uint8_t),
+				frame->format, frame->width, frame->height, 1);
+		if (n_planes == 1 && inb->datas[0].chunk->stride > 0)
+			frame->linesize[0] = inb->datas[0].chunk->stride;
+	}
+
+	/* the frame is not refcounted, the codec copies what it needs */
+	res = avcodec_send_frame(this->context, frame);
+
+	for (i = 0; i < AV_NUM_DATA_POINTERS; i++)
+		frame->data[i] = NULL;
+
+	return res;
+}
+
+static int receive_packet(struct impl *this, struct spa_io_buffers *outio)
+{
+	struct port *port = GET_OUT_PORT(this, 0);
+	AVPacket *packet = this->packet;
+	struct buffer *b;
+	struct spa_data *d;
+	uint32_t size;
+	int res;
+
+	if ((res = avcodec_receive_packet(this->context, packet)) < 0)
+		return res;
+
+	if ((b = dequeue_buffer(this, port)) == NULL) {
+		spa_log_warn(this->log, NAME " %p: out of buffers", this);
+		av_packet_unref(packet);
+		return -EPIPE;
+	}
+
+	d = &b->outbuf->datas[0];
+	size = packet->size;
+	if (size > d->maxsize) {
+		/* a truncated packet can't be decoded, drop it */
+		spa_log_error(this->log, NAME " %p: packet of %d bytes doesn't fit in %d, dropped",
+				this, packet->size, d->maxsize);
+		recycle_buffer(this, port, b->id);
+		av_packet_unref(packet);
+		return -ENOSPC;
+	}
+	memcpy(d->data, packet->data, size);
+	d->chunk->offset = 0;
+	d->chunk->size = size;
+	d->chunk->stride = 0;
+
+	if (b->h) {
+		b->h->pts = packet->pts;
+		b->h->dts_offset = packet->dts != AV_NOPTS_VALUE && packet->pts != AV_NOPTS_VALUE ?
+			packet->dts - packet->pts : 0;
+		b->h->flags = (packet->flags & AV_PKT_FLAG_KEY) ? 0 : SPA_META_HEADER_FLAG_DELTA_UNIT;
+	}
+	av_packet_unref(packet);
+
+	outio->buffer_id = b->id;
+	outio->status = SPA_STATUS_HAVE_DATA;
+
+	return 0;
 }
 
 static int impl_node_process(void *object)
 {
 	struct impl *this = object;
-	struct port *port;
-	struct spa_io_buffers *output;
+	struct port *inport, *outport;
+	struct spa_io_buffers *inio, *outio;
+	int res;
 
 	if (this == NULL)
 		return -EINVAL;
 
-	if ((output = this->out_ports[0].io) == NULL)
-		return -EIO;
+	inport = GET_IN_PORT(this, 0);
+	outport = GET_OUT_PORT(this, 0);
 
-	port = &this->out_ports[0];
+	if ((outio = outport->io) == NULL || (inio = inport->io) == NULL)
+		return -EIO;
 
-	if (!port->have_format) {
-		output->status = -EIO;
+	if (!outport->have_format || this->context == NULL) {
+		outio->status = -EIO;
 		return -EIO;
 	}
-	output->status = SPA_STATUS_OK;
 
-	return SPA_STATUS_OK;
+	if (outio->status == SPA_STATUS_HAVE_DATA)
+		return SPA_STATUS_HAVE_DATA;
+
+	if (outio->buffer_id < outport->n_buffers) {
+		recycle_buffer(this, outport, outio->buffer_id);
+		outio->buffer_id = SPA_ID_INVALID;
+	}
+
+	if (inio->status == SPA_STATUS_HAVE_DATA) {
+		res = send_frame(this, inio);
+		if (res == AVERROR(EAGAIN)) {
+			/* the codec is full, keep the frame until a packet is out */
+			spa_log_trace_fp(this->log, NAME " %p: codec full", this);
+		} else {
+			if (res < 0)
+				spa_log_warn(this->log, NAME " %p: encode error %d", this, res);
+			inio->status = SPA_STATUS_NEED_DATA;
+		}
+	}
+
+	res = receive_packet(this, outio);
+	if (res == AVERROR(EAGAIN) || res == -ENOSPC)
+		return inio->status;
+	if (res < 0)
+		return outio->status = res == AVERROR_EOF ? SPA_STATUS_OK : res;
+
+	return inio->status | SPA_STATUS_HAVE_DATA;
 }
 
 static const struct spa_node_methods impl_node = {
@@ -432,19 +846,68 @@ impl_get_interface(struct spa_handle *handle, const char *type, void **interface
 	return 0;
 }
 
+static int impl_clear(struct spa_handle *handle)
+{
+	struct impl *this;
+
+	if (handle == NULL)
+		return -EINVAL;
+
+	this = (struct impl *) handle;
+
+	close_codec(this);
+	av_packet_free(&this->packet);
+	av_frame_free(&this->frame);
+
+	return 0;
+}
+
+size_t spa_ffmpeg_enc_get_size(void)
+{
+	return sizeof(struct impl);
+}
+
+static void init_port(struct port *port, enum spa_direction direction)
+{
+	port->direction = direction;
+	port->id = 0;
+	port->info_all = SPA_PORT_CHANGE_MASK_FLAGS |
+			SPA_PORT_CHANGE_MASK_PARAMS;
+	port->info = SPA_PORT_INFO_INIT();
+	port->info.flags = direction == SPA_DIRECTION_OUTPUT ? SPA_PORT_FLAG_NO_REF : 0;
+	port->params[0] = SPA_PARAM_INFO(SPA_PARAM_EnumFormat, SPA_PARAM_INFO_READ);
+	port->params[1] = SPA_PARAM_INFO(SPA_PARAM_Meta, SPA_PARAM_INFO_READ);
+	port->params[2] = SPA_PARAM_INFO(SPA_PARAM_IO, SPA_PARAM_INFO_READ);
+	port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
+	port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, 0);
+	port->info.params = port->params;
+	port->info.n_params = 5;
+	spa_list_init(&port->free);
+}
+
 int
 spa_ffmpeg_enc_init(struct spa_handle *handle,
 		    const struct spa_dict *info,
-		    const struct spa_support *support, uint32_t n_support)
+		    const struct spa_support *support, uint32_t n_support,
+		    const AVCodec *codec)
 {
 	struct impl *this;
-	struct port *port;
 
 	handle->get_interface = impl_get_interface;
+	handle->clear = impl_clear;
 
 	this = (struct impl *) handle;
 
 	this->log = spa_support_find(support, n_support, SPA_TYPE_INTERFACE_Log);
+	this->codec = codec;
+
+	spa_ffmpeg_parse_threads(info, &this->thread_count, &this->thread_type);
+
+	if ((this->packet = av_packet_alloc()) == NULL ||
+	    (this->frame = av_frame_alloc()) == NULL) {
+		av_packet_free(&this->packet);
+		return -ENOMEM;
+	}
 
 	spa_hook_list_init(&this->hooks);
 
@@ -459,29 +922,11 @@ spa_ffmpeg_enc_init(struct spa_handle *handle,
 	this->info.flags = SPA_NODE_FLAG_RT;
 	this->info.params = this->params;
 
-	port = GET_IN_PORT(this, 0);
-	port->direction = SPA_DIRECTION_INPUT;
-	port->id = 0;
-	port->info_all = SPA_PORT_CHANGE_MASK_FLAGS |
-			SPA_PORT_CHANGE_MASK_PARAMS;
-	port->info = SPA_PORT_INFO_INIT();
-	port->info.flags = 0;
-	port->params[0] = SPA_PARAM_INFO(SPA_PARAM_EnumFormat, SPA_PARAM_INFO_READ);
-	port->params[1] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
-	port->info.params = port->params;
-	port->info.n_params = 2;
+	init_port(GET_IN_PORT(this, 0), SPA_DIRECTION_INPUT);
+	init_port(GET_OUT_PORT(this, 0), SPA_DIRECTION_OUTPUT);
 
-	port = GET_OUT_PORT(this, 0);
-	port->direction = SPA_DIRECTION_OUTPUT;
-	port->id = 0;
-	port->info_all = SPA_PORT_CHANGE_MASK_FLAGS |
-			SPA_PORT_CHANGE_MASK_PARAMS;
-	port->info = SPA_PORT_INFO_INIT();
-	port->info.flags = 0;
-	port->params[0] = SPA_PARAM_INFO(SPA_PARAM_EnumFormat, SPA_PARAM_INFO_READ);
-	port->params[1] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_WRITE);
-	port->info.params = port->params;
-	port->info.n_params = 2;
+	spa_log_debug(this->log, NAME " %p: %s threads:%d type:%d", this,
+			codec->name, this->thread_count, this->thread_type);
 
 	return 0;
 }
@@ -24,6 +24,7 @@
 
 #include <errno.h>
 #include <stdio.h>
+#include <pthread.h>
 
 #include <spa/support/plugin.h>
 #include <spa/node/node.h>
@@ -31,10 +32,26 @@
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 
-int spa_ffmpeg_dec_init(struct spa_handle *handle, const struct spa_dict *info,
-			const struct spa_support *support, uint32_t n_support);
-int spa_ffmpeg_enc_init(struct spa_handle *handle, const struct spa_dict *info,
-			const struct spa_support *support, uint32_t n_support);
+#include "ffmpeg.h"
+
+#define MAX_FACTORIES	256
+
+struct factory {
+	struct spa_handle_factory factory;
+	const AVCodec *codec;
+	char name[128];
+};
+
+static struct factory factories[MAX_FACTORIES];
+static uint32_t n_factories;
+static pthread_once_t factories_once = PTHREAD_ONCE_INIT;
+
+static size_t
+ffmpeg_dec_get_size(const struct spa_handle_factory *factory,
+		const struct spa_dict *params)
+{
+	return spa_ffmpeg_dec_get_size();
+}
 
 static int
 ffmpeg_dec_init(const struct spa_handle_factory *factory,
@@ -43,10 +60,21 @@ ffmpeg_dec_init(const struct spa_handle_factory *factory,
 		const struct spa_support *support,
 		uint32_t n_support)
 {
+	struct factory *f;
+
 	if (factory == NULL || handle == NULL)
 		return -EINVAL;
 
-	return spa_ffmpeg_dec_init(handle, info, support, n_support);
+	f = SPA_CONTAINER_OF(factory, struct factory, factory);
+
+	return spa_ffmpeg_dec_init(handle, info, support, n_support, f->codec);
+}
+
+static size_t
+ffmpeg_enc_get_size(const struct spa_handle_factory *factory,
+		const struct spa_dict *params)
+{
+	return spa_ffmpeg_enc_get_size();
 }
 
 static int
@@ -56,10 +84,14 @@ ffmpeg_enc_init(const struct spa_handle_factory *factory,
 		const struct spa_support *support,
 		uint32_t n_support)
 {
+	struct factory *f;
+
 	if (factory == NULL || handle == NULL)
 		return -EINVAL;
 
-	return spa_ffmpeg_enc_init(handle, info, support, n_support);
+	f = SPA_CONTAINER_OF(factory, struct factory, factory);
+
+	return spa_ffmpeg_enc_init(handle, info, support, n_support, f->codec);
 }
 
 static const struct spa_interface_info ffmpeg_interfaces[] = {
@@ -82,42 +114,62 @@ ffmpeg_enum_interface_info(const struct spa_handle_factory *factory,
 	return 1;
 }
 
-SPA_EXPORT
-int spa_handle_factory_enum(const struct spa_handle_factory **factory, uint32_t *index)
+/* only video codecs that we can express as an SPA format get a factory */
+static void add_factory(const AVCodec *c)
 {
-	static const AVCodec *c = NULL;
-	static uint32_t ci = 0;
-	static struct spa_handle_factory f;
-	static char name[128];
+	struct factory *f;
 
-  #if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 9, 100)
-	av_register_all();
-  #endif
+	if (n_factories >= MAX_FACTORIES)
+		return;
+	if (c->type != AVMEDIA_TYPE_VIDEO ||
+	    spa_ffmpeg_codec_to_media_subtype(c->id) == SPA_MEDIA_SUBTYPE_unknown)
+		return;
 
-	if (*index == 0) {
-		c = av_codec_next(NULL);
-		ci = 0;
-	}
-	while (*index > ci && c) {
-		c = av_codec_next(c);
-		ci++;
-	}
-	if (c == NULL)
-		return 0;
+	f = &factories[n_factories++];
+	f->codec = c;
+	f->factory.version = SPA_VERSION_HANDLE_FACTORY;
+	f->factory.info = NULL;
+	f->factory.enum_interface_info = ffmpeg_enum_interface_info;
 
 	if (av_codec_is_encoder(c)) {
-		snprintf(name, 128, "encoder.%s", c->name);
-		f.init = ffmpeg_enc_init;
+		snprintf(f->name, sizeof(f->name), "encoder.%s", c->name);
+		f->factory.get_size = ffmpeg_enc_get_size;
+		f->factory.init = ffmpeg_enc_init;
 	} else {
-		snprintf(name, 128, "decoder.%s", c->name);
-		f.init = ffmpeg_dec_init;
+		snprintf(f->name, sizeof(f->name), "decoder.%s", c->name);
+		f->factory.get_size = ffmpeg_dec_get_size;
+		f->factory.init = ffmpeg_dec_init;
 	}
-	f.name = name;
-	f.info = NULL;
-	f.enum_interface_info = ffmpeg_enum_interface_info;
+	f->factory.name = f->name;
+}
+
+static void init_factories(void)
+{
+	const AVCodec *c;
+
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 10, 100)
+	av_register_all();
+	for (c = av_codec_next(NULL); c; c = av_codec_next(c))
+		add_factory(c);
+#else
+	void *state = NULL;
+	while ((c = av_codec_iterate(&state)) != NULL)
+		add_factory(c);
+#endif
+}
+
+SPA_EXPORT
+int spa_handle_factory_enum(const struct spa_handle_factory **factory, uint32_t *index)
+{
+	if (factory == NULL || index == NULL)
+		return -EINVAL;
+
+	pthread_once(&factories_once, init_factories);
+
+	if (*index >= n_factories)
+		return 0;
 
-	*factory = &f;
-	(*index)++;
+	*factory = &factories[(*index)++].factory;
 
 	return 1;
 }
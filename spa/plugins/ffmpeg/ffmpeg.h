@@ -0,0 +1,249 @@
+/* Spa FFMpeg support
+ *
+ * Copyright © 2020 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef SPA_FFMPEG_H
+#define SPA_FFMPEG_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <spa/support/plugin.h>
+#include <spa/utils/dict.h>
+#include <spa/pod/builder.h>
+#include <spa/param/format-utils.h>
+#include <spa/param/video/format-utils.h>
+
+#include <libavcodec/avcodec.h>
+
+#define SPA_KEY_FFMPEG_THREADS		"ffmpeg.threads"	/**< number of codec threads, 0 is auto */
+#define SPA_KEY_FFMPEG_THREAD_TYPE	"ffmpeg.thread-type"	/**< "frame", "slice" or "frame+slice" */
+
+int spa_ffmpeg_dec_init(struct spa_handle *handle, const struct spa_dict *info,
+			const struct spa_support *support, uint32_t n_support,
+			const AVCodec *codec);
+size_t spa_ffmpeg_dec_get_size(void);
+
+int spa_ffmpeg_enc_init(struct spa_handle *handle, const struct spa_dict *info,
+			const struct spa_support *support, uint32_t n_support,
+			const AVCodec *codec);
+size_t spa_ffmpeg_enc_get_size(void);
+
+static const struct {
+	enum AVCodecID codec_id;
+	uint32_t media_subtype;
+} spa_ffmpeg_codec_map[] = {
+	{ AV_CODEC_ID_H264, SPA_MEDIA_SUBTYPE_h264 },
+	{ AV_CODEC_ID_MJPEG, SPA_MEDIA_SUBTYPE_mjpg },
+	{ AV_CODEC_ID_DVVIDEO, SPA_MEDIA_SUBTYPE_dv },
+	{ AV_CODEC_ID_H263, SPA_MEDIA_SUBTYPE_h263 },
+	{ AV_CODEC_ID_MPEG1VIDEO, SPA_MEDIA_SUBTYPE_mpeg1 },
+	{ AV_CODEC_ID_MPEG2VIDEO, SPA_MEDIA_SUBTYPE_mpeg2 },
+	{ AV_CODEC_ID_MPEG4, SPA_MEDIA_SUBTYPE_mpeg4 },
+	{ AV_CODEC_ID_VC1, SPA_MEDIA_SUBTYPE_vc1 },
+	{ AV_CODEC_ID_VP8, SPA_MEDIA_SUBTYPE_vp8 },
+	{ AV_CODEC_ID_VP9, SPA_MEDIA_SUBTYPE_vp9 },
+};
+
+static inline uint32_t spa_ffmpeg_codec_to_media_subtype(enum AVCodecID id)
+{
+	size_t i;
+	for (i = 0; i < SPA_N_ELEMENTS(spa_ffmpeg_codec_map); i++)
+		if (spa_ffmpeg_codec_map[i].codec_id == id)
+			return spa_ffmpeg_codec_map[i].media_subtype;
+	return SPA_MEDIA_SUBTYPE_unknown;
+}
+
+static const struct {
+	enum AVPixelFormat pix_fmt;
+	uint32_t format;
+} spa_ffmpeg_format_map[] = {
+	{ AV_PIX_FMT_YUV420P, SPA_VIDEO_FORMAT_I420 },
+	{ AV_PIX_FMT_YUVJ420P, SPA_VIDEO_FORMAT_I420 },
+	{ AV_PIX_FMT_YUYV422, SPA_VIDEO_FORMAT_YUY2 },
+	{ AV_PIX_FMT_UYVY422, SPA_VIDEO_FORMAT_UYVY },
+	{ AV_PIX_FMT_YUV422P, SPA_VIDEO_FORMAT_Y42B },
+	{ AV_PIX_FMT_YUVJ422P, SPA_VIDEO_FORMAT_Y42B },
+	{ AV_PIX_FMT_YUV444P, SPA_VIDEO_FORMAT_Y444 },
+	{ AV_PIX_FMT_YUVJ444P, SPA_VIDEO_FORMAT_Y444 },
+	{ AV_PIX_FMT_NV12, SPA_VIDEO_FORMAT_NV12 },
+	{ AV_PIX_FMT_NV21, SPA_VIDEO_FORMAT_NV21 },
+	{ AV_PIX_FMT_GRAY8, SPA_VIDEO_FORMAT_GRAY8 },
+	{ AV_PIX_FMT_RGB24, SPA_VIDEO_FORMAT_RGB },
+	{ AV_PIX_FMT_BGR24, SPA_VIDEO_FORMAT_BGR },
+	{ AV_PIX_FMT_RGBA, SPA_VIDEO_FORMAT_RGBA },
+	{ AV_PIX_FMT_BGRA, SPA_VIDEO_FORMAT_BGRA },
+};
+
+static inline uint32_t spa_ffmpeg_pix_fmt_to_format(enum AVPixelFormat pix_fmt)
+{
+	size_t i;
+	for (i = 0; i < SPA_N_ELEMENTS(spa_ffmpeg_format_map); i++)
+		if (spa_ffmpeg_format_map[i].pix_fmt == pix_fmt)
+			return spa_ffmpeg_format_map[i].format;
+	return SPA_VIDEO_FORMAT_UNKNOWN;
+}
+
+static inline enum AVPixelFormat spa_ffmpeg_format_to_pix_fmt(uint32_t format)
+{
+	size_t i;
+	for (i = 0; i < SPA_N_ELEMENTS(spa_ffmpeg_format_map); i++)
+		if (spa_ffmpeg_format_map[i].format == format)
+			return spa_ffmpeg_format_map[i].pix_fmt;
+	return AV_PIX_FMT_NONE;
+}
+
+/** parse the threading properties of a node, see \ref SPA_KEY_FFMPEG_THREADS */
+static inline void spa_ffmpeg_parse_threads(const struct spa_dict *info,
+		int *thread_count, int *thread_type)
+{
+	const char *str;
+
+	*thread_count = 0;
+	*thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+
+	if (info == NULL)
+		return;
+
+	if ((str = spa_dict_lookup(info, SPA_KEY_FFMPEG_THREADS)) != NULL)
+		*thread_count = atoi(str);
+
+	if ((str = spa_dict_lookup(info, SPA_KEY_FFMPEG_THREAD_TYPE)) != NULL) {
+		*thread_type = 0;
+		if (strstr(str, "frame"))
+			*thread_type |= FF_THREAD_FRAME;
+		if (strstr(str, "slice"))
+			*thread_type |= FF_THREAD_SLICE;
+	}
+}
+
+static inline void spa_ffmpeg_configure_threads(AVCodecContext *context,
+		const AVCodec *codec, int thread_count, int thread_type)
+{
+	if (!(codec->capabilities & AV_CODEC_CAP_FRAME_THREADS))
+		thread_type &= ~FF_THREAD_FRAME;
+	if (!(codec->capabilities & AV_CODEC_CAP_SLICE_THREADS))
+		thread_type &= ~FF_THREAD_SLICE;
+
+	context->thread_count = thread_type ? thread_count : 1;
+	context->thread_type = thread_type;
+}
+
+/** parse the size and framerate of a raw or encoded video format, the
+ * encoded formats all start with the size and framerate like mjpg */
+static inline int spa_ffmpeg_parse_format(const struct spa_pod *format,
+		uint32_t media_subtype, struct spa_video_info *info)
+{
+	int res;
+
+	if ((res = spa_format_parse(format, &info->media_type, &info->media_subtype)) < 0)
+		return res;
+
+	if (info->media_type != SPA_MEDIA_TYPE_video ||
+	    info->media_subtype != media_subtype)
+		return -EINVAL;
+
+	if (media_subtype == SPA_MEDIA_SUBTYPE_raw)
+		res = spa_format_video_raw_parse(format, &info->info.raw);
+	else if (media_subtype == SPA_MEDIA_SUBTYPE_h264)
+		res = spa_format_video_h264_parse(format, &info->info.h264);
+	else
+		res = spa_format_video_mjpg_parse(format, &info->info.mjpg);
+
+	return res < 0 ? -EINVAL : 0;
+}
+
+static inline void spa_ffmpeg_add_size(struct spa_pod_builder *b,
+		const struct spa_rectangle *size, const struct spa_fraction *framerate)
+{
+	if (size && size->width && size->height)
+		spa_pod_builder_add(b,
+			SPA_FORMAT_VIDEO_size,      SPA_POD_Rectangle(size), 0);
+	else
+		spa_pod_builder_add(b,
+			SPA_FORMAT_VIDEO_size,      SPA_POD_CHOICE_RANGE_Rectangle(
+							&SPA_RECTANGLE(320, 240),
+							&SPA_RECTANGLE(1, 1),
+							&SPA_RECTANGLE(INT32_MAX, INT32_MAX)), 0);
+	if (framerate && framerate->denom)
+		spa_pod_builder_add(b,
+			SPA_FORMAT_VIDEO_framerate, SPA_POD_Fraction(framerate), 0);
+	else
+		spa_pod_builder_add(b,
+			SPA_FORMAT_VIDEO_framerate, SPA_POD_CHOICE_RANGE_Fraction(
+							&SPA_FRACTION(25,1),
+							&SPA_FRACTION(0, 1),
+							&SPA_FRACTION(INT32_MAX, 1)), 0);
+}
+
+/** build the encoded format of \a codec */
+static inline struct spa_pod *spa_ffmpeg_build_encoded_format(struct spa_pod_builder *b,
+		uint32_t id, const AVCodec *codec,
+		const struct spa_rectangle *size, const struct spa_fraction *framerate)
+{
+	struct spa_pod_frame f;
+
+	spa_pod_builder_push_object(b, &f, SPA_TYPE_OBJECT_Format, id);
+	spa_pod_builder_add(b,
+		SPA_FORMAT_mediaType,    SPA_POD_Id(SPA_MEDIA_TYPE_video),
+		SPA_FORMAT_mediaSubtype, SPA_POD_Id(spa_ffmpeg_codec_to_media_subtype(codec->id)),
+		0);
+	spa_ffmpeg_add_size(b, size, framerate);
+	return spa_pod_builder_pop(b, &f);
+}
+
+/** build the raw formats that \a codec can handle, I420 when the codec
+ * does not list its formats */
+static inline struct spa_pod *spa_ffmpeg_build_raw_format(struct spa_pod_builder *b,
+		uint32_t id, const AVCodec *codec,
+		const struct spa_rectangle *size, const struct spa_fraction *framerate)
+{
+	struct spa_pod_frame f[2];
+	uint32_t i, format, n_formats = 0;
+
+	spa_pod_builder_push_object(b, &f[0], SPA_TYPE_OBJECT_Format, id);
+	spa_pod_builder_add(b,
+		SPA_FORMAT_mediaType,    SPA_POD_Id(SPA_MEDIA_TYPE_video),
+		SPA_FORMAT_mediaSubtype, SPA_POD_Id(SPA_MEDIA_SUBTYPE_raw),
+		0);
+	spa_pod_builder_prop(b, SPA_FORMAT_VIDEO_format, 0);
+	spa_pod_builder_push_choice(b, &f[1], SPA_CHOICE_Enum, 0);
+	for (i = 0; codec->pix_fmts && codec->pix_fmts[i] != AV_PIX_FMT_NONE; i++) {
+		if ((format = spa_ffmpeg_pix_fmt_to_format(codec->pix_fmts[i])) ==
+		    SPA_VIDEO_FORMAT_UNKNOWN)
+			continue;
+		/* the first one is the default */
+		if (n_formats++ == 0)
+			spa_pod_builder_id(b, format);
+		spa_pod_builder_id(b, format);
+	}
+	if (n_formats == 0) {
+		spa_pod_builder_id(b, SPA_VIDEO_FORMAT_I420);
+		spa_pod_builder_id(b, SPA_VIDEO_FORMAT_I420);
+	}
+	spa_pod_builder_pop(b, &f[1]);
+	spa_ffmpeg_add_size(b, size, framerate);
+	return spa_pod_builder_pop(b, &f[0]);
+}
+
+#endif /* SPA_FFMPEG_H */
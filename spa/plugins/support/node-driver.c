@@ -27,6 +27,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <spa/support/plugin.h>
 #include <spa/support/log.h>
@@ -37,11 +38,18 @@
 #include <spa/node/io.h>
 #include <spa/node/utils.h>
 #include <spa/param/param.h>
+#include <spa/param/props.h>
+#include <spa/pod/filter.h>
+#include <spa/pod/parser.h>
 
 #define NAME "driver"
 
 #define DEFAULT_FREEWHEEL	false
 
+/* in freewheel the next cycle starts when the graph completed, the timer
+ * only restarts a graph that got stuck */
+#define FREEWHEEL_TIMEOUT	SPA_NSEC_PER_SEC
+
 struct props {
 	bool freewheel;
 };
@@ -58,7 +66,7 @@ struct impl {
 
 	uint64_t info_all;
 	struct spa_node_info info;
-	struct spa_param_info params[1];
+	struct spa_param_info params[2];
 
 	struct spa_hook_list hooks;
 	struct spa_callbacks callbacks;
@@ -70,7 +78,13 @@ struct impl {
 	struct itimerspec timerspec;
 
 	bool started;
+	bool freewheel;			/**< freewheel state in the data thread */
 	uint64_t next_time;
+
+	uint64_t freewheel_start;
+	uint64_t freewheel_cycles;
+	uint64_t freewheel_frames;
+	uint64_t freewheel_time;	/**< duration of the processed frames in nsec */
 };
 
 static void reset_props(struct props *props)
@@ -78,6 +92,67 @@ static void reset_props(struct props *props)
 	props->freewheel = DEFAULT_FREEWHEEL;
 }
 
+static int impl_node_enum_params(void *object, int seq,
+				 uint32_t id, uint32_t start, uint32_t num,
+				 const struct spa_pod *filter)
+{
+	struct impl *this = object;
+	struct spa_pod *param;
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_result_node_params result;
+	uint32_t count = 0;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+	spa_return_val_if_fail(num != 0, -EINVAL);
+
+	result.id = id;
+	result.next = start;
+      next:
+	result.index = result.next++;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
+	switch (id) {
+	case SPA_PARAM_PropInfo:
+		switch (result.index) {
+		case 0:
+			param = spa_pod_builder_add_object(&b,
+				SPA_TYPE_OBJECT_PropInfo, id,
+				SPA_PROP_INFO_id,   SPA_POD_Id(SPA_PROP_freewheel),
+				SPA_PROP_INFO_name, SPA_POD_String("Run cycles as fast as possible"),
+				SPA_PROP_INFO_type, SPA_POD_Bool(this->props.freewheel));
+			break;
+		default:
+			return 0;
+		}
+		break;
+	case SPA_PARAM_Props:
+		switch (result.index) {
+		case 0:
+			param = spa_pod_builder_add_object(&b,
+				SPA_TYPE_OBJECT_Props, id,
+				SPA_PROP_freewheel, SPA_POD_Bool(this->props.freewheel));
+			break;
+		default:
+			return 0;
+		}
+		break;
+	default:
+		return -ENOENT;
+	}
+
+	if (spa_pod_filter(&b, &result.param, param, filter) < 0)
+		goto next;
+
+	spa_node_emit_result(&this->hooks, seq, 0, SPA_RESULT_TYPE_NODE_PARAMS, &result);
+
+	if (++count != num)
+		goto next;
+
+	return 0;
+}
+
 static int impl_node_set_io(void *object, uint32_t id, void *data, size_t size)
 {
 	struct impl *this = object;
@@ -109,6 +184,13 @@ static void set_timer(struct impl *this, uint64_t next_time)
 			this->timer_source.fd, SPA_FD_TIMER_ABSTIME, &this->timerspec, NULL);
 }
 
+static inline uint64_t get_time_ns(struct impl *this)
+{
+	struct timespec now;
+	spa_system_clock_gettime(this->data_system, CLOCK_MONOTONIC, &now);
+	return SPA_TIMESPEC_TO_NSEC(&now);
+}
+
 static void on_timeout(struct spa_source *source)
 {
 	struct impl *this = source->data;
@@ -121,7 +203,7 @@ static void on_timeout(struct spa_source *source)
 				this->timer_source.fd, &expirations) < 0)
 		perror("read timerfd");
 
-	nsec = this->next_time;
+	nsec = this->freewheel ? get_time_ns(this) : this->next_time;
 
 	if (SPA_LIKELY(this->position)) {
 		duration = this->position->clock.duration;
@@ -133,19 +215,109 @@ static void on_timeout(struct spa_source *source)
 
 	this->next_time = nsec + duration * SPA_NSEC_PER_SEC / rate;
 
+	if (SPA_UNLIKELY(this->freewheel)) {
+		this->freewheel_cycles++;
+		this->freewheel_frames += duration;
+		this->freewheel_time += duration * SPA_NSEC_PER_SEC / rate;
+	}
+
 	if (SPA_LIKELY(this->clock)) {
+		SPA_FLAG_UPDATE(this->clock->flags, SPA_IO_CLOCK_FLAG_FREEWHEEL, this->freewheel);
 		this->clock->nsec = nsec;
 		this->clock->position += duration;
 		this->clock->duration = duration;
 		this->clock->delay = 0;
 		this->clock->rate_diff = 1.0;
-		this->clock->next_nsec = this->next_time;
+		this->clock->next_nsec = this->freewheel ? nsec : this->next_time;
 	}
 
+	/* set the timer first, the graph can complete and restart the cycle
+	 * from the ready callback */
+	set_timer(this, this->freewheel ? nsec + FREEWHEEL_TIMEOUT : this->next_time);
+
 	spa_node_call_ready(&this->callbacks,
 			SPA_STATUS_HAVE_DATA | SPA_STATUS_NEED_DATA);
+}
 
-	set_timer(this, this->next_time);
+static void start_freewheel(struct impl *this, uint64_t now)
+{
+	this->freewheel_start = now;
+	this->freewheel_cycles = 0;
+	this->freewheel_frames = 0;
+	this->freewheel_time = 0;
+}
+
+static int do_set_freewheel(struct spa_loop *loop, bool async, uint32_t seq,
+		const void *data, size_t size, void *user_data)
+{
+	struct impl *this = user_data;
+	bool freewheel = *(bool*)data;
+	uint64_t now, elapsed;
+
+	if (this->freewheel == freewheel)
+		return 0;
+
+	now = get_time_ns(this);
+	this->freewheel = freewheel;
+
+	if (freewheel) {
+		start_freewheel(this, now);
+	} else {
+		elapsed = now - this->freewheel_start;
+		spa_log_info(this->log, NAME " %p: freewheel %"PRIu64" cycles %"PRIu64
+				" frames in %"PRIu64" usec, %f times real time", this,
+				this->freewheel_cycles, this->freewheel_frames,
+				(uint64_t)(elapsed / SPA_NSEC_PER_USEC),
+				elapsed ? (double)this->freewheel_time / elapsed : 0.0);
+	}
+	/* start the next cycle now, when freewheeling the timer is only a timeout
+	 * and when going back to real time we restart the clock */
+	if (this->started) {
+		this->next_time = now;
+		set_timer(this, now);
+	}
+	return 0;
+}
+
+static void set_freewheel(struct impl *this, bool freewheel)
+{
+	spa_log_debug(this->log, NAME " %p: freewheel %d", this, freewheel);
+	this->props.freewheel = freewheel;
+	spa_loop_invoke(this->data_loop, do_set_freewheel, 0,
+			&freewheel, sizeof(freewheel), true, this);
+}
+
+static void emit_node_info(struct impl *this, bool full);
+
+static int impl_node_set_param(void *object, uint32_t id, uint32_t flags,
+			       const struct spa_pod *param)
+{
+	struct impl *this = object;
+	bool freewheel;
+
+	spa_return_val_if_fail(this != NULL, -EINVAL);
+
+	switch (id) {
+	case SPA_PARAM_Props:
+		freewheel = this->props.freewheel;
+		if (param == NULL)
+			freewheel = DEFAULT_FREEWHEEL;
+		else
+			spa_pod_parse_object(param,
+				SPA_TYPE_OBJECT_Props, NULL,
+				SPA_PROP_freewheel, SPA_POD_OPT_Bool(&freewheel));
+
+		if (freewheel != this->props.freewheel) {
+			set_freewheel(this, freewheel);
+			this->info.change_mask |= SPA_NODE_CHANGE_MASK_PARAMS;
+			this->params[1].flags ^= SPA_PARAM_INFO_SERIAL;
+			emit_node_info(this, false);
+		}
+		break;
+	default:
+		return -ENOENT;
+	}
+	return 0;
 }
 
 static int impl_node_send_command(void *object, const struct spa_command *command)
@@ -159,13 +331,10 @@ static int impl_node_send_command(void *object, const struct spa_command *comman
 	switch (SPA_NODE_COMMAND_ID(command)) {
 	case SPA_NODE_COMMAND_Start:
 	{
-		struct timespec now;
-
 		if (this->started)
 			return 0;
 
-		clock_gettime(CLOCK_MONOTONIC, &now);
-		this->next_time = SPA_TIMESPEC_TO_NSEC(&now);
+		this->next_time = get_time_ns(this);
 		this->started = true;
 		set_timer(this, this->next_time);
 		break;
@@ -234,14 +403,13 @@ impl_node_set_callbacks(void *object,
 static int impl_node_process(void *object)
 {
 	struct impl *this = object;
-	struct timespec now;
 
 	spa_return_val_if_fail(this != NULL, -EINVAL);
-	spa_log_trace(this->log, "process %d", this->props.freewheel);
+	spa_log_trace(this->log, "process %d", this->freewheel);
 
-	if (this->props.freewheel) {
-		clock_gettime(CLOCK_MONOTONIC, &now);
-		this->next_time = SPA_TIMESPEC_TO_NSEC(&now);
+	/* the graph completed, start the next cycle right away */
+	if (this->freewheel && this->started) {
+		this->next_time = get_time_ns(this);
 		set_timer(this, this->next_time);
 	}
 	return SPA_STATUS_OK;
@@ -251,6 +419,8 @@ static const struct spa_node_methods impl_node = {
 	SPA_VERSION_NODE_METHODS,
 	.add_listener = impl_node_add_listener,
 	.set_callbacks = impl_node_set_callbacks,
+	.enum_params = impl_node_enum_params,
+	.set_param = impl_node_set_param,
 	.set_io = impl_node_set_io,
 	.send_command = impl_node_send_command,
 	.process = impl_node_process,
@@ -302,6 +472,7 @@ impl_init(const struct spa_handle_factory *factory,
 	  uint32_t n_support)
 {
 	struct impl *this;
+	const char *str;
 
 	spa_return_val_if_fail(factory != NULL, -EINVAL);
 	spa_return_val_if_fail(handle != NULL, -EINVAL);
@@ -338,9 +509,10 @@ impl_init(const struct spa_handle_factory *factory,
 	this->info.max_input_ports = 0;
 	this->info.max_output_ports = 0;
 	this->info.flags = SPA_NODE_FLAG_RT;
-	this->params[0] = SPA_PARAM_INFO(SPA_PARAM_Props, SPA_PARAM_INFO_READWRITE);
+	this->params[0] = SPA_PARAM_INFO(SPA_PARAM_PropInfo, SPA_PARAM_INFO_READ);
+	this->params[1] = SPA_PARAM_INFO(SPA_PARAM_Props, SPA_PARAM_INFO_READWRITE);
 	this->info.params = this->params;
-	this->info.n_params = 1;
+	this->info.n_params = 2;
 
 	this->timer_source.func = on_timeout;
 	this->timer_source.data = this;
@@ -354,6 +526,12 @@ impl_init(const struct spa_handle_factory *factory,
 
 	reset_props(&this->props);
 
+	if (info && (str = spa_dict_lookup(info, SPA_KEY_NODE_FREEWHEEL)) != NULL)
+		this->props.freewheel = this->freewheel =
+			(strcmp(str, "true") == 0 || atoi(str) == 1);
+	if (this->freewheel)
+		start_freewheel(this, get_time_ns(this));
+
 	spa_loop_add_source(this->data_loop, &this->timer_source);
 
 	return 0;
@@ -37,6 +37,7 @@
 #include <spa/node/io.h>
 #include <spa/param/param.h>
 #include <spa/param/format.h>
+#include <spa/param/audio/format.h>
 #include <spa/pod/parser.h>
 #include <spa/pod/filter.h>
 
@@ -209,16 +210,11 @@ static int fill_buffer(struct impl *this, struct buffer *b)
 
 static void set_timer(struct impl *this, bool enabled)
 {
-	if (this->callbacks.funcs || this->props.live) {
+	if (this->props.live) {
 		if (enabled) {
-			if (this->props.live) {
-				uint64_t next_time = this->start_time + this->elapsed_time;
-				this->timerspec.it_value.tv_sec = next_time / SPA_NSEC_PER_SEC;
-				this->timerspec.it_value.tv_nsec = next_time % SPA_NSEC_PER_SEC;
-			} else {
-				this->timerspec.it_value.tv_sec = 0;
-				this->timerspec.it_value.tv_nsec = 1;
-			}
+			uint64_t next_time = this->start_time + this->elapsed_time;
+			this->timerspec.it_value.tv_sec = next_time / SPA_NSEC_PER_SEC;
+			this->timerspec.it_value.tv_nsec = next_time % SPA_NSEC_PER_SEC;
 		} else {
 			this->timerspec.it_value.tv_sec = 0;
 			this->timerspec.it_value.tv_nsec = 0;
@@ -232,7 +228,7 @@ static inline void read_timer(struct impl *this)
 {
 	uint64_t expirations;
 
-	if (this->callbacks.funcs || this->props.live) {
+	if (this->props.live) {
 		if (spa_system_timerfd_read(this->data_system,
 					this->timer_source.fd, &expirations) < 0)
 			perror("read timerfd");
@@ -426,7 +422,20 @@ static int port_enum_formats(struct impl *this, struct port *port,
 			     struct spa_pod **param,
 			     struct spa_pod_builder *builder)
 {
-	return 0;
+	switch (index) {
+	case 0:
+		*param = spa_pod_builder_add_object(builder,
+			SPA_TYPE_OBJECT_Format, SPA_PARAM_EnumFormat,
+			SPA_FORMAT_mediaType,      SPA_POD_Id(SPA_MEDIA_TYPE_audio),
+			SPA_FORMAT_mediaSubtype,   SPA_POD_Id(SPA_MEDIA_SUBTYPE_raw),
+			SPA_FORMAT_AUDIO_format,   SPA_POD_Id(SPA_AUDIO_FORMAT_F32),
+			SPA_FORMAT_AUDIO_rate,     SPA_POD_CHOICE_RANGE_Int(44100, 1, INT32_MAX),
+			SPA_FORMAT_AUDIO_channels, SPA_POD_CHOICE_RANGE_Int(1, 1, INT32_MAX));
+		break;
+	default:
+		return 0;
+	}
+	return 1;
 }
 
 static int port_get_format(struct impl *this, struct port *port,
@@ -488,10 +497,10 @@ impl_node_port_enum_params(void *object, int seq,
 		case 0:
 			param = spa_pod_builder_add_object(&b,
 				SPA_TYPE_OBJECT_ParamBuffers, id,
-				SPA_PARAM_BUFFERS_buffers, SPA_POD_CHOICE_RANGE_Int(32, 2, 32),
+				SPA_PARAM_BUFFERS_buffers, SPA_POD_CHOICE_RANGE_Int(2, 1, MAX_BUFFERS),
 				SPA_PARAM_BUFFERS_blocks,  SPA_POD_Int(1),
 				SPA_PARAM_BUFFERS_size,    SPA_POD_Int(128),
-				SPA_PARAM_BUFFERS_stride,  SPA_POD_Int(1),
+				SPA_PARAM_BUFFERS_stride,  SPA_POD_Int(0),
 				SPA_PARAM_BUFFERS_align,   SPA_POD_Int(16));
 			break;
 		default:
@@ -688,7 +697,7 @@ static int impl_node_process(void *object)
 		io->buffer_id = SPA_ID_INVALID;
 	}
 
-	if (this->callbacks.funcs == NULL)
+	if (!this->props.live)
 		return make_buffer(this);
 	else
 		return SPA_STATUS_OK;
@@ -23,6 +23,7 @@
  */
 
 #include <errno.h>
+#include <stdlib.h>
 
 typedef enum {
 	GRAY = 0,
@@ -72,14 +73,21 @@ static Pixel colors[N_COLORS] = {
 
 typedef struct _DrawingData DrawingData;
 
-typedef void (*DrawPixelFunc) (DrawingData * dd, int x, Pixel * pixel);
+typedef void (*FillSpanFunc) (DrawingData * dd, int x, int length, const Pixel * color);
+typedef void (*SnowSpanFunc) (DrawingData * dd, int x, int length, uint64_t * state);
+
+/* rows of snow that are rendered from one random state, stripes don't
+ * depend on each other */
+#define SNOW_STRIPE	64
 
 struct _DrawingData {
-	char *line;
+	uint8_t *line;
 	int width;
 	int height;
 	int stride;
-	DrawPixelFunc draw_pixel;
+	uint64_t seed;
+	FillSpanFunc fill_span;
+	SnowSpanFunc snow_span;
 };
 
 static inline void update_yuv(Pixel * pixel)
@@ -115,23 +123,136 @@ static void init_colors(void)
 	}
 }
 
-static void draw_pixel_rgb(DrawingData * dd, int x, Pixel * color)
+/* luma of a gray pixel, the same as update_yuv() with R = G = B */
+static inline uint8_t gray_to_y(uint8_t r)
+{
+	return (255 * r + 128) >> 8;
+}
+
+/* gray_to_y() on the 8 bytes of r at once, that is r - 1 for the bytes
+ * above 128 */
+static inline uint64_t gray_to_y8(uint64_t r)
+{
+	const uint64_t h = 0x8080808080808080ULL, l = 0x7f7f7f7f7f7f7f7fULL;
+	uint64_t above = r & (((r & l) + l) & h);
+
+	return r - (above >> 7);
+}
+
+/* xorshift64*, good enough for snow and a lot faster than rand() */
+static inline uint64_t snow_random(uint64_t * state)
+{
+	uint64_t x = *state;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+
+	return x * 0x2545f4914f6cdd1dULL;
+}
+
+/* the first unit bytes of d are filled, repeat them until size bytes are
+ * filled. Every copy doubles the filled area. */
+static inline void fill_repeat(uint8_t * d, size_t unit, size_t size)
+{
+	size_t filled = unit;
+
+	while (filled < size) {
+		size_t n = SPA_MIN(filled, size - filled);
+		memcpy(d + filled, d, n);
+		filled += n;
+	}
+}
+
+static void fill_span_rgb(DrawingData * dd, int x, int length, const Pixel * color)
+{
+	uint8_t *d = dd->line + 3 * x;
+
+	if (length <= 0)
+		return;
+
+	d[0] = color->R;
+	d[1] = color->G;
+	d[2] = color->B;
+	fill_repeat(d, 3, 3 * length);
+}
+
+static void fill_span_uyvy(DrawingData * dd, int x, int length, const Pixel * color)
+{
+	uint8_t *d = dd->line;
+
+	if (length <= 0)
+		return;
+
+	if (x & 1) {
+		/* odd pixel, only the Y of the pair */
+		d[2 * (x - 1) + 3] = color->Y;
+		x++;
+		length--;
+	}
+	if (length >= 2) {
+		uint8_t *p = d + 2 * x;
+
+		p[0] = color->U;
+		p[1] = color->Y;
+		p[2] = color->V;
+		p[3] = color->Y;
+		fill_repeat(p, 4, 4 * (length / 2));
+		x += length & ~1;
+	}
+	if (length & 1) {
+		/* even pixel, the next span writes the Y of the odd pixel */
+		d[2 * x + 0] = color->U;
+		d[2 * x + 1] = color->Y;
+		d[2 * x + 2] = color->V;
+	}
+}
+
+static void snow_span_rgb(DrawingData * dd, int x, int length, uint64_t * state)
 {
-	dd->line[3 * x + 0] = color->R;
-	dd->line[3 * x + 1] = color->G;
-	dd->line[3 * x + 2] = color->B;
+	uint8_t *d = dd->line + 3 * x;
+	int i, j;
+
+	for (i = 0; i < length; i += 8) {
+		uint64_t r = snow_random(state);
+		int n = SPA_MIN(8, length - i);
+
+		for (j = 0; j < n; j++, r >>= 8, d += 3)
+			d[0] = d[1] = d[2] = r;
+	}
 }
 
-static void draw_pixel_uyvy(DrawingData * dd, int x, Pixel * color)
+static void snow_span_uyvy(DrawingData * dd, int x, int length, uint64_t * state)
 {
+	uint8_t *d = dd->line;
+	uint64_t r;
+	int i, j;
+
+	if (length <= 0)
+		return;
+
 	if (x & 1) {
-		/* odd pixel */
-		dd->line[2 * (x - 1) + 3] = color->Y;
-	} else {
-		/* even pixel */
-		dd->line[2 * x + 0] = color->U;
-		dd->line[2 * x + 1] = color->Y;
-		dd->line[2 * x + 2] = color->V;
+		d[2 * (x - 1) + 3] = gray_to_y(snow_random(state));
+		x++;
+		length--;
+	}
+	d += 2 * x;
+	for (i = 0; i + 1 < length; i += 8) {
+		int n = SPA_MIN(8, (length - i) & ~1);
+
+		r = gray_to_y8(snow_random(state));
+		for (j = 0; j < n; j += 2, r >>= 16, d += 4) {
+			d[0] = 128;
+			d[1] = r;
+			d[2] = 128;
+			d[3] = r >> 8;
+		}
+	}
+	if (length & 1) {
+		d[0] = 128;
+		d[1] = gray_to_y(snow_random(state));
+		d[2] = 128;
 	}
 }
 
@@ -146,27 +267,26 @@ static int drawing_data_init(DrawingData * dd, struct impl *this, char *data)
 		return -ENOTSUP;
 
 	if (format->info.raw.format == SPA_VIDEO_FORMAT_RGB) {
-		dd->draw_pixel = draw_pixel_rgb;
+		dd->fill_span = fill_span_rgb;
+		dd->snow_span = snow_span_rgb;
 	} else if (format->info.raw.format == SPA_VIDEO_FORMAT_UYVY) {
-		dd->draw_pixel = draw_pixel_uyvy;
+		dd->fill_span = fill_span_uyvy;
+		dd->snow_span = snow_span_uyvy;
 	} else
 		return -ENOTSUP;
 
-	dd->line = data;
+	dd->line = (uint8_t *) data;
 	dd->width = size->width;
 	dd->height = size->height;
 	dd->stride = port->stride;
+	dd->seed = this->frame_count;
 
 	return 0;
 }
 
 static inline void draw_pixels(DrawingData * dd, int offset, Color color, int length)
 {
-	int x;
-
-	for (x = offset; x < offset + length; x++) {
-		dd->draw_pixel(dd, x, &colors[color]);
-	}
+	dd->fill_span(dd, offset, length, &colors[color]);
 }
 
 static inline void next_line(DrawingData * dd)
@@ -174,27 +294,61 @@ static inline void next_line(DrawingData * dd)
 	dd->line += dd->stride;
 }
 
-static void draw_smpte_snow(DrawingData * dd)
+/* copy the current line to the next n_lines lines */
+static inline void repeat_line(DrawingData * dd, int n_lines)
+{
+	int i;
+
+	for (i = 0; i < n_lines; i++) {
+		memcpy(dd->line + dd->stride, dd->line, dd->stride);
+		next_line(dd);
+	}
+}
+
+/* draw snow in the rows [y1, y2), columns [x, width), in stripes that each
+ * have their own random state derived from the frame seed */
+static void draw_snow_rows(DrawingData * dd, int y1, int y2, int x)
+{
+	uint8_t *start = dd->line;
+	int y, stripe;
+
+	for (stripe = y1 / SNOW_STRIPE; stripe * SNOW_STRIPE < y2; stripe++) {
+		uint64_t state = ((dd->seed + 1) * 0x9e3779b97f4a7c15ULL ^ stripe) | 1;
+		int s1 = SPA_MAX(y1, stripe * SNOW_STRIPE);
+		int s2 = SPA_MIN(y2, (stripe + 1) * SNOW_STRIPE);
+
+		for (y = s1; y < s2; y++) {
+			dd->line = start + y * dd->stride;
+			dd->snow_span(dd, x, dd->width - x, &state);
+		}
+	}
+	dd->line = start;
+}
+
+/* the static part of the SMPTE pattern, the snow area is left black */
+static void draw_smpte(DrawingData * dd)
 {
+	uint8_t *start = dd->line;
 	int h, w;
 	int y1, y2;
-	int i, j;
+	int j, x;
 
 	w = dd->width;
 	h = dd->height;
 	y1 = 2 * h / 3;
 	y2 = 3 * h / 4;
 
-	for (i = 0; i < y1; i++) {
+	if (y1 > 0) {
 		for (j = 0; j < 7; j++) {
 			int x1 = j * w / 7;
 			int x2 = (j + 1) * w / 7;
 			draw_pixels(dd, x1, j, x2 - x1);
 		}
+		repeat_line(dd, y1 - 1);
 		next_line(dd);
 	}
 
-	for (i = y1; i < y2; i++) {
+	if (y2 > y1) {
 		for (j = 0; j < 7; j++) {
 			int x1 = j * w / 7;
 			int x2 = (j + 1) * w / 7;
@@ -202,11 +356,12 @@ static void draw_smpte_snow(DrawingData * dd)
 
 			draw_pixels(dd, x1, c, x2 - x1);
 		}
+		repeat_line(dd, y2 - y1 - 1);
 		next_line(dd);
 	}
 
-	for (i = y2; i < h; i++) {
-		int x = 0;
+	if (h > y2) {
+		x = 0;
 
 		/* negative I */
 		draw_pixels(dd, x, NEG_I, w / 6);
@@ -228,40 +383,72 @@ static void draw_smpte_snow(DrawingData * dd)
 		draw_pixels(dd, x, LIGHT_BLACK, w / 12);
 		x += w / 12;
 
-		/* war of the ants (a.k.a. snow) */
-		for (j = x; j < w; j++) {
-			Pixel p;
-			unsigned char r = rand();
-
-			p.R = r;
-			p.G = r;
-			p.B = r;
-			update_yuv(&p);
-			dd->draw_pixel(dd, j, &p);
-		}
+		/* room for the snow */
+		draw_pixels(dd, x, BLACK, w - x);
 
-		next_line(dd);
+		repeat_line(dd, h - y2 - 1);
 	}
+	dd->line = start;
 }
 
-static void draw_snow(DrawingData * dd)
+/* the static part of the SMPTE pattern only changes with the format, keep
+ * a rendered copy of it. The memory is allocated on the main thread when
+ * the format is set, the data thread renders it on the first frame */
+static int alloc_smpte_cache(struct impl *this)
 {
-	int x, y;
-
-	for (y = 0; y < dd->height; y++) {
-		for (x = 0; x < dd->width; x++) {
-			Pixel p;
-			unsigned char r = rand();
-
-			p.R = r;
-			p.G = r;
-			p.B = r;
-			update_yuv(&p);
-			dd->draw_pixel(dd, x, &p);
-		}
+	struct port *port = &this->port;
+	size_t size = (size_t)port->stride * port->current_format.info.raw.size.height;
 
-		next_line(dd);
+	this->cache_valid = false;
+
+	if (this->cache_size >= size)
+		return 0;
+
+	free(this->cache);
+	if ((this->cache = malloc(size)) == NULL) {
+		this->cache_size = 0;
+		return -errno;
 	}
+	this->cache_size = size;
+	return 0;
+}
+
+static uint8_t *get_smpte_cache(struct impl *this, DrawingData * dd)
+{
+	DrawingData cd;
+	size_t size = (size_t)dd->stride * dd->height;
+
+	if (this->cache_valid)
+		return this->cache;
+
+	if (this->cache_size < size)
+		return NULL;
+
+	cd = *dd;
+	cd.line = this->cache;
+	draw_smpte(&cd);
+	this->cache_valid = true;
+
+	return this->cache;
+}
+
+static void draw_smpte_snow(struct impl *this, DrawingData * dd)
+{
+	uint8_t *cache;
+	int w = dd->width, h = dd->height;
+
+	if ((cache = get_smpte_cache(this, dd)) != NULL)
+		memcpy(dd->line, cache, (size_t)dd->stride * h);
+	else
+		draw_smpte(dd);
+
+	/* war of the ants (a.k.a. snow) */
+	draw_snow_rows(dd, 3 * h / 4, h, 3 * (w / 6) + 3 * (w / 12));
+}
+
+static void draw_snow(DrawingData * dd)
+{
+	draw_snow_rows(dd, 0, dd->height, 0);
 }
 
 static int draw(struct impl *this, char *data)
@@ -276,7 +463,7 @@ static int draw(struct impl *this, char *data)
 
 	switch (this->props.pattern) {
 	case PATTERN_SMPTE_SNOW:
-		draw_smpte_snow(&dd);
+		draw_smpte_snow(this, &dd);
 		break;
 	case PATTERN_SNOW:
 		draw_snow(&dd);
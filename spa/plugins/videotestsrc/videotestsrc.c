@@ -120,6 +120,11 @@ struct impl {
 
 	uint64_t frame_count;
 
+	/* static part of the pattern, rendered once per format */
+	uint8_t *cache;
+	size_t cache_size;
+	bool cache_valid;
+
 	struct port port;
 };
 
@@ -617,6 +622,8 @@ static int port_set_format(struct impl *this, struct port *port,
 {
 	int res;
 
+	this->cache_valid = false;
+
 	if (format == NULL) {
 		port->have_format = false;
 		clear_buffers(this, port);
@@ -648,6 +655,8 @@ static int port_set_format(struct impl *this, struct port *port,
 	if (port->have_format) {
 		struct spa_video_info_raw *raw_info = &port->current_format.info.raw;
 		port->stride = SPA_ROUND_UP_N(port->bpp * raw_info->size.width, 4);
+		if (alloc_smpte_cache(this) < 0)
+			spa_log_warn(this->log, NAME " %p: can't allocate the SMPTE cache", this);
 		port->params[3] = SPA_PARAM_INFO(SPA_PARAM_Format, SPA_PARAM_INFO_READWRITE);
 		port->params[4] = SPA_PARAM_INFO(SPA_PARAM_Buffers, SPA_PARAM_INFO_READ);
 	} else {
@@ -848,6 +857,9 @@ static int impl_clear(struct spa_handle *handle)
 		spa_loop_remove_source(this->data_loop, &this->timer_source);
 	spa_system_close(this->data_system, this->timer_source.fd);
 
+	free(this->cache);
+	this->cache = NULL;
+
 	return 0;
 }
 
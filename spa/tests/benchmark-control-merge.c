@@ -0,0 +1,169 @@
+/* Spa
+ *
+ * Copyright © 2020 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <assert.h>
+
+#include <spa/pod/builder.h>
+#include <spa/control/control.h>
+#include <spa/control/merge.h>
+
+#define MAX_COUNT 100
+#define MAX_SEQ 64
+#define MAX_EVENTS 1000
+#define MAX_OFFSET 1024
+
+static uint8_t buffers[MAX_SEQ][MAX_EVENTS * 32 + 64];
+static struct spa_pod_sequence *seq[MAX_SEQ];
+
+static int compare_offset(const void *a, const void *b)
+{
+	return *(const uint32_t *)a - *(const uint32_t *)b;
+}
+
+static void gen_sequences(uint32_t n_seq, uint32_t n_events)
+{
+	uint32_t i, j, offsets[MAX_EVENTS];
+	uint8_t midi[3] = { 0xb0, 0, 0 };
+
+	for (i = 0; i < n_seq; i++) {
+		struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffers[i], sizeof(buffers[i]));
+		struct spa_pod_frame f;
+
+		for (j = 0; j < n_events; j++)
+			offsets[j] = random() % MAX_OFFSET;
+		qsort(offsets, n_events, sizeof(uint32_t), compare_offset);
+
+		spa_pod_builder_push_sequence(&b, &f, 0);
+		for (j = 0; j < n_events; j++) {
+			midi[1] = i;
+			midi[2] = j & 0x7f;
+			spa_pod_builder_control(&b, offsets[j], SPA_CONTROL_Midi);
+			spa_pod_builder_bytes(&b, midi, sizeof(midi));
+		}
+		seq[i] = spa_pod_builder_pop(&b, &f);
+		assert(seq[i] != NULL);
+	}
+}
+
+/* the previous implementation, scan all sequences for each control */
+static uint64_t merge_scan(uint32_t n_seq)
+{
+	struct spa_pod_control *ctrl[MAX_SEQ];
+	uint64_t sum = 0;
+	uint32_t i;
+
+	for (i = 0; i < n_seq; i++)
+		ctrl[i] = spa_pod_control_first(&seq[i]->body);
+
+	while (true) {
+		struct spa_pod_control *next = NULL;
+		uint32_t next_index = 0;
+
+		for (i = 0; i < n_seq; i++) {
+			if (!spa_pod_control_is_inside(&seq[i]->body,
+					SPA_POD_BODY_SIZE(seq[i]), ctrl[i]))
+				continue;
+
+			if (next == NULL || ctrl[i]->offset < next->offset) {
+				next = ctrl[i];
+				next_index = i;
+			}
+		}
+		if (next == NULL)
+			break;
+
+		sum = sum * 31 + (uintptr_t)next;
+		ctrl[next_index] = spa_pod_control_next(ctrl[next_index]);
+	}
+	return sum;
+}
+
+static uint64_t merge_heap(uint32_t n_seq)
+{
+	struct spa_control_merge_item items[MAX_SEQ];
+	struct spa_control_merge merge;
+	struct spa_pod_control *c;
+	uint64_t sum = 0;
+
+	spa_control_merge_init(&merge, items, seq, n_seq);
+	while ((c = spa_control_merge_next(&merge)) != NULL)
+		sum = sum * 31 + (uintptr_t)c;
+
+	return sum;
+}
+
+static uint64_t run(uint64_t (*func) (uint32_t n_seq), uint32_t n_seq, uint64_t *sum)
+{
+	struct timespec ts;
+	uint64_t t1, t2;
+	uint32_t i;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t1 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	for (i = 0; i < MAX_COUNT; i++)
+		*sum = func(n_seq);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	t2 = SPA_TIMESPEC_TO_NSEC(&ts);
+
+	return t2 - t1;
+}
+
+static void test_merge(uint32_t n_seq, uint32_t n_events)
+{
+	uint64_t t1, t2, sum1, sum2;
+
+	gen_sequences(n_seq, n_events);
+
+	t1 = run(merge_scan, n_seq, &sum1);
+	t2 = run(merge_heap, n_seq, &sum2);
+
+	/* both must produce the controls in the same order */
+	assert(sum1 == sum2);
+
+	fprintf(stderr, "%u x %u: scan %"PRIu64" heap %"PRIu64" ns/merge %f speedup\n",
+			n_seq, n_events, t1 / MAX_COUNT, t2 / MAX_COUNT,
+			(double)t1 / t2);
+}
+
+int main(int argc, char *argv[])
+{
+	/* warmup */
+	test_merge(MAX_SEQ, 100);
+
+	test_merge(1, MAX_EVENTS);
+	test_merge(2, MAX_EVENTS);
+	test_merge(4, MAX_EVENTS);
+	test_merge(16, MAX_EVENTS);
+	test_merge(64, MAX_EVENTS);
+
+	return 0;
+}
@@ -41,6 +41,7 @@ static void test_io_abi(void)
 	spa_assert(SPA_IO_Position == 7);
 	spa_assert(SPA_IO_RateMatch == 8);
 	spa_assert(SPA_IO_Memory == 9);
+	spa_assert(SPA_IO_Meter == 10);
 
 #if defined(__x86_64__)
 	spa_assert(sizeof(struct spa_io_buffers) == 8);
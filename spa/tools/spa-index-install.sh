@@ -0,0 +1,10 @@
+#!/bin/sh
+# Generate the factory index in the installed plugin directory.
+#
+# usage: spa-index-install.sh <spa-index> <plugin-dir>
+
+spa_index="$1"
+plugindir="${DESTDIR}$2"
+
+echo "Generating ${plugindir}/factory.index"
+"${spa_index}" "${plugindir}" "${plugindir}/factory.index"
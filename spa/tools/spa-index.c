@@ -0,0 +1,158 @@
+/* Simple Plugin API
+ *
+ * Copyright © 2020 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <limits.h>
+#include <dirent.h>
+#include <dlfcn.h>
+
+#include <spa/support/plugin.h>
+#include <spa/utils/result.h>
+
+/* Generate the factory index for a plugin directory.
+ *
+ * Each plugin in the subdirectories of the plugin directory is opened and
+ * all of its factories and interfaces are written as:
+ *
+ *   <factory-name> <library-name> <interface>,...
+ *
+ * The output should be saved as factory.index in the plugin directory so
+ * that factories can be found without opening every library. */
+
+static int is_plugin(const struct dirent *entry)
+{
+	size_t len = strlen(entry->d_name);
+	return len > 3 && strcmp(entry->d_name + len - 3, ".so") == 0;
+}
+
+static int is_subdir(const struct dirent *entry)
+{
+	return entry->d_name[0] != '.' &&
+		(entry->d_type == DT_DIR || entry->d_type == DT_UNKNOWN);
+}
+
+static void print_interfaces(FILE *out, const struct spa_handle_factory *factory)
+{
+	const struct spa_interface_info *info;
+	uint32_t index;
+	int res;
+	const char *sep = "";
+
+	for (index = 0;;) {
+		if ((res = spa_handle_factory_enum_interface_info(factory, &info, &index)) <= 0)
+			break;
+		fprintf(out, "%s%s", sep, info->type);
+		sep = ",";
+	}
+}
+
+static int index_plugin(FILE *out, const char *dir, const char *subdir, const char *name)
+{
+	char path[PATH_MAX], lib[PATH_MAX];
+	void *handle;
+	spa_handle_factory_enum_func_t enum_func;
+	uint32_t index;
+	int res;
+
+	snprintf(path, sizeof(path), "%s/%s/%s", dir, subdir, name);
+	/* library names are relative to the plugin dir, without .so */
+	snprintf(lib, sizeof(lib), "%s/%.*s", subdir, (int)strlen(name) - 3, name);
+
+	if ((handle = dlopen(path, RTLD_LAZY)) == NULL) {
+		fprintf(stderr, "can't load %s: %s\n", path, dlerror());
+		return -ENOENT;
+	}
+	if ((enum_func = dlsym(handle, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		dlclose(handle);
+		return 0;
+	}
+
+	for (index = 0;;) {
+		const struct spa_handle_factory *factory;
+
+		if ((res = enum_func(&factory, &index)) <= 0) {
+			if (res != 0)
+				fprintf(stderr, "error enum_func %s: %s\n", path, spa_strerror(res));
+			break;
+		}
+		if (factory->version < 1)
+			continue;
+
+		fprintf(out, "%s %s ", factory->name, lib);
+		print_interfaces(out, factory);
+		fprintf(out, "\n");
+	}
+	dlclose(handle);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *dir;
+	struct dirent **subdirs, **plugins;
+	FILE *out = stdout;
+	int i, j, n_subdirs, n_plugins;
+
+	if (argc > 1)
+		dir = argv[1];
+	else if ((dir = getenv("SPA_PLUGIN_DIR")) == NULL) {
+		printf("usage: %s <plugin-dir> [<output>]\n", argv[0]);
+		return -1;
+	}
+
+	if ((n_subdirs = scandir(dir, &subdirs, is_subdir, alphasort)) < 0) {
+		fprintf(stderr, "can't scan %s: %m\n", dir);
+		return -1;
+	}
+
+	if (argc > 2 && (out = fopen(argv[2], "we")) == NULL) {
+		fprintf(stderr, "can't open %s: %m\n", argv[2]);
+		return -1;
+	}
+
+	fprintf(out, "# generated by spa-index, do not edit\n");
+
+	for (i = 0; i < n_subdirs; i++) {
+		char path[PATH_MAX];
+
+		snprintf(path, sizeof(path), "%s/%s", dir, subdirs[i]->d_name);
+		if ((n_plugins = scandir(path, &plugins, is_plugin, alphasort)) >= 0) {
+			for (j = 0; j < n_plugins; j++) {
+				index_plugin(out, dir, subdirs[i]->d_name, plugins[j]->d_name);
+				free(plugins[j]);
+			}
+			free(plugins);
+		}
+		free(subdirs[i]);
+	}
+	free(subdirs);
+
+	if (out != stdout)
+		fclose(out);
+
+	return 0;
+}
@@ -56,9 +56,20 @@ struct impl {
 	uint32_t sample_rate;
 
 	struct spa_list node_list;
+	struct spa_list bucket_list;
+	struct spa_list dirty_list;	/**< streams that need a rescan */
 	int seq;
 };
 
+/* the nodes of one media and direction, ordered by priority and plugged
+ * time so that the first usable node is the best target */
+struct bucket {
+	struct spa_list link;		/**< link in impl bucket_list */
+	enum pw_direction direction;
+	struct spa_list node_list;
+	char media[];
+};
+
 struct node {
 	struct sm_node *obj;
 
@@ -68,6 +79,11 @@ struct node {
 	struct spa_list link;		/**< link in impl node_list */
 	enum pw_direction direction;
 
+	struct bucket *bucket;		/**< bucket of the node */
+	struct spa_list bucket_link;	/**< link in bucket node_list */
+	struct bucket *target_bucket;	/**< bucket with the possible targets */
+	struct spa_list dirty_link;	/**< link in impl dirty_list */
+
 	struct spa_hook listener;
 
 	struct node *peer;
@@ -87,8 +103,60 @@ struct node {
 	unsigned int active:1;
 	unsigned int exclusive:1;
 	unsigned int enabled:1;
+	unsigned int dirty:1;
 };
 
+static struct bucket *get_bucket(struct impl *impl, const char *media,
+		enum pw_direction direction)
+{
+	struct bucket *b;
+
+	spa_list_for_each(b, &impl->bucket_list, link) {
+		if (b->direction == direction && strcmp(b->media, media) == 0)
+			return b;
+	}
+	b = calloc(1, sizeof(struct bucket) + strlen(media) + 1);
+	if (b == NULL)
+		return NULL;
+
+	b->direction = direction;
+	strcpy(b->media, media);
+	spa_list_init(&b->node_list);
+	spa_list_append(&impl->bucket_list, &b->link);
+	return b;
+}
+
+static void bucket_add_node(struct bucket *b, struct node *node)
+{
+	struct node *n;
+
+	/* after the nodes with the same priority and plugged time so that
+	 * the oldest one wins */
+	spa_list_for_each(n, &b->node_list, bucket_link) {
+		if (node->priority > n->priority ||
+		    (node->priority == n->priority && node->plugged > n->plugged))
+			break;
+	}
+	spa_list_append(&n->bucket_link, &node->bucket_link);
+	node->bucket = b;
+}
+
+static void mark_dirty(struct impl *impl, struct node *node)
+{
+	if (node->dirty || node->type != NODE_TYPE_STREAM)
+		return;
+	spa_list_append(&impl->dirty_list, &node->dirty_link);
+	node->dirty = true;
+}
+
+static void clear_dirty(struct node *node)
+{
+	if (!node->dirty)
+		return;
+	spa_list_remove(&node->dirty_link);
+	node->dirty = false;
+}
+
 static int activate_node(struct node *node)
 {
 	struct impl *impl = node->impl;
@@ -159,6 +227,8 @@ static void object_update(void *data)
 	if (node->obj->obj.avail & SM_NODE_CHANGE_MASK_PARAMS &&
 	    !node->active)
 		activate_node(node);
+
+	mark_dirty(impl, node);
 }
 
 static const struct sm_object_events object_events = {
@@ -172,6 +242,7 @@ handle_node(struct impl *impl, struct sm_object *object)
 	const char *str, *media_class;
 	enum pw_direction direction;
 	struct node *node;
+	struct bucket *bucket;
 	uint32_t client_id = SPA_ID_INVALID;
 
 	if (object->props) {
@@ -262,6 +333,13 @@ handle_node(struct impl *impl, struct sm_object *object)
 				object->id, node->media, node->priority);
 	}
 
+	if ((bucket = get_bucket(impl, node->media, node->direction)) == NULL ||
+	    (node->target_bucket = get_bucket(impl, node->media,
+			pw_direction_reverse(node->direction))) == NULL)
+		return -errno;
+	bucket_add_node(bucket, node);
+	mark_dirty(impl, node);
+
 	node->enabled = true;
 	node->obj->obj.mask |= SM_NODE_CHANGE_MASK_PARAMS;
 	sm_object_add_listener(&node->obj->obj, &node->listener, &object_events, node);
@@ -272,6 +350,9 @@ handle_node(struct impl *impl, struct sm_object *object)
 static void destroy_node(struct impl *impl, struct node *node)
 {
 	spa_list_remove(&node->link);
+	if (node->bucket)
+		spa_list_remove(&node->bucket_link);
+	clear_dirty(node);
 	if (node->enabled)
 		spa_hook_remove(&node->listener);
 	free(node->media);
@@ -307,76 +388,57 @@ static void session_remove(void *data, struct sm_object *object)
 	if (strcmp(object->type, PW_TYPE_INTERFACE_Node) == 0) {
 		struct node *n, *node;
 
-		if ((node = sm_object_get_data(object, SESSION_KEY)) != NULL)
+		if ((node = sm_object_get_data(object, SESSION_KEY)) != NULL) {
 			destroy_node(impl, node);
 
-		spa_list_for_each(n, &impl->node_list, link) {
-			if (n->peer == node)
-				n->peer = NULL;
+			spa_list_for_each(n, &impl->node_list, link) {
+				if (n->peer == node) {
+					n->peer = NULL;
+					mark_dirty(impl, n);
+				}
+			}
 		}
 	}
 
 	sm_media_session_schedule_rescan(impl->session);
 }
 
-struct find_data {
-	struct impl *impl;
-	struct node *target;
-	struct node *node;
-	bool exclusive;
-	int priority;
-	uint64_t plugged;
-};
-
-static int find_node(void *data, struct node *node)
+static bool can_link(struct impl *impl, struct node *node, bool exclusive)
 {
-	struct find_data *find = data;
-	struct impl *impl = find->impl;
-	int priority = 0;
-	uint64_t plugged = 0;
 	struct sm_device *device = node->obj->device;
 
 	pw_log_debug(NAME " %p: looking at node '%d' enabled:%d state:%d peer:%p exclusive:%d",
 			impl, node->id, node->enabled, node->obj->info->state, node->peer, node->exclusive);
 
-	if (!node->enabled || node->type == NODE_TYPE_UNKNOWN)
-		return 0;
+	if (!node->enabled)
+		return false;
 
 	if (device && device->locked) {
 		pw_log_debug(".. device locked");
-		return 0;
+		return false;
 	}
 
-	if (node->direction == find->target->direction) {
-		pw_log_debug(".. same direction");
-		return 0;
-	}
-	if (strcmp(node->media, find->target->media) != 0) {
-		pw_log_debug(".. incompatible media %s <-> %s", node->media, find->target->media);
-		return 0;
-	}
-
-	plugged = node->plugged;
-	priority = node->priority;
-
-	if ((find->exclusive && node->obj->info->state == PW_NODE_STATE_RUNNING) ||
+	if ((exclusive && node->obj->info->state == PW_NODE_STATE_RUNNING) ||
 	    (node->peer && node->peer->exclusive)) {
 		pw_log_debug(NAME " %p: node '%d' in use", impl, node->id);
-		return 0;
+		return false;
 	}
+	return true;
+}
 
-	pw_log_debug(NAME " %p: found node '%d' %"PRIu64" prio:%d", impl,
-			node->id, plugged, priority);
+static struct node *find_node(struct impl *impl, struct node *target, bool exclusive)
+{
+	struct node *node;
+
+	spa_list_for_each(node, &target->target_bucket->node_list, bucket_link) {
+		if (!can_link(impl, node, exclusive))
+			continue;
 
-	if (find->node == NULL ||
-	    priority > find->priority ||
-	    (priority == find->priority && plugged > find->plugged)) {
-		pw_log_debug(NAME " %p: new best %d %" PRIu64, impl, priority, plugged);
-		find->node = node;
-		find->priority = priority;
-		find->plugged = plugged;
+		pw_log_debug(NAME " %p: found node '%d' %"PRIu64" prio:%d", impl,
+				node->id, node->plugged, node->priority);
+		return node;
 	}
-	return 0;
+	return NULL;
 }
 
 static int link_nodes(struct node *node, struct node *peer)
@@ -412,7 +474,6 @@ static int rescan_node(struct impl *impl, struct node *n)
 	struct spa_dict *props;
         const char *str;
         bool exclusive;
-        struct find_data find;
 	struct pw_node_info *info;
 	struct node *peer;
 	struct sm_object *obj;
@@ -449,17 +510,11 @@ static int rescan_node(struct impl *impl, struct node *n)
 		return 0;
 	}
 
-	spa_zero(find);
-
 	if ((str = spa_dict_lookup(props, PW_KEY_NODE_EXCLUSIVE)) != NULL)
 		exclusive = pw_properties_parse_bool(str);
 	else
 		exclusive = false;
 
-	find.impl = impl;
-	find.target = n;
-	find.exclusive = exclusive;
-
 	pw_log_debug(NAME " %p: exclusive:%d", impl, exclusive);
 
 	str = spa_dict_lookup(props, PW_KEY_NODE_TARGET);
@@ -477,10 +532,7 @@ static int rescan_node(struct impl *impl, struct node *n)
 		}
 	}
 
-	spa_list_for_each(peer, &impl->node_list, link)
-		find_node(&find, peer);
-
-	if (find.node == NULL) {
+	if ((peer = find_node(impl, n, exclusive)) == NULL) {
 		struct sm_object *obj;
 
 		pw_log_warn(NAME " %p: no node found for %d", impl, n->id);
@@ -497,7 +549,6 @@ static int rescan_node(struct impl *impl, struct node *n)
 		}
 		return -ENOENT;
 	}
-	peer = find.node;
 
 	if (exclusive && peer->obj->info->state == PW_NODE_STATE_RUNNING) {
 		pw_log_warn(NAME" %p: node %d busy, can't get exclusive access", impl, peer->id);
@@ -529,18 +580,33 @@ static void session_info(void *data, const struct pw_core_info *info)
 static void session_rescan(void *data, int seq)
 {
 	struct impl *impl = data;
-	struct node *node;
+	struct node *node, *t;
 
 	pw_log_debug(NAME" %p: rescan", impl);
 
-	spa_list_for_each(node, &impl->node_list, link)
-		rescan_node(impl, node);
+	/* nodes without a target stay dirty and are tried again */
+	spa_list_for_each_safe(node, t, &impl->dirty_list, dirty_link) {
+		switch (rescan_node(impl, node)) {
+		case -ENOENT:
+		case -EBUSY:
+			break;
+		default:
+			clear_dirty(node);
+			break;
+		}
+	}
 }
 
 static void session_destroy(void *data)
 {
 	struct impl *impl = data;
+	struct bucket *b;
+
 	spa_hook_remove(&impl->listener);
+	spa_list_consume(b, &impl->bucket_list, link) {
+		spa_list_remove(&b->link);
+		free(b);
+	}
 	free(impl);
 }
 
@@ -567,6 +633,8 @@ int sm_policy_node_start(struct sm_media_session *session)
 	impl->sample_rate = 48000;
 
 	spa_list_init(&impl->node_list);
+	spa_list_init(&impl->bucket_list);
+	spa_list_init(&impl->dirty_list);
 
 	sm_media_session_add_listener(impl->session, &impl->listener, &session_events, impl);
 
@@ -66,6 +66,12 @@ static void
 pool_data_destroy (gpointer user_data)
 {
   GstPipeWirePoolData *data = user_data;
+  guint i;
+
+  /* the memory can outlive the buffer in other buffers */
+  for (i = 0; i < gst_buffer_n_memory (data->buf); i++)
+    gst_mini_object_set_qdata (GST_MINI_OBJECT_CAST (gst_buffer_peek_memory (data->buf, i)),
+                               pool_data_quark, NULL, NULL);
 
   gst_object_unref (data->pool);
   g_slice_free (GstPipeWirePoolData, data);
@@ -105,8 +111,11 @@ void gst_pipewire_pool_wrap_buffer (GstPipeWirePool *pool, struct pw_buffer *b)
                                      d->maxsize, NULL, NULL);
       data->offset = 0;
     }
-    if (gmem)
+    if (gmem) {
+      gst_mini_object_set_qdata (GST_MINI_OBJECT_CAST (gmem),
+                                 pool_data_quark, data, NULL);
       gst_buffer_append_memory (buf, gmem);
+    }
   }
 
   data->pool = gst_object_ref (pool);
@@ -128,6 +137,32 @@ GstPipeWirePoolData *gst_pipewire_pool_get_data (GstBuffer *buffer)
   return gst_mini_object_get_qdata (GST_MINI_OBJECT_CAST (buffer), pool_data_quark);
 }
 
+/* also finds the data of buffers that only share the memory of one of our
+ * buffers, like the copies that upstream elements make */
+GstPipeWirePoolData *gst_pipewire_pool_find_data (GstPipeWirePool *pool, GstBuffer *buffer)
+{
+  GstPipeWirePoolData *data;
+  guint i, n_mem;
+
+  if ((data = gst_pipewire_pool_get_data (buffer)) != NULL)
+    return data->pool == pool ? data : NULL;
+
+  n_mem = gst_buffer_n_memory (buffer);
+  if (n_mem == 0)
+    return NULL;
+
+  data = gst_mini_object_get_qdata (GST_MINI_OBJECT_CAST (gst_buffer_peek_memory (buffer, 0)),
+                                    pool_data_quark);
+  if (data == NULL || data->pool != pool || gst_buffer_n_memory (data->buf) != n_mem)
+    return NULL;
+
+  for (i = 0; i < n_mem; i++) {
+    if (gst_buffer_peek_memory (buffer, i) != gst_buffer_peek_memory (data->buf, i))
+      return NULL;
+  }
+  return data;
+}
+
 #if 0
 gboolean
 gst_pipewire_pool_add_buffer (GstPipeWirePool *pool, GstBuffer *buffer)
@@ -82,6 +82,7 @@ GstPipeWirePool *  gst_pipewire_pool_new           (void);
 void gst_pipewire_pool_wrap_buffer (GstPipeWirePool *pool, struct pw_buffer *buffer);
 
 GstPipeWirePoolData *gst_pipewire_pool_get_data (GstBuffer *buffer);
+GstPipeWirePoolData *gst_pipewire_pool_find_data (GstPipeWirePool *pool, GstBuffer *buffer);
 
 //gboolean        gst_pipewire_pool_add_buffer    (GstPipeWirePool *pool, GstBuffer *buffer);
 //gboolean        gst_pipewire_pool_remove_buffer (GstPipeWirePool *pool, GstBuffer *buffer);
@@ -47,6 +47,8 @@
 #include <spa/pod/builder.h>
 #include <spa/utils/result.h>
 
+#include <gst/video/video.h>
+
 #include "gstpipewireformat.h"
 
 GST_DEBUG_CATEGORY_STATIC (pipewire_sink_debug);
@@ -134,8 +136,19 @@ static gboolean
 gst_pipewire_sink_propose_allocation (GstBaseSink * bsink, GstQuery * query)
 {
   GstPipeWireSink *pwsink = GST_PIPEWIRE_SINK (bsink);
+  GstCaps *caps;
+  GstVideoInfo info;
+  gboolean need_pool;
+  guint size = 0;
+
+  gst_query_parse_allocation (query, &caps, &need_pool);
+
+  /* upstream should allocate frames of the right size from our pool so that
+   * they can be sent without a copy */
+  if (caps && gst_video_info_from_caps (&info, caps))
+    size = info.size;
 
-  gst_query_add_allocation_pool (query, GST_BUFFER_POOL_CAST (pwsink->pool), 0, 0, 0);
+  gst_query_add_allocation_pool (query, GST_BUFFER_POOL_CAST (pwsink->pool), size, 0, 0);
   return TRUE;
 }
 
@@ -421,7 +434,7 @@ do_send_buffer (GstPipeWireSink *pwsink, GstBuffer *buffer)
   guint i;
   struct spa_buffer *b;
 
-  data = gst_pipewire_pool_get_data(buffer);
+  data = gst_pipewire_pool_find_data (pwsink->pool, buffer);
 
   b = data->b->buffer;
 
@@ -572,7 +585,7 @@ gst_pipewire_sink_render (GstBaseSink * bsink, GstBuffer * buffer)
   if (pw_stream_get_state (pwsink->stream, &error) != PW_STREAM_STATE_STREAMING)
     goto done;
 
-  if (buffer->pool != GST_BUFFER_POOL_CAST (pwsink->pool)) {
+  if (gst_pipewire_pool_find_data (pwsink->pool, buffer) == NULL) {
     GstBuffer *b = NULL;
     GstMapInfo info = { 0, };
 
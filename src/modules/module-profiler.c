@@ -47,6 +47,8 @@
 #define MIN_FLUSH		(16 * 1024)
 #define DEFAULT_IDLE		5
 #define DEFAULT_INTERVAL	1
+/* when freewheeling, cycles run back to back and we only sample them */
+#define FREEWHEEL_INTERVAL	(10 * SPA_NSEC_PER_MSEC)
 
 int pw_protocol_native_ext_profiler_init(struct pw_context *context);
 
@@ -74,6 +76,7 @@ struct impl {
 	int64_t count;
 	uint32_t busy;
 	uint32_t empty;
+	uint64_t next_freewheel;
 	struct spa_source *flush_timeout;
 	unsigned int flushing:1;
 	unsigned int listening:1;
@@ -162,6 +165,13 @@ static void context_start(void *data, struct pw_impl_node *node)
 	int32_t filled;
 	uint32_t idx, avail;
 
+	if (SPA_UNLIKELY(SPA_FLAG_IS_SET(pos->clock.flags, SPA_IO_CLOCK_FLAG_FREEWHEEL))) {
+		/* the count and clock position of the samples give the throughput */
+		if (a->finish_time < impl->next_freewheel)
+			goto done;
+		impl->next_freewheel = a->finish_time + FREEWHEEL_INTERVAL;
+	}
+
 	spa_pod_builder_init(&b, buffer, sizeof(buffer));
 	spa_pod_builder_push_object(&b, &f[0],
 			SPA_TYPE_OBJECT_Profiler, 0);
@@ -194,7 +204,13 @@ static void context_start(void *data, struct pw_impl_node *node)
 			SPA_POD_Long(a->signal_time),
 			SPA_POD_Long(a->awake_time),
 			SPA_POD_Long(a->finish_time),
-			SPA_POD_Int(a->status));
+			SPA_POD_Int(a->status),
+			SPA_POD_Int(a->xrun_count));
+
+	spa_pod_builder_prop(&b, SPA_PROFILER_dataThread, 0);
+	spa_pod_builder_add_struct(&b,
+			SPA_POD_Int(impl->context->data_loop_impl->cpu),
+			SPA_POD_Long(impl->context->data_loop_impl->migrations));
 
 	spa_list_for_each(t, &node->rt.target_list, link) {
 		struct pw_impl_node *n = t->node;
@@ -212,7 +228,8 @@ static void context_start(void *data, struct pw_impl_node *node)
 			SPA_POD_Long(na->signal_time),
 			SPA_POD_Long(na->awake_time),
 			SPA_POD_Long(na->finish_time),
-			SPA_POD_Int(na->status));
+			SPA_POD_Int(na->status),
+			SPA_POD_Int(na->xrun_count));
 	}
 	spa_pod_builder_pop(&b, &f[0]);
 
@@ -26,6 +26,7 @@
 #include <time.h>
 #include <stdio.h>
 #include <regex.h>
+#include <pthread.h>
 
 #include <pipewire/log.h>
 
@@ -56,6 +57,9 @@
 #define DEFAULT_VIDEO_RATE_DENOM	1u
 #define DEFAULT_LINK_MAX_BUFFERS	64u
 #define DEFAULT_MEM_ALLOW_MLOCK		true
+#define DEFAULT_MEM_PREFAULT		false
+#define DEFAULT_MEM_MLOCK		false
+#define DEFAULT_MEM_HUGETLB		false
 
 /** \cond */
 struct impl {
@@ -101,6 +105,154 @@ static int load_module_profile(struct pw_context *this, const char *profile)
 	return 0;
 }
 
+static void do_flush_info(void *data, uint64_t count)
+{
+	pw_context_flush_info(data);
+}
+
+static int latency_param(void *data, int seq,
+		uint32_t id, uint32_t index, uint32_t next, struct spa_pod *param)
+{
+	struct pw_impl_port *port = data;
+	struct spa_latency_info info;
+
+	if (spa_latency_parse(param, &info) >= 0)
+		port->latency.own[info.direction] = info;
+	return 0;
+}
+
+/* read the latency the port adds itself, nodes that don't report any
+ * add nothing */
+static void port_read_latency(struct pw_impl_port *port)
+{
+	port->latency.own[SPA_DIRECTION_INPUT] = SPA_LATENCY_INFO(SPA_DIRECTION_INPUT);
+	port->latency.own[SPA_DIRECTION_OUTPUT] = SPA_LATENCY_INFO(SPA_DIRECTION_OUTPUT);
+	port->latency.stale = false;
+
+	pw_impl_port_for_each_param(port, 0, SPA_PARAM_Latency, 0, 0, NULL,
+			latency_param, port);
+}
+
+static void combine_latency(struct spa_latency_info *info, bool *have,
+		const struct spa_latency_info *other)
+{
+	if (*have)
+		spa_latency_info_combine(info, other);
+	else
+		*info = *other;
+	*have = true;
+}
+
+/* The capture latency (SPA_DIRECTION_OUTPUT) of a port is its own latency
+ * plus that of the ports it gets data from: the input ports of the node for
+ * an output port and the linked output ports for an input port. The
+ * playback latency (SPA_DIRECTION_INPUT) goes the other way. Parallel paths
+ * are combined into one range. Ports are visited once per generation, a
+ * cycle sees the partial total of the port that started it. */
+static const struct spa_latency_info *port_get_latency(struct pw_impl_port *port,
+		enum spa_direction direction, uint32_t gen)
+{
+	struct spa_latency_info *total = &port->latency.total[direction];
+	struct spa_latency_info other;
+	struct pw_impl_port *p;
+	struct pw_impl_link *l;
+	bool have = false;
+
+	if (port->latency.gen[direction] == gen)
+		return total;
+
+	port->latency.gen[direction] = gen;
+	*total = port->latency.own[direction];
+
+	if (direction == SPA_DIRECTION_OUTPUT) {
+		if (port->direction == PW_DIRECTION_OUTPUT) {
+			spa_list_for_each(p, &port->node->input_ports, link)
+				combine_latency(&other, &have, port_get_latency(p, direction, gen));
+		} else {
+			spa_list_for_each(l, &port->links, input_link)
+				combine_latency(&other, &have, port_get_latency(l->output, direction, gen));
+		}
+	} else {
+		if (port->direction == PW_DIRECTION_INPUT) {
+			spa_list_for_each(p, &port->node->output_ports, link)
+				combine_latency(&other, &have, port_get_latency(p, direction, gen));
+		} else {
+			spa_list_for_each(l, &port->links, output_link)
+				combine_latency(&other, &have, port_get_latency(l->input, direction, gen));
+		}
+	}
+	if (have)
+		spa_latency_info_add(total, &other);
+
+	return total;
+}
+
+static void port_report_latency(struct pw_impl_port *port, enum spa_direction direction)
+{
+	const struct spa_latency_info *total = &port->latency.total[direction];
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_pod *param;
+	int res;
+
+	if (spa_latency_info_is_equal(total, &port->latency.reported[direction]))
+		return;
+
+	port->latency.reported[direction] = *total;
+
+	pw_log_debug(NAME" %p: port %p %s latency quantum:%f-%f rate:%u-%u ns:%"PRIu64"-%"PRIu64,
+			port->node->context, port,
+			direction == SPA_DIRECTION_INPUT ? "playback" : "capture",
+			total->min_quantum, total->max_quantum,
+			total->min_rate, total->max_rate,
+			total->min_ns, total->max_ns);
+
+	/* not all nodes want to know, ignore errors */
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	param = spa_latency_build(&b, SPA_PARAM_Latency, total);
+	if ((res = spa_node_port_set_param(port->node->node,
+				port->direction, port->port_id,
+				SPA_PARAM_Latency, 0, param)) < 0)
+		pw_log_trace(NAME" %p: port %p set latency: %s",
+				port->node->context, port, spa_strerror(res));
+}
+
+static void do_recalc_latency(void *data, uint64_t count)
+{
+	struct pw_context *context = data;
+	struct pw_impl_node *n;
+	struct pw_impl_port *p;
+	uint32_t gen, d;
+
+	spa_list_for_each(n, &context->node_list, link) {
+		spa_list_for_each(p, &n->input_ports, link)
+			if (p->latency.stale)
+				port_read_latency(p);
+		spa_list_for_each(p, &n->output_ports, link)
+			if (p->latency.stale)
+				port_read_latency(p);
+	}
+
+	gen = ++context->latency_gen;
+
+	spa_list_for_each(n, &context->node_list, link) {
+		for (d = 0; d < 2; d++) {
+			spa_list_for_each(p, &n->input_ports, link)
+				port_get_latency(p, d, gen);
+			spa_list_for_each(p, &n->output_ports, link)
+				port_get_latency(p, d, gen);
+		}
+	}
+	spa_list_for_each(n, &context->node_list, link) {
+		for (d = 0; d < 2; d++) {
+			spa_list_for_each(p, &n->input_ports, link)
+				port_report_latency(p, d);
+			spa_list_for_each(p, &n->output_ports, link)
+				port_report_latency(p, d);
+		}
+	}
+}
+
 static void fill_properties(struct pw_context *context)
 {
 	struct pw_properties *properties = context->properties;
@@ -174,6 +326,9 @@ static void fill_defaults(struct pw_context *this)
 	this->defaults.video_rate.denom = get_default_int(p, "default.video.rate.denom", DEFAULT_VIDEO_RATE_DENOM);
 	this->defaults.link_max_buffers = get_default_int(p, "link.max-buffers", DEFAULT_LINK_MAX_BUFFERS);
 	this->defaults.mem_allow_mlock = get_default_bool(p, "mem.allow-mlock", DEFAULT_MEM_ALLOW_MLOCK);
+	this->defaults.mem_prefault = get_default_bool(p, PW_KEY_MEM_PREFAULT, DEFAULT_MEM_PREFAULT);
+	this->defaults.mem_mlock = get_default_bool(p, PW_KEY_MEM_MLOCK, DEFAULT_MEM_MLOCK);
+	this->defaults.mem_hugetlb = get_default_bool(p, PW_KEY_MEM_HUGETLB, DEFAULT_MEM_HUGETLB);
 
 	this->defaults.clock_max_quantum = SPA_CLAMP(this->defaults.clock_max_quantum,
 			CLOCK_MIN_QUANTUM, CLOCK_MAX_QUANTUM);
@@ -232,6 +387,14 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 	pr = pw_properties_copy(properties);
 	if ((str = pw_properties_get(pr, "context.data-loop." PW_KEY_LIBRARY_NAME_SYSTEM)))
 		pw_properties_set(pr, PW_KEY_LIBRARY_NAME_SYSTEM, str);
+	if ((str = pw_properties_get(pr, PW_KEY_CPU_RT_AFFINITY))) {
+		const char *iso = pw_properties_get(pr, PW_KEY_CPU_RT_ISOLATE);
+		/* threads created from here on inherit the isolation, the
+		 * data thread moves itself to the realtime CPUs */
+		if (iso && pw_properties_parse_bool(iso))
+			pw_thread_set_affinity(pthread_self(), str, true);
+		pw_properties_set(pr, "loop.cpu-affinity", str);
+	}
 
 	this->data_loop_impl = pw_data_loop_new(&pr->dict);
 	pw_properties_free(pr);
@@ -240,7 +403,13 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 		goto error_free;
 	}
 
-	this->pool = pw_mempool_new(NULL);
+	/* buffers and activation records are allocated from this pool, they
+	 * can be prefaulted and locked so that the data thread doesn't fault */
+	this->pool = pw_mempool_new(pw_properties_new(
+				PW_KEY_MEM_PREFAULT, this->defaults.mem_prefault ? "true" : "false",
+				PW_KEY_MEM_MLOCK, this->defaults.mem_mlock ? "true" : "false",
+				PW_KEY_MEM_HUGETLB, this->defaults.mem_hugetlb ? "true" : "false",
+				NULL));
 	if (this->pool == NULL) {
 		res = -errno;
 		goto error_free_loop;
@@ -250,6 +419,18 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 	this->data_system = this->data_loop->system;
 	this->main_loop = main_loop;
 
+	spa_list_init(&this->info_list);
+	this->info_event = pw_loop_add_event(main_loop, do_flush_info, this);
+	if (this->info_event == NULL) {
+		res = -errno;
+		goto error_free_loop;
+	}
+	this->latency_event = pw_loop_add_event(main_loop, do_recalc_latency, this);
+	if (this->latency_event == NULL) {
+		res = -errno;
+		goto error_free_loop;
+	}
+
 	n_support = pw_get_support(this->support, SPA_N_ELEMENTS(this->support));
 	this->support[n_support++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_System, this->main_loop->system);
 	this->support[n_support++] = SPA_SUPPORT_INIT(SPA_TYPE_INTERFACE_Loop, this->main_loop->loop);
@@ -323,6 +504,10 @@ struct pw_context *pw_context_new(struct pw_loop *main_loop,
 	return this;
 
 error_free_loop:
+	if (this->info_event)
+		pw_loop_destroy_source(main_loop, this->info_event);
+	if (this->latency_event)
+		pw_loop_destroy_source(main_loop, this->latency_event);
 	pw_data_loop_destroy(this->data_loop_impl);
 error_free:
 	free(this);
@@ -398,6 +583,9 @@ void pw_context_destroy(struct pw_context *context)
 
 	pw_map_clear(&context->globals);
 
+	pw_loop_destroy_source(context->main_loop, context->info_event);
+	pw_loop_destroy_source(context->main_loop, context->latency_event);
+
 	free(context);
 }
 
@@ -976,11 +1164,12 @@ const char *pw_context_find_spa_lib(struct pw_context *context, const char *fact
 {
 	struct factory_entry *entry;
 
+	/* the configured regexps override the generated factory index */
 	pw_array_for_each(entry, &context->factory_lib) {
 		if (regexec(&entry->regex, factory_name, 0, NULL, 0) == 0)
 			return entry->lib;
 	}
-	return NULL;
+	return pw_find_spa_lib(factory_name);
 }
 
 SPA_EXPORT
@@ -1079,3 +1268,45 @@ void *pw_context_get_object(struct pw_context *context, const char *type)
 
 	return NULL;
 }
+
+void pw_context_queue_latency(struct pw_context *context)
+{
+	pw_loop_signal_event(context->main_loop, context->latency_event);
+}
+
+/** Queue the info notification of an object
+ *
+ * \a notify is flushed once, from the main loop or before a sync reply,
+ * however often it is queued until then.
+ */
+SPA_EXPORT
+void pw_context_queue_info(struct pw_context *context, struct pw_info_notify *notify)
+{
+	if (notify->queued)
+		return;
+	if (spa_list_is_empty(&context->info_list))
+		pw_loop_signal_event(context->main_loop, context->info_event);
+	spa_list_append(&context->info_list, &notify->link);
+	notify->queued = true;
+}
+
+SPA_EXPORT
+void pw_context_cancel_info(struct pw_context *context, struct pw_info_notify *notify)
+{
+	if (!notify->queued)
+		return;
+	spa_list_remove(&notify->link);
+	notify->queued = false;
+}
+
+SPA_EXPORT
+void pw_context_flush_info(struct pw_context *context)
+{
+	struct pw_info_notify *notify;
+
+	spa_list_consume(notify, &context->info_list, link) {
+		spa_list_remove(&notify->link);
+		notify->queued = false;
+		notify->flush(notify);
+	}
+}
@@ -23,6 +23,7 @@
  */
 
 #include <pthread.h>
+#include <sched.h>
 #include <errno.h>
 #include <sys/resource.h>
 
@@ -32,6 +33,10 @@
 
 #define NAME "data-loop"
 
+#ifdef __FreeBSD__
+static int sched_getcpu(void) { return -1; }
+#endif
+
 SPA_EXPORT
 int pw_data_loop_wait(struct pw_data_loop *this, int timeout)
 {
@@ -69,6 +74,8 @@ static void *do_loop(void *user_data)
 	int res;
 
 	pw_log_debug(NAME" %p: enter thread", this);
+	if (this->affinity)
+		pw_thread_set_affinity(pthread_self(), this->affinity, false);
 	pw_loop_enter(this->loop);
 
 	pthread_cleanup_push(thread_cleanup, this);
@@ -80,6 +87,11 @@ static void *do_loop(void *user_data)
 			pw_log_error(NAME" %p: iterate error %d (%s)",
 					this, res, spa_strerror(res));
 		}
+		if (SPA_UNLIKELY((res = sched_getcpu()) != this->cpu)) {
+			if (this->cpu >= 0)
+				this->migrations++;
+			this->cpu = res;
+		}
 	}
 	pthread_cleanup_pop(1);
 
@@ -128,6 +140,11 @@ static struct pw_data_loop *loop_new(struct pw_loop *loop, const struct spa_dict
 			goto error_loop_destroy;
 		}
 	}
+	if (props != NULL &&
+	    (str = spa_dict_lookup(props, "loop.cpu-affinity")) != NULL)
+		this->affinity = strdup(str);
+	this->cpu = -1;
+
 	spa_hook_list_init(&this->listener_list);
 
 	return this;
@@ -171,6 +188,7 @@ void pw_data_loop_destroy(struct pw_data_loop *loop)
 		pw_loop_destroy_source(loop->loop, loop->event);
 	if (loop->created)
 		pw_loop_destroy(loop->loop);
+	free(loop->affinity);
 	free(loop);
 }
 
@@ -265,3 +283,44 @@ int pw_data_loop_invoke(struct pw_data_loop *loop,
 		res = func(loop->loop->loop, false, seq, data, size, user_data);
 	return res;
 }
+
+struct faults {
+	uint64_t minor;
+	uint64_t major;
+};
+
+static int do_get_faults(struct spa_loop *loop,
+		bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct faults *f = user_data;
+	struct rusage ru;
+#ifdef RUSAGE_THREAD
+	int who = RUSAGE_THREAD;
+#else
+	int who = RUSAGE_SELF;
+#endif
+	if (getrusage(who, &ru) < 0)
+		return -errno;
+
+	f->minor = ru.ru_minflt;
+	f->major = ru.ru_majflt;
+	return 0;
+}
+
+/** Get the number of page faults of the processing thread.
+ * When the thread is not running, the faults of the caller thread
+ * are returned. */
+SPA_EXPORT
+int pw_data_loop_get_faults(struct pw_data_loop *loop, uint64_t *minor, uint64_t *major)
+{
+	struct faults f = { 0, };
+	int res;
+
+	if ((res = pw_data_loop_invoke(loop, do_get_faults, 0, NULL, 0, true, &f)) < 0)
+		return res;
+	if (minor)
+		*minor = f.minor;
+	if (major)
+		*major = f.major;
+	return 0;
+}
@@ -88,6 +88,9 @@ int pw_data_loop_invoke(struct pw_data_loop *loop,
 		spa_invoke_func_t func, uint32_t seq, const void *data, size_t size,
 		bool block, void *user_data);
 
+/** Get the minor and major page faults of the processing thread. Since 0.3.6 */
+int pw_data_loop_get_faults(struct pw_data_loop *loop, uint64_t *minor, uint64_t *major);
+
 #ifdef __cplusplus
 }
 #endif
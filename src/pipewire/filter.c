@@ -46,9 +46,8 @@
 
 #define MAX_SAMPLES	8192
 #define MAX_BUFFERS	64
-
-#define MASK_BUFFERS	(MAX_BUFFERS-1)
 #define MAX_PORTS	1024
+#define MAX_ALIGN	64
 
 static float empty[MAX_SAMPLES];
 
@@ -61,12 +60,29 @@ struct buffer {
 };
 
 struct queue {
-	uint32_t ids[MAX_BUFFERS];
+	uint32_t *ids;
+	uint32_t mask;
 	struct spa_ringbuffer ring;
 	uint64_t incount;
 	uint64_t outcount;
 };
 
+/* the buffers of a port with the ids of its dequeued and queued queue,
+ * allocated in one block and handed to the data thread with invoke */
+struct port_buffers {
+	struct buffer *buffers;
+	uint32_t n_buffers;
+	uint32_t *ids[2];
+	uint32_t mask;
+};
+
+/* a new port and the array to look it up on the data thread */
+struct port_slot {
+	struct port *port;
+	struct port **ports;
+	uint32_t n_ports;
+};
+
 struct data {
 	struct pw_context *context;
 	struct spa_hook filter_listener;
@@ -99,7 +115,7 @@ struct port {
 
 	struct spa_io_buffers *io;
 
-	struct buffer buffers[MAX_BUFFERS];
+	struct buffer *buffers;
 	uint32_t n_buffers;
 
 	struct queue dequeued;
@@ -125,10 +141,12 @@ struct filter {
 
 	struct {
 		struct spa_io_position *position;
+		struct port **ports[2];		/* indexed by port id */
+		uint32_t n_ports[2];
 	} rt;
 
 	struct spa_list port_list;;
-	struct port *ports[2][MAX_PORTS];
+	struct pw_map ports[2];
 
 	uint32_t change_mask_all;
 	struct spa_node_info info;
@@ -231,33 +249,111 @@ static struct port *alloc_port(struct filter *filter,
 		enum spa_direction direction, uint32_t user_data_size)
 {
 	struct port *p;
-	int i;
+	uint32_t id;
 
-	for (i = 0; i < MAX_PORTS; i++) {
-		if ((p = filter->ports[direction][i]) == NULL)
-			break;
-	}
-	if (i == MAX_PORTS)
+	p = calloc(1, sizeof(struct port) + user_data_size);
+	if (p == NULL)
 		return NULL;
 
-	p = calloc(1, sizeof(struct port) + user_data_size);
+	id = pw_map_insert_new(&filter->ports[direction], p);
+	if (id == SPA_ID_INVALID || id >= MAX_PORTS) {
+		if (id != SPA_ID_INVALID)
+			pw_map_remove(&filter->ports[direction], id);
+		free(p);
+		errno = ENOSPC;
+		return NULL;
+	}
 	p->filter = filter;
 	p->direction = direction;
-	p->id = i;
+	p->id = id;
 
 	spa_list_init(&p->param_list);
 	spa_ringbuffer_init(&p->dequeued.ring);
 	spa_ringbuffer_init(&p->queued.ring);
 
-	filter->ports[direction][i] = p;
-	spa_list_append(&filter->port_list, &p->link);
-
 	return p;
 }
 
+static int
+do_add_port(struct spa_loop *loop,
+		bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct filter *impl = user_data;
+	const struct port_slot *slot = data;
+	struct port *p = slot->port;
+
+	impl->rt.ports[p->direction] = slot->ports;
+	impl->rt.n_ports[p->direction] = slot->n_ports;
+	slot->ports[p->id] = p;
+	spa_list_append(&impl->port_list, &p->link);
+	return 0;
+}
+
+/* The data thread looks up ports in rt.ports and walks the port_list. Both
+ * are only changed on the data thread. When rt.ports is too small, a larger
+ * copy is made here and swapped in, the old one is freed after the swap. */
+static int add_port(struct filter *impl, struct port *p)
+{
+	enum spa_direction direction = p->direction;
+	struct port **old = NULL;
+	struct port_slot slot;
+
+	slot.port = p;
+	slot.ports = impl->rt.ports[direction];
+	slot.n_ports = impl->rt.n_ports[direction];
+
+	if (p->id >= slot.n_ports) {
+		uint32_t n_ports = SPA_MAX(slot.n_ports, 16u);
+
+		while (n_ports <= p->id)
+			n_ports *= 2;
+
+		if ((slot.ports = calloc(n_ports, sizeof(struct port *))) == NULL)
+			return -errno;
+		if (slot.n_ports > 0)
+			memcpy(slot.ports, impl->rt.ports[direction],
+					slot.n_ports * sizeof(struct port *));
+
+		old = impl->rt.ports[direction];
+		slot.n_ports = n_ports;
+	}
+	pw_loop_invoke(impl->context->data_loop,
+			do_add_port, 1, &slot, sizeof(slot), true, impl);
+	free(old);
+
+	return 0;
+}
+
+static int
+do_remove_port(struct spa_loop *loop,
+		bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct filter *impl = user_data;
+	struct port *p = *(struct port **)data;
+
+	impl->rt.ports[p->direction][p->id] = NULL;
+	spa_list_remove(&p->link);
+	return 0;
+}
+
+static void remove_port(struct filter *impl, struct port *p)
+{
+	pw_loop_invoke(impl->context->data_loop,
+			do_remove_port, 1, &p, sizeof(p), true, impl);
+	pw_map_remove(&impl->ports[p->direction], p->id);
+}
+
 static inline struct port *get_port(struct filter *filter, enum spa_direction direction, uint32_t port_id)
 {
-	return filter->ports[direction][port_id];
+	return pw_map_lookup(&filter->ports[direction], port_id);
+}
+
+/* get_port() for the data thread */
+static inline struct port *get_rt_port(struct filter *filter, enum spa_direction direction, uint32_t port_id)
+{
+	if (port_id >= filter->rt.n_ports[direction])
+		return NULL;
+	return filter->rt.ports[direction][port_id];
 }
 
 static inline int push_queue(struct port *port, struct queue *queue, struct buffer *buffer)
@@ -271,7 +367,7 @@ static inline int push_queue(struct port *port, struct queue *queue, struct buff
 	queue->incount += buffer->this.size;
 
 	spa_ringbuffer_get_write_index(&queue->ring, &index);
-	queue->ids[index & MASK_BUFFERS] = buffer->id;
+	queue->ids[index & queue->mask] = buffer->id;
 	spa_ringbuffer_write_update(&queue->ring, index + 1);
 
 	return 0;
@@ -288,7 +384,7 @@ static inline struct buffer *pop_queue(struct port *port, struct queue *queue)
 		return NULL;
 	}
 
-	id = queue->ids[index & MASK_BUFFERS];
+	id = queue->ids[index & queue->mask];
 	spa_ringbuffer_read_update(&queue->ring, index + 1);
 
 	buffer = &port->buffers[id];
@@ -304,6 +400,73 @@ static inline void clear_queue(struct port *port, struct queue *queue)
 	queue->incount = queue->outcount;
 }
 
+/* the buffers and the ids of both queues are allocated in one block, each
+ * on its own cache line. The queues are sized to the next power of 2 so
+ * that we can mask the index */
+static int alloc_buffers(struct port_buffers *pb, uint32_t n_buffers)
+{
+	uint32_t n_ids;
+	size_t size, ids_size;
+	void *p;
+	int res;
+
+	spa_zero(*pb);
+	if (n_buffers > MAX_BUFFERS)
+		return -ENOSPC;
+	if (n_buffers == 0)
+		return 0;
+
+	for (n_ids = 1; n_ids < n_buffers; n_ids <<= 1);
+
+	size = SPA_ROUND_UP_N(n_buffers * sizeof(struct buffer), MAX_ALIGN);
+	ids_size = SPA_ROUND_UP_N(n_ids * sizeof(uint32_t), MAX_ALIGN);
+	if ((res = posix_memalign(&p, MAX_ALIGN, size + 2 * ids_size)) != 0)
+		return -res;
+	memset(p, 0, size + 2 * ids_size);
+
+	pb->buffers = p;
+	pb->n_buffers = n_buffers;
+	pb->ids[0] = SPA_MEMBER(p, size, uint32_t);
+	pb->ids[1] = SPA_MEMBER(p, size + ids_size, uint32_t);
+	pb->mask = n_ids - 1;
+
+	return 0;
+}
+
+static int
+do_set_buffers(struct spa_loop *loop,
+		bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct port *port = user_data;
+	const struct port_buffers *pb = data;
+	uint32_t i;
+
+	port->buffers = pb->buffers;
+	port->dequeued.ids = pb->ids[0];
+	port->dequeued.mask = pb->mask;
+	port->queued.ids = pb->ids[1];
+	port->queued.mask = pb->mask;
+	clear_queue(port, &port->dequeued);
+	clear_queue(port, &port->queued);
+	port->n_buffers = pb->n_buffers;
+
+	if (port->direction == SPA_DIRECTION_OUTPUT) {
+		for (i = 0; i < port->n_buffers; i++) {
+			pw_log_trace(NAME" %p: recycle buffer %d", port->filter, i);
+			push_queue(port, &port->dequeued, &port->buffers[i]);
+		}
+	}
+	return 0;
+}
+
+/* install new buffers on the data thread, after this the data thread
+ * doesn't use the old buffers anymore */
+static void set_buffers(struct port *port, const struct port_buffers *pb)
+{
+	pw_loop_invoke(port->filter->context->data_loop,
+			do_set_buffers, 1, pb, sizeof(*pb), true, port);
+}
+
 static bool filter_set_state(struct pw_filter *filter, enum pw_filter_state state, const char *error)
 {
 	enum pw_filter_state old = filter->state;
@@ -577,13 +740,20 @@ static int unmap_data(struct filter *impl, struct spa_data *data)
 
 static void clear_buffers(struct port *port)
 {
-	uint32_t i, j;
+	uint32_t i, j, n_buffers = port->n_buffers;
+	struct buffer *buffers = port->buffers;
 	struct filter *impl = port->filter;
+	struct port_buffers none = { NULL, };
+
+	pw_log_debug(NAME" %p: clear buffers %d", impl, n_buffers);
 
-	pw_log_debug(NAME" %p: clear buffers %d", impl, port->n_buffers);
+	if (buffers == NULL)
+		return;
 
-	for (i = 0; i < port->n_buffers; i++) {
-		struct buffer *b = &port->buffers[i];
+	set_buffers(port, &none);
+
+	for (i = 0; i < n_buffers; i++) {
+		struct buffer *b = &buffers[i];
 
 		pw_filter_emit_remove_buffer(&impl->this, port->user_data, &b->this);
 
@@ -596,9 +766,7 @@ static void clear_buffers(struct port *port)
 			}
 		}
 	}
-	port->n_buffers = 0;
-	clear_queue(port, &port->dequeued);
-	clear_queue(port, &port->queued);
+	free(buffers);
 }
 
 static int impl_port_set_param(void *object,
@@ -649,6 +817,7 @@ static int impl_port_use_buffers(void *object,
 	struct filter *impl = object;
 	struct port *port;
 	struct pw_filter *filter = &impl->this;
+	struct port_buffers pb;
 	uint32_t i, j, impl_flags;
 	int prot, res;
 	int size = 0;
@@ -664,9 +833,12 @@ static int impl_port_use_buffers(void *object,
 
 	clear_buffers(port);
 
+	if ((res = alloc_buffers(&pb, n_buffers)) < 0)
+		return res;
+
 	for (i = 0; i < n_buffers; i++) {
 		int buf_size = 0;
-		struct buffer *b = &port->buffers[i];
+		struct buffer *b = &pb.buffers[i];
 
 		b->flags = 0;
 		b->id = i;
@@ -677,11 +849,12 @@ static int impl_port_use_buffers(void *object,
 				if (d->type == SPA_DATA_MemFd ||
 				    d->type == SPA_DATA_DmaBuf) {
 					if ((res = map_data(impl, d, prot)) < 0)
-						return res;
+						goto error_free;
 				}
 				else if (d->data == NULL) {
 					pw_log_error(NAME" %p: invalid buffer mem", filter);
-					return -EINVAL;
+					res = -EINVAL;
+					goto error_free;
 				}
 				buf_size += d->maxsize;
 			}
@@ -689,7 +862,8 @@ static int impl_port_use_buffers(void *object,
 
 			if (size > 0 && buf_size != size) {
 				pw_log_error(NAME" %p: invalid buffer size %d", filter, buf_size);
-				return -EINVAL;
+				res = -EINVAL;
+				goto error_free;
 			} else
 				size = buf_size;
 		}
@@ -698,23 +872,23 @@ static int impl_port_use_buffers(void *object,
 	}
 
 	for (i = 0; i < n_buffers; i++) {
-		struct buffer *b = &port->buffers[i];
+		struct buffer *b = &pb.buffers[i];
 
 		b->flags = 0;
 		b->id = i;
 		b->this.buffer = buffers[i];
 
-		if (port->direction == SPA_DIRECTION_OUTPUT) {
-			pw_log_trace(NAME" %p: recycle buffer %d", filter, b->id);
-			push_queue(port, &port->dequeued, b);
-		}
-
 		pw_filter_emit_add_buffer(filter, port->user_data, &b->this);
 	}
 
-	port->n_buffers = n_buffers;
+	/* output buffers are queued for dequeue on the data thread */
+	set_buffers(port, &pb);
 
 	return 0;
+
+error_free:
+	free(pb.buffers);
+	return res;
 }
 
 static int impl_port_reuse_buffer(void *object, uint32_t port_id, uint32_t buffer_id)
@@ -722,7 +896,7 @@ static int impl_port_reuse_buffer(void *object, uint32_t port_id, uint32_t buffe
 	struct filter *impl = object;
 	struct port *port;
 
-	if ((port = get_port(impl, SPA_DIRECTION_OUTPUT, port_id)) == NULL)
+	if ((port = get_rt_port(impl, SPA_DIRECTION_OUTPUT, port_id)) == NULL)
 		return -EINVAL;
 
 	pw_log_trace(NAME" %p: recycle buffer %d", impl, buffer_id);
@@ -971,6 +1145,8 @@ filter_new(struct pw_context *context, const char *name,
 
 	spa_list_init(&impl->param_list);
 	spa_list_init(&impl->port_list);
+	pw_map_init(&impl->ports[SPA_DIRECTION_INPUT], 0, 16 * sizeof(union pw_map_item));
+	pw_map_init(&impl->ports[SPA_DIRECTION_OUTPUT], 0, 16 * sizeof(union pw_map_item));
 
 	spa_hook_list_init(&this->listener_list);
 	spa_list_init(&this->controls);
@@ -1075,6 +1251,7 @@ SPA_EXPORT
 void pw_filter_destroy(struct pw_filter *filter)
 {
 	struct filter *impl = SPA_CONTAINER_OF(filter, struct filter, this);
+	struct port *p;
 
 	pw_log_debug(NAME" %p: destroy", filter);
 
@@ -1087,8 +1264,21 @@ void pw_filter_destroy(struct pw_filter *filter)
 		spa_list_remove(&filter->link);
 	}
 
+	spa_list_consume(p, &impl->port_list, link) {
+		remove_port(impl, p);
+		clear_params(impl, p, SPA_ID_INVALID);
+		pw_properties_free(p->props);
+		free(p->buffers);
+		free(p);
+	}
+
 	clear_params(impl, NULL, SPA_ID_INVALID);
 
+	pw_map_clear(&impl->ports[SPA_DIRECTION_INPUT]);
+	pw_map_clear(&impl->ports[SPA_DIRECTION_OUTPUT]);
+	free(impl->rt.ports[SPA_DIRECTION_INPUT]);
+	free(impl->rt.ports[SPA_DIRECTION_OUTPUT]);
+
 	pw_log_debug(NAME" %p: free", filter);
 	free(filter->error);
 
@@ -1368,6 +1558,13 @@ void *pw_filter_add_port(struct pw_filter *filter,
 	if ((p = alloc_port(impl, direction, port_data_size)) == NULL)
 		goto error_cleanup;
 
+	if ((res = add_port(impl, p)) < 0) {
+		pw_map_remove(&impl->ports[direction], p->id);
+		free(p);
+		errno = -res;
+		goto error_cleanup;
+	}
+
 	p->props = props;
 	p->flags = flags;
 
@@ -1410,6 +1607,7 @@ void *pw_filter_add_port(struct pw_filter *filter,
 
 error_free:
 	clear_params(impl, p, SPA_ID_INVALID);
+	remove_port(impl, p);
 	free(p);
 error_cleanup:
 	if (props)
@@ -1425,8 +1623,7 @@ int pw_filter_remove_port(void *port_data)
 
 	spa_node_emit_port_info(&impl->hooks, port->direction, port->id, NULL);
 
-	spa_list_remove(&port->link);
-	impl->ports[port->direction][port->id] = NULL;
+	remove_port(impl, port);
 
 	clear_buffers(port);
 	clear_params(impl, port, SPA_ID_INVALID);
@@ -1500,6 +1697,7 @@ int pw_filter_get_time(struct pw_filter *filter, struct pw_time *time)
 	do {
 		seq1 = SEQ_READ(impl->seq);
 		*time = impl->time;
+		SEQ_READ_FENCE();
 		seq2 = SEQ_READ(impl->seq);
 	} while (!SEQ_READ_SUCCESS(seq1, seq2));
 
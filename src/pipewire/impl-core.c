@@ -177,6 +177,8 @@ static int core_sync(void *object, uint32_t id, int seq)
 {
 	struct pw_resource *resource = object;
 	pw_log_trace(NAME" %p: sync %d for resource %d", resource->context, seq, id);
+	/* pending info is sent before the reply */
+	pw_context_flush_info(resource->context);
 	pw_core_resource_done(resource, id, seq);
 	return 0;
 }
@@ -124,6 +124,8 @@ static void check_properties(struct pw_impl_device *device)
 	}
 }
 
+static void flush_info(struct pw_info_notify *notify);
+
 SPA_EXPORT
 struct pw_impl_device *pw_context_create_device(struct pw_context *context,
 				struct pw_properties *properties,
@@ -152,6 +154,7 @@ struct pw_impl_device *pw_context_create_device(struct pw_context *context,
 
 	this->context = context;
 	this->properties = properties;
+	this->info_notify.flush = flush_info;
 
 	this->info.props = &properties->dict;
 	this->info.params = this->params;
@@ -193,6 +196,7 @@ void pw_impl_device_destroy(struct pw_impl_device *device)
 		spa_hook_remove(&device->global_listener);
 		pw_global_destroy(device->global);
 	}
+	pw_context_cancel_info(device->context, &device->info_notify);
 	pw_log_debug(NAME" %p: free", device);
 	pw_impl_device_emit_free(device);
 
@@ -532,14 +536,12 @@ static const struct pw_impl_device_events device_object_events = {
 
 static void emit_info_changed(struct pw_impl_device *device)
 {
-	struct pw_resource *resource;
-
 	pw_impl_device_emit_info_changed(device, &device->info);
 
-	if (device->global)
-		spa_list_for_each(resource, &device->global->resource_list, link)
-			pw_device_resource_info(resource, &device->info);
-
+	if (device->global) {
+		device->info_notify.change_mask |= device->info.change_mask;
+		pw_context_queue_info(device->context, &device->info_notify);
+	}
 	device->info.change_mask = 0;
 }
 
@@ -617,6 +619,40 @@ static void emit_params(struct pw_impl_device *device, uint32_t *changed_ids, ui
 	}
 }
 
+static void flush_info(struct pw_info_notify *notify)
+{
+	struct pw_impl_device *device = SPA_CONTAINER_OF(notify, struct pw_impl_device, info_notify);
+	struct pw_resource *resource;
+
+	if (device->global && notify->change_mask) {
+		device->info.change_mask = notify->change_mask;
+		spa_list_for_each(resource, &device->global->resource_list, link)
+			pw_device_resource_info(resource, &device->info);
+		device->info.change_mask = 0;
+	}
+	notify->change_mask = 0;
+
+	if (notify->n_param_ids > 0) {
+		uint32_t ids[MAX_PARAMS], n_ids = notify->n_param_ids;
+
+		memcpy(ids, notify->param_ids, n_ids * sizeof(uint32_t));
+		notify->n_param_ids = 0;
+		emit_params(device, ids, n_ids);
+	}
+}
+
+static void queue_params(struct pw_impl_device *device, uint32_t *changed_ids, uint32_t n_changed_ids)
+{
+	uint32_t i;
+
+	if (device->global == NULL)
+		return;
+
+	for (i = 0; i < n_changed_ids; i++)
+		pw_info_notify_add_param(&device->info_notify, changed_ids[i]);
+	pw_context_queue_info(device->context, &device->info_notify);
+}
+
 static void device_info(void *data, const struct spa_device_info *info)
 {
 	struct pw_impl_device *device = data;
@@ -647,7 +683,7 @@ static void device_info(void *data, const struct spa_device_info *info)
 	emit_info_changed(device);
 
 	if (n_changed_ids > 0)
-		emit_params(device, changed_ids, n_changed_ids);
+		queue_params(device, changed_ids, n_changed_ids);
 }
 
 static void device_add_object(struct pw_impl_device *device, uint32_t id,
@@ -72,16 +72,28 @@ struct impl {
 
 /** \endcond */
 
-static void info_changed(struct pw_impl_link *link)
+static void flush_info(struct pw_info_notify *notify)
 {
+	struct pw_impl_link *link = SPA_CONTAINER_OF(notify, struct pw_impl_link, info_notify);
 	struct pw_resource *resource;
 
-	pw_impl_link_emit_info_changed(link, &link->info);
-
-	if (link->global)
+	if (link->global && notify->change_mask) {
+		link->info.change_mask = notify->change_mask;
 		spa_list_for_each(resource, &link->global->resource_list, link)
 			pw_link_resource_info(resource, &link->info);
+		link->info.change_mask = 0;
+	}
+	notify->change_mask = 0;
+}
+
+static void info_changed(struct pw_impl_link *link)
+{
+	pw_impl_link_emit_info_changed(link, &link->info);
 
+	if (link->global) {
+		link->info_notify.change_mask |= link->info.change_mask;
+		pw_context_queue_info(link->context, &link->info_notify);
+	}
 	link->info.change_mask = 0;
 }
 
@@ -1033,6 +1045,7 @@ struct pw_impl_link *pw_context_create_link(struct pw_context *context,
 
 	this->context = context;
 	this->properties = properties;
+	this->info_notify.flush = flush_info;
 	this->info.state = PW_LINK_STATE_INIT;
 
 	this->output = output;
@@ -1093,6 +1106,8 @@ struct pw_impl_link *pw_context_create_link(struct pw_context *context,
 	pw_impl_port_emit_link_added(output, this);
 	pw_impl_port_emit_link_added(input, this);
 
+	pw_context_queue_latency(context);
+
 	try_link_controls(impl, output, input);
 
 	pw_impl_node_emit_peer_added(output_node, input_node);
@@ -1236,9 +1251,11 @@ void pw_impl_link_destroy(struct pw_impl_link *link)
 		spa_hook_remove(&link->global_listener);
 		pw_global_destroy(link->global);
 	}
+	pw_context_cancel_info(link->context, &link->info_notify);
 
 	if (link->prepared)
 		pw_context_recalc_graph(link->context, "link destroy");
+	pw_context_queue_latency(link->context);
 
 	pw_log_debug(NAME" %p: free", impl);
 	pw_impl_link_emit_free(link);
@@ -197,17 +197,15 @@ static int start_node(struct pw_impl_node *this)
 
 static void emit_info_changed(struct pw_impl_node *node)
 {
-	struct pw_resource *resource;
-
 	if (node->info.change_mask == 0)
 		return;
 
 	pw_impl_node_emit_info_changed(node, &node->info);
 
-	if (node->global)
-		spa_list_for_each(resource, &node->global->resource_list, link)
-			pw_node_resource_info(resource, &node->info);
-
+	if (node->global) {
+		node->info_notify.change_mask |= node->info.change_mask;
+		pw_context_queue_info(node->context, &node->info_notify);
+	}
 	node->info.change_mask = 0;
 }
 
@@ -239,6 +237,18 @@ static int notify_param(void *data, int seq, uint32_t id,
 	return 0;
 }
 
+static void queue_params(struct pw_impl_node *node, uint32_t *changed_ids, uint32_t n_changed_ids)
+{
+	uint32_t i;
+
+	if (node->global == NULL)
+		return;
+
+	for (i = 0; i < n_changed_ids; i++)
+		pw_info_notify_add_param(&node->info_notify, changed_ids[i]);
+	pw_context_queue_info(node->context, &node->info_notify);
+}
+
 static void emit_params(struct pw_impl_node *node, uint32_t *changed_ids, uint32_t n_changed_ids)
 {
 	uint32_t i;
@@ -268,6 +278,28 @@ static void emit_params(struct pw_impl_node *node, uint32_t *changed_ids, uint32
 	}
 }
 
+static void flush_info(struct pw_info_notify *notify)
+{
+	struct pw_impl_node *node = SPA_CONTAINER_OF(notify, struct pw_impl_node, info_notify);
+	struct pw_resource *resource;
+
+	if (node->global && notify->change_mask) {
+		node->info.change_mask = notify->change_mask;
+		spa_list_for_each(resource, &node->global->resource_list, link)
+			pw_node_resource_info(resource, &node->info);
+		node->info.change_mask = 0;
+	}
+	notify->change_mask = 0;
+
+	if (notify->n_param_ids > 0) {
+		uint32_t ids[MAX_PARAMS], n_ids = notify->n_param_ids;
+
+		memcpy(ids, notify->param_ids, n_ids * sizeof(uint32_t));
+		notify->n_param_ids = 0;
+		emit_params(node, ids, n_ids);
+	}
+}
+
 static int
 do_node_add(struct spa_loop *loop,
 	    bool async, uint32_t seq, const void *data, size_t size, void *user_data)
@@ -985,6 +1017,7 @@ struct pw_impl_node *pw_context_create_node(struct pw_context *context,
 	this = &impl->this;
 	this->context = context;
 	this->name = strdup("node");
+	this->info_notify.flush = flush_info;
 
 	if (user_data_size > 0)
                 this->user_data = SPA_MEMBER(impl, sizeof(struct impl), void);
@@ -1175,7 +1208,7 @@ static void node_info(void *data, const struct spa_node_info *info)
 	emit_info_changed(node);
 
 	if (n_changed_ids > 0)
-		emit_params(node, changed_ids, n_changed_ids);
+		queue_params(node, changed_ids, n_changed_ids);
 }
 
 static void node_port_info(void *data, enum spa_direction direction, uint32_t port_id,
@@ -1581,6 +1614,7 @@ void pw_impl_node_destroy(struct pw_impl_node *node)
 		spa_hook_remove(&node->global_listener);
 		pw_global_destroy(node->global);
 	}
+	pw_context_cancel_info(node->context, &node->info_notify);
 
 	if (active)
 		pw_context_recalc_graph(node->context, "active node destroy");
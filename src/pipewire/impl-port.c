@@ -61,8 +61,6 @@ struct resource_data {
 
 static void emit_info_changed(struct pw_impl_port *port)
 {
-	struct pw_resource *resource;
-
 	if (port->info.change_mask == 0)
 		return;
 
@@ -70,10 +68,10 @@ static void emit_info_changed(struct pw_impl_port *port)
 	if (port->node)
 		pw_impl_node_emit_port_info_changed(port->node, port, &port->info);
 
-	if (port->global)
-		spa_list_for_each(resource, &port->global->resource_list, link)
-			pw_port_resource_info(resource, &port->info);
-
+	if (port->global) {
+		port->info_notify.change_mask |= port->info.change_mask;
+		pw_context_queue_info(port->global->context, &port->info_notify);
+	}
 	port->info.change_mask = 0;
 }
 
@@ -321,6 +319,40 @@ static void emit_params(struct pw_impl_port *port, uint32_t *changed_ids, uint32
 	}
 }
 
+static void flush_info(struct pw_info_notify *notify)
+{
+	struct pw_impl_port *port = SPA_CONTAINER_OF(notify, struct pw_impl_port, info_notify);
+	struct pw_resource *resource;
+
+	if (port->global && notify->change_mask) {
+		port->info.change_mask = notify->change_mask;
+		spa_list_for_each(resource, &port->global->resource_list, link)
+			pw_port_resource_info(resource, &port->info);
+		port->info.change_mask = 0;
+	}
+	notify->change_mask = 0;
+
+	if (notify->n_param_ids > 0) {
+		uint32_t ids[MAX_PARAMS], n_ids = notify->n_param_ids;
+
+		memcpy(ids, notify->param_ids, n_ids * sizeof(uint32_t));
+		notify->n_param_ids = 0;
+		emit_params(port, ids, n_ids);
+	}
+}
+
+static void queue_params(struct pw_impl_port *port, uint32_t *changed_ids, uint32_t n_changed_ids)
+{
+	uint32_t i;
+
+	if (port->global == NULL)
+		return;
+
+	for (i = 0; i < n_changed_ids; i++)
+		pw_info_notify_add_param(&port->info_notify, changed_ids[i]);
+	pw_context_queue_info(port->global->context, &port->info_notify);
+}
+
 static void update_info(struct pw_impl_port *port, const struct spa_port_info *info)
 {
 	uint32_t changed_ids[MAX_PARAMS], n_changed_ids = 0;
@@ -348,10 +380,14 @@ static void update_info(struct pw_impl_port *port, const struct spa_port_info *i
 
 			port->info.params[i] = info->params[i];
 		}
+		/* the latency can change without a change of the param flags */
+		port->latency.stale = true;
+		if (port->node)
+			pw_context_queue_latency(port->node->context);
 	}
 
 	if (n_changed_ids > 0)
-		emit_params(port, changed_ids, n_changed_ids);
+		queue_params(port, changed_ids, n_changed_ids);
 }
 
 SPA_EXPORT
@@ -373,6 +409,7 @@ struct pw_impl_port *pw_context_create_port(
 		return NULL;
 
 	this = &impl->this;
+	this->info_notify.flush = flush_info;
 	pw_log_debug(NAME" %p: new %s %d", this,
 			pw_direction_as_string(direction), port_id);
 
@@ -408,6 +445,10 @@ struct pw_impl_port *pw_context_create_port(
 	this->info.change_mask = PW_PORT_CHANGE_MASK_PROPS;
 	this->info.props = &this->properties->dict;
 
+	this->latency.own[SPA_DIRECTION_INPUT] = SPA_LATENCY_INFO(SPA_DIRECTION_INPUT);
+	this->latency.own[SPA_DIRECTION_OUTPUT] = SPA_LATENCY_INFO(SPA_DIRECTION_OUTPUT);
+	this->latency.stale = true;
+
 	spa_list_init(&this->links);
 	spa_list_init(&this->mix_list);
 	spa_list_init(&this->rt.mix_list);
@@ -758,6 +799,7 @@ static void global_destroy(void *object)
 {
 	struct pw_impl_port *port = object;
 	spa_hook_remove(&port->global_listener);
+	pw_context_cancel_info(port->global->context, &port->info_notify);
 	port->global = NULL;
 	pw_impl_port_destroy(port);
 }
@@ -909,6 +951,8 @@ int pw_impl_port_add(struct pw_impl_port *port, struct pw_impl_node *node)
 	pw_impl_node_emit_port_added(node, port);
 	emit_info_changed(port);
 
+	pw_context_queue_latency(node->context);
+
 	return 0;
 }
 
@@ -964,6 +1008,8 @@ static void pw_impl_port_remove(struct pw_impl_port *port)
 	spa_list_remove(&port->link);
 	pw_impl_node_emit_port_removed(node, port);
 	port->node = NULL;
+
+	pw_context_queue_latency(node->context);
 }
 
 void pw_impl_port_destroy(struct pw_impl_port *port)
@@ -984,6 +1030,7 @@ void pw_impl_port_destroy(struct pw_impl_port *port)
 
 	if (port->global) {
 		spa_hook_remove(&port->global_listener);
+		pw_context_cancel_info(port->global->context, &port->info_notify);
 		pw_global_destroy(port->global);
 	}
 
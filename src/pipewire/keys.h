@@ -80,6 +80,10 @@ extern "C" {
 #define PW_KEY_CPU_MAX_ALIGN		"cpu.max-align"		/**< maximum alignment needed to support
 								  *  all CPU optimizations */
 #define PW_KEY_CPU_CORES		"cpu.cores"		/**< number of cores */
+#define PW_KEY_CPU_RT_AFFINITY		"cpu.rt-affinity"	/**< CPUs for the realtime data threads,
+								  *  like "2-3,6" */
+#define PW_KEY_CPU_RT_ISOLATE		"cpu.rt-isolate"	/**< keep the main thread and the threads
+								  *  it creates off the realtime CPUs */
 
 /* priorities */
 #define PW_KEY_PRIORITY_SESSION		"priority.session"	/**< priority in session manager */
@@ -225,6 +229,9 @@ extern "C" {
 #define PW_KEY_STREAM_MONITOR		"stream.monitor"	/**< Indicates that the stream is monitoring
 								  *  and might select a less accurate but faster
 								  *  conversion algorithm. */
+#define PW_KEY_STREAM_LOW_WATER		"stream.low-water"	/**< number of buffers left before the stream
+								  *  runs dry at which a stream with
+								  *  PW_STREAM_FLAG_LOW_WAKEUP is woken up */
 
 /** object properties */
 #define PW_KEY_OBJECT_LINGER		"object.linger"		/**< the object lives on even after the client
@@ -33,6 +33,7 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <sys/syscall.h>
+#include <sys/stat.h>
 
 #include <spa/utils/list.h>
 #include <spa/buffer/buffer.h>
@@ -72,6 +73,10 @@ static inline int memfd_create(const char *name, unsigned int flags)
 #define MFD_ALLOW_SEALING 0x0002U
 #endif
 
+#ifndef MFD_HUGETLB
+#define MFD_HUGETLB       0x0004U
+#endif
+
 /* fcntl() seals-related flags */
 
 #ifndef F_LINUX_SPECIFIC_BASE
@@ -105,6 +110,10 @@ struct mempool {
 	struct pw_map map;
 	struct spa_list blocks;
 	uint32_t pagesize;
+	uint32_t hugepagesize;
+	uint32_t flags;				/* default block flags */
+
+	struct pw_mempool_stats stats;
 };
 
 struct memblock {
@@ -112,6 +121,9 @@ struct memblock {
 	struct spa_list link;
 	struct spa_list mappings;
 	struct spa_list maps;
+	uint32_t pagesize;
+	size_t alloc_size;
+	unsigned int hugetlb:1;
 };
 
 struct mapping {
@@ -120,6 +132,8 @@ struct mapping {
 	uint32_t offset;
 	uint32_t size;
 	unsigned int do_unmap:1;
+	unsigned int prefaulted:1;
+	unsigned int locked:1;
 	struct spa_list link;
 	void *ptr;
 };
@@ -130,6 +144,14 @@ struct memmap {
 	struct spa_list link;
 };
 
+static bool get_bool(struct pw_properties *props, const char *key)
+{
+	const char *str;
+	if (props == NULL || (str = pw_properties_get(props, key)) == NULL)
+		return false;
+	return pw_properties_parse_bool(str);
+}
+
 struct pw_mempool *pw_mempool_new(struct pw_properties *props)
 {
 	struct mempool *impl;
@@ -144,7 +166,14 @@ struct pw_mempool *pw_mempool_new(struct pw_properties *props)
 
 	impl->pagesize = sysconf(_SC_PAGESIZE);
 
-	pw_log_debug(NAME" %p: new", this);
+	if (get_bool(props, PW_KEY_MEM_PREFAULT))
+		impl->flags |= PW_MEMBLOCK_FLAG_PREFAULT;
+	if (get_bool(props, PW_KEY_MEM_MLOCK))
+		impl->flags |= PW_MEMBLOCK_FLAG_LOCK;
+	if (get_bool(props, PW_KEY_MEM_HUGETLB))
+		impl->flags |= PW_MEMBLOCK_FLAG_HUGETLB;
+
+	pw_log_debug(NAME" %p: new flags:%08x", this, impl->flags);
 
 	spa_hook_list_init(&impl->listener_list);
 	pw_map_init(&impl->map, 64, 64);
@@ -164,6 +193,18 @@ void pw_mempool_clear(struct pw_mempool *pool)
 		pw_memblock_free(&b->this);
 }
 
+SPA_EXPORT
+void pw_mempool_get_stats(struct pw_mempool *pool, struct pw_mempool_stats *stats)
+{
+	struct mempool *impl = SPA_CONTAINER_OF(pool, struct mempool, this);
+	struct memblock *b;
+
+	*stats = impl->stats;
+	stats->n_blocks = 0;
+	spa_list_for_each(b, &impl->blocks, link)
+		stats->n_blocks++;
+}
+
 void pw_mempool_destroy(struct pw_mempool *pool)
 {
 	struct mempool *impl = SPA_CONTAINER_OF(pool, struct mempool, this);
@@ -294,6 +335,11 @@ static struct mapping * memblock_map(struct memblock *b,
 		return NULL;
 	}
 
+#ifdef MAP_POPULATE
+	/* fault in the pages now instead of in the processing thread */
+	if (flags & (PW_MEMMAP_FLAG_PREFAULT | PW_MEMMAP_FLAG_LOCK))
+		fl |= MAP_POPULATE;
+#endif
 
 	ptr = mmap(NULL, size, prot, fl, b->this.fd, offset);
 	if (ptr == MAP_FAILED) {
@@ -315,6 +361,24 @@ static struct mapping * memblock_map(struct memblock *b,
 	b->this.ref++;
 	spa_list_append(&b->mappings, &m->link);
 
+	if (flags & (PW_MEMMAP_FLAG_PREFAULT | PW_MEMMAP_FLAG_LOCK)) {
+		m->prefaulted = true;
+		p->stats.prefault_size += size;
+	}
+	if (flags & PW_MEMMAP_FLAG_LOCK) {
+		if (mlock(ptr, size) < 0) {
+			/* only warn once, RLIMIT_MEMLOCK is usually the reason */
+			enum spa_log_level level = p->stats.n_lock_failed++ == 0 ?
+				SPA_LOG_LEVEL_WARN : SPA_LOG_LEVEL_DEBUG;
+			pw_log(level, NAME" %p: Failed to mlock memory %p %u: %m", p, ptr, size);
+		} else {
+			m->locked = true;
+			p->stats.locked_size += size;
+		}
+	}
+	p->stats.n_mappings++;
+	p->stats.mapped_size += size;
+
         pw_log_debug(NAME" %p: block:%p fd:%d map:%p ptr:%p (%d %d) block-ref:%d", p, &b->this,
 			b->this.fd, m, m->ptr, offset, size, b->this.ref);
 
@@ -329,8 +393,15 @@ static void mapping_unmap(struct mapping *m)
         pw_log_debug(NAME" %p: mapping:%p block:%p fd:%d ptr:%p size:%d block-ref:%d",
 			p, m, b, b->this.fd, m->ptr, m->size, b->this.ref);
 
-	if (m->do_unmap)
+	if (m->do_unmap) {
 		munmap(m->ptr, m->size);
+		if (m->prefaulted)
+			p->stats.prefault_size -= m->size;
+		if (m->locked)
+			p->stats.locked_size -= m->size;
+		p->stats.n_mappings--;
+		p->stats.mapped_size -= m->size;
+	}
 	spa_list_remove(&m->link);
 	free(m);
 
@@ -347,7 +418,7 @@ struct pw_memmap * pw_memblock_map(struct pw_memblock *block,
 	struct memmap *mm;
 	struct pw_map_range range;
 
-	pw_map_range_init(&range, offset, size, p->pagesize);
+	pw_map_range_init(&range, offset, size, b->pagesize);
 
 	m = memblock_find_mapping(b, flags, range.offset, range.size);
 	if (m == NULL)
@@ -424,10 +495,70 @@ static inline enum pw_memmap_flags block_flags_to_mem(enum pw_memblock_flags fla
 		fl |= PW_MEMMAP_FLAG_READ;
 	if (flags & PW_MEMBLOCK_FLAG_WRITABLE)
 		fl |= PW_MEMMAP_FLAG_WRITE;
+	if (flags & PW_MEMBLOCK_FLAG_PREFAULT)
+		fl |= PW_MEMMAP_FLAG_PREFAULT;
+	if (flags & PW_MEMBLOCK_FLAG_LOCK)
+		fl |= PW_MEMMAP_FLAG_LOCK;
 
 	return fl;
 }
 
+#ifdef USE_MEMFD
+static uint32_t get_hugepagesize(void)
+{
+	FILE *f;
+	char line[128];
+	uint32_t size = 0;
+
+	if ((f = fopen("/proc/meminfo", "re")) == NULL)
+		return 0;
+	while (fgets(line, sizeof(line), f) != NULL) {
+		if (sscanf(line, "Hugepagesize: %u kB", &size) == 1) {
+			size *= 1024;
+			break;
+		}
+	}
+	fclose(f);
+	return size;
+}
+
+/* huge pages are only used for blocks of at least one huge page, smaller
+ * blocks would waste most of the page */
+static int memfd_create_hugetlb(struct mempool *impl, struct memblock *b, size_t *size)
+{
+	size_t hsize;
+	enum spa_log_level level;
+	int fd;
+
+	if (impl->hugepagesize == 0)
+		impl->hugepagesize = get_hugepagesize();
+	if (impl->hugepagesize == 0 || *size < impl->hugepagesize)
+		return -1;
+
+	fd = memfd_create("pipewire-memfd", MFD_CLOEXEC | MFD_ALLOW_SEALING | MFD_HUGETLB);
+	if (fd == -1)
+		goto error;
+
+	/* reserve the pages now, touching a page that can't be allocated
+	 * later would raise SIGBUS */
+	hsize = SPA_ROUND_UP_N(*size, impl->hugepagesize);
+	if (ftruncate(fd, hsize) < 0 ||
+	    fallocate(fd, 0, 0, hsize) < 0) {
+		close(fd);
+		goto error;
+	}
+	*size = hsize;
+	b->pagesize = impl->hugepagesize;
+	b->hugetlb = true;
+	return fd;
+
+error:
+	level = impl->stats.n_hugetlb_failed++ == 0 ? SPA_LOG_LEVEL_WARN : SPA_LOG_LEVEL_DEBUG;
+	pw_log(level, NAME" %p: Failed to allocate huge pages: %m", impl);
+	return -1;
+}
+#endif
+
 /** Create a new memblock
  * \param pool the pool to use
  * \param flags memblock flags
@@ -442,22 +573,30 @@ struct pw_memblock * pw_mempool_alloc(struct pw_mempool *pool, enum pw_memblock_
 {
 	struct mempool *impl = SPA_CONTAINER_OF(pool, struct mempool, this);
 	struct memblock *b;
+	size_t alloc_size = size;
 	int res;
 
 	b = calloc(1, sizeof(struct memblock));
 	if (b == NULL)
 		return NULL;
 
+	flags |= impl->flags;
+
 	b->this.ref = 1;
 	b->this.pool = pool;
 	b->this.flags = flags;
 	b->this.type = type;
 	b->this.size = size;
+	b->pagesize = impl->pagesize;
 	spa_list_init(&b->mappings);
 	spa_list_init(&b->maps);
 
 #ifdef USE_MEMFD
-	b->this.fd = memfd_create("pipewire-memfd", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	b->this.fd = -1;
+	if (flags & PW_MEMBLOCK_FLAG_HUGETLB)
+		b->this.fd = memfd_create_hugetlb(impl, b, &alloc_size);
+	if (b->this.fd == -1)
+		b->this.fd = memfd_create("pipewire-memfd", MFD_CLOEXEC | MFD_ALLOW_SEALING);
 	if (b->this.fd == -1) {
 		res = -errno;
 		pw_log_error(NAME" %p: Failed to create memfd: %m", pool);
@@ -474,7 +613,7 @@ struct pw_memblock * pw_mempool_alloc(struct pw_mempool *pool, enum pw_memblock_
 	unlink(filename);
 #endif
 
-	if (ftruncate(b->this.fd, size) < 0) {
+	if (ftruncate(b->this.fd, alloc_size) < 0) {
 		res = -errno;
 		pw_log_warn(NAME" %p: Failed to truncate temporary file: %m", pool);
 		goto error_close;
@@ -498,9 +637,16 @@ struct pw_memblock * pw_mempool_alloc(struct pw_mempool *pool, enum pw_memblock_
 		b->this.ref--;
 	}
 
+	b->alloc_size = alloc_size;
+	impl->stats.n_allocs++;
+	impl->stats.alloc_size += alloc_size;
+	if (b->hugetlb)
+		impl->stats.hugetlb_size += alloc_size;
+
 	b->this.id = pw_map_insert_new(&impl->map, b);
 	spa_list_append(&impl->blocks, &b->link);
-	pw_log_debug(NAME" %p: block:%p id:%d type:%u", pool, &b->this, b->this.id, type);
+	pw_log_debug(NAME" %p: block:%p id:%d type:%u flags:%08x", pool, &b->this,
+			b->this.id, type, flags);
 
 	pw_mempool_emit_added(impl, &b->this);
 
@@ -529,6 +675,20 @@ static struct memblock * mempool_find_fd(struct pw_mempool *pool, int fd)
 	return NULL;
 }
 
+/* memfds can be backed by huge pages, they need to be mapped at huge page
+ * boundaries. */
+static uint32_t get_pagesize(struct mempool *impl, uint32_t type, int fd)
+{
+	struct stat st;
+
+	if (type == SPA_DATA_MemFd && fstat(fd, &st) == 0 &&
+	    st.st_blksize > impl->pagesize &&
+	    st.st_blksize % impl->pagesize == 0)
+		return st.st_blksize;
+
+	return impl->pagesize;
+}
+
 SPA_EXPORT
 struct pw_memblock * pw_mempool_import(struct pw_mempool *pool,
 		enum pw_memblock_flags flags, uint32_t type, int fd)
@@ -554,6 +714,7 @@ struct pw_memblock * pw_mempool_import(struct pw_mempool *pool,
 	b->this.type = type;
 	b->this.fd = fd;
 	b->this.flags = flags;
+	b->pagesize = get_pagesize(impl, type, fd);
 	b->this.id = pw_map_insert_new(&impl->map, b);
 	spa_list_append(&impl->blocks, &b->link);
 
@@ -672,6 +833,10 @@ void pw_memblock_free(struct pw_memblock *block)
 	spa_list_consume(mm, &b->maps, link)
 		pw_memmap_free(&mm->this);
 
+	impl->stats.alloc_size -= b->alloc_size;
+	if (b->hugetlb)
+		impl->stats.hugetlb_size -= b->alloc_size;
+
 	if (block->fd != -1 && !(block->flags & PW_MEMBLOCK_FLAG_DONT_CLOSE)) {
 		pw_log_debug(NAME" %p: close fd:%d", pool, block->fd);
 		close(block->fd);
@@ -39,6 +39,9 @@ enum pw_memblock_flags {
 	PW_MEMBLOCK_FLAG_SEAL = (1 << 2),
 	PW_MEMBLOCK_FLAG_MAP = (1 << 3),
 	PW_MEMBLOCK_FLAG_DONT_CLOSE = (1 << 4),
+	PW_MEMBLOCK_FLAG_PREFAULT = (1 << 5),	/**< fault in the pages when mapping */
+	PW_MEMBLOCK_FLAG_LOCK = (1 << 6),	/**< lock the pages in memory when mapping */
+	PW_MEMBLOCK_FLAG_HUGETLB = (1 << 7),	/**< try to use huge pages for large blocks */
 
 	PW_MEMBLOCK_FLAG_READWRITE = PW_MEMBLOCK_FLAG_READABLE | PW_MEMBLOCK_FLAG_WRITABLE,
 };
@@ -50,15 +53,36 @@ enum pw_memmap_flags {
 	PW_MEMMAP_FLAG_TWICE = (1 << 2),	/**< map the same area twice afer eachother,
 						  *  creating a circular ringbuffer */
 	PW_MEMMAP_FLAG_PRIVATE = (1 << 3),	/**< writes will be private */
+	PW_MEMMAP_FLAG_PREFAULT = (1 << 4),	/**< fault in the pages, see MAP_POPULATE */
+	PW_MEMMAP_FLAG_LOCK = (1 << 5),		/**< lock the pages in memory */
 	PW_MEMMAP_FLAG_READWRITE = PW_MEMMAP_FLAG_READ | PW_MEMMAP_FLAG_WRITE,
 };
 
+/** Pool properties, set as default flags on all allocated blocks */
+#define PW_KEY_MEM_PREFAULT	"mem.prefault"	/**< prefault memory, boolean */
+#define PW_KEY_MEM_MLOCK	"mem.mlock"	/**< lock memory, boolean */
+#define PW_KEY_MEM_HUGETLB	"mem.hugetlb"	/**< use huge pages, boolean */
+
 struct pw_memchunk;
 
 struct pw_mempool {
 	struct pw_properties *props;
 };
 
+/** Allocation counters of a pool, see \ref pw_mempool_get_stats() */
+struct pw_mempool_stats {
+	uint32_t n_blocks;		/**< number of blocks in the pool */
+	uint32_t n_mappings;		/**< number of mmapped regions */
+	uint64_t n_allocs;		/**< total number of allocated blocks */
+	uint64_t alloc_size;		/**< size of the blocks currently allocated */
+	uint64_t mapped_size;		/**< size of the currently mapped regions */
+	uint64_t prefault_size;		/**< size of the prefaulted regions */
+	uint64_t locked_size;		/**< size of the locked regions */
+	uint64_t hugetlb_size;		/**< size of the blocks backed by huge pages */
+	uint32_t n_lock_failed;		/**< number of failed mlock calls */
+	uint32_t n_hugetlb_failed;	/**< number of failed huge page allocations */
+};
+
 /** \class pw_memblock
  * Memory block structure */
 struct pw_memblock {
@@ -108,6 +132,9 @@ void pw_mempool_add_listener(struct pw_mempool *pool,
 /** Clear a pool */
 void pw_mempool_clear(struct pw_mempool *pool);
 
+/** Get the allocation counters of a pool */
+void pw_mempool_get_stats(struct pw_mempool *pool, struct pw_mempool_stats *stats);
+
 /** Clear and destroy a pool */
 void pw_mempool_destroy(struct pw_mempool *pool);
 
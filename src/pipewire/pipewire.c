@@ -45,6 +45,7 @@
 #define MAX_SUPPORT	32
 
 #define SUPPORTLIB	"support/libspa-support"
+#define FACTORY_INDEX	"factory.index"
 
 struct plugin {
 	struct spa_list link;
@@ -63,8 +64,25 @@ struct handle {
 	struct spa_handle handle;
 };
 
+struct index_entry {
+	uint32_t hash;
+	char *factory_name;
+	char *lib;
+	unsigned int stale:1;		/* library could not provide the factory */
+};
+
+/* open addressed hash table of factory_name to library, loaded from
+ * the factory index in the plugin directory. The index is generated
+ * with spa-index and avoids opening libraries to find a factory. */
+struct factory_index {
+	struct index_entry *entries;
+	uint32_t size;			/* power of 2 */
+	uint32_t n_entries;
+};
+
 struct registry {
 	struct spa_list plugins;
+	struct factory_index index;
 };
 
 struct support {
@@ -198,6 +216,144 @@ static void unref_handle(struct handle *handle)
 	}
 }
 
+static inline uint32_t index_hash(const char *str)
+{
+	/* FNV-1a */
+	uint32_t h = 2166136261u;
+	while (*str)
+		h = (h ^ (uint8_t)*str++) * 16777619u;
+	return h;
+}
+
+static struct index_entry *index_find(struct factory_index *index,
+		const char *factory_name, uint32_t hash)
+{
+	uint32_t i, mask = index->size - 1;
+
+	for (i = hash & mask;; i = (i + 1) & mask) {
+		struct index_entry *e = &index->entries[i];
+		if (e->factory_name == NULL ||
+		    (e->hash == hash && strcmp(e->factory_name, factory_name) == 0))
+			return e;
+	}
+}
+
+static int index_add(struct factory_index *index, const char *factory_name, const char *lib)
+{
+	struct index_entry *e;
+	uint32_t i, hash;
+
+	if ((index->n_entries + 1) * 2 > index->size) {
+		struct factory_index grow;
+
+		grow.size = index->size ? index->size * 2 : 64;
+		grow.n_entries = 0;
+		if ((grow.entries = calloc(grow.size, sizeof(struct index_entry))) == NULL)
+			return -errno;
+
+		for (i = 0; i < index->size; i++) {
+			struct index_entry *o = &index->entries[i];
+			if (o->factory_name == NULL)
+				continue;
+			*index_find(&grow, o->factory_name, o->hash) = *o;
+			grow.n_entries++;
+		}
+		free(index->entries);
+		*index = grow;
+	}
+
+	hash = index_hash(factory_name);
+	e = index_find(index, factory_name, hash);
+	if (e->factory_name != NULL)
+		return 0;
+
+	e->factory_name = strdup(factory_name);
+	e->lib = strdup(lib);
+	e->hash = hash;
+	if (e->factory_name == NULL || e->lib == NULL) {
+		free(e->factory_name);
+		free(e->lib);
+		spa_zero(*e);
+		return -ENOMEM;
+	}
+	index->n_entries++;
+	return 0;
+}
+
+/* The index is a text file with one factory per line:
+ *
+ *   <factory-name> <library-name> [<interface>,...]
+ *
+ * Empty lines and lines starting with # are ignored. The library name
+ * is relative to the plugin directory and without the .so suffix. */
+static int load_factory_index(struct factory_index *index, const char *filename)
+{
+	FILE *f;
+	char *line = NULL;
+	size_t len = 0;
+	int res = 0;
+
+	if ((f = fopen(filename, "re")) == NULL) {
+		pw_log_debug("no factory index %s: %m", filename);
+		return -errno;
+	}
+
+	while (getline(&line, &len, f) != -1) {
+		char **tokens;
+		int n_tokens;
+
+		if (line[0] == '#')
+			continue;
+
+		tokens = pw_split_strv(line, " \t\n", 3, &n_tokens);
+		if (tokens == NULL)
+			continue;
+		if (n_tokens >= 2)
+			res = index_add(index, tokens[0], tokens[1]);
+		pw_free_strv(tokens);
+		if (res < 0)
+			break;
+	}
+	free(line);
+	fclose(f);
+
+	pw_log_info("loaded %u factories from index %s", index->n_entries, filename);
+	return res;
+}
+
+/** Find the library that provides \a factory_name in the factory index
+ * \return the library name or NULL when the factory is not indexed */
+const char *pw_find_spa_lib(const char *factory_name)
+{
+	struct factory_index *index;
+	struct index_entry *e;
+
+	if (global_support.registry == NULL)
+		return NULL;
+
+	index = &global_support.registry->index;
+	if (index->n_entries == 0)
+		return NULL;
+
+	e = index_find(index, factory_name, index_hash(factory_name));
+	return e->stale ? NULL : e->lib;
+}
+
+/* mark the index entry of \a factory_name as stale so that it is not
+ * used anymore, the library was removed or does not have the factory */
+static void index_mark_stale(const char *factory_name)
+{
+	struct factory_index *index = &global_support.registry->index;
+	struct index_entry *e;
+
+	if (index->n_entries == 0)
+		return;
+
+	e = index_find(index, factory_name, index_hash(factory_name));
+	if (e->factory_name != NULL)
+		e->stale = true;
+}
+
 static void configure_debug(struct support *support, const char *str)
 {
 	char **level;
@@ -234,6 +390,7 @@ struct spa_handle *pw_load_spa_handle(const char *lib,
 	struct plugin *plugin;
 	struct handle *handle;
         const struct spa_handle_factory *factory;
+	const char *index_lib;
         int res;
 
 	if (factory_name == NULL) {
@@ -241,13 +398,17 @@ struct spa_handle *pw_load_spa_handle(const char *lib,
 		goto error_out;
 	}
 
+	index_lib = pw_find_spa_lib(factory_name);
 	if (lib == NULL)
-		lib = sup->support_lib;
+		lib = index_lib ? index_lib : sup->support_lib;
 
+again:
 	pw_log_debug("load lib:'%s' factory-name:'%s'", lib, factory_name);
 
 	if ((plugin = open_plugin(sup->registry, sup->plugin_dir, lib)) == NULL) {
 		res = -errno;
+		if (lib == index_lib)
+			goto stale_index;
 		pw_log_error("can't load '%s': %m", lib);
 		goto error_out;
 	}
@@ -255,6 +416,10 @@ struct spa_handle *pw_load_spa_handle(const char *lib,
 	factory = find_factory(plugin, factory_name);
 	if (factory == NULL) {
 		res = -errno;
+		if (lib == index_lib) {
+			unref_plugin(plugin);
+			goto stale_index;
+		}
 		pw_log_error("can't find factory '%s': %m %s", factory_name, spa_strerror(res));
 		goto error_unref_plugin;
 	}
@@ -280,6 +445,19 @@ struct spa_handle *pw_load_spa_handle(const char *lib,
 
 	return &handle->handle;
 
+stale_index:
+	/* the index is out of date, don't use it for this factory again
+	 * and try the support library like we do without an index */
+	pw_log_warn("stale factory index entry '%s' for '%s': %s",
+			lib, factory_name, spa_strerror(res));
+	index_mark_stale(factory_name);
+	index_lib = NULL;
+	if (strcmp(lib, sup->support_lib) != 0) {
+		lib = sup->support_lib;
+		goto again;
+	}
+	goto error_out;
+
 error_free_handle:
 	free(handle);
 error_unref_plugin:
@@ -382,6 +560,16 @@ void pw_init(int *argc, char **argv[])
 	spa_list_init(&global_registry.plugins);
 	support->registry = &global_registry;
 
+	if ((str = getenv("SPA_PLUGIN_INDEX")) != NULL) {
+		load_factory_index(&global_registry.index, str);
+	} else {
+		char *filename = spa_aprintf("%s/%s", support->plugin_dir, FACTORY_INDEX);
+		if (filename != NULL) {
+			load_factory_index(&global_registry.index, filename);
+			free(filename);
+		}
+	}
+
 	if (pw_log_is_default()) {
 		n_items = 0;
 		items[n_items++] = SPA_DICT_ITEM_INIT(SPA_KEY_LOG_COLORS, "true");
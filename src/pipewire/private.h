@@ -36,6 +36,7 @@ extern "C" {
 
 #include <spa/support/plugin.h>
 #include <spa/pod/builder.h>
+#include <spa/param/latency-utils.h>
 #include <spa/utils/result.h>
 #include <spa/utils/type-info.h>
 
@@ -57,6 +58,9 @@ struct defaults {
 	struct spa_fraction video_rate;
 	uint32_t link_max_buffers;
 	unsigned int mem_allow_mlock;
+	unsigned int mem_prefault;
+	unsigned int mem_mlock;
+	unsigned int mem_hugetlb;
 };
 
 struct ratelimit {
@@ -280,6 +284,34 @@ struct pw_context_driver_events {
 #define pw_registry_resource_global(r,...)        pw_registry_resource(r,global,0,__VA_ARGS__)
 #define pw_registry_resource_global_remove(r,...) pw_registry_resource(r,global_remove,0,__VA_ARGS__)
 
+/** A pending info and param notification of an object to its resources.
+ * Notifications are merged and flushed once per main loop iteration or
+ * before a sync reply. */
+struct pw_info_notify {
+	struct spa_list link;
+	void (*flush) (struct pw_info_notify *notify);
+	uint64_t change_mask;			/**< merged change_mask of the info */
+	uint32_t param_ids[MAX_PARAMS];		/**< changed params */
+	uint32_t n_param_ids;
+	unsigned int queued:1;
+};
+
+static inline void pw_info_notify_add_param(struct pw_info_notify *notify, uint32_t id)
+{
+	uint32_t i;
+
+	for (i = 0; i < notify->n_param_ids; i++) {
+		if (notify->param_ids[i] == id)
+			return;
+	}
+	if (notify->n_param_ids < MAX_PARAMS)
+		notify->param_ids[notify->n_param_ids++] = id;
+}
+
+void pw_context_queue_info(struct pw_context *context, struct pw_info_notify *notify);
+void pw_context_cancel_info(struct pw_context *context, struct pw_info_notify *notify);
+void pw_context_flush_info(struct pw_context *context);
+
 #define pw_context_emit(o,m,v,...) spa_hook_list_call(&o->listener_list, struct pw_context_events, m, v, ##__VA_ARGS__)
 #define pw_context_emit_destroy(c)		pw_context_emit(c, destroy, 0)
 #define pw_context_emit_free(c)			pw_context_emit(c, free, 0)
@@ -317,6 +349,12 @@ struct pw_context {
 	struct spa_hook_list driver_listener_list;
 	struct spa_hook_list listener_list;
 
+	struct spa_list info_list;		/**< list of pending info notifications */
+	struct spa_source *info_event;		/**< flushes info_list */
+
+	struct spa_source *latency_event;	/**< recalculates the port latencies */
+	uint32_t latency_gen;			/**< generation of the port latencies */
+
 	struct pw_loop *main_loop;	/**< main loop for control */
 	struct pw_loop *data_loop;	/**< data loop for data passing */
         struct pw_data_loop *data_loop_impl;
@@ -345,6 +383,9 @@ struct pw_data_loop {
 	struct spa_source *event;
 
 	pthread_t thread;
+	char *affinity;			/**< CPUs of the thread */
+	int cpu;			/**< current CPU of the thread */
+	uint64_t migrations;		/**< number of CPU changes of the thread */
 	unsigned int created:1;
 	unsigned int running:1;
 };
@@ -377,6 +418,7 @@ struct pw_impl_device {
 	struct pw_properties *properties;	/**< properties of the device */
 	struct pw_device_info info;		/**< introspectable device info */
 	struct spa_param_info params[MAX_PARAMS];
+	struct pw_info_notify info_notify;	/**< pending info for the resources */
 
 	char *name;				/**< device name for debug */
 
@@ -501,6 +543,8 @@ struct pw_node_activation {
 #define SEQ_WRITE_SUCCESS(s1,s2)	((s1) + 1 == (s2) && ((s2) & 1) == 0)
 
 #define SEQ_READ(s)			ATOMIC_LOAD(s)
+/* keep the reads of the protected data before the second SEQ_READ */
+#define SEQ_READ_FENCE()		__atomic_thread_fence(__ATOMIC_ACQUIRE)
 #define SEQ_READ_SUCCESS(s1,s2)		((s1) == (s2) && ((s2) & 1) == 0)
 
 #define pw_impl_node_emit(o,m,v,...) spa_hook_list_call(&o->listener_list, struct pw_impl_node_events, m, v, ##__VA_ARGS__)
@@ -532,6 +576,7 @@ struct pw_impl_node {
 
 	struct pw_node_info info;		/**< introspectable node info */
 	struct spa_param_info params[MAX_PARAMS];
+	struct pw_info_notify info_notify;	/**< pending info for the resources */
 
 	char *name;				/** for debug */
 
@@ -665,6 +710,7 @@ struct pw_impl_port {
 	struct pw_properties *properties;	/**< properties of the port */
 	struct pw_port_info info;
 	struct spa_param_info params[MAX_PARAMS];
+	struct pw_info_notify info_notify;	/**< pending info for the resources */
 
 	struct pw_buffers buffers;	/**< buffers managed by this port, only on
 					  *  output ports, shared with all links */
@@ -689,6 +735,15 @@ struct pw_impl_port {
 	struct pw_map mix_port_map;	/**< map from port_id from mixer */
 	uint32_t n_mix;
 
+	struct {
+		struct spa_latency_info own[2];		/**< latency the port adds, indexed by
+							  *  direction */
+		struct spa_latency_info total[2];	/**< latency of the paths through the port */
+		struct spa_latency_info reported[2];	/**< last total set on the port */
+		uint32_t gen[2];			/**< generation of total */
+		unsigned int stale:1;			/**< own latency needs to be read */
+	} latency;
+
 	struct {
 		struct spa_io_buffers io;	/**< io area of the port */
 		struct spa_io_clock clock;	/**< io area of the clock */
@@ -727,6 +782,7 @@ struct pw_impl_link {
 	char *name;
 
 	struct pw_link_info info;		/**< introspectable link info */
+	struct pw_info_notify info_notify;	/**< pending info for the resources */
 	struct pw_properties *properties;	/**< extra link properties */
 
 	struct spa_io_buffers *io;		/**< link io area */
@@ -995,6 +1051,9 @@ void pw_proxy_remove(struct pw_proxy *proxy);
 
 int pw_context_recalc_graph(struct pw_context *context, const char *reason);
 
+/** Recalculate the latency of all ports later from the main loop */
+void pw_context_queue_latency(struct pw_context *context);
+
 void pw_impl_port_update_info(struct pw_impl_port *port, const struct spa_port_info *info);
 
 int pw_impl_port_register(struct pw_impl_port *port,
@@ -1106,6 +1165,10 @@ void pw_log_log_object(enum spa_log_level level, const char *file, int line,
 
 bool pw_log_is_default(void);
 
+const char *pw_find_spa_lib(const char *factory_name);
+
+int pw_thread_set_affinity(pthread_t thread, const char *cpus, bool exclude);
+
 /** \endcond */
 
 #ifdef __cplusplus
@@ -46,8 +46,8 @@
 
 #define MAX_BUFFERS	64
 
-#define MASK_BUFFERS	(MAX_BUFFERS-1)
 #define MAX_PORTS	1
+#define MAX_ALIGN	64
 
 struct buffer {
 	struct pw_buffer this;
@@ -58,12 +58,22 @@ struct buffer {
 };
 
 struct queue {
-	uint32_t ids[MAX_BUFFERS];
+	uint32_t *ids;
+	uint32_t mask;
 	struct spa_ringbuffer ring;
 	uint64_t incount;
 	uint64_t outcount;
 };
 
+/* the buffers with the ids of the dequeued and queued queue, allocated
+ * in one block and handed to the data thread with invoke */
+struct stream_buffers {
+	struct buffer *buffers;
+	uint32_t n_buffers;
+	uint32_t *ids[2];
+	uint32_t mask;
+};
+
 struct data {
 	struct pw_context *context;
 	struct spa_hook stream_listener;
@@ -109,6 +119,8 @@ struct stream {
 	struct spa_io_buffers *io;
 	struct {
 		struct spa_io_position *position;
+		struct spa_latency_info latency;	/**< latency of the path to the device */
+		bool have_latency;
 	} rt;
 
 	uint32_t change_mask_all;
@@ -120,15 +132,16 @@ struct stream {
 	uint32_t media_type;
 	uint32_t media_subtype;
 
-	struct buffer buffers[MAX_BUFFERS];
+	struct buffer *buffers;
 	uint32_t n_buffers;
+	uint32_t low_water;
 
 	struct queue dequeued;
 	struct queue queued;
 
 	struct data data;
 	uintptr_t seq;
-	struct pw_time time;
+	struct pw_stream_timing timing;
 
 	unsigned int disconnecting:1;
 	unsigned int free_proxy:1;
@@ -239,7 +252,7 @@ static inline int push_queue(struct stream *stream, struct queue *queue, struct
 	queue->incount += buffer->this.size;
 
 	spa_ringbuffer_get_write_index(&queue->ring, &index);
-	queue->ids[index & MASK_BUFFERS] = buffer->id;
+	queue->ids[index & queue->mask] = buffer->id;
 	spa_ringbuffer_write_update(&queue->ring, index + 1);
 
 	return 0;
@@ -256,7 +269,7 @@ static inline struct buffer *pop_queue(struct stream *stream, struct queue *queu
 		return NULL;
 	}
 
-	id = queue->ids[index & MASK_BUFFERS];
+	id = queue->ids[index & queue->mask];
 	spa_ringbuffer_read_update(&queue->ring, index + 1);
 
 	buffer = &stream->buffers[id];
@@ -271,6 +284,73 @@ static inline void clear_queue(struct stream *stream, struct queue *queue)
 	queue->incount = queue->outcount;
 }
 
+/* the buffers and the ids of both queues are allocated in one block, each
+ * on its own cache line. The queues are sized to the next power of 2 so
+ * that we can mask the index */
+static int alloc_buffers(struct stream_buffers *sb, uint32_t n_buffers)
+{
+	uint32_t n_ids;
+	size_t size, ids_size;
+	void *p;
+	int res;
+
+	spa_zero(*sb);
+	if (n_buffers > MAX_BUFFERS)
+		return -ENOSPC;
+	if (n_buffers == 0)
+		return 0;
+
+	for (n_ids = 1; n_ids < n_buffers; n_ids <<= 1);
+
+	size = SPA_ROUND_UP_N(n_buffers * sizeof(struct buffer), MAX_ALIGN);
+	ids_size = SPA_ROUND_UP_N(n_ids * sizeof(uint32_t), MAX_ALIGN);
+	if ((res = posix_memalign(&p, MAX_ALIGN, size + 2 * ids_size)) != 0)
+		return -res;
+	memset(p, 0, size + 2 * ids_size);
+
+	sb->buffers = p;
+	sb->n_buffers = n_buffers;
+	sb->ids[0] = SPA_MEMBER(p, size, uint32_t);
+	sb->ids[1] = SPA_MEMBER(p, size + ids_size, uint32_t);
+	sb->mask = n_ids - 1;
+
+	return 0;
+}
+
+static int
+do_set_buffers(struct spa_loop *loop,
+		bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct stream *impl = user_data;
+	const struct stream_buffers *sb = data;
+	uint32_t i;
+
+	impl->buffers = sb->buffers;
+	impl->dequeued.ids = sb->ids[0];
+	impl->dequeued.mask = sb->mask;
+	impl->queued.ids = sb->ids[1];
+	impl->queued.mask = sb->mask;
+	clear_queue(impl, &impl->dequeued);
+	clear_queue(impl, &impl->queued);
+	impl->n_buffers = sb->n_buffers;
+
+	if (impl->direction == SPA_DIRECTION_OUTPUT) {
+		for (i = 0; i < impl->n_buffers; i++) {
+			pw_log_trace(NAME" %p: recycle buffer %d", impl, i);
+			push_queue(impl, &impl->dequeued, &impl->buffers[i]);
+		}
+	}
+	return 0;
+}
+
+/* install new buffers on the data thread, after this the data thread
+ * doesn't use the old buffers anymore */
+static void set_buffers(struct stream *impl, const struct stream_buffers *sb)
+{
+	pw_loop_invoke(impl->context->data_loop,
+			do_set_buffers, 1, sb, sizeof(*sb), true, impl);
+}
+
 static bool stream_set_state(struct pw_stream *stream, enum pw_stream_state state, const char *error)
 {
 	enum pw_stream_state old = stream->state;
@@ -327,6 +407,24 @@ static void call_process(struct stream *impl)
 	}
 }
 
+/* with PW_STREAM_FLAG_LOW_WAKEUP, only wake up the application when the
+ * number of buffers we can still process drops to the low water mark */
+static inline bool need_process(struct stream *impl)
+{
+	uint32_t index;
+	int32_t avail;
+
+	if (!SPA_FLAG_IS_SET(impl->flags, PW_STREAM_FLAG_LOW_WAKEUP))
+		return true;
+
+	if (impl->direction == SPA_DIRECTION_OUTPUT)
+		avail = spa_ringbuffer_get_read_index(&impl->queued.ring, &index);
+	else
+		avail = impl->n_buffers - spa_ringbuffer_get_read_index(&impl->dequeued.ring, &index);
+
+	return avail <= (int32_t)impl->low_water;
+}
+
 static int
 do_call_drained(struct spa_loop *loop,
                  bool async, uint32_t seq, const void *data, size_t size, void *user_data)
@@ -578,12 +676,19 @@ static int unmap_data(struct stream *impl, struct spa_data *data)
 static void clear_buffers(struct pw_stream *stream)
 {
 	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
-	uint32_t i, j;
+	uint32_t i, j, n_buffers = impl->n_buffers;
+	struct buffer *buffers = impl->buffers;
+	struct stream_buffers none = { NULL, };
+
+	pw_log_debug(NAME" %p: clear buffers %d", stream, n_buffers);
 
-	pw_log_debug(NAME" %p: clear buffers %d", stream, impl->n_buffers);
+	if (buffers == NULL)
+		return;
+
+	set_buffers(impl, &none);
 
-	for (i = 0; i < impl->n_buffers; i++) {
-		struct buffer *b = &impl->buffers[i];
+	for (i = 0; i < n_buffers; i++) {
+		struct buffer *b = &buffers[i];
 
 		pw_stream_emit_remove_buffer(stream, &b->this);
 
@@ -596,9 +701,43 @@ static void clear_buffers(struct pw_stream *stream)
 			}
 		}
 	}
-	impl->n_buffers = 0;
-	clear_queue(impl, &impl->dequeued);
-	clear_queue(impl, &impl->queued);
+	free(buffers);
+}
+
+static int
+do_set_latency(struct spa_loop *loop,
+		bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct stream *impl = user_data;
+	const struct spa_latency_info *info = data;
+
+	impl->rt.have_latency = info != NULL;
+	if (info != NULL)
+		impl->rt.latency = *info;
+	return 0;
+}
+
+/* The graph sets the latency of the paths through the port. We keep the
+ * playback latency for output streams and the capture latency for input
+ * streams, it is not one of our own params. The data thread uses it for
+ * the timing. */
+static int set_latency(struct stream *impl, const struct spa_pod *param)
+{
+	struct spa_latency_info info;
+	int res;
+
+	if (param == NULL) {
+		pw_loop_invoke(impl->context->data_loop,
+				do_set_latency, 1, NULL, 0, true, impl);
+		return 0;
+	}
+	if ((res = spa_latency_parse(param, &info)) < 0)
+		return res;
+
+	if (info.direction == SPA_DIRECTION_REVERSE(impl->direction))
+		pw_loop_invoke(impl->context->data_loop,
+				do_set_latency, 1, &info, sizeof(info), true, impl);
+	return 0;
 }
 
 static int impl_port_set_param(void *object,
@@ -619,6 +758,9 @@ static int impl_port_set_param(void *object,
 	if (param)
 		pw_log_pod(SPA_LOG_LEVEL_DEBUG, param);
 
+	if (id == SPA_PARAM_Latency)
+		return set_latency(impl, param);
+
 	if ((res = update_params(impl, id, &param, param ? 1 : 0)) < 0)
 		return res;
 
@@ -642,9 +784,11 @@ static int impl_port_use_buffers(void *object,
 {
 	struct stream *impl = object;
 	struct pw_stream *stream = &impl->this;
+	struct stream_buffers sb;
 	uint32_t i, j, impl_flags = impl->flags;
 	int prot, res;
 	int size = 0;
+	const char *str;
 
 	if (impl->disconnecting)
 		return n_buffers == 0 ? 0 : -EIO;
@@ -653,9 +797,12 @@ static int impl_port_use_buffers(void *object,
 
 	clear_buffers(stream);
 
+	if ((res = alloc_buffers(&sb, n_buffers)) < 0)
+		return res;
+
 	for (i = 0; i < n_buffers; i++) {
 		int buf_size = 0;
-		struct buffer *b = &impl->buffers[i];
+		struct buffer *b = &sb.buffers[i];
 
 		b->flags = 0;
 		b->id = i;
@@ -666,11 +813,12 @@ static int impl_port_use_buffers(void *object,
 				if (d->type == SPA_DATA_MemFd ||
 				    d->type == SPA_DATA_DmaBuf) {
 					if ((res = map_data(impl, d, prot)) < 0)
-						return res;
+						goto error_free;
 				}
 				else if (d->data == NULL) {
 					pw_log_error(NAME" %p: invalid buffer mem", stream);
-					return -EINVAL;
+					res = -EINVAL;
+					goto error_free;
 				}
 				buf_size += d->maxsize;
 			}
@@ -678,7 +826,8 @@ static int impl_port_use_buffers(void *object,
 
 			if (size > 0 && buf_size != size) {
 				pw_log_error(NAME" %p: invalid buffer size %d", stream, buf_size);
-				return -EINVAL;
+				res = -EINVAL;
+				goto error_free;
 			} else
 				size = buf_size;
 		}
@@ -687,23 +836,30 @@ static int impl_port_use_buffers(void *object,
 	}
 
 	for (i = 0; i < n_buffers; i++) {
-		struct buffer *b = &impl->buffers[i];
+		struct buffer *b = &sb.buffers[i];
 
 		b->flags = 0;
 		b->id = i;
 		b->this.buffer = buffers[i];
 
-		if (impl->direction == SPA_DIRECTION_OUTPUT) {
-			pw_log_trace(NAME" %p: recycle buffer %d", stream, b->id);
-			push_queue(impl, &impl->dequeued, b);
-		}
-
 		pw_stream_emit_add_buffer(stream, &b->this);
 	}
 
-	impl->n_buffers = n_buffers;
+	if ((str = pw_properties_get(stream->properties, PW_KEY_STREAM_LOW_WATER)) != NULL)
+		impl->low_water = SPA_MIN((uint32_t)SPA_MAX(pw_properties_parse_int(str), 0), n_buffers);
+	else
+		impl->low_water = SPA_MAX(n_buffers / 4, 1u);
+
+	pw_log_debug(NAME" %p: %d buffers low-water:%d", stream, n_buffers, impl->low_water);
+
+	/* output buffers are queued for dequeue on the data thread */
+	set_buffers(impl, &sb);
 
 	return 0;
+
+error_free:
+	free(sb.buffers);
+	return res;
 }
 
 static int impl_port_reuse_buffer(void *object, uint32_t port_id, uint32_t buffer_id)
@@ -720,11 +876,23 @@ static inline void copy_position(struct stream *impl, int64_t queued)
 	struct spa_io_position *p = impl->rt.position;
 	if (p != NULL) {
 		SEQ_WRITE(impl->seq);
-		impl->time.now = p->clock.nsec;
-		impl->time.rate = p->clock.rate;
-		impl->time.ticks = p->clock.position;
-		impl->time.delay = p->clock.delay;
-		impl->time.queued = queued;
+		impl->timing.version++;
+		impl->timing.now = p->clock.nsec;
+		impl->timing.rate = p->clock.rate;
+		impl->timing.ticks = p->clock.position;
+		impl->timing.duration = p->clock.duration;
+		impl->timing.delay = p->clock.delay;
+		/* the latency of the path to the device is more complete than
+		 * the delay of the driver alone */
+		if (impl->rt.have_latency && p->clock.rate.num != 0) {
+			uint64_t max;
+			spa_latency_info_get_samples(&impl->rt.latency, p->clock.duration,
+					p->clock.rate.denom / p->clock.rate.num, NULL, &max);
+			impl->timing.delay = max;
+		}
+		impl->timing.queued = queued;
+		impl->timing.rate_diff = p->clock.rate_diff;
+		impl->timing.next_nsec = p->clock.next_nsec;
 		SEQ_WRITE(impl->seq);
 	}
 }
@@ -737,7 +905,7 @@ static int impl_node_process_input(void *object)
 	struct buffer *b;
 
 	pw_log_trace(NAME" %p: process in status:%d id:%d ticks:%"PRIu64" delay:%"PRIi64,
-			stream, io->status, io->buffer_id, impl->time.ticks, impl->time.delay);
+			stream, io->status, io->buffer_id, impl->timing.ticks, impl->timing.delay);
 
 	if (io->status != SPA_STATUS_HAVE_DATA)
 		goto done;
@@ -746,7 +914,8 @@ static int impl_node_process_input(void *object)
 		goto done;
 
 	/* push new buffer */
-	if (push_queue(impl, &impl->dequeued, b) == 0)
+	if (push_queue(impl, &impl->dequeued, b) == 0 &&
+	    need_process(impl))
 		call_process(impl);
 
 done:
@@ -801,7 +970,8 @@ again:
 
 	if (!impl->draining &&
 	    !SPA_FLAG_IS_SET(impl->flags, PW_STREAM_FLAG_DRIVER) &&
-	    spa_ringbuffer_get_read_index(&impl->dequeued.ring, &index) > 0) {
+	    spa_ringbuffer_get_read_index(&impl->dequeued.ring, &index) > 0 &&
+	    need_process(impl)) {
 		call_process(impl);
 		if (spa_ringbuffer_get_read_index(&impl->queued.ring, &index) > 0 &&
 		    io->status == SPA_STATUS_NEED_DATA)
@@ -1240,6 +1410,7 @@ void pw_stream_destroy(struct pw_stream *stream)
 	}
 
 	clear_params(impl, SPA_ID_INVALID);
+	free(impl->buffers);
 
 	pw_log_debug(NAME" %p: free", stream);
 	free(stream->error);
@@ -1441,6 +1612,7 @@ pw_stream_connect(struct pw_stream *stream,
 		return res;
 
 	impl->disconnecting = false;
+	set_latency(impl, NULL);
 	stream_set_state(stream, PW_STREAM_STATE_CONNECTING, NULL);
 
 	if (target_id != PW_ID_ANY)
@@ -1696,22 +1868,48 @@ int pw_stream_set_active(struct pw_stream *stream, bool active)
 	return 0;
 }
 
-SPA_EXPORT
-int pw_stream_get_time(struct pw_stream *stream, struct pw_time *time)
+static void get_timing(struct stream *impl, struct pw_stream_timing *timing)
 {
-	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
 	uintptr_t seq1, seq2;
 
 	do {
 		seq1 = SEQ_READ(impl->seq);
-		*time = impl->time;
+		*timing = impl->timing;
+		SEQ_READ_FENCE();
 		seq2 = SEQ_READ(impl->seq);
 	} while (!SEQ_READ_SUCCESS(seq1, seq2));
 
 	if (impl->direction == SPA_DIRECTION_INPUT)
-		time->queued = (int64_t)(time->queued - impl->dequeued.outcount);
+		timing->queued = (int64_t)(timing->queued - impl->dequeued.outcount);
 	else
-		time->queued = (int64_t)(impl->queued.incount - time->queued);
+		timing->queued = (int64_t)(impl->queued.incount - timing->queued);
+}
+
+SPA_EXPORT
+int pw_stream_get_timing(struct pw_stream *stream, struct pw_stream_timing *timing, size_t size)
+{
+	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
+	struct pw_stream_timing t;
+
+	get_timing(impl, &t);
+	memcpy(timing, &t, SPA_MIN(size, sizeof(t)));
+
+	return 0;
+}
+
+SPA_EXPORT
+int pw_stream_get_time(struct pw_stream *stream, struct pw_time *time)
+{
+	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
+	struct pw_stream_timing t;
+
+	get_timing(impl, &t);
+
+	time->now = t.now;
+	time->rate = t.rate;
+	time->ticks = t.ticks;
+	time->delay = t.delay;
+	time->queued = t.queued;
 
 	pw_log_trace(NAME" %p: %"PRIi64" %"PRIi64" %"PRIu64" %d/%d %"PRIu64" %"
 			PRIu64" %"PRIu64" %"PRIu64" %"PRIu64, stream,
@@ -1789,8 +1987,10 @@ do_flush(struct spa_loop *loop,
 	}
 	while (b);
 
-	impl->time.queued = impl->queued.outcount = impl->dequeued.incount =
+	SEQ_WRITE(impl->seq);
+	impl->timing.queued = impl->queued.outcount = impl->dequeued.incount =
 		impl->dequeued.outcount = impl->queued.incount;
+	SEQ_WRITE(impl->seq);
 
 	return 0;
 }
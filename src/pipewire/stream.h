@@ -187,12 +187,40 @@ struct pw_time {
 					  *  the remote end is reading/writing. */
 	int64_t delay;			/**< delay to device, add to ticks to get the time of the
 					  *  device. Positive for INPUT streams and
-					  *  negative for OUTPUT streams. */
+					  *  negative for OUTPUT streams. This is the max latency
+					  *  of the path to the device when the graph knows it
+					  *  and the delay of the driver otherwise. */
 	uint64_t queued;		/**< data queued in the stream, this is the sum
 					  *  of the size fields in the pw_buffer that are
 					  *  currently queued */
 };
 
+/** A consistent snapshot of the timing of a stream, see
+ * \ref pw_stream_get_timing() \memberof pw_stream */
+struct pw_stream_timing {
+	uint64_t version;		/**< incremented for each cycle of the stream */
+	int64_t now;			/**< the monotonic time at the start of the cycle */
+	struct spa_fraction rate;	/**< the rate of \a ticks, \a duration and \a delay */
+	uint64_t ticks;			/**< the ticks at \a now, see struct pw_time */
+	uint64_t duration;		/**< the duration of the cycle in ticks */
+	int64_t delay;			/**< delay to device, see struct pw_time */
+	uint64_t queued;		/**< data queued in the stream, see struct pw_time */
+	double rate_diff;		/**< the rate of the ticks against the monotonic clock */
+	int64_t next_nsec;		/**< the estimated monotonic time of the next cycle */
+};
+
+/** Extrapolate the ticks of \a timing to the monotonic time \a nsec \memberof pw_stream */
+static inline uint64_t pw_stream_timing_ticks(const struct pw_stream_timing *timing, int64_t nsec)
+{
+	double rate_diff = timing->rate_diff > 0.0 ? timing->rate_diff : 1.0;
+
+	if (timing->rate.num == 0)
+		return timing->ticks;
+
+	return timing->ticks + (int64_t)((nsec - timing->now) * rate_diff *
+			timing->rate.denom / (timing->rate.num * (double)SPA_NSEC_PER_SEC));
+}
+
 #include <pipewire/pipewire.h>
 
 /** Events for a stream. These events are always called from the mainloop
@@ -253,6 +281,11 @@ enum pw_stream_flags {
 	PW_STREAM_FLAG_ALLOC_BUFFERS	= (1 << 8),	/**< the application will allocate buffer
 							  *  memory. In the add_buffer event, the
 							  *  data of the buffer should be set */
+	PW_STREAM_FLAG_LOW_WAKEUP	= (1 << 9),	/**< only call process when the stream
+							  *  runs low on buffers, see
+							  *  PW_KEY_STREAM_LOW_WATER. The application
+							  *  should queue or dequeue all the buffers
+							  *  it can in the process callback. */
 };
 
 /** Create a new unconneced \ref pw_stream \memberof pw_stream
@@ -336,6 +369,11 @@ int pw_stream_set_control(struct pw_stream *stream, uint32_t id, uint32_t n_valu
 /** Query the time on the stream \memberof pw_stream */
 int pw_stream_get_time(struct pw_stream *stream, struct pw_time *time);
 
+/** Get a snapshot of the timing of the stream. This does not block and
+ * can be called from any thread at any rate. \a size is the size of
+ * \a timing, newer fields that don't fit are not filled. \memberof pw_stream */
+int pw_stream_get_timing(struct pw_stream *stream, struct pw_stream_timing *timing, size_t size);
+
 /** Get a buffer that can be filled for playback streams or consumed
  * for capture streams.  */
 struct pw_buffer *pw_stream_dequeue_buffer(struct pw_stream *stream);
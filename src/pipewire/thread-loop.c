@@ -30,6 +30,7 @@
 
 #include "log.h"
 #include "thread-loop.h"
+#include "private.h"
 
 #define NAME "thread-loop"
 
@@ -52,6 +53,7 @@ struct pw_thread_loop {
 	pthread_cond_t accept_cond;
 
 	pthread_t thread;
+	char *cpu_exclude;		/**< CPUs to keep the thread off */
 
 	struct spa_hook hook;
 
@@ -104,6 +106,7 @@ static struct pw_thread_loop *loop_new(struct pw_loop *loop,
 	struct pw_thread_loop *this;
 	pthread_mutexattr_t attr;
 	pthread_condattr_t cattr;
+	const char *str;
 	int res;
 
 	this = calloc(1, sizeof(struct pw_thread_loop));
@@ -122,6 +125,9 @@ static struct pw_thread_loop *loop_new(struct pw_loop *loop,
 	}
 	this->loop = loop;
 	this->name = name ? strdup(name) : NULL;
+	if (props != NULL &&
+	    (str = spa_dict_lookup(props, "loop.cpu-exclude")) != NULL)
+		this->cpu_exclude = strdup(str);
 
 	spa_hook_list_init(&this->listener_list);
 
@@ -154,6 +160,7 @@ clean_this:
 	if (this->created && this->loop)
 		pw_loop_destroy(this->loop);
 	free(this->name);
+	free(this->cpu_exclude);
 	free(this);
 	errno = -res;
 	return NULL;
@@ -207,6 +214,7 @@ void pw_thread_loop_destroy(struct pw_thread_loop *loop)
 	pthread_mutex_destroy(&loop->lock);
 
 	free(loop->name);
+	free(loop->cpu_exclude);
 	free(loop);
 }
 
@@ -234,6 +242,8 @@ static void *do_loop(void *user_data)
 	pthread_mutex_lock(&this->lock);
 	pw_log_debug(NAME" %p: enter thread", this);
 	pthread_setname_np(this->thread, this->name ? this->name : "pipewire-thread");
+	if (this->cpu_exclude)
+		pw_thread_set_affinity(pthread_self(), this->cpu_exclude, true);
 	pw_loop_enter(this->loop);
 
 	while (this->running) {
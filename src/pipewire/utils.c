@@ -23,10 +23,15 @@
  */
 
 #include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include <pipewire/array.h>
 #include <pipewire/log.h>
 #include <pipewire/utils.h>
+#include <pipewire/private.h>
 
 /** Split a string based on delimiters
  * \param str a string to split
@@ -138,3 +143,71 @@ char *pw_strip(char *str, const char *whitespace)
 
 	return str;
 }
+
+#ifndef __FreeBSD__
+static int parse_cpu_set(const char *str, cpu_set_t *set)
+{
+	const char *state = NULL, *s;
+	size_t len;
+
+	CPU_ZERO(set);
+	while ((s = pw_split_walk(str, ",", &len, &state))) {
+		char *end;
+		long first, last;
+
+		first = last = strtol(s, &end, 10);
+		if (end < s + len && *end == '-')
+			last = strtol(end + 1, &end, 10);
+		if (end != s + len || first < 0 || last < first || last >= CPU_SETSIZE)
+			return -EINVAL;
+		for (; first <= last; first++)
+			CPU_SET(first, set);
+	}
+	return CPU_COUNT(set) > 0 ? 0 : -EINVAL;
+}
+#endif
+
+/** Set the CPU affinity of a thread
+ * \param thread the thread
+ * \param cpus a list of CPUs like "2-3,6"
+ * \param exclude keep the thread off \a cpus instead of on them
+ * \return 0 on success, < 0 on error
+ *
+ * When \a exclude is true, the thread keeps its current CPUs minus
+ * \a cpus. Nothing is changed when no CPU would be left.
+ */
+SPA_EXPORT
+int pw_thread_set_affinity(pthread_t thread, const char *cpus, bool exclude)
+{
+#ifndef __FreeBSD__
+	cpu_set_t set, cur;
+	int i, res;
+
+	if ((res = parse_cpu_set(cpus, &set)) < 0) {
+		pw_log_warn("invalid cpu list '%s'", cpus);
+		return res;
+	}
+	if (exclude) {
+		if ((res = pthread_getaffinity_np(thread, sizeof(cur), &cur)) != 0)
+			return -res;
+		for (i = 0; i < CPU_SETSIZE; i++)
+			if (CPU_ISSET(i, &set))
+				CPU_CLR(i, &cur);
+		if (CPU_COUNT(&cur) == 0) {
+			pw_log_warn("no cpus left after excluding '%s'", cpus);
+			return -EINVAL;
+		}
+		set = cur;
+	}
+	if ((res = pthread_setaffinity_np(thread, sizeof(set), &set)) != 0) {
+		pw_log_warn("can't set affinity %s'%s': %s", exclude ? "!" : "",
+				cpus, strerror(res));
+		return -res;
+	}
+	pw_log_debug("thread %lu affinity %s'%s'", (unsigned long)thread,
+			exclude ? "!" : "", cpus);
+	return 0;
+#else
+	return -ENOTSUP;
+#endif
+}
@@ -0,0 +1,631 @@
+/* PipeWire
+ *
+ * Copyright © 2020 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include <spa/utils/names.h>
+#include <spa/support/plugin.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/impl.h>
+#include <pipewire/private.h>
+
+/* Measure the scheduler with in-process graphs of fakesrc, fakesink and
+ * audiomixer nodes, driven by the dummy node-driver.
+ *
+ * For each cycle we record the time between the driver waking up the graph
+ * and the graph completing, the part of that time spent outside of the
+ * node process functions (the scheduling overhead) and the number of
+ * allocations and page faults on the data thread. */
+
+#define DEFAULT_CYCLES	500
+#define DEFAULT_WARMUP	50
+#define DEFAULT_QUANTUM	256
+#define DEFAULT_RATE	48000
+#define TIMEOUT_SLACK	(5 * SPA_NSEC_PER_SEC)	/* on top of twice the measuring window */
+#define MAX_MIX_INPUTS	64
+
+enum topology {
+	TOPOLOGY_CHAIN,
+	TOPOLOGY_FAN_IN,
+	TOPOLOGY_FAN_OUT,
+	TOPOLOGY_DAG,
+	TOPOLOGY_LAST,
+};
+
+static const char *topology_names[] = {
+	[TOPOLOGY_CHAIN] = "chain",
+	[TOPOLOGY_FAN_IN] = "fan-in",
+	[TOPOLOGY_FAN_OUT] = "fan-out",
+	[TOPOLOGY_DAG] = "dag",
+};
+
+struct sample {
+	uint64_t busy;		/* driver wakeup to graph finished */
+	uint64_t run;		/* time spent in node process functions */
+	uint64_t allocs;	/* allocations on the data thread */
+	uint64_t faults;	/* page faults on the data thread */
+};
+
+struct data {
+	struct pw_main_loop *loop;
+	struct pw_context *context;
+	struct spa_source *done;
+	struct spa_source *timeout;
+
+	struct pw_impl_node *driver;
+	struct pw_impl_node **nodes;
+	struct spa_handle **handles;
+	uint32_t n_nodes;
+	uint32_t max_nodes;
+	uint32_t n_links;
+	uint32_t n_ready;
+
+	struct spa_hook driver_listener;
+
+	uint32_t warmup;
+	uint32_t n_cycles;
+	uint32_t cycle;
+	uint64_t last_allocs;
+	uint64_t last_faults;
+	struct sample *samples;
+};
+
+#ifdef __GLIBC__
+/* count allocations per thread by wrapping the glibc allocator */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static __thread uint64_t thread_allocs;
+
+void *malloc(size_t size)
+{
+	thread_allocs++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	thread_allocs++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	thread_allocs++;
+	return __libc_realloc(ptr, size);
+}
+#else
+static __thread uint64_t thread_allocs;
+#endif
+
+static void driver_start(void *userdata, struct pw_impl_node *node)
+{
+	struct data *d = userdata;
+	struct pw_node_activation *a = node->rt.activation;
+	struct pw_node_target *t;
+	struct sample *s;
+	struct rusage ru;
+	uint64_t allocs = thread_allocs, faults;
+
+	if (node != d->driver || d->cycle >= d->warmup + d->n_cycles)
+		return;
+
+	getrusage(RUSAGE_THREAD, &ru);
+	faults = ru.ru_minflt + ru.ru_majflt;
+
+	if (d->cycle++ < d->warmup) {
+		d->last_allocs = allocs;
+		d->last_faults = faults;
+		return;
+	}
+
+	s = &d->samples[d->cycle - d->warmup - 1];
+	s->busy = a->finish_time - a->signal_time;
+	s->run = 0;
+	s->allocs = allocs - d->last_allocs;
+	s->faults = faults - d->last_faults;
+	d->last_allocs = allocs;
+	d->last_faults = faults;
+
+	spa_list_for_each(t, &node->rt.target_list, link) {
+		struct pw_node_activation *ta = t->activation;
+
+		if (t->node == NULL || t->node == node ||
+		    ta->status != PW_NODE_ACTIVATION_FINISHED ||
+		    ta->finish_time < ta->awake_time)
+			continue;
+		s->run += ta->finish_time - ta->awake_time;
+	}
+
+	if (d->cycle == d->warmup + d->n_cycles)
+		pw_loop_signal_event(pw_main_loop_get_loop(d->loop), d->done);
+}
+
+static const struct pw_context_driver_events driver_events = {
+	PW_VERSION_CONTEXT_DRIVER_EVENTS,
+	.start = driver_start,
+};
+
+static void on_done(void *userdata, uint64_t count)
+{
+	struct data *d = userdata;
+	pw_main_loop_quit(d->loop);
+}
+
+static void on_timeout(void *userdata, uint64_t expirations)
+{
+	struct data *d = userdata;
+	fprintf(stderr, "timeout waiting for %u cycles\n", d->warmup + d->n_cycles);
+	/* stop the driver so that report() reads stable samples */
+	pw_impl_node_set_active(d->driver, false);
+	pw_main_loop_quit(d->loop);
+}
+
+static struct pw_impl_node *make_node(struct data *d, const char *factory_name, bool driver)
+{
+	struct pw_properties *props;
+	struct pw_impl_node *node;
+	struct spa_handle *handle;
+	void *iface;
+	int res;
+
+	props = pw_properties_new(NULL, NULL);
+	pw_properties_setf(props, PW_KEY_NODE_NAME, "%s.%u", factory_name, d->n_nodes);
+	if (driver)
+		pw_properties_set(props, PW_KEY_NODE_DRIVER, "true");
+	else
+		pw_properties_set(props, PW_KEY_NODE_ALWAYS_PROCESS, "true");
+
+	handle = pw_context_load_spa_handle(d->context, factory_name, &props->dict);
+	if (handle == NULL) {
+		fprintf(stderr, "can't load %s: %m\n", factory_name);
+		goto error_free;
+	}
+	if ((res = spa_handle_get_interface(handle, SPA_TYPE_INTERFACE_Node, &iface)) < 0) {
+		fprintf(stderr, "can't get node interface: %s\n", spa_strerror(res));
+		goto error_unload;
+	}
+	if ((node = pw_context_create_node(d->context, props, 0)) == NULL)
+		goto error_unload;
+
+	pw_impl_node_set_implementation(node, iface);
+	pw_impl_node_register(node, NULL);
+
+	d->nodes[d->n_nodes] = node;
+	d->handles[d->n_nodes] = handle;
+	d->n_nodes++;
+
+	return node;
+
+error_unload:
+	pw_unload_spa_handle(handle);
+error_free:
+	pw_properties_free(props);
+	return NULL;
+}
+
+static struct pw_impl_port *get_port(struct pw_impl_node *node, enum pw_direction direction)
+{
+	struct pw_impl_port *p;
+	uint32_t port_id;
+
+	/* output ports can have many links, input ports of the
+	 * mixer are added as needed */
+	if (direction == PW_DIRECTION_OUTPUT)
+		return pw_impl_node_find_port(node, direction, 0);
+
+	p = pw_impl_node_find_port(node, direction, PW_ID_ANY);
+	if (p != NULL && !pw_impl_port_is_linked(p))
+		return p;
+
+	port_id = node->info.n_input_ports;
+	if (spa_node_add_port(node->node, direction, port_id, NULL) < 0)
+		return NULL;
+
+	return pw_impl_node_find_port(node, direction, port_id);
+}
+
+static void link_state_changed(void *data, enum pw_link_state old,
+		enum pw_link_state state, const char *error)
+{
+	struct data *d = data;
+	uint32_t i;
+
+	if (state == PW_LINK_STATE_ERROR)
+		fprintf(stderr, "link error: %s\n", error);
+
+	if (old >= PW_LINK_STATE_PAUSED || state < PW_LINK_STATE_PAUSED ||
+	    ++d->n_ready < d->n_links)
+		return;
+
+	/* nodes can only start with a format, start the ones that failed
+	 * when they were activated before their links were negotiated */
+	for (i = 0; i < d->n_nodes; i++) {
+		if (d->nodes[i]->info.state != PW_NODE_STATE_RUNNING)
+			pw_impl_node_set_state(d->nodes[i], PW_NODE_STATE_RUNNING);
+	}
+}
+
+static const struct pw_impl_link_events link_events = {
+	PW_VERSION_IMPL_LINK_EVENTS,
+	.state_changed = link_state_changed,
+};
+
+static int make_link(struct data *d, struct pw_impl_node *output, struct pw_impl_node *input)
+{
+	struct pw_impl_port *op, *ip;
+	struct pw_impl_link *link;
+
+	if ((op = get_port(output, PW_DIRECTION_OUTPUT)) == NULL ||
+	    (ip = get_port(input, PW_DIRECTION_INPUT)) == NULL)
+		return -ENOENT;
+
+	link = pw_context_create_link(d->context, op, ip, NULL,
+			pw_properties_new(PW_KEY_LINK_PASSIVE, "false", NULL),
+			sizeof(struct spa_hook));
+	if (link == NULL)
+		return -errno;
+
+	pw_impl_link_add_listener(link, pw_impl_link_get_user_data(link),
+			&link_events, d);
+
+	d->n_links++;
+	return pw_impl_link_register(link, NULL);
+}
+
+#define SRC(d)		make_node(d, "fakesrc", false)
+#define SINK(d)		make_node(d, "fakesink", false)
+#define MIXER(d)	make_node(d, SPA_NAME_AUDIO_MIXER, false)
+
+/* src -> mixer -> ... -> mixer -> sink */
+static int make_chain(struct data *d, uint32_t n_nodes)
+{
+	struct pw_impl_node *prev, *n;
+	uint32_t i;
+
+	prev = SRC(d);
+	for (i = 2; i < n_nodes; i++) {
+		n = MIXER(d);
+		make_link(d, prev, n);
+		prev = n;
+	}
+	make_link(d, prev, SINK(d));
+	return 0;
+}
+
+/* many sources -> mixers with MAX_MIX_INPUTS inputs -> mixer -> sink */
+static int make_fan_in(struct data *d, uint32_t n_nodes)
+{
+	struct pw_impl_node *out, *mix;
+	uint32_t i, n_src, n_mix;
+
+	n_src = n_nodes - 2;
+	if (n_src > MAX_MIX_INPUTS) {
+		n_mix = (n_src + MAX_MIX_INPUTS) / (MAX_MIX_INPUTS + 1);
+		n_src -= n_mix;
+	} else {
+		n_mix = 0;
+	}
+
+	out = mix = MIXER(d);
+	make_link(d, out, SINK(d));
+
+	for (i = 0; i < n_src; i++) {
+		if (n_mix > 0 && i % MAX_MIX_INPUTS == 0) {
+			mix = MIXER(d);
+			make_link(d, mix, out);
+		}
+		make_link(d, SRC(d), mix);
+	}
+	return 0;
+}
+
+/* source -> many sinks */
+static int make_fan_out(struct data *d, uint32_t n_nodes)
+{
+	struct pw_impl_node *src;
+	uint32_t i;
+
+	src = SRC(d);
+	for (i = 1; i < n_nodes; i++)
+		make_link(d, src, SINK(d));
+	return 0;
+}
+
+/* random DAG. Mixers take up to 3 inputs from earlier nodes and nodes
+ * without consumers are linked to a sink. */
+static int make_dag(struct data *d, uint32_t n_nodes)
+{
+	struct pw_impl_node **order;
+	uint32_t *n_inputs, *n_outputs;
+	uint32_t i, j, n_src, n_mix, n;
+
+	n_src = SPA_MAX(1u, n_nodes / 10);
+	n_mix = (n_nodes - n_src) / 2;
+
+	order = calloc(n_src + n_mix, sizeof(struct pw_impl_node *));
+	n_inputs = calloc(n_src + n_mix, sizeof(uint32_t));
+	n_outputs = calloc(n_src + n_mix, sizeof(uint32_t));
+
+	for (i = 0; i < n_src; i++)
+		order[i] = SRC(d);
+
+	for (i = n_src; i < n_src + n_mix; i++) {
+		order[i] = MIXER(d);
+		n = 1 + random() % 3;
+		for (j = 0; j < n; j++) {
+			uint32_t peer = random() % i;
+			if (make_link(d, order[peer], order[i]) >= 0) {
+				n_inputs[i]++;
+				n_outputs[peer]++;
+			}
+		}
+	}
+	for (i = 0; i < n_src + n_mix && d->n_nodes < d->max_nodes; i++) {
+		if (n_outputs[i] == 0)
+			make_link(d, order[i], SINK(d));
+	}
+	free(order);
+	free(n_inputs);
+	free(n_outputs);
+	return 0;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t ua = *(const uint64_t *)a, ub = *(const uint64_t *)b;
+	return ua < ub ? -1 : ua > ub ? 1 : 0;
+}
+
+static void report(struct data *d, enum topology topology, uint32_t quantum)
+{
+	uint64_t *busy, sum_busy = 0, sum_overhead = 0, sum_allocs = 0, sum_faults = 0;
+	/* don't count the driver */
+	uint32_t i, n, n_nodes = d->n_nodes - 1;
+
+	/* a stalled graph might not even have finished the warmup */
+	n = d->cycle > d->warmup ? d->cycle - d->warmup : 0;
+
+	if (n == 0) {
+		fprintf(stdout, "%-8s nodes:%-5u no cycles completed\n",
+				topology_names[topology], n_nodes);
+		return;
+	}
+
+	busy = calloc(n, sizeof(uint64_t));
+	for (i = 0; i < n; i++) {
+		struct sample *s = &d->samples[i];
+		busy[i] = s->busy;
+		sum_busy += s->busy;
+		sum_overhead += s->busy > s->run ? s->busy - s->run : 0;
+		sum_allocs += s->allocs;
+		sum_faults += s->faults;
+	}
+	qsort(busy, n, sizeof(uint64_t), cmp_u64);
+
+#define USEC(v)	((v) / 1000.0)
+	fprintf(stdout, "%-8s nodes:%-5u links:%-5u quantum:%u cycles:%u "
+			"busy:%.1fus overhead:%.1fus/cycle %.3fus/node "
+			"p50:%.1fus p90:%.1fus p99:%.1fus max:%.1fus allocs:%.2f/cycle "
+			"faults:%.2f/cycle\n",
+			topology_names[topology], n_nodes, d->n_links, quantum, n,
+			USEC((double)sum_busy / n),
+			USEC((double)sum_overhead / n),
+			USEC((double)sum_overhead / n / n_nodes),
+			USEC((double)busy[n / 2]),
+			USEC((double)busy[(n * 90) / 100]),
+			USEC((double)busy[(n * 99) / 100]),
+			USEC((double)busy[n - 1]),
+			(double)sum_allocs / n,
+			(double)sum_faults / n);
+#undef USEC
+	free(busy);
+}
+
+static int run_benchmark(enum topology topology, uint32_t n_nodes,
+		uint32_t n_cycles, uint32_t quantum, bool lock)
+{
+	struct data data = { 0, }, *d = &data;
+	struct pw_properties *props;
+	struct pw_loop *l;
+	struct timespec timeout;
+	uint64_t window;
+	uint32_t i;
+	int res = 0;
+
+	d->loop = pw_main_loop_new(NULL);
+	l = pw_main_loop_get_loop(d->loop);
+
+	props = pw_properties_new(
+			PW_KEY_CONTEXT_PROFILE_MODULES, "none",
+			NULL);
+	pw_properties_setf(props, "default.clock.rate", "%u", DEFAULT_RATE);
+	pw_properties_setf(props, "default.clock.quantum", "%u", quantum);
+	pw_properties_setf(props, "default.clock.min-quantum", "%u", quantum);
+	if (lock) {
+		pw_properties_set(props, PW_KEY_MEM_PREFAULT, "true");
+		pw_properties_set(props, PW_KEY_MEM_MLOCK, "true");
+	}
+	d->context = pw_context_new(l, props, 0);
+
+	pw_context_add_spa_lib(d->context, "fakesrc|fakesink", "test/libspa-test");
+	pw_context_add_spa_lib(d->context, "audio.mixer", "audiomixer/libspa-audiomixer");
+	pw_context_add_spa_lib(d->context, "support.*", "support/libspa-support");
+
+	d->done = pw_loop_add_event(l, on_done, d);
+	d->warmup = DEFAULT_WARMUP;
+	d->n_cycles = n_cycles;
+
+	/* don't wait forever when the graph stalls, report what we have */
+	window = (uint64_t)(d->warmup + n_cycles) * quantum * SPA_NSEC_PER_SEC / DEFAULT_RATE;
+	window = window * 2 + TIMEOUT_SLACK;
+	timeout.tv_sec = window / SPA_NSEC_PER_SEC;
+	timeout.tv_nsec = window % SPA_NSEC_PER_SEC;
+	d->timeout = pw_loop_add_timer(l, on_timeout, d);
+	d->samples = calloc(n_cycles, sizeof(struct sample));
+	/* a random DAG adds sinks for the unconsumed nodes */
+	d->max_nodes = n_nodes * 2 + 1;
+	d->nodes = calloc(d->max_nodes, sizeof(struct pw_impl_node *));
+	d->handles = calloc(d->max_nodes, sizeof(struct spa_handle *));
+
+	if ((d->driver = make_node(d, SPA_NAME_SUPPORT_NODE_DRIVER, true)) == NULL) {
+		res = -ENOENT;
+		goto exit;
+	}
+
+	spa_hook_list_append(&d->context->driver_listener_list,
+			&d->driver_listener, &driver_events, d);
+
+	switch (topology) {
+	case TOPOLOGY_CHAIN:
+		make_chain(d, SPA_MAX(n_nodes, 2u));
+		break;
+	case TOPOLOGY_FAN_IN:
+		make_fan_in(d, SPA_MAX(n_nodes, 3u));
+		break;
+	case TOPOLOGY_FAN_OUT:
+		make_fan_out(d, SPA_MAX(n_nodes, 2u));
+		break;
+	case TOPOLOGY_DAG:
+		make_dag(d, SPA_MAX(n_nodes, 4u));
+		break;
+	default:
+		break;
+	}
+	/* activate when all links are made so that nodes only start
+	 * with a format */
+	for (i = 0; i < d->n_nodes; i++)
+		pw_impl_node_set_active(d->nodes[i], true);
+
+	pw_loop_update_timer(l, d->timeout, &timeout, NULL, false);
+	pw_main_loop_run(d->loop);
+
+	spa_hook_remove(&d->driver_listener);
+
+	report(d, topology, quantum);
+
+exit:
+	/* the handles use the context support, unload them first */
+	for (i = 0; i < d->max_nodes; i++) {
+		if (d->nodes[i])
+			pw_impl_node_destroy(d->nodes[i]);
+		if (d->handles[i])
+			pw_unload_spa_handle(d->handles[i]);
+	}
+	pw_context_destroy(d->context);
+	pw_loop_destroy_source(l, d->done);
+	pw_loop_destroy_source(l, d->timeout);
+	pw_main_loop_destroy(d->loop);
+	free(d->samples);
+	free(d->nodes);
+	free(d->handles);
+
+	return res;
+}
+
+static void show_help(const char *name)
+{
+	fprintf(stdout, "%s [options]\n"
+		"  -h, --help                            Show this help\n"
+		"  -t, --topology                        Topology to run: chain, fan-in, fan-out, dag\n"
+		"                                        (default all)\n"
+		"  -n, --nodes                           Number of nodes (default 10, 100 and 1000)\n"
+		"  -c, --cycles                          Number of measured cycles (default %u)\n"
+		"  -q, --quantum                         Quantum in samples (default %u)\n"
+		"  -l, --lock                            Prefault and lock the memory pool\n",
+		name, DEFAULT_CYCLES, DEFAULT_QUANTUM);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{ "help",	no_argument,		NULL, 'h' },
+		{ "topology",	required_argument,	NULL, 't' },
+		{ "nodes",	required_argument,	NULL, 'n' },
+		{ "cycles",	required_argument,	NULL, 'c' },
+		{ "quantum",	required_argument,	NULL, 'q' },
+		{ "lock",	no_argument,		NULL, 'l' },
+		{ NULL, 0, NULL, 0}
+	};
+	static const uint32_t default_sizes[] = { 10, 100, 1000 };
+	int c, t, topology = -1;
+	uint32_t i, n_nodes = 0, n_cycles = DEFAULT_CYCLES, quantum = DEFAULT_QUANTUM;
+	bool lock = false;
+
+	pw_init(&argc, &argv);
+
+	while ((c = getopt_long(argc, argv, "ht:n:c:q:l", long_options, NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			show_help(argv[0]);
+			return 0;
+		case 't':
+			for (t = 0; t < TOPOLOGY_LAST; t++)
+				if (strcmp(optarg, topology_names[t]) == 0)
+					topology = t;
+			if (topology == -1) {
+				fprintf(stderr, "unknown topology %s\n", optarg);
+				return -1;
+			}
+			break;
+		case 'n':
+			n_nodes = atoi(optarg);
+			break;
+		case 'c':
+			n_cycles = SPA_MAX(atoi(optarg), 1);
+			break;
+		case 'q':
+			quantum = atoi(optarg);
+			break;
+		case 'l':
+			lock = true;
+			break;
+		default:
+			show_help(argv[0]);
+			return -1;
+		}
+	}
+
+	for (t = 0; t < TOPOLOGY_LAST; t++) {
+		if (topology != -1 && t != topology)
+			continue;
+		if (n_nodes != 0) {
+			if (run_benchmark(t, n_nodes, n_cycles, quantum, lock) < 0)
+				return -1;
+			continue;
+		}
+		for (i = 0; i < SPA_N_ELEMENTS(default_sizes); i++) {
+			if (run_benchmark(t, default_sizes[i], n_cycles, quantum, lock) < 0)
+				return -1;
+		}
+	}
+	return 0;
+}
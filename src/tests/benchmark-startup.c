@@ -0,0 +1,183 @@
+/* PipeWire
+ *
+ * Copyright © 2020 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+
+#include <spa/param/audio/format-utils.h>
+
+#include <pipewire/pipewire.h>
+
+/* Measure the time it takes a client to go from process start to a
+ * connected and streaming pw_stream. This covers plugin loading in
+ * pw_init, the context and core connection and the negotiation with
+ * the daemon. A running daemon is required. */
+
+#define TIMEOUT_SEC	5
+
+struct data {
+	struct pw_main_loop *loop;
+	struct pw_stream *stream;
+	struct spa_source *timeout;
+
+	uint64_t t_start;
+	uint64_t t_init;
+	uint64_t t_paused;
+	uint64_t t_streaming;
+	uint64_t t_process;
+	int res;
+};
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_NSEC(&ts);
+}
+
+static void on_state_changed(void *userdata, enum pw_stream_state old,
+		enum pw_stream_state state, const char *error)
+{
+	struct data *data = userdata;
+
+	switch (state) {
+	case PW_STREAM_STATE_ERROR:
+		fprintf(stderr, "stream error: %s\n", error);
+		data->res = -EIO;
+		pw_main_loop_quit(data->loop);
+		break;
+	case PW_STREAM_STATE_UNCONNECTED:
+		data->res = -EPIPE;
+		pw_main_loop_quit(data->loop);
+		break;
+	case PW_STREAM_STATE_PAUSED:
+		if (data->t_paused == 0)
+			data->t_paused = get_time_ns();
+		break;
+	case PW_STREAM_STATE_STREAMING:
+		if (data->t_streaming == 0)
+			data->t_streaming = get_time_ns();
+		break;
+	default:
+		break;
+	}
+}
+
+static void on_process(void *userdata)
+{
+	struct data *data = userdata;
+	struct pw_buffer *b;
+
+	if ((b = pw_stream_dequeue_buffer(data->stream)) == NULL)
+		return;
+
+	b->buffer->datas[0].chunk->size = 0;
+	pw_stream_queue_buffer(data->stream, b);
+
+	if (data->t_process == 0) {
+		data->t_process = get_time_ns();
+		pw_main_loop_quit(data->loop);
+	}
+}
+
+static const struct pw_stream_events stream_events = {
+	PW_VERSION_STREAM_EVENTS,
+	.state_changed = on_state_changed,
+	.process = on_process,
+};
+
+static void on_timeout(void *userdata, uint64_t expirations)
+{
+	struct data *data = userdata;
+	fprintf(stderr, "timeout waiting for stream\n");
+	data->res = -ETIMEDOUT;
+	pw_main_loop_quit(data->loop);
+}
+
+static void print_delta(const char *what, uint64_t start, uint64_t t)
+{
+	if (t == 0)
+		fprintf(stdout, "%-20s: -\n", what);
+	else
+		fprintf(stdout, "%-20s: %f ms\n", what, (t - start) / (float)SPA_NSEC_PER_MSEC);
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { 0, };
+	const struct spa_pod *params[1];
+	uint8_t buffer[1024];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	struct pw_loop *l;
+	struct timespec timeout = { TIMEOUT_SEC, 0 };
+
+	data.t_start = get_time_ns();
+
+	pw_init(&argc, &argv);
+
+	data.t_init = get_time_ns();
+
+	data.loop = pw_main_loop_new(NULL);
+	l = pw_main_loop_get_loop(data.loop);
+
+	data.timeout = pw_loop_add_timer(l, on_timeout, &data);
+	pw_loop_update_timer(l, data.timeout, &timeout, NULL, false);
+
+	data.stream = pw_stream_new_simple(l,
+			"benchmark-startup",
+			pw_properties_new(
+				PW_KEY_MEDIA_TYPE, "Audio",
+				PW_KEY_MEDIA_CATEGORY, "Playback",
+				PW_KEY_MEDIA_ROLE, "Music",
+				NULL),
+			&stream_events,
+			&data);
+
+	params[0] = spa_format_audio_raw_build(&b, SPA_PARAM_EnumFormat,
+			&SPA_AUDIO_INFO_RAW_INIT(
+				.format = SPA_AUDIO_FORMAT_F32,
+				.channels = 2,
+				.rate = 48000 ));
+
+	pw_stream_connect(data.stream,
+			  PW_DIRECTION_OUTPUT,
+			  PW_ID_ANY,
+			  PW_STREAM_FLAG_AUTOCONNECT |
+			  PW_STREAM_FLAG_MAP_BUFFERS,
+			  params, 1);
+
+	pw_main_loop_run(data.loop);
+
+	print_delta("pw_init", data.t_start, data.t_init);
+	print_delta("stream paused", data.t_start, data.t_paused);
+	print_delta("stream streaming", data.t_start, data.t_streaming);
+	print_delta("first process", data.t_start, data.t_process);
+
+	pw_stream_destroy(data.stream);
+	pw_loop_destroy_source(l, data.timeout);
+	pw_main_loop_destroy(data.loop);
+
+	return data.res < 0 ? -1 : 0;
+}
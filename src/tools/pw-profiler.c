@@ -58,6 +58,9 @@ struct data {
 	int64_t count;
 	int64_t start_status;
 	int64_t last_status;
+	int64_t last_count;
+	uint64_t last_position;
+	uint64_t last_migrations;
 
 	struct pw_proxy *profiler;
 	struct spa_hook profiler_listener;
@@ -167,6 +170,24 @@ static int add_follower(struct data *d, uint32_t id, const char *name)
 	return idx;
 }
 
+static int process_data_thread(struct data *d, const struct spa_pod *pod, struct point *point)
+{
+	int32_t cpu;
+	int64_t migrations;
+
+	if (spa_pod_parse_struct(pod,
+			SPA_POD_Int(&cpu),
+			SPA_POD_Long(&migrations)) < 0)
+		return 0;
+
+	if ((uint64_t)migrations != d->last_migrations) {
+		fprintf(stderr, "\ndata thread migrated to CPU %d (%"PRIi64" migrations)\n",
+				cpu, migrations);
+		d->last_migrations = migrations;
+	}
+	return 0;
+}
+
 static int process_follower_block(struct data *d, const struct spa_pod *pod, struct point *point)
 {
 	uint32_t id;
@@ -240,12 +261,29 @@ static void dump_point(struct data *d, struct point *point)
 	if (d->count == 0) {
 		d->start_status = point->clock.nsec;
 		d->last_status = point->clock.nsec;
+		d->last_count = point->count;
+		d->last_position = point->clock.position;
 	}
 	else if (point->clock.nsec - d->last_status > SPA_NSEC_PER_SEC) {
-		fprintf(stderr, "logging %"PRIi64" samples  %"PRIi64" seconds [CPU %f %f %f]\r",
+		if (SPA_FLAG_IS_SET(point->clock.flags, SPA_IO_CLOCK_FLAG_FREEWHEEL) &&
+		    point->clock.rate.denom > 0) {
+			/* the profiler only samples freewheel cycles, use the
+			 * cycle count and clock position for the throughput */
+			double elapsed = (point->clock.nsec - d->last_status) / (double)SPA_NSEC_PER_SEC;
+			double media = (point->clock.position - d->last_position) /
+				(double)point->clock.rate.denom;
+
+			fprintf(stderr, "freewheel %.0f cycles/s  %.1f times real time [CPU %f %f %f]\r",
+				(point->count - d->last_count) / elapsed, media / elapsed,
+				point->cpu_load[0], point->cpu_load[1], point->cpu_load[2]);
+		} else {
+			fprintf(stderr, "logging %"PRIi64" samples  %"PRIi64" seconds [CPU %f %f %f]\r",
 				d->count, (int64_t) ((d->last_status - d->start_status) / SPA_NSEC_PER_SEC),
 				point->cpu_load[0], point->cpu_load[1], point->cpu_load[2]);
+		}
 		d->last_status = point->clock.nsec;
+		d->last_count = point->count;
+		d->last_position = point->clock.position;
 	}
 	d->count++;
 }
@@ -446,6 +484,9 @@ static void profiler_profile(void *data, const struct spa_pod *pod)
 			case SPA_PROFILER_driverBlock:
 				res = process_driver_block(d, &p->value, &point);
 				break;
+			case SPA_PROFILER_dataThread:
+				res = process_data_thread(d, &p->value, &point);
+				break;
 			case SPA_PROFILER_followerBlock:
 				process_follower_block(d, &p->value, &point);
 				break;
@@ -0,0 +1,596 @@
+/* PipeWire
+ *
+ * Copyright © 2020 Wim Taymans
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <signal.h>
+#include <getopt.h>
+#include <unistd.h>
+
+#include <spa/utils/result.h>
+#include <spa/pod/parser.h>
+#include <spa/param/profiler.h>
+
+#include <pipewire/impl.h>
+#include <extensions/profiler.h>
+
+#define MAX_NAME		128
+#define MAX_NODES		256
+#define DEFAULT_INTERVAL	1
+
+/* deadline usage above which a node is highlighted */
+#define DL_WARN			0.75
+#define DL_ERROR		1.0
+
+struct measurement {
+	int64_t prev_signal;
+	int64_t signal;
+	int64_t awake;
+	int64_t finish;
+	int32_t status;
+	int32_t xrun_count;
+};
+
+struct node {
+	uint32_t id;
+	char name[MAX_NAME];
+	uint32_t driver_id;
+
+	int64_t quantum;
+	uint32_t rate;
+	int64_t period;			/**< duration of the quantum in nsec */
+
+	/* accumulated over one interval */
+	unsigned int seen:1;
+	uint32_t cycles;
+	int64_t wait_sum;
+	int64_t busy_sum;
+	int64_t busy_max;
+	int64_t deadline_max;		/**< max finish time after the driver signal */
+
+	int32_t first_xruns;
+	int32_t xruns;			/**< xruns since the node was first seen */
+
+	/* values of the last interval, used for display */
+	float wait;
+	float busy;
+	float max_busy;
+	float busy_ratio;
+	float deadline;
+	float group_deadline;		/**< worst deadline of the driver and its followers */
+};
+
+struct data {
+	struct pw_main_loop *loop;
+	struct pw_context *context;
+
+	struct pw_core *core;
+	struct spa_hook core_listener;
+
+	struct pw_registry *registry;
+	struct spa_hook registry_listener;
+
+	struct pw_proxy *profiler;
+	struct spa_hook profiler_listener;
+	int check_profiler;
+
+	struct spa_source *timer;
+	uint32_t interval;
+	unsigned int batch:1;
+	unsigned int color:1;
+
+	uint32_t n_nodes;
+	struct node nodes[MAX_NODES];
+};
+
+struct point {
+	struct spa_io_clock clock;
+	uint32_t driver_id;
+	struct measurement driver;
+};
+
+static struct node *find_node(struct data *d, uint32_t id, const char *name)
+{
+	struct node *n;
+	uint32_t i;
+
+	for (i = 0; i < d->n_nodes; i++) {
+		n = &d->nodes[i];
+		if (n->id == id && strcmp(n->name, name) == 0)
+			return n;
+	}
+	if (d->n_nodes == MAX_NODES)
+		return NULL;
+
+	n = &d->nodes[d->n_nodes++];
+	spa_zero(*n);
+	n->id = id;
+	strncpy(n->name, name, MAX_NAME);
+	n->name[MAX_NAME-1] = '\0';
+	n->first_xruns = -1;
+	return n;
+}
+
+static int parse_block(const struct spa_pod *pod, uint32_t *id, const char **name,
+		struct measurement *m)
+{
+	struct spa_pod_parser prs;
+	struct spa_pod_frame f;
+	int res;
+
+	spa_zero(*m);
+	spa_pod_parser_pod(&prs, pod);
+	if ((res = spa_pod_parser_push_struct(&prs, &f)) < 0)
+		return res;
+	if ((res = spa_pod_parser_get(&prs,
+			SPA_POD_Int(id),
+			SPA_POD_String(name),
+			SPA_POD_Long(&m->prev_signal),
+			SPA_POD_Long(&m->signal),
+			SPA_POD_Long(&m->awake),
+			SPA_POD_Long(&m->finish),
+			SPA_POD_Int(&m->status),
+			NULL)) < 0)
+		return res;
+	/* older servers don't send the xrun count */
+	m->xrun_count = -1;
+	spa_pod_parser_get(&prs,
+			SPA_POD_Int(&m->xrun_count),
+			NULL);
+	return 0;
+}
+
+static void update_node(struct data *d, struct node *n, struct point *point,
+		const struct measurement *m)
+{
+	n->seen = true;
+	n->driver_id = point->driver_id;
+	n->quantum = point->clock.duration;
+	n->rate = point->clock.rate.denom;
+	if (n->rate > 0)
+		n->period = n->quantum * SPA_NSEC_PER_SEC / n->rate;
+
+	if (m->xrun_count >= 0) {
+		if (n->first_xruns < 0)
+			n->first_xruns = m->xrun_count;
+		n->xruns = m->xrun_count - n->first_xruns;
+	}
+
+	/* the node did not run completely in this cycle */
+	if (m->signal <= 0 || m->awake < m->signal || m->finish < m->awake)
+		return;
+
+	n->cycles++;
+	n->wait_sum += m->awake - m->signal;
+	n->busy_sum += m->finish - m->awake;
+	n->busy_max = SPA_MAX(n->busy_max, m->finish - m->awake);
+	if (m->finish > point->driver.signal)
+		n->deadline_max = SPA_MAX(n->deadline_max, m->finish - point->driver.signal);
+}
+
+static int process_clock(struct data *d, const struct spa_pod *pod, struct point *point)
+{
+	return spa_pod_parse_struct(pod,
+			SPA_POD_Int(&point->clock.flags),
+			SPA_POD_Int(&point->clock.id),
+			SPA_POD_Stringn(point->clock.name, sizeof(point->clock.name)),
+			SPA_POD_Long(&point->clock.nsec),
+			SPA_POD_Fraction(&point->clock.rate),
+			SPA_POD_Long(&point->clock.position),
+			SPA_POD_Long(&point->clock.duration),
+			SPA_POD_Long(&point->clock.delay),
+			SPA_POD_Double(&point->clock.rate_diff),
+			SPA_POD_Long(&point->clock.next_nsec));
+}
+
+static int process_driver_block(struct data *d, const struct spa_pod *pod, struct point *point)
+{
+	const char *name;
+	struct node *n;
+	int res;
+
+	if ((res = parse_block(pod, &point->driver_id, &name, &point->driver)) < 0)
+		return res;
+
+	if ((n = find_node(d, point->driver_id, name)) == NULL)
+		return -ENOSPC;
+
+	update_node(d, n, point, &point->driver);
+	return 0;
+}
+
+static int process_follower_block(struct data *d, const struct spa_pod *pod, struct point *point)
+{
+	const char *name;
+	struct measurement m;
+	struct node *n;
+	uint32_t id;
+	int res;
+
+	if ((res = parse_block(pod, &id, &name, &m)) < 0)
+		return res;
+
+	if ((n = find_node(d, id, name)) == NULL)
+		return -ENOSPC;
+
+	update_node(d, n, point, &m);
+	return 0;
+}
+
+static void profiler_profile(void *data, const struct spa_pod *pod)
+{
+	struct data *d = data;
+	struct spa_pod *o;
+	struct spa_pod_prop *p;
+	struct point point;
+
+	SPA_POD_STRUCT_FOREACH(pod, o) {
+		int res = 0;
+		if (!spa_pod_is_object_type(o, SPA_TYPE_OBJECT_Profiler))
+			continue;
+
+		spa_zero(point);
+		SPA_POD_OBJECT_FOREACH((struct spa_pod_object*)o, p) {
+			switch(p->key) {
+			case SPA_PROFILER_clock:
+				res = process_clock(d, &p->value, &point);
+				break;
+			case SPA_PROFILER_driverBlock:
+				res = process_driver_block(d, &p->value, &point);
+				break;
+			case SPA_PROFILER_followerBlock:
+				/* the followers are measured against the driver */
+				if (point.driver_id != 0)
+					process_follower_block(d, &p->value, &point);
+				break;
+			default:
+				break;
+			}
+			if (res < 0)
+				break;
+		}
+	}
+}
+
+static const struct pw_profiler_events profiler_events = {
+	PW_VERSION_PROFILER_EVENTS,
+	.profile = profiler_profile,
+};
+
+/* compute the display values of the last interval, nodes that were
+ * not scheduled in the interval are removed */
+static void finish_interval(struct data *d)
+{
+	uint32_t i, j;
+
+	for (i = 0; i < d->n_nodes;) {
+		struct node *n = &d->nodes[i];
+
+		if (!n->seen) {
+			d->nodes[i] = d->nodes[--d->n_nodes];
+			continue;
+		}
+		if (n->cycles > 0 && n->period > 0) {
+			n->wait = n->wait_sum / (float)n->cycles;
+			n->busy = n->busy_sum / (float)n->cycles;
+			n->max_busy = n->busy_max;
+			n->busy_ratio = n->busy / n->period;
+			n->deadline = n->deadline_max / (float)n->period;
+		} else {
+			n->wait = n->busy = n->max_busy = 0.0f;
+			n->busy_ratio = n->deadline = 0.0f;
+		}
+		n->group_deadline = n->deadline;
+
+		n->seen = false;
+		n->cycles = 0;
+		n->wait_sum = n->busy_sum = n->busy_max = n->deadline_max = 0;
+		i++;
+	}
+	for (i = 0; i < d->n_nodes; i++) {
+		struct node *n = &d->nodes[i];
+
+		if (n->id == n->driver_id)
+			continue;
+		for (j = 0; j < d->n_nodes; j++) {
+			struct node *dr = &d->nodes[j];
+			if (dr->id == n->driver_id)
+				dr->group_deadline = SPA_MAX(dr->group_deadline, n->deadline);
+		}
+	}
+}
+
+static int compare_deadline(float a, float b, uint32_t ida, uint32_t idb)
+{
+	if (a != b)
+		return a < b ? 1 : -1;
+	return ida < idb ? -1 : (ida > idb);
+}
+
+static int compare_driver(const void *a, const void *b)
+{
+	const struct node *na = *(const struct node **)a;
+	const struct node *nb = *(const struct node **)b;
+	return compare_deadline(na->group_deadline, nb->group_deadline, na->id, nb->id);
+}
+
+static int compare_follower(const void *a, const void *b)
+{
+	const struct node *na = *(const struct node **)a;
+	const struct node *nb = *(const struct node **)b;
+	return compare_deadline(na->deadline, nb->deadline, na->id, nb->id);
+}
+
+static void print_node(struct data *d, struct node *n, bool follower)
+{
+	const char *start = "", *end = "";
+
+	if (d->color) {
+		end = "\033[0m";
+		if (n->deadline >= DL_ERROR || n->xruns > 0)
+			start = "\033[1;31m";
+		else if (n->deadline >= DL_WARN)
+			start = "\033[1;33m";
+		else
+			end = "";
+	}
+	fprintf(stdout, "%s%5u %6"PRIi64" %6u %8.1f %8.1f %8.1f %5.2f %5.2f %5d  %s%s%s\n",
+			start, n->id, n->quantum, n->rate,
+			n->wait / 1000.0f, n->busy / 1000.0f, n->max_busy / 1000.0f,
+			n->busy_ratio, n->deadline, n->xruns,
+			follower ? " + " : "", n->name, end);
+}
+
+static void redraw(struct data *d)
+{
+	struct node *drivers[MAX_NODES], *followers[MAX_NODES];
+	uint32_t i, j, n_drivers = 0, n_followers;
+
+	for (i = 0; i < d->n_nodes; i++) {
+		if (d->nodes[i].id == d->nodes[i].driver_id)
+			drivers[n_drivers++] = &d->nodes[i];
+	}
+	qsort(drivers, n_drivers, sizeof(struct node *), compare_driver);
+
+	if (!d->batch)
+		fprintf(stdout, "\033[H\033[2J");
+
+	fprintf(stdout, "%5s %6s %6s %8s %8s %8s %5s %5s %5s  %s\n",
+			"ID", "QUANT", "RATE", "WAIT", "BUSY", "MAXBUSY",
+			"B/Q", "DL", "ERR", "NAME");
+
+	for (i = 0; i < n_drivers; i++) {
+		print_node(d, drivers[i], false);
+
+		n_followers = 0;
+		for (j = 0; j < d->n_nodes; j++) {
+			struct node *n = &d->nodes[j];
+			if (n->driver_id == drivers[i]->id && n != drivers[i])
+				followers[n_followers++] = n;
+		}
+		qsort(followers, n_followers, sizeof(struct node *), compare_follower);
+
+		for (j = 0; j < n_followers; j++)
+			print_node(d, followers[j], true);
+	}
+	if (d->batch)
+		fprintf(stdout, "\n");
+	fflush(stdout);
+}
+
+static void on_timeout(void *data, uint64_t expirations)
+{
+	struct data *d = data;
+
+	finish_interval(d);
+	redraw(d);
+}
+
+static void registry_event_global(void *data, uint32_t id,
+				  uint32_t permissions, const char *type, uint32_t version,
+				  const struct spa_dict *props)
+{
+	struct data *d = data;
+	struct pw_proxy *proxy;
+
+	if (strcmp(type, PW_TYPE_INTERFACE_Profiler) != 0)
+		return;
+
+	if (d->profiler != NULL) {
+		fprintf(stderr, "Ignoring profiler %d: already attached\n", id);
+		return;
+	}
+
+	proxy = pw_registry_bind(d->registry, id, type, PW_VERSION_PROFILER, 0);
+	if (proxy == NULL)
+		goto error_proxy;
+
+	d->profiler = proxy;
+	pw_proxy_add_object_listener(proxy, &d->profiler_listener, &profiler_events, d);
+
+	return;
+
+error_proxy:
+	pw_log_error("failed to create proxy: %m");
+	return;
+}
+
+static const struct pw_registry_events registry_events = {
+	PW_VERSION_REGISTRY_EVENTS,
+	.global = registry_event_global,
+};
+
+static void on_core_error(void *_data, uint32_t id, int seq, int res, const char *message)
+{
+	struct data *data = _data;
+
+	pw_log_error("error id:%u seq:%d res:%d (%s): %s",
+			id, seq, res, spa_strerror(res), message);
+
+	if (id == PW_ID_CORE)
+		pw_main_loop_quit(data->loop);
+}
+
+static void on_core_done(void *_data, uint32_t id, int seq)
+{
+	struct data *d = _data;
+
+	if (seq == d->check_profiler) {
+		if (d->profiler == NULL) {
+			pw_log_error("no Profiler Interface found, please load one in the server");
+			pw_main_loop_quit(d->loop);
+		}
+	}
+}
+
+static const struct pw_core_events core_events = {
+	PW_VERSION_CORE_EVENTS,
+	.error = on_core_error,
+	.done = on_core_done,
+};
+
+static void do_quit(void *data, int signal_number)
+{
+	struct data *d = data;
+	pw_main_loop_quit(d->loop);
+}
+
+static void show_help(const char *name)
+{
+        fprintf(stdout, "%s [options]\n"
+		"  -h, --help                            Show this help\n"
+		"      --version                         Show version\n"
+		"  -r, --remote                          Remote daemon name\n"
+		"  -i, --interval                        Update interval in seconds (default %d)\n"
+		"  -b, --batch                           Batch mode, don't clear the screen\n"
+		"\n"
+		"Columns: WAIT, BUSY and MAXBUSY are in usec, B/Q is the average\n"
+		"busy time and DL the worst finish time relative to the quantum.\n",
+		name,
+		DEFAULT_INTERVAL);
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { 0 };
+	struct pw_loop *l;
+	const char *opt_remote = NULL;
+	struct timespec value, interval;
+	static const struct option long_options[] = {
+		{ "help",	no_argument,		NULL, 'h' },
+		{ "version",	no_argument,		NULL, 'V' },
+		{ "remote",	required_argument,	NULL, 'r' },
+		{ "interval",	required_argument,	NULL, 'i' },
+		{ "batch",	no_argument,		NULL, 'b' },
+		{ NULL, 0, NULL, 0}
+	};
+	int c;
+
+	pw_init(&argc, &argv);
+
+	data.interval = DEFAULT_INTERVAL;
+
+	while ((c = getopt_long(argc, argv, "hVr:i:b", long_options, NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			show_help(argv[0]);
+			return 0;
+		case 'V':
+			fprintf(stdout, "%s\n"
+				"Compiled with libpipewire %s\n"
+				"Linked with libpipewire %s\n",
+				argv[0],
+				pw_get_headers_version(),
+				pw_get_library_version());
+			return 0;
+		case 'r':
+			opt_remote = optarg;
+			break;
+		case 'i':
+			data.interval = atoi(optarg);
+			if (data.interval == 0) {
+				fprintf(stderr, "invalid interval %s\n", optarg);
+				return -1;
+			}
+			break;
+		case 'b':
+			data.batch = true;
+			break;
+		default:
+			show_help(argv[0]);
+			return -1;
+		}
+	}
+	data.color = !data.batch && isatty(STDOUT_FILENO);
+
+	data.loop = pw_main_loop_new(NULL);
+	if (data.loop == NULL) {
+		fprintf(stderr, "Can't create data loop: %m\n");
+		return -1;
+	}
+
+	l = pw_main_loop_get_loop(data.loop);
+	pw_loop_add_signal(l, SIGINT, do_quit, &data);
+	pw_loop_add_signal(l, SIGTERM, do_quit, &data);
+
+	data.context = pw_context_new(l, NULL, 0);
+	if (data.context == NULL) {
+		fprintf(stderr, "Can't create context: %m\n");
+		return -1;
+	}
+
+	pw_context_load_module(data.context, PW_EXTENSION_MODULE_PROFILER, NULL, NULL);
+
+	data.core = pw_context_connect(data.context,
+			pw_properties_new(
+				PW_KEY_REMOTE_NAME, opt_remote,
+				NULL),
+			0);
+	if (data.core == NULL) {
+		fprintf(stderr, "Can't connect: %m\n");
+		return -1;
+	}
+
+	pw_core_add_listener(data.core,
+				   &data.core_listener,
+				   &core_events, &data);
+	data.registry = pw_core_get_registry(data.core,
+					  PW_VERSION_REGISTRY, 0);
+	pw_registry_add_listener(data.registry,
+				       &data.registry_listener,
+				       &registry_events, &data);
+
+	data.check_profiler = pw_core_sync(data.core, 0, 0);
+
+	data.timer = pw_loop_add_timer(l, on_timeout, &data);
+	value.tv_sec = interval.tv_sec = data.interval;
+	value.tv_nsec = interval.tv_nsec = 0;
+	pw_loop_update_timer(l, data.timer, &value, &interval, false);
+
+	pw_main_loop_run(data.loop);
+
+	pw_context_destroy(data.context);
+	pw_main_loop_destroy(data.loop);
+
+	return 0;
+}